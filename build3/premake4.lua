@@ -79,6 +79,12 @@
 		description = "Disable unit tests using gtest"
 	}
 
+	newoption
+	{
+		trigger = "threadsafe",
+		description = "Compile the Bullet 2 libraries with BT_THREADSAFE=1 and the multi-threading tests (needs a C++11 compiler)"
+	}
+
 	configurations {"Release", "Debug"}
 	configuration "Release"
 		flags { "Optimize", "EnableSSE2","StaticRuntime", "NoMinimalRebuild", "FloatFast"}
@@ -153,6 +159,10 @@
 		defines {"NO_OPENGL3"}
 	end
 
+	if _OPTIONS["threadsafe"] then
+		defines {"BT_THREADSAFE=1"}
+	end
+
 	language "C++"
 
 if not _OPTIONS["ios"] then
@@ -189,6 +199,11 @@ if not _OPTIONS["ios"] then
                 include "../test/gtest-1.7.0"
 --              include "../test/hello_gtest"
                 include "../test/collision"
+                include "../test/dynamics"
+                if _OPTIONS["threadsafe"] then
+                        include "../test/determinism"
+                end
+                include "../test/multibody"
                 include "../test/TestBullet3OpenCL"
                 include "../test/GwenOpenGLTest"
         end
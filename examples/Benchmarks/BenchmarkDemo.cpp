@@ -126,6 +126,7 @@ public:
 	btVector3 direction[NUMRAYS];
 	btVector3 hit[NUMRAYS];
 	btVector3 normal[NUMRAYS];
+	btCollisionWorld::BatchedRayResult result[NUMRAYS];
 	struct GUIHelperInterface* m_guiHelper;
 	
 	int frame_counter;
@@ -228,15 +229,13 @@ public:
 				normal[i].normalize ();
 		}
 #else
+		cw->rayTestBatch (source, dest, NUMRAYS, result);
 		for (int i = 0; i < NUMRAYS; i++)
 		{
-			btCollisionWorld::ClosestRayResultCallback cb(source[i], dest[i]);
-			
-			cw->rayTest (source[i], dest[i], cb);
-			if (cb.hasHit ())
+			if (result[i].m_collisionObject)
 			{
-				hit[i] = cb.m_hitPointWorld;
-				normal[i] = cb.m_hitNormalWorld;
+				hit[i] = result[i].m_hitPointWorld;
+				normal[i] = result[i].m_hitNormalWorld;
 				normal[i].normalize ();
 			} else {
 				hit[i] = dest[i];
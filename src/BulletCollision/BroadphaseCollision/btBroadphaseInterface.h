@@ -44,6 +44,43 @@ struct	btBroadphaseRayCallback : public btBroadphaseAabbCallback
 };
 
 #include "LinearMath/btVector3.h"
+#include "btRayPacket.h"
+
+///btBroadphaseRayPacketCallback receives the proxies hit by the rays of m_packet.
+///process may shorten the rays with m_packet.clipRay, the rest of the traversal then skips nodes beyond the new ends.
+struct	btBroadphaseRayPacketCallback
+{
+	btRayPacket	m_packet;
+
+	virtual ~btBroadphaseRayPacketCallback() {}
+	///rayMask has a bit set for each ray of the packet whose ray hits the aabb of the proxy, returns false to stop the traversal
+	virtual bool	process(const btBroadphaseProxy* proxy, unsigned int rayMask) = 0;
+};
+
+///feeds the single ray tests of a broadphase without packet traversal into a btBroadphaseRayPacketCallback
+struct	btBroadphaseRayPacketAdapter : public btBroadphaseRayCallback
+{
+	btBroadphaseRayPacketCallback&	m_packetCallback;
+	int	m_ray;
+
+	btBroadphaseRayPacketAdapter(btBroadphaseRayPacketCallback& packetCallback, int ray)
+		:m_packetCallback(packetCallback),
+		m_ray(ray)
+	{
+		const btRayPacket& packet = packetCallback.m_packet;
+		for (int axis=0;axis<3;axis++)
+		{
+			m_rayDirectionInverse[axis] = packet.m_rayDirectionInverse[axis][ray];
+			m_signs[axis] = m_rayDirectionInverse[axis] < 0.0;
+		}
+		m_lambda_max = packet.m_lambdaMax[ray];
+	}
+
+	virtual bool	process(const btBroadphaseProxy* proxy)
+	{
+		return m_packetCallback.process(proxy,1u<<m_ray);
+	}
+};
 
 ///The btBroadphaseInterface class provides an interface to detect aabb-overlapping object pairs.
 ///Some implementations for this broadphase interface include btAxisSweep3, bt32BitAxisSweep3 and btDbvtBroadphase.
@@ -58,8 +95,33 @@ public:
 	virtual void	setAabb(btBroadphaseProxy* proxy,const btVector3& aabbMin,const btVector3& aabbMax, btDispatcher* dispatcher)=0;
 	virtual void	getAabb(btBroadphaseProxy* proxy,btVector3& aabbMin, btVector3& aabbMax ) const =0;
 
+	///setAabbBatch moves many proxies at once, aabbMins and aabbMaxs hold one entry per proxy.
+	///The default implementation calls setAabb for each proxy, in order.
+	virtual void	setAabbBatch(btBroadphaseProxy** proxies,const btVector3* aabbMins,const btVector3* aabbMaxs,int numProxies, btDispatcher* dispatcher)
+	{
+		for (int i=0;i<numProxies;i++)
+		{
+			setAabb(proxies[i],aabbMins[i],aabbMaxs[i],dispatcher);
+		}
+	}
+
 	virtual void	rayTest(const btVector3& rayFrom,const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin=btVector3(0,0,0), const btVector3& aabbMax = btVector3(0,0,0)) = 0;
 
+	///rayTestPacket reports the proxies hit by any ray of callback.m_packet.
+	///The default implementation does a rayTest for each active ray of the packet, one after the other.
+	virtual void	rayTestPacket(btBroadphaseRayPacketCallback& callback)
+	{
+		const btRayPacket& packet = callback.m_packet;
+		for (int i=0;i<packet.m_numRays;i++)
+		{
+			if (packet.m_activeMask & (1u<<i))
+			{
+				btBroadphaseRayPacketAdapter adapter(callback,i);
+				rayTest(packet.m_rayFromWorld[i],packet.m_rayToWorld[i],adapter);
+			}
+		}
+	}
+
 	virtual void	aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback) = 0;
 
 	///calculateOverlappingPairs is optional: incremental algorithms (sweep and prune) might do it during the set aabb
@@ -0,0 +1,139 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btCompactDbvt.h"
+#include <math.h>
+
+btCompactDbvt::btCompactDbvt()
+:m_bvhAabbMin(0,0,0),
+m_bvhQuantization(1,1,1),
+m_bvhInvQuantization(1,1,1),
+m_tree(0),
+m_revision(0),
+m_useQuantization(false)
+{
+}
+
+void	btCompactDbvt::clear()
+{
+	m_nodes.clear();
+	m_quantizedNodes.clear();
+	m_leaves.clear();
+	m_tree = 0;
+}
+
+void	btCompactDbvt::quantize(unsigned short* out, const btVector3& point, int isMax) const
+{
+	btVector3 v = (point - m_bvhAabbMin) * m_bvhQuantization;
+	for (int axis=0;axis<3;axis++)
+	{
+		//round outwards by a full step, so the dequantized box always contains the original
+		btScalar q = isMax ? btScalar(ceil(v[axis]))+btScalar(1.) : btScalar(floor(v[axis]))-btScalar(1.);
+		q = btMax(btScalar(0.),btMin(btScalar(65535.),q));
+		out[axis] = (unsigned short) q;
+	}
+}
+
+void	btCompactDbvt::build(const btDbvt& tree, bool useQuantization)
+{
+	m_nodes.resize(0);
+	m_quantizedNodes.resize(0);
+	m_leaves.resize(0);
+	m_tree = &tree;
+	m_revision = tree.m_revision;
+	m_useQuantization = useQuantization;
+	if (!tree.m_root)
+	{
+		return;
+	}
+
+	const int numNodes = tree.m_leaves*2-1;
+	m_leaves.reserve(tree.m_leaves);
+	if (useQuantization)
+	{
+		//two steps of room on each side, for the outward rounding of quantize
+		const btVector3 rootMin = tree.m_root->volume.Mins();
+		const btVector3 rootMax = tree.m_root->volume.Maxs();
+		btVector3 extent = rootMax-rootMin;
+		for (int axis=0;axis<3;axis++)
+		{
+			extent[axis] = btMax(extent[axis],btScalar(SIMD_EPSILON));
+		}
+		m_bvhQuantization = btVector3(btScalar(65531.),btScalar(65531.),btScalar(65531.))/extent;
+		m_bvhInvQuantization = extent/btScalar(65531.);
+		m_bvhAabbMin = rootMin - btScalar(2.)*m_bvhInvQuantization;
+		m_quantizedNodes.reserve(numNodes);
+	} else
+	{
+		m_nodes.reserve(numNodes);
+	}
+
+	//depth first, the second child first, so the nodes are visited in the order the stack based traversals of btDbvt visit them.
+	//Below the children of an internal node the stack holds a null marker, the escape index of the node is set when the marker is popped
+	btAlignedObjectArray<const btDbvtNode*> stack;
+	btAlignedObjectArray<int> pending;
+	stack.reserve(btDbvt::SIMPLE_STACKSIZE);
+	stack.push_back(tree.m_root);
+	while (stack.size())
+	{
+		const btDbvtNode* node = stack[stack.size()-1];
+		stack.pop_back();
+		if (!node)
+		{
+			const int nodeIndex = pending[pending.size()-1];
+			pending.pop_back();
+			const int escapeIndex = -(getNumNodes()-nodeIndex);
+			if (useQuantization)
+			{
+				m_quantizedNodes[nodeIndex].m_escapeIndexOrLeafIndex = escapeIndex;
+			} else
+			{
+				m_nodes[nodeIndex].m_escapeIndexOrLeafIndex = escapeIndex;
+			}
+			continue;
+		}
+		const int nodeIndex = getNumNodes();
+		int escapeIndexOrLeafIndex = -1;
+		if (node->isleaf())
+		{
+			escapeIndexOrLeafIndex = m_leaves.size();
+			m_leaves.push_back(node);
+		}
+		if (useQuantization)
+		{
+			btCompactDbvtQuantizedNode& qnode = m_quantizedNodes.expand();
+			quantize(qnode.m_quantizedAabbMin,node->volume.Mins(),0);
+			quantize(qnode.m_quantizedAabbMax,node->volume.Maxs(),1);
+			qnode.m_escapeIndexOrLeafIndex = escapeIndexOrLeafIndex;
+		} else
+		{
+			btCompactDbvtNode& cnode = m_nodes.expand();
+			for (int axis=0;axis<3;axis++)
+			{
+				cnode.m_aabbMin[axis] = node->volume.Mins()[axis];
+				cnode.m_aabbMax[axis] = node->volume.Maxs()[axis];
+			}
+			cnode.m_escapeIndexOrLeafIndex = escapeIndexOrLeafIndex;
+			cnode.m_padding = 0;
+		}
+		if (node->isinternal())
+		{
+			pending.push_back(nodeIndex);
+			stack.push_back(0);
+			stack.push_back(node->childs[0]);
+			stack.push_back(node->childs[1]);
+		}
+	}
+}
@@ -0,0 +1,329 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_COMPACT_DBVT_H
+#define BT_COMPACT_DBVT_H
+
+#include "btDbvt.h"
+#include "LinearMath/btAabbUtil2.h"
+
+///btCompactDbvtNode is a node with full precision bounds, 32 bytes for single precision
+ATTRIBUTE_ALIGNED16	(struct) btCompactDbvtNode
+{
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btScalar	m_aabbMin[3];
+	//escape index (negative) for internal nodes, leaf index (>= 0) for leaves, like btQuantizedBvhNode
+	int			m_escapeIndexOrLeafIndex;
+	btScalar	m_aabbMax[3];
+	int			m_padding;
+};
+
+///btCompactDbvtQuantizedNode is a node with 16 bit quantized bounds, 16 bytes
+ATTRIBUTE_ALIGNED16	(struct) btCompactDbvtQuantizedNode
+{
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	unsigned short int	m_quantizedAabbMin[3];
+	unsigned short int	m_quantizedAabbMax[3];
+	int	m_escapeIndexOrLeafIndex;
+};
+
+///btCompactDbvt is a copy of the layout of a btDbvt for fast queries: the nodes are stored in one contiguous array in depth first order,
+///with the bounds and an index instead of the volume, the parent and the child pointers of btDbvtNode, so a traversal walks through memory
+///mostly forward instead of chasing pointers. The bounds are stored with full precision or quantized to 16 bits (16 bytes per node),
+///in which case the boxes of the leaves are tested once more with the volume of their btDbvtNode.
+///The second child of a node comes right after it and the first child after the subtree of the second, so the queries report the leaves
+///in the same order as the queries of btDbvt with the same arguments, and the callbacks get the btDbvtNode of the leaves.
+///The copy is only valid as long as the tree doesn't change (see isValid), build it again (relayout) after the tree changed.
+///btDbvtBroadphase can keep one for its set of fixed proxies, see btDbvtBroadphase::m_compactLayoutPeriod.
+ATTRIBUTE_ALIGNED16(class) btCompactDbvt
+{
+public:
+
+	/* Stack element of collideTT	*/
+	struct	sStkNC
+	{
+		const btDbvtNode*	node;
+		int					compact;
+		sStkNC() {}
+		sStkNC(const btDbvtNode* n,int c) : node(n),compact(c) {}
+	};
+
+protected:
+
+	btAlignedObjectArray<btCompactDbvtNode>				m_nodes;
+	btAlignedObjectArray<btCompactDbvtQuantizedNode>	m_quantizedNodes;
+	btAlignedObjectArray<const btDbvtNode*>				m_leaves;
+
+	btVector3		m_bvhAabbMin;
+	btVector3		m_bvhQuantization;
+	btVector3		m_bvhInvQuantization;
+
+	const btDbvt*	m_tree;
+	unsigned		m_revision;
+	bool			m_useQuantization;
+
+	void	quantize(unsigned short* out, const btVector3& point, int isMax) const;
+
+	SIMD_FORCE_INLINE int	getEscapeIndexOrLeafIndex(int nodeIndex) const
+	{
+		return m_useQuantization ? m_quantizedNodes[nodeIndex].m_escapeIndexOrLeafIndex : m_nodes[nodeIndex].m_escapeIndexOrLeafIndex;
+	}
+
+	SIMD_FORCE_INLINE void	getNodeAabb(int nodeIndex, btVector3& aabbMin, btVector3& aabbMax) const
+	{
+		if (m_useQuantization)
+		{
+			const btCompactDbvtQuantizedNode& node = m_quantizedNodes[nodeIndex];
+			aabbMin.setValue(node.m_quantizedAabbMin[0],node.m_quantizedAabbMin[1],node.m_quantizedAabbMin[2]);
+			aabbMax.setValue(node.m_quantizedAabbMax[0],node.m_quantizedAabbMax[1],node.m_quantizedAabbMax[2]);
+			aabbMin = aabbMin*m_bvhInvQuantization+m_bvhAabbMin;
+			aabbMax = aabbMax*m_bvhInvQuantization+m_bvhAabbMin;
+		} else
+		{
+			const btCompactDbvtNode& node = m_nodes[nodeIndex];
+			aabbMin.setValue(node.m_aabbMin[0],node.m_aabbMin[1],node.m_aabbMin[2]);
+			aabbMax.setValue(node.m_aabbMax[0],node.m_aabbMax[1],node.m_aabbMax[2]);
+		}
+	}
+
+	SIMD_FORCE_INLINE bool	intersectNode(int nodeIndex, const btDbvtVolume& volume) const
+	{
+		btVector3 aabbMin,aabbMax;
+		getNodeAabb(nodeIndex,aabbMin,aabbMax);
+		return TestAabbAgainstAabb2(aabbMin,aabbMax,volume.Mins(),volume.Maxs());
+	}
+
+	///the quantized bounds of a leaf are larger than its volume
+	SIMD_FORCE_INLINE bool	intersectLeaf(int nodeIndex, int leafIndex, const btDbvtVolume& volume) const
+	{
+		return m_useQuantization ? Intersect(m_leaves[leafIndex]->volume,volume) : intersectNode(nodeIndex,volume);
+	}
+
+public:
+
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btCompactDbvt();
+
+	///copies the layout of tree, this takes time linear in the number of nodes
+	void	build(const btDbvt& tree, bool useQuantization);
+
+	void	clear();
+
+	///true if this is a copy of tree and tree didn't change since
+	bool	isValid(const btDbvt& tree) const
+	{
+		return (m_tree==&tree) && (m_revision==tree.m_revision);
+	}
+
+	bool	isQuantized() const
+	{
+		return m_useQuantization;
+	}
+
+	int		getNumNodes() const
+	{
+		return m_useQuantization ? m_quantizedNodes.size() : m_nodes.size();
+	}
+
+	int		getNumLeaves() const
+	{
+		return m_leaves.size();
+	}
+
+	///like btDbvt::collideTV
+	template <typename POLICY>
+	void	collideTV(const btDbvtVolume& volume, POLICY& policy) const;
+
+	///like btDbvt::collideTTpersistentStack of this tree and the tree at root, or of the tree at root and this tree when compactFirst is false.
+	///Each pair of leaves is reported as (leaf of the first tree, leaf of the second tree)
+	template <typename POLICY>
+	void	collideTT(const btDbvtNode* root, bool compactFirst, btAlignedObjectArray<sStkNC>& stack, POLICY& policy) const;
+
+	///like btDbvt::rayTestInternal
+	template <typename POLICY>
+	void	rayTestInternal(const btVector3& rayFrom, const btVector3& rayDirectionInverse, unsigned int signs[3], btScalar lambda_max,
+							const btVector3& aabbMin, const btVector3& aabbMax, POLICY& policy) const;
+};
+
+//
+template <typename POLICY>
+inline void	btCompactDbvt::collideTV(const btDbvtVolume& volume, POLICY& policy) const
+{
+	const int numNodes = getNumNodes();
+	int nodeIndex = 0;
+	while (nodeIndex<numNodes)
+	{
+		const int escapeIndexOrLeafIndex = getEscapeIndexOrLeafIndex(nodeIndex);
+		if (escapeIndexOrLeafIndex>=0)
+		{
+			if (intersectLeaf(nodeIndex,escapeIndexOrLeafIndex,volume))
+			{
+				policy.Process(m_leaves[escapeIndexOrLeafIndex]);
+			}
+			nodeIndex++;
+		} else if (intersectNode(nodeIndex,volume))
+		{
+			nodeIndex++;
+		} else
+		{
+			nodeIndex -= escapeIndexOrLeafIndex;
+		}
+	}
+}
+
+//
+template <typename POLICY>
+inline void	btCompactDbvt::collideTT(const btDbvtNode* root, bool compactFirst, btAlignedObjectArray<sStkNC>& stack, POLICY& policy) const
+{
+	if (!root || !getNumNodes())
+	{
+		return;
+	}
+	//the same traversal as btDbvt::collideTTstack, the first child of a compact node is after the subtree of its second child
+	int depth = 1;
+	if (stack.size()<btDbvt::DOUBLE_STACKSIZE)
+	{
+		stack.resize(btDbvt::DOUBLE_STACKSIZE);
+	}
+	int treshold = stack.size()-4;
+	stack[0] = sStkNC(root,0);
+	do
+	{
+		const sStkNC p = stack[--depth];
+		if (depth>treshold)
+		{
+			stack.resize(stack.size()*2);
+			treshold = stack.size()-4;
+		}
+		const int escapeIndexOrLeafIndex = getEscapeIndexOrLeafIndex(p.compact);
+		const bool compactIsLeaf = escapeIndexOrLeafIndex>=0;
+		if (compactIsLeaf ? !intersectLeaf(p.compact,escapeIndexOrLeafIndex,p.node->volume) : !intersectNode(p.compact,p.node->volume))
+		{
+			continue;
+		}
+		int compactChilds[2];
+		if (!compactIsLeaf)
+		{
+			compactChilds[1] = p.compact+1;
+			const int secondChild = getEscapeIndexOrLeafIndex(compactChilds[1]);
+			compactChilds[0] = compactChilds[1] + (secondChild>=0 ? 1 : -secondChild);
+		}
+		if (compactFirst)
+		{
+			if (!compactIsLeaf)
+			{
+				if (p.node->isinternal())
+				{
+					stack[depth++]=sStkNC(p.node->childs[0],compactChilds[0]);
+					stack[depth++]=sStkNC(p.node->childs[0],compactChilds[1]);
+					stack[depth++]=sStkNC(p.node->childs[1],compactChilds[0]);
+					stack[depth++]=sStkNC(p.node->childs[1],compactChilds[1]);
+				}
+				else
+				{
+					stack[depth++]=sStkNC(p.node,compactChilds[0]);
+					stack[depth++]=sStkNC(p.node,compactChilds[1]);
+				}
+			}
+			else
+			{
+				if (p.node->isinternal())
+				{
+					stack[depth++]=sStkNC(p.node->childs[0],p.compact);
+					stack[depth++]=sStkNC(p.node->childs[1],p.compact);
+				}
+				else
+				{
+					policy.Process(m_leaves[escapeIndexOrLeafIndex],p.node);
+				}
+			}
+		} else
+		{
+			if (p.node->isinternal())
+			{
+				if (!compactIsLeaf)
+				{
+					stack[depth++]=sStkNC(p.node->childs[0],compactChilds[0]);
+					stack[depth++]=sStkNC(p.node->childs[1],compactChilds[0]);
+					stack[depth++]=sStkNC(p.node->childs[0],compactChilds[1]);
+					stack[depth++]=sStkNC(p.node->childs[1],compactChilds[1]);
+				}
+				else
+				{
+					stack[depth++]=sStkNC(p.node->childs[0],p.compact);
+					stack[depth++]=sStkNC(p.node->childs[1],p.compact);
+				}
+			}
+			else
+			{
+				if (!compactIsLeaf)
+				{
+					stack[depth++]=sStkNC(p.node,compactChilds[0]);
+					stack[depth++]=sStkNC(p.node,compactChilds[1]);
+				}
+				else
+				{
+					policy.Process(p.node,m_leaves[escapeIndexOrLeafIndex]);
+				}
+			}
+		}
+	} while (depth);
+}
+
+//
+template <typename POLICY>
+inline void	btCompactDbvt::rayTestInternal(const btVector3& rayFrom, const btVector3& rayDirectionInverse, unsigned int signs[3], btScalar lambda_max,
+										const btVector3& aabbMin, const btVector3& aabbMax, POLICY& policy) const
+{
+	const int numNodes = getNumNodes();
+	int nodeIndex = 0;
+	btVector3 bounds[2];
+	while (nodeIndex<numNodes)
+	{
+		const int escapeIndexOrLeafIndex = getEscapeIndexOrLeafIndex(nodeIndex);
+		if (escapeIndexOrLeafIndex>=0 && m_useQuantization)
+		{
+			const btDbvtVolume& volume = m_leaves[escapeIndexOrLeafIndex]->volume;
+			bounds[0] = volume.Mins();
+			bounds[1] = volume.Maxs();
+		} else
+		{
+			getNodeAabb(nodeIndex,bounds[0],bounds[1]);
+		}
+		bounds[0] -= aabbMax;
+		bounds[1] -= aabbMin;
+		btScalar tmin=1.f,lambda_min=0.f;
+		const bool hit = btRayAabb2(rayFrom,rayDirectionInverse,signs,bounds,tmin,lambda_min,lambda_max);
+		if (escapeIndexOrLeafIndex>=0)
+		{
+			if (hit)
+			{
+				policy.Process(m_leaves[escapeIndexOrLeafIndex]);
+			}
+			nodeIndex++;
+		} else if (hit)
+		{
+			nodeIndex++;
+		} else
+		{
+			nodeIndex -= escapeIndexOrLeafIndex;
+		}
+	}
+}
+
+#endif //BT_COMPACT_DBVT_H
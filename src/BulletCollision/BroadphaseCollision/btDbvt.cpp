@@ -15,6 +15,7 @@ subject to the following restrictions:
 ///btDbvt implementation by Nathanael Presson
 
 #include "btDbvt.h"
+#include "LinearMath/btThreads.h"
 
 //
 typedef btAlignedObjectArray<btDbvtNode*>			tNodeArray;
@@ -48,6 +49,15 @@ static DBVT_INLINE btDbvtVolume	merge(	const btDbvtVolume& a,
 	return(res);
 }
 
+// half surface area, the cost of a node in the surface area heuristic
+static DBVT_INLINE btScalar		area(const btDbvtVolume& a)
+{
+	const btVector3	edges=a.Lengths();
+	return(	edges.x()*edges.y()+
+		edges.y()*edges.z()+
+		edges.z()*edges.x());
+}
+
 // volume+edge lengths
 static DBVT_INLINE btScalar		size(const btDbvtVolume& a)
 {
@@ -93,7 +103,8 @@ static DBVT_INLINE btDbvtNode*	createnode(	btDbvt* pdbvt,
 										   void* data)
 {
 	btDbvtNode*	node;
-	if(pdbvt->m_free)
+	// pdbvt is null in the tasks of optimizeTopDownParallel, they don't share the free node
+	if(pdbvt&&pdbvt->m_free)
 	{ node=pdbvt->m_free;pdbvt->m_free=0; }
 	else
 	{ node=new(btAlignedAlloc(sizeof(btDbvtNode),16)) btDbvtNode(); }
@@ -298,59 +309,67 @@ static void						bottomup(	btDbvt* pdbvt,
 }
 
 //
-static btDbvtNode*			topdown(btDbvt* pdbvt,
-									tNodeArray& leaves,
-									int bu_treshold)
+static btDbvtVolume				splitleaves(const tNodeArray& leaves,
+											tNodeArray sets[2])
 {
 	static const btVector3	axis[]={btVector3(1,0,0),
 		btVector3(0,1,0),
 		btVector3(0,0,1)};
+	const btDbvtVolume	vol=bounds(leaves);
+	const btVector3			org=vol.Center();
+	int						bestaxis=-1;
+	int						bestmidp=leaves.size();
+	int						splitcount[3][2]={{0,0},{0,0},{0,0}};
+	int i;
+	for( i=0;i<leaves.size();++i)
+	{
+		const btVector3	x=leaves[i]->volume.Center()-org;
+		for(int j=0;j<3;++j)
+		{
+			++splitcount[j][btDot(x,axis[j])>0?1:0];
+		}
+	}
+	for( i=0;i<3;++i)
+	{
+		if((splitcount[i][0]>0)&&(splitcount[i][1]>0))
+		{
+			const int	midp=(int)btFabs(btScalar(splitcount[i][0]-splitcount[i][1]));
+			if(midp<bestmidp)
+			{
+				bestaxis=i;
+				bestmidp=midp;
+			}
+		}
+	}
+	if(bestaxis>=0)
+	{
+		sets[0].reserve(splitcount[bestaxis][0]);
+		sets[1].reserve(splitcount[bestaxis][1]);
+		split(leaves,sets[0],sets[1],org,axis[bestaxis]);
+	}
+	else
+	{
+		sets[0].reserve(leaves.size()/2+1);
+		sets[1].reserve(leaves.size()/2);
+		for(int i=0,ni=leaves.size();i<ni;++i)
+		{
+			sets[i&1].push_back(leaves[i]);
+		}
+	}
+	return(vol);
+}
+
+//
+static btDbvtNode*			topdown(btDbvt* pdbvt,
+									tNodeArray& leaves,
+									int bu_treshold)
+{
 	if(leaves.size()>1)
 	{
 		if(leaves.size()>bu_treshold)
 		{
-			const btDbvtVolume	vol=bounds(leaves);
-			const btVector3			org=vol.Center();
 			tNodeArray				sets[2];
-			int						bestaxis=-1;
-			int						bestmidp=leaves.size();
-			int						splitcount[3][2]={{0,0},{0,0},{0,0}};
-			int i;
-			for( i=0;i<leaves.size();++i)
-			{
-				const btVector3	x=leaves[i]->volume.Center()-org;
-				for(int j=0;j<3;++j)
-				{
-					++splitcount[j][btDot(x,axis[j])>0?1:0];
-				}
-			}
-			for( i=0;i<3;++i)
-			{
-				if((splitcount[i][0]>0)&&(splitcount[i][1]>0))
-				{
-					const int	midp=(int)btFabs(btScalar(splitcount[i][0]-splitcount[i][1]));
-					if(midp<bestmidp)
-					{
-						bestaxis=i;
-						bestmidp=midp;
-					}
-				}
-			}
-			if(bestaxis>=0)
-			{
-				sets[0].reserve(splitcount[bestaxis][0]);
-				sets[1].reserve(splitcount[bestaxis][1]);
-				split(leaves,sets[0],sets[1],org,axis[bestaxis]);
-			}
-			else
-			{
-				sets[0].reserve(leaves.size()/2+1);
-				sets[1].reserve(leaves.size()/2);
-				for(int i=0,ni=leaves.size();i<ni;++i)
-				{
-					sets[i&1].push_back(leaves[i]);
-				}
-			}
+			const btDbvtVolume	vol=splitleaves(leaves,sets);
 			btDbvtNode*	node=createnode(pdbvt,0,vol,0);
 			node->childs[0]=topdown(pdbvt,sets[0],bu_treshold);
 			node->childs[1]=topdown(pdbvt,sets[1],bu_treshold);
@@ -367,6 +386,124 @@ static btDbvtNode*			topdown(btDbvt* pdbvt,
 	return(leaves[0]);
 }
 
+// Subtree of optimizeTopDownParallel, built by one task
+struct btDbvtTopDownTask
+{
+	int				begin;
+	int				end;
+	btDbvtNode*		parent;
+	int				child;
+};
+
+// The nodes of topdown above the subtrees of at most grainsize leaves, the leaves of each subtree go to a task
+static btDbvtNode*			topdownsplit(btDbvt* pdbvt,
+										 tNodeArray& leaves,
+										 int bu_treshold,
+										 int grainsize,
+										 tNodeArray& taskleaves,
+										 btAlignedObjectArray<btDbvtTopDownTask>& tasks)
+{
+	if((leaves.size()>grainsize)&&(leaves.size()>bu_treshold))
+	{
+		tNodeArray				sets[2];
+		const btDbvtVolume	vol=splitleaves(leaves,sets);
+		btDbvtNode*	node=createnode(pdbvt,0,vol,0);
+		for(int i=0;i<2;++i)
+		{
+			node->childs[i]=topdownsplit(pdbvt,sets[i],bu_treshold,grainsize,taskleaves,tasks);
+			if(node->childs[i])
+			{
+				node->childs[i]->parent=node;
+			}
+			else
+			{
+				tasks[tasks.size()-1].parent=node;
+				tasks[tasks.size()-1].child=i;
+			}
+		}
+		return(node);
+	}
+	btDbvtTopDownTask&	task=tasks.expand();
+	task.begin	=	taskleaves.size();
+	for(int i=0;i<leaves.size();++i)
+	{
+		taskleaves.push_back(leaves[i]);
+	}
+	task.end	=	taskleaves.size();
+	task.parent	=	0;
+	task.child	=	0;
+	return(0);
+}
+
+//
+struct btDbvtTopDownLoop : btIParallelForBody
+{
+	btDbvt*										m_tree;
+	const tNodeArray*							m_leaves;
+	const btAlignedObjectArray<btDbvtTopDownTask>*	m_tasks;
+	int											m_bu_treshold;
+
+	void forLoop(int iBegin,int iEnd) const
+	{
+		tNodeArray	leaves;
+		for(int i=iBegin;i<iEnd;++i)
+		{
+			const btDbvtTopDownTask&	task=(*m_tasks)[i];
+			leaves.resize(0);
+			for(int j=task.begin;j<task.end;++j)
+			{
+				leaves.push_back((*m_leaves)[j]);
+			}
+			btDbvtNode*	root=topdown(0,leaves,m_bu_treshold);
+			root->parent=task.parent;
+			if(task.parent)
+				task.parent->childs[task.child]=root;
+			else
+				m_tree->m_root=root;
+		}
+	}
+};
+
+// Swap a child of node with a grandchild on the other side if that lowers the surface area heuristic cost.
+// The volume of node doesn't change, only the volume of the child that gets the grandchild's place.
+// Returns true if it swapped
+static bool					rotate(btDbvtNode* node)
+{
+	btScalar	bestgain=0;
+	int			bestchild=-1;
+	int			bestgrandchild=-1;
+	for(int i=0;i<2;++i)
+	{
+		const btDbvtNode*	c=node->childs[i];
+		const btDbvtNode*	o=node->childs[1-i];
+		if(o->isinternal())
+		{
+			const btScalar	cost=area(merge(o->childs[0]->volume,o->childs[1]->volume));
+			for(int j=0;j<2;++j)
+			{
+				const btScalar	gain=cost-area(merge(c->volume,o->childs[1-j]->volume));
+				if(gain>bestgain)
+				{
+					bestgain		=	gain;
+					bestchild		=	i;
+					bestgrandchild	=	j;
+				}
+			}
+		}
+	}
+	if(bestchild>=0)
+	{
+		btDbvtNode*	c=node->childs[bestchild];
+		btDbvtNode*	o=node->childs[1-bestchild];
+		btDbvtNode*	g=o->childs[bestgrandchild];
+		node->childs[bestchild]=g;g->parent=node;
+		o->childs[bestgrandchild]=c;c->parent=o;
+		Merge(o->childs[0]->volume,o->childs[1]->volume,o->volume);
+		return(true);
+	}
+	return(false);
+}
+
 //
 static DBVT_INLINE btDbvtNode*	sort(btDbvtNode* n,btDbvtNode*& r)
 {
@@ -415,6 +552,8 @@ btDbvt::btDbvt()
 	m_lkhd		=	-1;
 	m_leaves	=	0;
 	m_opath		=	0;
+	m_rpath		=	0;
+	m_revision	=	0;
 }
 
 //
@@ -433,6 +572,7 @@ void			btDbvt::clear()
 	m_lkhd		=	-1;
 	m_stkStack.clear();
 	m_opath		=	0;
+	++m_revision;
 	
 }
 
@@ -446,6 +586,7 @@ void			btDbvt::optimizeBottomUp()
 		fetchleaves(this,m_root,leaves);
 		bottomup(this,leaves);
 		m_root=leaves[0];
+		++m_revision;
 	}
 }
 
@@ -458,6 +599,55 @@ void			btDbvt::optimizeTopDown(int bu_treshold)
 		leaves.reserve(m_leaves);
 		fetchleaves(this,m_root,leaves);
 		m_root=topdown(this,leaves,bu_treshold);
+		++m_revision;
+	}
+}
+
+//
+void			btDbvt::optimizeTopDownParallel(int bu_treshold,int grainSize)
+{
+	if(m_root)
+	{
+		tNodeArray	leaves;
+		leaves.reserve(m_leaves);
+		fetchleaves(this,m_root,leaves);
+		tNodeArray	taskleaves;
+		btAlignedObjectArray<btDbvtTopDownTask>	tasks;
+		taskleaves.reserve(m_leaves);
+		m_root=topdownsplit(this,leaves,bu_treshold,grainSize,taskleaves,tasks);
+		btDbvtTopDownLoop	loop;
+		loop.m_tree			=	this;
+		loop.m_leaves		=	&taskleaves;
+		loop.m_tasks		=	&tasks;
+		loop.m_bu_treshold	=	bu_treshold;
+		btParallelFor(0,tasks.size(),1,loop);
+		++m_revision;
+	}
+}
+
+//
+void			btDbvt::optimizeRotations(int passes)
+{
+	if(passes<0) passes=m_leaves;
+	if(m_root&&m_root->isinternal()&&(passes>0))
+	{
+		bool	rotated=false;
+		do	{
+			btDbvtNode*		node=m_root;
+			unsigned	bit=0;
+			while(node->isinternal())
+			{
+				node=node->childs[(m_rpath>>bit)&1];
+				bit=(bit+1)&(sizeof(unsigned)*8-1);
+			}
+			for(node=node->parent;node;node=node->parent)
+			{
+				rotated|=rotate(node);
+			}
+			++m_rpath;
+		} while(--passes);
+		//a settled tree keeps its revision, so layouts built from it (btCompactDbvt) stay valid
+		if(rotated) ++m_revision;
 	}
 }
 
@@ -467,6 +657,7 @@ void			btDbvt::optimizeIncremental(int passes)
 	if(passes<0) passes=m_leaves;
 	if(m_root&&(passes>0))
 	{
+		++m_revision;
 		do	{
 			btDbvtNode*		node=m_root;
 			unsigned	bit=0;
@@ -487,6 +678,7 @@ btDbvtNode*	btDbvt::insert(const btDbvtVolume& volume,void* data)
 	btDbvtNode*	leaf=createnode(this,0,volume,data);
 	insertleaf(this,m_root,leaf);
 	++m_leaves;
+	++m_revision;
 	return(leaf);
 }
 
@@ -505,6 +697,7 @@ void			btDbvt::update(btDbvtNode* leaf,int lookahead)
 		} else root=m_root;
 	}
 	insertleaf(this,root,leaf);
+	++m_revision;
 }
 
 //
@@ -523,6 +716,7 @@ void			btDbvt::update(btDbvtNode* leaf,btDbvtVolume& volume)
 	}
 	leaf->volume=volume;
 	insertleaf(this,root,leaf);
+	++m_revision;
 }
 
 //
@@ -559,6 +753,7 @@ void			btDbvt::remove(btDbvtNode* leaf)
 	removeleaf(this,leaf);
 	deletenode(this,leaf);
 	--m_leaves;
+	++m_revision;
 }
 
 //
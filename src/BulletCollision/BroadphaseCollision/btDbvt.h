@@ -21,6 +21,7 @@ subject to the following restrictions:
 #include "LinearMath/btVector3.h"
 #include "LinearMath/btTransform.h"
 #include "LinearMath/btAabbUtil2.h"
+#include "btRayPacket.h"
 
 //
 // Compile time configuration
@@ -205,6 +206,7 @@ struct	btDbvt
 	{
 		const btDbvtNode*	node;
 		int			mask;
+		sStkNP() {}
 		sStkNP(const btDbvtNode* n,unsigned m) : node(n),mask(m) {}
 	};
 	struct	sStkNPS
@@ -260,10 +262,12 @@ struct	btDbvt
 	int				m_lkhd;
 	int				m_leaves;
 	unsigned		m_opath;
+	unsigned		m_rpath;
+	///incremented by every change of the tree, so a copy of its layout (see btCompactDbvt) can tell when it is out of date
+	unsigned		m_revision;
 
 	
 	btAlignedObjectArray<sStkNN>	m_stkStack;
-	mutable btAlignedObjectArray<const btDbvtNode*>	m_rayTestStack;
 
 
 	// Methods
@@ -273,7 +277,13 @@ struct	btDbvt
 	bool			empty() const { return(0==m_root); }
 	void			optimizeBottomUp();
 	void			optimizeTopDown(int bu_treshold=128);
+	///like optimizeTopDown, the subtrees of at most grainSize leaves are built in parallel by btParallelFor. The tree is the same as the one of optimizeTopDown
+	void			optimizeTopDownParallel(int bu_treshold=128,int grainSize=1024);
 	void			optimizeIncremental(int passes);
+	///each pass walks from a leaf up to the root and rotates the nodes on the way (swaps a child with a grandchild) where that lowers the surface area heuristic cost,
+	///the leaves are visited in turn from one call to the next. It doesn't move leaves far like optimizeIncremental, but it doesn't change the volume of any ancestor either.
+	///m_revision only changes if a node was rotated
+	void			optimizeRotations(int passes);
 	btDbvtNode*		insert(const btDbvtVolume& box,void* data);
 	void			update(btDbvtNode* leaf,int lookahead=-1);
 	void			update(btDbvtNode* leaf,btDbvtVolume& volume);
@@ -307,6 +317,14 @@ struct	btDbvt
 		void		collideTTpersistentStack(	const btDbvtNode* root0,
 		  const btDbvtNode* root1,
 		  DBVT_IPOLICY);
+	///collideTTstack continues a collideTTpersistentStack traversal from the depth pairs on the stack.
+	///With maxDepth>0 it stops once the stack holds maxDepth pairs and returns the depth. Finishing the remaining
+	///pairs from the top of the stack down, each with its own traversal, gives the same Process calls in the same order.
+	DBVT_PREFIX
+		static int		collideTTstack(	btAlignedObjectArray<sStkNN>& stack,
+		  int depth,
+		  int maxDepth,
+		  DBVT_IPOLICY);
 #if 0
 	DBVT_PREFIX
 		void		collideTT(	const btDbvtNode* root0,
@@ -334,6 +352,7 @@ struct	btDbvt
 		DBVT_IPOLICY);
 	///rayTestInternal is faster than rayTest, because it uses a persistent stack (to reduce dynamic memory allocations to a minimum) and it uses precomputed signs/rayInverseDirections
 	///rayTestInternal is used by btDbvtBroadphase to accelerate world ray casts
+	///the stack is owned by the caller, so concurrent ray casts against the same tree need a stack each
 	DBVT_PREFIX
 		void		rayTestInternal(	const btDbvtNode* root,
 								const btVector3& rayFrom,
@@ -343,7 +362,16 @@ struct	btDbvt
 								btScalar lambda_max,
 								const btVector3& aabbMin,
 								const btVector3& aabbMax,
+								btAlignedObjectArray<const btDbvtNode*>& stack,
 								DBVT_IPOLICY) const;
+	///rayTestPacketInternal traverses the tree with all rays of a packet at once, a node is only tested with the rays that hit its parent.
+	///policy.Process(leaf,rayMask) is called for each leaf hit by a ray of the packet and returns false to stop the traversal.
+	///The packet is read again at every node, so rays shortened by the policy skip the rest of the tree beyond their new end.
+	template <typename POLICY>
+		static bool		rayTestPacketInternal(	const btDbvtNode* root,
+								const btRayPacket& packet,
+								btAlignedObjectArray<sStkNP>& stack,
+								POLICY& policy);
 
 	DBVT_PREFIX
 		static void		collideKDOP(const btDbvtNode* root,
@@ -793,59 +821,70 @@ inline void		btDbvt::collideTTpersistentStack(	const btDbvtNode* root0,
 	DBVT_CHECKTYPE
 		if(root0&&root1)
 		{
-			int								depth=1;
-			int								treshold=DOUBLE_STACKSIZE-4;
-			
 			m_stkStack.resize(DOUBLE_STACKSIZE);
 			m_stkStack[0]=sStkNN(root0,root1);
-			do	{		
-				sStkNN	p=m_stkStack[--depth];
-				if(depth>treshold)
+			collideTTstack(m_stkStack,1,0,policy);
+		}
+}
+
+//
+DBVT_PREFIX
+inline int		btDbvt::collideTTstack(	btAlignedObjectArray<sStkNN>& stack,
+								  int depth,
+								  int maxDepth,
+								  DBVT_IPOLICY)
+{
+	DBVT_CHECKTYPE
+		int								treshold=stack.size()-4;
+		while(depth&&((maxDepth<=0)||(depth<maxDepth)))
+		{
+			sStkNN	p=stack[--depth];
+			if(depth>treshold)
+			{
+				stack.resize(stack.size()*2);
+				treshold=stack.size()-4;
+			}
+			if(p.a==p.b)
+			{
+				if(p.a->isinternal())
 				{
-					m_stkStack.resize(m_stkStack.size()*2);
-					treshold=m_stkStack.size()-4;
+					stack[depth++]=sStkNN(p.a->childs[0],p.a->childs[0]);
+					stack[depth++]=sStkNN(p.a->childs[1],p.a->childs[1]);
+					stack[depth++]=sStkNN(p.a->childs[0],p.a->childs[1]);
 				}
-				if(p.a==p.b)
+			}
+			else if(Intersect(p.a->volume,p.b->volume))
+			{
+				if(p.a->isinternal())
 				{
-					if(p.a->isinternal())
+					if(p.b->isinternal())
+					{
+						stack[depth++]=sStkNN(p.a->childs[0],p.b->childs[0]);
+						stack[depth++]=sStkNN(p.a->childs[1],p.b->childs[0]);
+						stack[depth++]=sStkNN(p.a->childs[0],p.b->childs[1]);
+						stack[depth++]=sStkNN(p.a->childs[1],p.b->childs[1]);
+					}
+					else
 					{
-						m_stkStack[depth++]=sStkNN(p.a->childs[0],p.a->childs[0]);
-						m_stkStack[depth++]=sStkNN(p.a->childs[1],p.a->childs[1]);
-						m_stkStack[depth++]=sStkNN(p.a->childs[0],p.a->childs[1]);
+						stack[depth++]=sStkNN(p.a->childs[0],p.b);
+						stack[depth++]=sStkNN(p.a->childs[1],p.b);
 					}
 				}
-				else if(Intersect(p.a->volume,p.b->volume))
+				else
 				{
-					if(p.a->isinternal())
+					if(p.b->isinternal())
 					{
-						if(p.b->isinternal())
-						{
-							m_stkStack[depth++]=sStkNN(p.a->childs[0],p.b->childs[0]);
-							m_stkStack[depth++]=sStkNN(p.a->childs[1],p.b->childs[0]);
-							m_stkStack[depth++]=sStkNN(p.a->childs[0],p.b->childs[1]);
-							m_stkStack[depth++]=sStkNN(p.a->childs[1],p.b->childs[1]);
-						}
-						else
-						{
-							m_stkStack[depth++]=sStkNN(p.a->childs[0],p.b);
-							m_stkStack[depth++]=sStkNN(p.a->childs[1],p.b);
-						}
+						stack[depth++]=sStkNN(p.a,p.b->childs[0]);
+						stack[depth++]=sStkNN(p.a,p.b->childs[1]);
 					}
 					else
 					{
-						if(p.b->isinternal())
-						{
-							m_stkStack[depth++]=sStkNN(p.a,p.b->childs[0]);
-							m_stkStack[depth++]=sStkNN(p.a,p.b->childs[1]);
-						}
-						else
-						{
-							policy.Process(p.a,p.b);
-						}
+						policy.Process(p.a,p.b);
 					}
 				}
-			} while(depth);
+			}
 		}
+		return(depth);
 }
 
 #if 0
@@ -959,6 +998,7 @@ inline void		btDbvt::rayTestInternal(	const btDbvtNode* root,
 								btScalar lambda_max,
 								const btVector3& aabbMin,
 								const btVector3& aabbMax,
+								btAlignedObjectArray<const btDbvtNode*>& stack,
 								DBVT_IPOLICY) const
 {
         (void) rayTo;
@@ -969,7 +1009,6 @@ inline void		btDbvt::rayTestInternal(	const btDbvtNode* root,
 
 		int								depth=1;
 		int								treshold=DOUBLE_STACKSIZE-2;
-		btAlignedObjectArray<const btDbvtNode*>&	stack = m_rayTestStack;
 		stack.resize(DOUBLE_STACKSIZE);
 		stack[0]=root;
 		btVector3 bounds[2];
@@ -1002,6 +1041,45 @@ inline void		btDbvt::rayTestInternal(	const btDbvtNode* root,
 	}
 }
 
+//
+template <typename POLICY>
+inline bool		btDbvt::rayTestPacketInternal(	const btDbvtNode* root,
+								const btRayPacket& packet,
+								btAlignedObjectArray<sStkNP>& stack,
+								POLICY& policy)
+{
+	if(root)
+	{
+		stack.resizeNoInitialize(0);
+		stack.push_back(sStkNP(root,packet.m_activeMask));
+		do	
+		{
+			const sStkNP	se=stack[stack.size()-1];
+			stack.pop_back();
+			/* tested when popped, rays may have been shortened since the node was pushed	*/ 
+			unsigned int	mask=packet.testAabb(se.node->volume.Mins(),se.node->volume.Maxs(),unsigned(se.mask));
+			if(!mask) continue;
+			if(se.node->isinternal())
+			{
+				const btDbvtNode*	nearChild=se.node->childs[0];
+				const btDbvtNode*	farChild=se.node->childs[1];
+				/* visit the child closer to the origin of the first ray first, that finds close hits early	*/ 
+				int					ray=0;
+				while(!(mask&(1u<<ray))) ++ray;
+				const btVector3		rayDir=packet.m_rayToWorld[ray]-packet.m_rayFromWorld[ray];
+				if(rayDir.dot(farChild->volume.Center()-nearChild->volume.Center())<0) btSwap(nearChild,farChild);
+				stack.push_back(sStkNP(farChild,mask));
+				stack.push_back(sStkNP(nearChild,mask));
+			}
+			else
+			{
+				if(!policy.Process(se.node,mask)) return(false);
+			}
+		} while(stack.size()>0);
+	}
+	return(true);
+}
+
 //
 DBVT_PREFIX
 inline void		btDbvt::rayTest(	const btDbvtNode* root,
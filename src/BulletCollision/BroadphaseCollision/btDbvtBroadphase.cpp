@@ -16,6 +16,7 @@ subject to the following restrictions:
 ///btDbvtBroadphase implementation by Nathanael Presson
 
 #include "btDbvtBroadphase.h"
+#include "LinearMath/btQuickprof.h"
 
 //
 // Profiling
@@ -88,6 +89,13 @@ static inline void	clear(T& value)
 // Colliders
 //
 
+/* Adds a pair found by any of the traversals, the only place that counts new pairs	*/ 
+static DBVT_INLINE void	addNewPair(btDbvtBroadphase* pbp,btDbvtProxy* pa,btDbvtProxy* pb)
+{
+	pbp->m_paircache->addOverlappingPair(pa,pb);
+	++pbp->m_newpairs;
+}
+
 /* Tree collider	*/ 
 struct	btDbvtTreeCollider : btDbvt::ICollide
 {
@@ -104,8 +112,7 @@ struct	btDbvtTreeCollider : btDbvt::ICollide
 			if(pa->m_uniqueId>pb->m_uniqueId) 
 				btSwap(pa,pb);
 #endif
-			pbp->m_paircache->addOverlappingPair(pa,pb);
-			++pbp->m_newpairs;
+			addNewPair(pbp,pa,pb);
 		}
 	}
 	void	Process(const btDbvtNode* n)
@@ -114,15 +121,123 @@ struct	btDbvtTreeCollider : btDbvt::ICollide
 	}
 };
 
+/* Pair collector, for traversals on worker threads	*/ 
+struct	btDbvtPairCollector : btDbvt::ICollide
+{
+	btAlignedObjectArray<btDbvtProxy*>*	pairs;
+	btDbvtPairCollector(btAlignedObjectArray<btDbvtProxy*>* p) : pairs(p) {}
+	void	Process(const btDbvtNode* na,const btDbvtNode* nb)
+	{
+		if(na!=nb)
+		{
+			btDbvtProxy*	pa=(btDbvtProxy*)na->data;
+			btDbvtProxy*	pb=(btDbvtProxy*)nb->data;
+#if DBVT_BP_SORTPAIRS
+			if(pa->m_uniqueId>pb->m_uniqueId) 
+				btSwap(pa,pb);
+#endif
+			pairs->push_back(pa);
+			pairs->push_back(pb);
+		}
+	}
+};
+
+/* Subtree pairs of collideTTparallel	*/ 
+struct	btDbvtCollideTaskLoop : btIParallelForBody
+{
+	btDbvtBroadphase*	pbp;
+	btDbvtCollideTaskLoop(btDbvtBroadphase* p) : pbp(p) {}
+	void	forLoop(int iBegin,int iEnd) const
+	{
+		BT_PROFILE_THREAD( "btDbvtBroadphase::collideTTparallel loop" );
+		int									bufferIndex=btGetCurrentThreadIndex();
+		btDbvtBroadphase::CollideBuffer&	buffer=pbp->m_collideBuffers[bufferIndex];
+		btDbvtPairCollector					collector(&buffer.m_pairs);
+		for(int i=iBegin;i<iEnd;++i)
+		{
+			btDbvtBroadphase::CollideTaskRange&	range=pbp->m_collideTaskRanges[i];
+			range.m_buffer	=	bufferIndex;
+			range.m_begin	=	buffer.m_pairs.size();
+			buffer.m_stack[0]=	pbp->m_collideTasks[i];
+			btDbvt::collideTTstack(buffer.m_stack,1,0,collector);
+			range.m_end		=	buffer.m_pairs.size();
+		}
+	}
+};
+
+/* Moved proxies of setAabbBatch	*/ 
+struct	btDbvtCollideProxyLoop : btIParallelForBody
+{
+	btDbvtBroadphase*	pbp;
+	btDbvtCollideProxyLoop(btDbvtBroadphase* p) : pbp(p) {}
+	void	forLoop(int iBegin,int iEnd) const
+	{
+		BT_PROFILE_THREAD( "btDbvtBroadphase::setAabbBatch loop" );
+		int									bufferIndex=btGetCurrentThreadIndex();
+		btDbvtBroadphase::CollideBuffer&	buffer=pbp->m_collideBuffers[bufferIndex];
+		btDbvtPairCollector					collector(&buffer.m_pairs);
+		for(int i=iBegin;i<iEnd;++i)
+		{
+			btDbvtProxy*						proxy=pbp->m_collideProxies[i];
+			btDbvtBroadphase::CollideTaskRange&	range=pbp->m_collideTaskRanges[i];
+			range.m_buffer	=	bufferIndex;
+			range.m_begin	=	buffer.m_pairs.size();
+			/* same order as setAabb	*/ 
+			for(int j=1;j>=0;--j)
+			{
+				if((j==btDbvtBroadphase::FIXED_SET)&&pbp->useCompactFixedSet())
+				{
+					pbp->m_compactFixedSet.collideTT(proxy->leaf,true,buffer.m_compactStack,collector);
+				}
+				else if(pbp->m_sets[j].m_root)
+				{
+					buffer.m_stack[0]=btDbvt::sStkNN(pbp->m_sets[j].m_root,proxy->leaf);
+					btDbvt::collideTTstack(buffer.m_stack,1,0,collector);
+				}
+			}
+			range.m_end		=	buffer.m_pairs.size();
+		}
+	}
+};
+
+/* Incremental optimization of the sets, one set per task	*/ 
+struct	btDbvtOptimizeLoop : btIParallelForBody
+{
+	btDbvtBroadphase*	pbp;
+	int					incremental[btDbvtBroadphase::SETCOUNT];
+	int					rotations[btDbvtBroadphase::SETCOUNT];
+	btDbvtOptimizeLoop(btDbvtBroadphase* p) : pbp(p) {}
+	void	forLoop(int iBegin,int iEnd) const
+	{
+		BT_PROFILE_THREAD( "btDbvtBroadphase::optimize loop" );
+		for(int i=iBegin;i<iEnd;++i)
+		{
+			if(incremental[i]>0)	pbp->m_sets[i].optimizeIncremental(incremental[i]);
+			if(rotations[i]>0)		pbp->m_sets[i].optimizeRotations(rotations[i]);
+		}
+	}
+};
+
 //
 // btDbvtBroadphase
 //
 
+#if BT_THREADSAFE
+/// subtree pairs per worker thread that collideTTparallel hands out
+static int	gDbvtCollideTasksPerThread=16;
+#endif //BT_THREADSAFE
+/// moved proxies per task in setAabbBatch
+static int	gDbvtCollideProxyGrainSize=32;
+
 //
 btDbvtBroadphase::btDbvtBroadphase(btOverlappingPairCache* paircache)
 {
 	m_deferedcollide	=	false;
 	m_needcleanup		=	true;
+	m_batchcollide		=	false;
+	m_compactLayoutPeriod	=	0;
+	m_compactLayoutPid	=	0;
+	m_compactLayoutQuantized	=	false;
 	m_releasepaircache	=	(paircache!=0)?false:true;
 	m_prediction		=	0;
 	m_stageCurrent		=	0;
@@ -130,6 +245,7 @@ btDbvtBroadphase::btDbvtBroadphase(btOverlappingPairCache* paircache)
 	m_fupdates			=	1;
 	m_dupdates			=	0;
 	m_cupdates			=	10;
+	m_rupdates			=	0;
 	m_newpairs			=	1;
 	m_updates_call		=	0;
 	m_updates_done		=	0;
@@ -142,6 +258,19 @@ btDbvtBroadphase::btDbvtBroadphase(btOverlappingPairCache* paircache)
 	{
 		m_stageRoots[i]=0;
 	}
+#if BT_THREADSAFE
+	m_rayTestStacks.resize(BT_MAX_THREAD_COUNT);
+	m_rayPacketStacks.resize(BT_MAX_THREAD_COUNT);
+	m_collideBuffers.resize(BT_MAX_THREAD_COUNT);
+#else
+	m_rayTestStacks.resize(1);
+	m_rayPacketStacks.resize(1);
+	m_collideBuffers.resize(1);
+#endif
+	for(int i=0;i<m_collideBuffers.size();++i)
+	{
+		m_collideBuffers[i].m_stack.resize(btDbvt::DOUBLE_STACKSIZE);
+	}
 #if DBVT_BP_PROFILE
 	clear(m_profiling);
 #endif
@@ -183,7 +312,10 @@ btBroadphaseProxy*				btDbvtBroadphase::createProxy(	const btVector3& aabbMin,
 		btDbvtTreeCollider	collider(this);
 		collider.proxy=proxy;
 		m_sets[0].collideTV(m_sets[0].m_root,aabb,collider);
-		m_sets[1].collideTV(m_sets[1].m_root,aabb,collider);
+		if(useCompactFixedSet())
+			m_compactFixedSet.collideTV(aabb,collider);
+		else
+			m_sets[1].collideTV(m_sets[1].m_root,aabb,collider);
 	}
 	return(proxy);
 }
@@ -227,6 +359,20 @@ struct	BroadphaseRayTester : btDbvt::ICollide
 void	btDbvtBroadphase::rayTest(const btVector3& rayFrom,const btVector3& rayTo, btBroadphaseRayCallback& rayCallback,const btVector3& aabbMin,const btVector3& aabbMax)
 {
 	BroadphaseRayTester callback(rayCallback);
+	btAlignedObjectArray<const btDbvtNode*>* stack = &m_rayTestStacks[0];
+#if BT_THREADSAFE
+	// ray tests may run concurrently, so each thread traverses with its own stack
+	int threadIndex = btGetCurrentThreadIndex();
+	btAlignedObjectArray<const btDbvtNode*> localStack;
+	if (threadIndex < m_rayTestStacks.size())
+	{
+		stack = &m_rayTestStacks[threadIndex];
+	}
+	else
+	{
+		stack = &localStack;
+	}
+#endif
 
 	m_sets[0].rayTestInternal(	m_sets[0].m_root,
 		rayFrom,
@@ -236,20 +382,74 @@ void	btDbvtBroadphase::rayTest(const btVector3& rayFrom,const btVector3& rayTo,
 		rayCallback.m_lambda_max,
 		aabbMin,
 		aabbMax,
+		*stack,
 		callback);
 
-	m_sets[1].rayTestInternal(	m_sets[1].m_root,
-		rayFrom,
-		rayTo,
-		rayCallback.m_rayDirectionInverse,
-		rayCallback.m_signs,
-		rayCallback.m_lambda_max,
-		aabbMin,
-		aabbMax,
-		callback);
+	if(useCompactFixedSet())
+	{
+		m_compactFixedSet.rayTestInternal(	rayFrom,
+			rayCallback.m_rayDirectionInverse,
+			rayCallback.m_signs,
+			rayCallback.m_lambda_max,
+			aabbMin,
+			aabbMax,
+			callback);
+	}
+	else
+	{
+		m_sets[1].rayTestInternal(	m_sets[1].m_root,
+			rayFrom,
+			rayTo,
+			rayCallback.m_rayDirectionInverse,
+			rayCallback.m_signs,
+			rayCallback.m_lambda_max,
+			aabbMin,
+			aabbMax,
+			*stack,
+			callback);
+	}
 
 }
 
+//
+struct	BroadphaseRayPacketTester
+{
+	btBroadphaseRayPacketCallback& m_packetCallback;
+	BroadphaseRayPacketTester(btBroadphaseRayPacketCallback& orgCallback)
+		:m_packetCallback(orgCallback)
+	{
+	}
+	bool					Process(const btDbvtNode* leaf,unsigned int rayMask)
+	{
+		btDbvtProxy*	proxy=(btDbvtProxy*)leaf->data;
+		return m_packetCallback.process(proxy,rayMask);
+	}
+};
+
+void	btDbvtBroadphase::rayTestPacket(btBroadphaseRayPacketCallback& packetCallback)
+{
+	BroadphaseRayPacketTester callback(packetCallback);
+	btAlignedObjectArray<btDbvt::sStkNP>* stack = &m_rayPacketStacks[0];
+#if BT_THREADSAFE
+	// ray tests may run concurrently, so each thread traverses with its own stack
+	int threadIndex = btGetCurrentThreadIndex();
+	btAlignedObjectArray<btDbvt::sStkNP> localStack;
+	if (threadIndex < m_rayPacketStacks.size())
+	{
+		stack = &m_rayPacketStacks[threadIndex];
+	}
+	else
+	{
+		stack = &localStack;
+	}
+#endif
+
+	if (btDbvt::rayTestPacketInternal(m_sets[0].m_root,packetCallback.m_packet,*stack,callback))
+	{
+		btDbvt::rayTestPacketInternal(m_sets[1].m_root,packetCallback.m_packet,*stack,callback);
+	}
+}
+
 
 struct	BroadphaseAabbTester : btDbvt::ICollide
 {
@@ -272,25 +472,26 @@ void	btDbvtBroadphase::aabbTest(const btVector3& aabbMin,const btVector3& aabbMa
 	const ATTRIBUTE_ALIGNED16(btDbvtVolume)	bounds=btDbvtVolume::FromMM(aabbMin,aabbMax);
 		//process all children, that overlap with  the given AABB bounds
 	m_sets[0].collideTV(m_sets[0].m_root,bounds,callback);
-	m_sets[1].collideTV(m_sets[1].m_root,bounds,callback);
+	if(useCompactFixedSet())
+		m_compactFixedSet.collideTV(bounds,callback);
+	else
+		m_sets[1].collideTV(m_sets[1].m_root,bounds,callback);
 
 }
 
 
 
 //
-void							btDbvtBroadphase::setAabb(		btBroadphaseProxy* absproxy,
-														  const btVector3& aabbMin,
-														  const btVector3& aabbMax,
-														  btDispatcher* /*dispatcher*/)
+bool							btDbvtBroadphase::moveProxy(	btDbvtProxy* proxy,
+															const btVector3& aabbMin,
+															const btVector3& aabbMax)
 {
-	btDbvtProxy*						proxy=(btDbvtProxy*)absproxy;
 	ATTRIBUTE_ALIGNED16(btDbvtVolume)	aabb=btDbvtVolume::FromMM(aabbMin,aabbMax);
+	bool	docollide=false;
 #if DBVT_BP_PREVENTFALSEUPDATE
 	if(NotEqual(aabb,proxy->leaf->volume))
 #endif
 	{
-		bool	docollide=false;
 		if(proxy->stage==STAGECOUNT)
 		{/* fixed -> dynamic set	*/ 
 			m_sets[1].remove(proxy->leaf);
@@ -335,16 +536,60 @@ void							btDbvtBroadphase::setAabb(		btBroadphaseProxy* absproxy,
 		if(docollide)
 		{
 			m_needcleanup=true;
-			if(!m_deferedcollide)
-			{
-				btDbvtTreeCollider	collider(this);
-				m_sets[1].collideTTpersistentStack(m_sets[1].m_root,proxy->leaf,collider);
-				m_sets[0].collideTTpersistentStack(m_sets[0].m_root,proxy->leaf,collider);
-			}
-		}	
+		}
 	}
+	return(docollide);
 }
 
+//
+void							btDbvtBroadphase::setAabb(		btBroadphaseProxy* absproxy,
+														  const btVector3& aabbMin,
+														  const btVector3& aabbMax,
+														  btDispatcher* /*dispatcher*/)
+{
+	btDbvtProxy*	proxy=(btDbvtProxy*)absproxy;
+	if(moveProxy(proxy,aabbMin,aabbMax)&&(!m_deferedcollide))
+	{
+		btDbvtTreeCollider	collider(this);
+		if(useCompactFixedSet())
+			m_compactFixedSet.collideTT(proxy->leaf,true,m_compactStack,collider);
+		else
+			m_sets[1].collideTTpersistentStack(m_sets[1].m_root,proxy->leaf,collider);
+		m_sets[0].collideTTpersistentStack(m_sets[0].m_root,proxy->leaf,collider);
+	}
+}
+
+//
+void							btDbvtBroadphase::setAabbBatch(	btBroadphaseProxy** proxies,
+															const btVector3* aabbMins,
+															const btVector3* aabbMaxs,
+															int numProxies,
+															btDispatcher* dispatcher)
+{
+	if((!m_batchcollide)||m_deferedcollide)
+	{
+		btBroadphaseInterface::setAabbBatch(proxies,aabbMins,aabbMaxs,numProxies,dispatcher);
+		return;
+	}
+	BT_PROFILE("btDbvtBroadphase::setAabbBatch");
+	/* move everything first, the trees are not touched by the queries	*/ 
+	m_collideProxies.resizeNoInitialize(0);
+	for(int i=0;i<numProxies;++i)
+	{
+		btDbvtProxy*	proxy=(btDbvtProxy*)proxies[i];
+		if(moveProxy(proxy,aabbMins[i],aabbMaxs[i]))
+		{
+			m_collideProxies.push_back(proxy);
+		}
+	}
+	if(m_collideProxies.size()>0)
+	{
+		resetCollideBuffers(m_collideProxies.size());
+		btDbvtCollideProxyLoop	loop(this);
+		btParallelFor(0,m_collideProxies.size(),gDbvtCollideProxyGrainSize,loop);
+		addCollideTaskPairs();
+	}
+}
 
 //
 void							btDbvtBroadphase::setAabbForceUpdate(		btBroadphaseProxy* absproxy,
@@ -380,7 +625,10 @@ void							btDbvtBroadphase::setAabbForceUpdate(		btBroadphaseProxy* absproxy,
 		if(!m_deferedcollide)
 		{
 			btDbvtTreeCollider	collider(this);
-			m_sets[1].collideTTpersistentStack(m_sets[1].m_root,proxy->leaf,collider);
+			if(useCompactFixedSet())
+				m_compactFixedSet.collideTT(proxy->leaf,true,m_compactStack,collider);
+			else
+				m_sets[1].collideTTpersistentStack(m_sets[1].m_root,proxy->leaf,collider);
 			m_sets[0].collideTTpersistentStack(m_sets[0].m_root,proxy->leaf,collider);
 		}
 	}	
@@ -508,12 +756,24 @@ void							btDbvtBroadphase::collide(btDispatcher* dispatcher)
 
 	SPC(m_profiling.m_total);
 	/* optimize				*/ 
-	m_sets[0].optimizeIncremental(1+(m_sets[0].m_leaves*m_dupdates)/100);
-	if(m_fixedleft)
 	{
-		const int count=1+(m_sets[1].m_leaves*m_fupdates)/100;
-		m_sets[1].optimizeIncremental(1+(m_sets[1].m_leaves*m_fupdates)/100);
-		m_fixedleft=btMax<int>(0,m_fixedleft-count);
+		btDbvtOptimizeLoop	loop(this);
+		loop.incremental[0]=1+(m_sets[0].m_leaves*m_dupdates)/100;
+		loop.incremental[1]=m_fixedleft?1+(m_sets[1].m_leaves*m_fupdates)/100:0;
+		for(int i=0;i<SETCOUNT;++i)
+		{
+			loop.rotations[i]=(m_rupdates>0)?1+(m_sets[i].m_leaves*m_rupdates)/100:0;
+		}
+		if(m_rupdates>0)
+		{
+			/* the sets are independent, the fixed set is refined on a worker thread	*/ 
+			btParallelFor(0,SETCOUNT,1,loop);
+		}
+		else
+		{
+			loop.forLoop(0,SETCOUNT);
+		}
+		m_fixedleft=btMax<int>(0,m_fixedleft-loop.incremental[1]);
 	}
 	/* dynamic -> fixed set	*/ 
 	m_stageCurrent=(m_stageCurrent+1)%STAGECOUNT;
@@ -540,18 +800,23 @@ void							btDbvtBroadphase::collide(btDispatcher* dispatcher)
 		m_fixedleft=m_sets[1].m_leaves;
 		m_needcleanup=true;
 	}
+	/* compact layout of the fixed set	*/ 
+	if((m_compactLayoutPeriod>0)&&(!m_compactFixedSet.isValid(m_sets[1]))&&((m_pid-m_compactLayoutPid)>=m_compactLayoutPeriod))
+	{
+		m_compactFixedSet.build(m_sets[1],m_compactLayoutQuantized);
+		m_compactLayoutPid=m_pid;
+	}
 	/* collide dynamics		*/ 
 	{
-		btDbvtTreeCollider	collider(this);
 		if(m_deferedcollide)
 		{
 			SPC(m_profiling.m_fdcollide);
-			m_sets[0].collideTTpersistentStack(m_sets[0].m_root,m_sets[1].m_root,collider);
+			collideTTparallel(m_sets[0].m_root,m_sets[1].m_root);
 		}
 		if(m_deferedcollide)
 		{
 			SPC(m_profiling.m_ddcollide);
-			m_sets[0].collideTTpersistentStack(m_sets[0].m_root,m_sets[0].m_root,collider);
+			collideTTparallel(m_sets[0].m_root,m_sets[0].m_root);
 		}
 	}
 	/* clean up				*/ 
@@ -592,6 +857,66 @@ void							btDbvtBroadphase::collide(btDispatcher* dispatcher)
 	m_updates_call/=2;
 }
 
+//
+void							btDbvtBroadphase::collideTTparallel(const btDbvtNode* root0,const btDbvtNode* root1)
+{
+	btDbvtTreeCollider	collider(this);
+#if BT_THREADSAFE
+	const int	numThreads=btGetTaskScheduler()->getNumThreads();
+	if(root0&&root1&&(numThreads>1)&&(!btThreadsAreRunning()))
+	{
+		/* walk the top of the trees here, until there are enough subtree pairs for all threads	*/ 
+		btAlignedObjectArray<btDbvt::sStkNN>&	stack=m_sets[0].m_stkStack;
+		stack.resize(btDbvt::DOUBLE_STACKSIZE);
+		stack[0]=btDbvt::sStkNN(root0,root1);
+		const int	depth=btDbvt::collideTTstack(stack,1,numThreads*gDbvtCollideTasksPerThread,collider);
+		if(depth>0)
+		{
+			/* the serial traversal would pop these from the top of the stack	*/ 
+			m_collideTasks.resizeNoInitialize(depth);
+			for(int i=0;i<depth;++i)
+			{
+				m_collideTasks[i]=stack[depth-1-i];
+			}
+			resetCollideBuffers(depth);
+			btDbvtCollideTaskLoop	loop(this);
+			btParallelFor(0,depth,1,loop);
+			addCollideTaskPairs();
+		}
+		return;
+	}
+#endif
+	if((root0!=root1)&&(root1==m_sets[1].m_root)&&useCompactFixedSet())
+		m_compactFixedSet.collideTT(root0,false,m_compactStack,collider);
+	else
+		m_sets[0].collideTTpersistentStack(root0,root1,collider);
+}
+
+//
+void							btDbvtBroadphase::resetCollideBuffers(int numTasks)
+{
+	for(int i=0;i<m_collideBuffers.size();++i)
+	{
+		m_collideBuffers[i].m_pairs.resizeNoInitialize(0);
+	}
+	m_collideTaskRanges.resizeNoInitialize(numTasks);
+}
+
+//
+void							btDbvtBroadphase::addCollideTaskPairs()
+{
+	/* in task order, so the pair cache ends up the same for any number of threads	*/ 
+	for(int i=0;i<m_collideTaskRanges.size();++i)
+	{
+		const CollideTaskRange&						range=m_collideTaskRanges[i];
+		const btAlignedObjectArray<btDbvtProxy*>&	pairs=m_collideBuffers[range.m_buffer].m_pairs;
+		for(int j=range.m_begin;j<range.m_end;j+=2)
+		{
+			addNewPair(this,pairs[j],pairs[j+1]);
+		}
+	}
+}
+
 //
 void							btDbvtBroadphase::optimize()
 {
@@ -599,6 +924,13 @@ void							btDbvtBroadphase::optimize()
 	m_sets[1].optimizeTopDown();
 }
 
+//
+void							btDbvtBroadphase::optimizeParallel()
+{
+	m_sets[0].optimizeTopDownParallel();
+	m_sets[1].optimizeTopDownParallel();
+}
+
 //
 btOverlappingPairCache*			btDbvtBroadphase::getOverlappingPairCache()
 {
@@ -638,6 +970,7 @@ void btDbvtBroadphase::resetPool(btDispatcher* dispatcher)
 		//reset internal dynamic tree data structures
 		m_sets[0].clear();
 		m_sets[1].clear();
+		m_compactFixedSet.clear();
 		
 		m_deferedcollide	=	false;
 		m_needcleanup		=	true;
@@ -646,6 +979,7 @@ void btDbvtBroadphase::resetPool(btDispatcher* dispatcher)
 		m_fupdates			=	1;
 		m_dupdates			=	0;
 		m_cupdates			=	10;
+		m_rupdates			=	0;
 		m_newpairs			=	1;
 		m_updates_call		=	0;
 		m_updates_done		=	0;
@@ -654,6 +988,7 @@ void btDbvtBroadphase::resetPool(btDispatcher* dispatcher)
 		m_gid				=	0;
 		m_pid				=	0;
 		m_cid				=	0;
+		m_compactLayoutPid	=	0;
 		for(int i=0;i<=STAGECOUNT;++i)
 		{
 			m_stageRoots[i]=0;
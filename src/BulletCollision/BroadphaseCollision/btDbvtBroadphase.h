@@ -18,7 +18,9 @@ subject to the following restrictions:
 #define BT_DBVT_BROADPHASE_H
 
 #include "BulletCollision/BroadphaseCollision/btDbvt.h"
+#include "BulletCollision/BroadphaseCollision/btCompactDbvt.h"
 #include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "LinearMath/btThreads.h"
 
 //
 // Compile time config
@@ -59,16 +61,26 @@ typedef btAlignedObjectArray<btDbvtProxy*>	btDbvtProxyArray;
 ///The btDbvtBroadphase implements a broadphase using two dynamic AABB bounding volume hierarchies/trees (see btDbvt).
 ///One tree is used for static/non-moving objects, and another tree is used for dynamic objects. Objects can move from one tree to the other.
 ///This is a very fast broadphase, especially for very dynamic worlds where many objects are moving. Its insert/add and remove of objects is generally faster than the sweep and prune broadphases btAxisSweep3 and bt32BitAxisSweep3.
+///With a multi-threaded task scheduler, the deferred tree/tree collision is split at subtree pairs that are traversed by the worker threads,
+///and the pairs are added to the pair cache afterwards in the same order as a serial traversal.
+///With m_batchcollide, setAabbBatch moves all proxies first and then searches the new pairs of each moved proxy in parallel.
+///With m_compactLayoutPeriod > 0 the fixed set is also kept as a btCompactDbvt, laid out again at most every m_compactLayoutPeriod calls of collide
+///after it changed. The pair searches and the ray and aabb tests use it instead of the fixed set while it is up to date, they find the same pairs in the same order.
+///With m_rupdates > 0 both sets are also refined by tree rotations (see btDbvt::optimizeRotations) every frame, each set in its own task,
+///which keeps the trees tight for fast moving objects at a small and steady cost. optimizeParallel rebuilds both sets top down in parallel, for level loading.
 struct	btDbvtBroadphase : btBroadphaseInterface
 {
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
 	/* Config		*/ 
 	enum	{
 		DYNAMIC_SET			=	0,	/* Dynamic set index	*/ 
 		FIXED_SET			=	1,	/* Fixed set index		*/ 
+		SETCOUNT			=	2,	/* Number of sets		*/ 
 		STAGECOUNT			=	2	/* Number of stages		*/ 
 	};
 	/* Fields		*/ 
-	btDbvt					m_sets[2];					// Dbvt sets
+	btDbvt					m_sets[SETCOUNT];					// Dbvt sets
 	btDbvtProxy*			m_stageRoots[STAGECOUNT+1];	// Stages list
 	btOverlappingPairCache*	m_paircache;				// Pair cache
 	btScalar				m_prediction;				// Velocity prediction
@@ -76,6 +88,7 @@ struct	btDbvtBroadphase : btBroadphaseInterface
 	int						m_fupdates;					// % of fixed updates per frame
 	int						m_dupdates;					// % of dynamic updates per frame
 	int						m_cupdates;					// % of cleanup updates per frame
+	int						m_rupdates;					// % of rotation updates per frame
 	int						m_newpairs;					// Number of pairs created
 	int						m_fixedleft;				// Fixed optimization left
 	unsigned				m_updates_call;				// Number of updates call
@@ -87,6 +100,32 @@ struct	btDbvtBroadphase : btBroadphaseInterface
 	bool					m_releasepaircache;			// Release pair cache on delete
 	bool					m_deferedcollide;			// Defere dynamic/static collision to collide call
 	bool					m_needcleanup;				// Need to run cleanup?
+	bool					m_batchcollide;				// Find the pairs of setAabbBatch after moving all proxies, in parallel
+	btCompactDbvt			m_compactFixedSet;			// Compact layout of the fixed set
+	btAlignedObjectArray<btCompactDbvt::sStkNC>	m_compactStack;	// Stack of the compact fixed set collide
+	int						m_compactLayoutPeriod;		// Relayout the fixed set at most every n collide calls, 0 to disable
+	int						m_compactLayoutPid;			// Parse id of the last relayout
+	bool					m_compactLayoutQuantized;	// Quantize the bounds of the compact layout
+	btAlignedObjectArray< btAlignedObjectArray<const btDbvtNode*> > m_rayTestStacks; // Ray test stacks, one per thread
+	btAlignedObjectArray< btAlignedObjectArray<btDbvt::sStkNP> > m_rayPacketStacks; // Ray packet stacks, one per thread
+	/* Parallel collide	*/ 
+	struct	CollideBuffer
+	{
+		btAlignedObjectArray<btDbvt::sStkNN>	m_stack;
+		btAlignedObjectArray<btCompactDbvt::sStkNC>	m_compactStack;
+		btAlignedObjectArray<btDbvtProxy*>		m_pairs;		// Found pairs, two proxies each
+		char									m_padding[64];	// Keep threads off each others cache lines
+	};
+	struct	CollideTaskRange
+	{
+		int						m_buffer;
+		int						m_begin;
+		int						m_end;
+	};
+	btAlignedObjectArray<CollideBuffer>			m_collideBuffers;		// Collide buffers, one per thread
+	btAlignedObjectArray<btDbvt::sStkNN>		m_collideTasks;			// Subtree pairs, in traversal order
+	btAlignedObjectArray<btDbvtProxy*>			m_collideProxies;		// Moved proxies of setAabbBatch, in order
+	btAlignedObjectArray<CollideTaskRange>		m_collideTaskRanges;	// Pairs found by each task or proxy
 #if DBVT_BP_PROFILE
 	btClock					m_clock;
 	struct	{
@@ -102,12 +141,21 @@ struct	btDbvtBroadphase : btBroadphaseInterface
 	~btDbvtBroadphase();
 	void							collide(btDispatcher* dispatcher);
 	void							optimize();
+	///like optimize, with the subtrees built in parallel by the task scheduler (see btDbvt::optimizeTopDownParallel)
+	void							optimizeParallel();
+	void							collideTTparallel(const btDbvtNode* root0,const btDbvtNode* root1);
+	bool							moveProxy(btDbvtProxy* proxy,const btVector3& aabbMin,const btVector3& aabbMax);
+	void							resetCollideBuffers(int numTasks);
+	void							addCollideTaskPairs();
+	bool							useCompactFixedSet() const	{ return((m_compactLayoutPeriod>0)&&m_compactFixedSet.isValid(m_sets[FIXED_SET])); }
 	
 	/* btBroadphaseInterface Implementation	*/
 	btBroadphaseProxy*				createProxy(const btVector3& aabbMin,const btVector3& aabbMax,int shapeType,void* userPtr,short int collisionFilterGroup,short int collisionFilterMask,btDispatcher* dispatcher,void* multiSapProxy);
 	virtual void					destroyProxy(btBroadphaseProxy* proxy,btDispatcher* dispatcher);
 	virtual void					setAabb(btBroadphaseProxy* proxy,const btVector3& aabbMin,const btVector3& aabbMax,btDispatcher* dispatcher);
+	virtual void					setAabbBatch(btBroadphaseProxy** proxies,const btVector3* aabbMins,const btVector3* aabbMaxs,int numProxies,btDispatcher* dispatcher);
 	virtual void					rayTest(const btVector3& rayFrom,const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin=btVector3(0,0,0), const btVector3& aabbMax = btVector3(0,0,0));
+	virtual void					rayTestPacket(btBroadphaseRayPacketCallback& callback);
 	virtual void					aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback);
 
 	virtual void					getAabb(btBroadphaseProxy* proxy,btVector3& aabbMin, btVector3& aabbMax ) const;
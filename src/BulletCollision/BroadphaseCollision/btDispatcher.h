@@ -46,7 +46,8 @@ struct btDispatcherInfo
 		m_useEpa(true),
 		m_allowedCcdPenetration(btScalar(0.04)),
 		m_useConvexConservativeDistanceUtil(false),
-		m_convexConservativeDistanceThreshold(0.0f)
+		m_convexConservativeDistanceThreshold(0.0f),
+		m_deterministicOrder(false)
 	{
 
 	}
@@ -60,8 +61,14 @@ struct btDispatcherInfo
 	bool		m_enableSPU;
 	bool		m_useEpa;
 	btScalar	m_allowedCcdPenetration;
+	///skip convex pairs while their cached separating axis proves they are further apart than the contact breaking threshold
+	///plus m_convexConservativeDistanceThreshold, see btConvexConvexAlgorithm
 	bool		m_useConvexConservativeDistanceUtil;
 	btScalar	m_convexConservativeDistanceThreshold;
+	///sort the overlapping pairs, and the manifolds of each simulation island, by the unique ids of their objects.
+	///Together with the multi-threaded dispatcher and island solver this gives bitwise identical results for any number
+	///of threads, and results that don't depend on the order in which pairs were found.
+	bool		m_deterministicOrder;
 };
 
 ///The btDispatcher interface class can be used in combination with broadphase to dispatch calculations for overlapping pairs.
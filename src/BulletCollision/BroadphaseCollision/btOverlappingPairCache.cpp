@@ -397,32 +397,28 @@ void	btHashedOverlappingPairCache::processAllOverlappingPairs(btOverlapCallback*
 
 void	btHashedOverlappingPairCache::sortOverlappingPairs(btDispatcher* dispatcher)
 {
-	///need to keep hashmap in sync with pair address, so rebuild all
-	btBroadphasePairArray tmpPairs;
-	int i;
-	for (i=0;i<m_overlappingPairArray.size();i++)
-	{
-		tmpPairs.push_back(m_overlappingPairArray[i]);
-	}
+	(void)dispatcher;
+	///the pairs keep their algorithms (and so their manifolds), only the hash chains are rebuilt for the new pair indices
+	m_overlappingPairArray.quickSort(btBroadphasePairSortPredicate());
 
-	for (i=0;i<tmpPairs.size();i++)
+	int i;
+	for (i = 0; i < m_hashTable.size(); i++)
 	{
-		removeOverlappingPair(tmpPairs[i].m_pProxy0,tmpPairs[i].m_pProxy1,dispatcher);
+		m_hashTable[i] = BT_NULL_PAIR;
 	}
-	
 	for (i = 0; i < m_next.size(); i++)
 	{
 		m_next[i] = BT_NULL_PAIR;
 	}
-
-	tmpPairs.quickSort(btBroadphasePairSortPredicate());
-
-	for (i=0;i<tmpPairs.size();i++)
+	for (i = 0; i < m_overlappingPairArray.size(); i++)
 	{
-		addOverlappingPair(tmpPairs[i].m_pProxy0,tmpPairs[i].m_pProxy1);
+		const btBroadphasePair& pair = m_overlappingPairArray[i];
+		int proxyId1 = pair.m_pProxy0->getUid();
+		int proxyId2 = pair.m_pProxy1->getUid();
+		int	hashValue = static_cast<int>(getHash(static_cast<unsigned int>(proxyId1),static_cast<unsigned int>(proxyId2)) & (m_overlappingPairArray.capacity()-1));
+		m_next[i] = m_hashTable[hashValue];
+		m_hashTable[hashValue] = i;
 	}
-
-	
 }
 
 
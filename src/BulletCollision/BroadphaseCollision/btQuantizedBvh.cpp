@@ -18,6 +18,8 @@ subject to the following restrictions:
 #include "LinearMath/btAabbUtil2.h"
 #include "LinearMath/btIDebugDraw.h"
 #include "LinearMath/btSerializer.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
 
 #define RAYAABB2
 
@@ -124,92 +126,451 @@ btQuantizedBvh::~btQuantizedBvh()
 {
 }
 
-#ifdef DEBUG_TREE_BUILDING
-int gStackDepth = 0;
-int gMaxStackDepth = 0;
-#endif //DEBUG_TREE_BUILDING
+int gQuantizedBvhSahBinCount = 0;
 
-void	btQuantizedBvh::buildTree	(int startIndex,int endIndex)
+#if BT_THREADSAFE
+/// leaf node ranges per worker thread that buildTree hands out
+static int	gQuantizedBvhBuildTasksPerThread = 8;
+/// leaf node ranges smaller than this are built on a single thread
+static int	gQuantizedBvhParallelMinLeafCount = 4096;
+#endif //BT_THREADSAFE
+
+struct btQuantizedBvhSahBin
+{
+	btVector3	m_aabbMin;
+	btVector3	m_aabbMax;
+	int	m_count;
+};
+
+///bounds of a range of leaf nodes and, for the surface area heuristic, their bins along each axis.
+///The passes over a large range compute one of these per chunk and merge them afterwards.
+struct btQuantizedBvhRangeInfo
+{
+	btVector3	m_aabbMin;
+	btVector3	m_aabbMax;
+	btVector3	m_centroidMin;
+	btVector3	m_centroidMax;
+	btQuantizedBvhSahBin	m_bins[3][BT_QUANTIZED_BVH_MAX_SAH_BINS];
+
+	void	resetBounds()
+	{
+		m_aabbMin.setValue(btScalar(BT_LARGE_FLOAT),btScalar(BT_LARGE_FLOAT),btScalar(BT_LARGE_FLOAT));
+		m_aabbMax.setValue(btScalar(-BT_LARGE_FLOAT),btScalar(-BT_LARGE_FLOAT),btScalar(-BT_LARGE_FLOAT));
+		m_centroidMin = m_aabbMin;
+		m_centroidMax = m_aabbMax;
+	}
+
+	void	resetBins(int numBins)
+	{
+		for (int axis=0;axis<3;axis++)
+		{
+			for (int i=0;i<numBins;i++)
+			{
+				m_bins[axis][i].m_aabbMin.setValue(btScalar(BT_LARGE_FLOAT),btScalar(BT_LARGE_FLOAT),btScalar(BT_LARGE_FLOAT));
+				m_bins[axis][i].m_aabbMax.setValue(btScalar(-BT_LARGE_FLOAT),btScalar(-BT_LARGE_FLOAT),btScalar(-BT_LARGE_FLOAT));
+				m_bins[axis][i].m_count = 0;
+			}
+		}
+	}
+
+	void	mergeBounds(const btQuantizedBvhRangeInfo& other)
+	{
+		m_aabbMin.setMin(other.m_aabbMin);
+		m_aabbMax.setMax(other.m_aabbMax);
+		m_centroidMin.setMin(other.m_centroidMin);
+		m_centroidMax.setMax(other.m_centroidMax);
+	}
+
+	void	mergeBins(const btQuantizedBvhRangeInfo& other,int numBins)
+	{
+		for (int axis=0;axis<3;axis++)
+		{
+			for (int i=0;i<numBins;i++)
+			{
+				m_bins[axis][i].m_aabbMin.setMin(other.m_bins[axis][i].m_aabbMin);
+				m_bins[axis][i].m_aabbMax.setMax(other.m_bins[axis][i].m_aabbMax);
+				m_bins[axis][i].m_count += other.m_bins[axis][i].m_count;
+			}
+		}
+	}
+};
+
+struct btQuantizedBvhBuildTask
+{
+	int	m_startIndex;
+	int	m_endIndex;
+	int	m_nodeIndex;
+};
+
+struct btQuantizedBvhBuildLoop : public btIParallelForBody
 {
-#ifdef DEBUG_TREE_BUILDING
-	gStackDepth++;
-	if (gStackDepth > gMaxStackDepth)
-		gMaxStackDepth = gStackDepth;
-#endif //DEBUG_TREE_BUILDING
+	btQuantizedBvh*	m_bvh;
+	const btQuantizedBvhBuildTask*	m_tasks;
 
+	btQuantizedBvhBuildLoop(btQuantizedBvh* bvh,const btQuantizedBvhBuildTask* tasks)
+		:m_bvh(bvh),
+		m_tasks(tasks)
+	{
+	}
+
+	void	forLoop(int iBegin,int iEnd) const
+	{
+		BT_PROFILE_THREAD("btQuantizedBvh build loop");
+		for (int i=iBegin;i<iEnd;i++)
+		{
+			const btQuantizedBvhBuildTask& task = m_tasks[i];
+			m_bvh->buildSubtree(task.m_startIndex,task.m_endIndex,task.m_nodeIndex);
+		}
+	}
+};
+
+struct btQuantizedBvhRangeInfoLoop : public btIParallelForBody
+{
+	const btQuantizedBvh*	m_bvh;
+	btQuantizedBvhRangeInfo*	m_chunkInfos;
+	int	m_startIndex;
+	int	m_endIndex;
+	int	m_chunkSize;
+	int	m_numBins;	///< 0 for the bounds pass
+	btVector3	m_centroidMin;
+	btVector3	m_binScale;
+
+	void	forLoop(int iBegin,int iEnd) const
+	{
+		BT_PROFILE_THREAD("btQuantizedBvh range loop");
+		for (int i=iBegin;i<iEnd;i++)
+		{
+			int chunkStart = m_startIndex+i*m_chunkSize;
+			int chunkEnd = btMin(chunkStart+m_chunkSize,m_endIndex);
+			if (m_numBins)
+			{
+				m_bvh->calcRangeBins(chunkStart,chunkEnd,m_numBins,m_centroidMin,m_binScale,m_chunkInfos[i],false);
+			}
+			else
+			{
+				m_bvh->calcRangeInfo(chunkStart,chunkEnd,m_chunkInfos[i],false);
+			}
+		}
+	}
+};
+
+static int	btQuantizedBvhNumChunks(int numIndices,bool parallel)
+{
+#if BT_THREADSAFE
+	if (parallel)
+	{
+		int numChunks = btGetTaskScheduler()->getNumThreads()*gQuantizedBvhBuildTasksPerThread;
+		return btMax(1,btMin(numChunks,numIndices/gQuantizedBvhParallelMinLeafCount));
+	}
+#else
+	(void)numIndices;
+	(void)parallel;
+#endif
+	return 1;
+}
+
+static SIMD_FORCE_INLINE btScalar	btHalfSurfaceArea(const btVector3& aabbMin,const btVector3& aabbMax)
+{
+	btVector3 extent = aabbMax-aabbMin;
+	return extent.getX()*extent.getY()+extent.getY()*extent.getZ()+extent.getZ()*extent.getX();
+}
+
+static SIMD_FORCE_INLINE int	btQuantizedBvhBinIndex(btScalar centroid,btScalar centroidMin,btScalar binScale,int numBins)
+{
+	int bin = int((centroid-centroidMin)*binScale);
+	return btMax(0,btMin(bin,numBins-1));
+}
+
+
+void	btQuantizedBvh::buildTree	(int startIndex,int endIndex)
+{
+	BT_PROFILE("btQuantizedBvh::buildTree");
 
-	int splitAxis, splitIndex, i;
 	int numIndices =endIndex-startIndex;
-	int curIndex = m_curNodeIndex;
+	btAssert(numIndices>0);
+
+	//a subtree of n leaf nodes always takes 2n-1 nodes, so the node index of every subtree is known before it is built
+	int rootNodeIndex = m_curNodeIndex;
+	m_curNodeIndex += 2*numIndices-1;
 
+#if BT_THREADSAFE
+	const int numThreads = btGetTaskScheduler()->getNumThreads();
+	if ((numThreads>1) && !btThreadsAreRunning() && (numIndices >= 2*gQuantizedBvhParallelMinLeafCount))
+	{
+		/* split the top of the tree here, until there are enough leaf node ranges for all threads	*/
+		const int maxTaskSize = btMax(gQuantizedBvhParallelMinLeafCount,numIndices/(numThreads*gQuantizedBvhBuildTasksPerThread));
+		btAlignedObjectArray<btQuantizedBvhBuildTask> stack;
+		btAlignedObjectArray<btQuantizedBvhBuildTask> tasks;
+		btQuantizedBvhBuildTask root;
+		root.m_startIndex = startIndex;
+		root.m_endIndex = endIndex;
+		root.m_nodeIndex = rootNodeIndex;
+		stack.push_back(root);
+		while (stack.size())
+		{
+			btQuantizedBvhBuildTask task = stack[stack.size()-1];
+			stack.pop_back();
+			int numTaskIndices = task.m_endIndex-task.m_startIndex;
+			if (numTaskIndices <= maxTaskSize)
+			{
+				tasks.push_back(task);
+				continue;
+			}
+			int splitIndex = splitInternalNode(task.m_startIndex,task.m_endIndex,task.m_nodeIndex,true);
+			setInternalNodeEscapeIndex(task.m_nodeIndex,2*numTaskIndices-1);
+
+			btQuantizedBvhBuildTask left;
+			left.m_startIndex = task.m_startIndex;
+			left.m_endIndex = splitIndex;
+			left.m_nodeIndex = task.m_nodeIndex+1;
+			btQuantizedBvhBuildTask right;
+			right.m_startIndex = splitIndex;
+			right.m_endIndex = task.m_endIndex;
+			right.m_nodeIndex = left.m_nodeIndex+2*(splitIndex-task.m_startIndex)-1;
+			stack.push_back(right);
+			stack.push_back(left);
+		}
+		btQuantizedBvhBuildLoop loop(this,&tasks[0]);
+		btParallelFor(0,tasks.size(),1,loop);
+	}
+	else
+#endif
+	{
+		buildSubtree(startIndex,endIndex,rootNodeIndex);
+	}
+
+	if (m_useQuantization)
+	{
+		buildSubtreeHeaders(rootNodeIndex);
+	}
+}
+
+void	btQuantizedBvh::buildSubtree(int startIndex,int endIndex,int nodeIndex)
+{
+	int numIndices =endIndex-startIndex;
 	btAssert(numIndices>0);
 
 	if (numIndices==1)
 	{
-#ifdef DEBUG_TREE_BUILDING
-		gStackDepth--;
-#endif //DEBUG_TREE_BUILDING
-		
-		assignInternalNodeFromLeafNode(m_curNodeIndex,startIndex);
-
-		m_curNodeIndex++;
-		return;	
+		assignInternalNodeFromLeafNode(nodeIndex,startIndex);
+		return;
 	}
-	//calculate Best Splitting Axis and where to split it. Sort the incoming 'leafNodes' array within range 'startIndex/endIndex'.
-	
-	splitAxis = calcSplittingAxis(startIndex,endIndex);
 
-	splitIndex = sortAndCalcSplittingIndex(startIndex,endIndex,splitAxis);
+	int splitIndex = splitInternalNode(startIndex,endIndex,nodeIndex,false);
+
+	int leftChildNodexIndex = nodeIndex+1;
+	int rightChildNodexIndex = leftChildNodexIndex+2*(splitIndex-startIndex)-1;
+	buildSubtree(startIndex,splitIndex,leftChildNodexIndex);
+	buildSubtree(splitIndex,endIndex,rightChildNodexIndex);
+
+	//the escape index is the number of nodes of this subtree
+	setInternalNodeEscapeIndex(nodeIndex,2*numIndices-1);
+}
+
+int	btQuantizedBvh::splitInternalNode(int startIndex,int endIndex,int nodeIndex,bool parallel)
+{
+	btQuantizedBvhRangeInfo info;
+	calcRangeInfo(startIndex,endIndex,info,parallel);
 
-	int internalNodeIndex = m_curNodeIndex;
-	
 	//set the min aabb to 'inf' or a max value, and set the max aabb to a -inf/minimum value.
-	//the aabb will be expanded during buildTree/mergeInternalNodeAabb with actual node values
-	setInternalNodeAabbMin(m_curNodeIndex,m_bvhAabbMax);//can't use btVector3(SIMD_INFINITY,SIMD_INFINITY,SIMD_INFINITY)) because of quantization
-	setInternalNodeAabbMax(m_curNodeIndex,m_bvhAabbMin);//can't use btVector3(-SIMD_INFINITY,-SIMD_INFINITY,-SIMD_INFINITY)) because of quantization
-	
-	
-	for (i=startIndex;i<endIndex;i++)
+	//then merge the aabb of the leaf nodes, this gives the same quantized values as merging them one by one
+	setInternalNodeAabbMin(nodeIndex,m_bvhAabbMax);//can't use btVector3(SIMD_INFINITY,SIMD_INFINITY,SIMD_INFINITY)) because of quantization
+	setInternalNodeAabbMax(nodeIndex,m_bvhAabbMin);//can't use btVector3(-SIMD_INFINITY,-SIMD_INFINITY,-SIMD_INFINITY)) because of quantization
+	mergeInternalNodeAabb(nodeIndex,info.m_aabbMin,info.m_aabbMax);
+
+	int splitIndex = -1;
+	int numBins = btMin(gQuantizedBvhSahBinCount,int(BT_QUANTIZED_BVH_MAX_SAH_BINS));
+	if (numBins > 1)
+	{
+		splitIndex = sortAndCalcSahSplittingIndex(startIndex,endIndex,numBins,info,parallel);
+	}
+	if (splitIndex < 0)
 	{
-		mergeInternalNodeAabb(m_curNodeIndex,getAabbMin(i),getAabbMax(i));
+		//calculate Best Splitting Axis and where to split it. Sort the incoming 'leafNodes' array within range 'startIndex/endIndex'.
+		int splitAxis = calcSplittingAxis(startIndex,endIndex);
+		splitIndex = sortAndCalcSplittingIndex(startIndex,endIndex,splitAxis);
 	}
+	return splitIndex;
+}
 
-	m_curNodeIndex++;
-	
+void	btQuantizedBvh::calcRangeInfo(int startIndex,int endIndex,btQuantizedBvhRangeInfo& info,bool parallel) const
+{
+	info.resetBounds();
+	int numChunks = btQuantizedBvhNumChunks(endIndex-startIndex,parallel);
+	if (numChunks > 1)
+	{
+		btAlignedObjectArray<btQuantizedBvhRangeInfo> chunkInfos;
+		chunkInfos.resize(numChunks);
+		btQuantizedBvhRangeInfoLoop loop;
+		loop.m_bvh = this;
+		loop.m_chunkInfos = &chunkInfos[0];
+		loop.m_startIndex = startIndex;
+		loop.m_endIndex = endIndex;
+		loop.m_chunkSize = (endIndex-startIndex+numChunks-1)/numChunks;
+		loop.m_numBins = 0;
+		btParallelFor(0,numChunks,1,loop);
+		for (int i=0;i<numChunks;i++)
+		{
+			info.mergeBounds(chunkInfos[i]);
+		}
+		return;
+	}
 
-	//internalNode->m_escapeIndex;
-	
-	int leftChildNodexIndex = m_curNodeIndex;
+	for (int i=startIndex;i<endIndex;i++)
+	{
+		btVector3 aabbMin = getAabbMin(i);
+		btVector3 aabbMax = getAabbMax(i);
+		btVector3 center = btScalar(0.5)*(aabbMax+aabbMin);
+		info.m_aabbMin.setMin(aabbMin);
+		info.m_aabbMax.setMax(aabbMax);
+		info.m_centroidMin.setMin(center);
+		info.m_centroidMax.setMax(center);
+	}
+}
+
+void	btQuantizedBvh::calcRangeBins(int startIndex,int endIndex,int numBins,const btVector3& centroidMin,const btVector3& binScale,btQuantizedBvhRangeInfo& info,bool parallel) const
+{
+	info.resetBins(numBins);
+	int numChunks = btQuantizedBvhNumChunks(endIndex-startIndex,parallel);
+	if (numChunks > 1)
+	{
+		btAlignedObjectArray<btQuantizedBvhRangeInfo> chunkInfos;
+		chunkInfos.resize(numChunks);
+		btQuantizedBvhRangeInfoLoop loop;
+		loop.m_bvh = this;
+		loop.m_chunkInfos = &chunkInfos[0];
+		loop.m_startIndex = startIndex;
+		loop.m_endIndex = endIndex;
+		loop.m_chunkSize = (endIndex-startIndex+numChunks-1)/numChunks;
+		loop.m_numBins = numBins;
+		loop.m_centroidMin = centroidMin;
+		loop.m_binScale = binScale;
+		btParallelFor(0,numChunks,1,loop);
+		for (int i=0;i<numChunks;i++)
+		{
+			info.mergeBins(chunkInfos[i],numBins);
+		}
+		return;
+	}
 
-	//build left child tree
-	buildTree(startIndex,splitIndex);
+	for (int i=startIndex;i<endIndex;i++)
+	{
+		btVector3 aabbMin = getAabbMin(i);
+		btVector3 aabbMax = getAabbMax(i);
+		btVector3 center = btScalar(0.5)*(aabbMax+aabbMin);
+		for (int axis=0;axis<3;axis++)
+		{
+			btQuantizedBvhSahBin& bin = info.m_bins[axis][btQuantizedBvhBinIndex(center[axis],centroidMin[axis],binScale[axis],numBins)];
+			bin.m_aabbMin.setMin(aabbMin);
+			bin.m_aabbMax.setMax(aabbMax);
+			bin.m_count++;
+		}
+	}
+}
 
-	int rightChildNodexIndex = m_curNodeIndex;
-	//build right child tree
-	buildTree(splitIndex,endIndex);
+int	btQuantizedBvh::sortAndCalcSahSplittingIndex(int startIndex,int endIndex,int numBins,const btQuantizedBvhRangeInfo& info,bool parallel)
+{
+	int numIndices = endIndex-startIndex;
+	btVector3 centroidExtent = info.m_centroidMax-info.m_centroidMin;
+	btVector3 binScale;
+	for (int axis=0;axis<3;axis++)
+	{
+		binScale[axis] = centroidExtent[axis] > SIMD_EPSILON ? btScalar(numBins)/centroidExtent[axis] : btScalar(0.);
+	}
 
-#ifdef DEBUG_TREE_BUILDING
-	gStackDepth--;
-#endif //DEBUG_TREE_BUILDING
+	btQuantizedBvhRangeInfo bins;
+	calcRangeBins(startIndex,endIndex,numBins,info.m_centroidMin,binScale,bins,parallel);
 
-	int escapeIndex = m_curNodeIndex - curIndex;
+	//like the unbalanced check in sortAndCalcSplittingIndex, this keeps the depth of the tree (and of the recursion) logarithmic
+	const int minCount = btMax(1,numIndices/16);
 
-	if (m_useQuantization)
+	int bestAxis = -1;
+	int bestBin = -1;
+	btScalar bestCost = btScalar(BT_LARGE_FLOAT);
+	for (int axis=0;axis<3;axis++)
 	{
-		//escapeIndex is the number of nodes of this subtree
-		const int sizeQuantizedNode =sizeof(btQuantizedBvhNode);
-		const int treeSizeInBytes = escapeIndex * sizeQuantizedNode;
-		if (treeSizeInBytes > MAX_SUBTREE_SIZE_IN_BYTES)
+		if (binScale[axis] == btScalar(0.))
 		{
-			updateSubtreeHeaders(leftChildNodexIndex,rightChildNodexIndex);
+			continue;
+		}
+		const btQuantizedBvhSahBin* axisBins = bins.m_bins[axis];
+
+		//rightArea[i] and rightCount[i] cover the bins i..numBins-1
+		btScalar rightArea[BT_QUANTIZED_BVH_MAX_SAH_BINS];
+		int rightCount[BT_QUANTIZED_BVH_MAX_SAH_BINS];
+		btVector3 aabbMin = axisBins[numBins-1].m_aabbMin;
+		btVector3 aabbMax = axisBins[numBins-1].m_aabbMax;
+		int count = 0;
+		for (int i=numBins-1;i>0;i--)
+		{
+			aabbMin.setMin(axisBins[i].m_aabbMin);
+			aabbMax.setMax(axisBins[i].m_aabbMax);
+			count += axisBins[i].m_count;
+			rightArea[i] = count ? btHalfSurfaceArea(aabbMin,aabbMax) : btScalar(0.);
+			rightCount[i] = count;
 		}
-	} else
-	{
 
+		aabbMin = axisBins[0].m_aabbMin;
+		aabbMax = axisBins[0].m_aabbMax;
+		count = 0;
+		for (int i=0;i<numBins-1;i++)
+		{
+			aabbMin.setMin(axisBins[i].m_aabbMin);
+			aabbMax.setMax(axisBins[i].m_aabbMax);
+			count += axisBins[i].m_count;
+			if (count < minCount || rightCount[i+1] < minCount)
+			{
+				continue;
+			}
+			btScalar cost = btHalfSurfaceArea(aabbMin,aabbMax)*btScalar(count)+rightArea[i+1]*btScalar(rightCount[i+1]);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = i;
+			}
+		}
 	}
 
-	setInternalNodeEscapeIndex(internalNodeIndex,escapeIndex);
+	if (bestAxis < 0)
+	{
+		return -1;
+	}
 
+	//sort leafNodes so the ones in the bins up to bestBin come first
+	int splitIndex = startIndex;
+	for (int i=startIndex;i<endIndex;i++)
+	{
+		btVector3 center = btScalar(0.5)*(getAabbMax(i)+getAabbMin(i));
+		if (btQuantizedBvhBinIndex(center[bestAxis],info.m_centroidMin[bestAxis],binScale[bestAxis],numBins) <= bestBin)
+		{
+			swapLeafNodes(i,splitIndex);
+			splitIndex++;
+		}
+	}
+	btAssert(splitIndex > startIndex && splitIndex < endIndex);
+	return splitIndex;
+}
+
+void	btQuantizedBvh::buildSubtreeHeaders(int nodeIndex)
+{
+	const btQuantizedBvhNode& node = m_quantizedContiguousNodes[nodeIndex];
+	if (node.isLeafNode())
+	{
+		return;
+	}
+	//the subtrees below a node that fits are even smaller, they don't get headers either
+	int escapeIndex = node.getEscapeIndex();
+	if (escapeIndex*static_cast<int>(sizeof(btQuantizedBvhNode)) <= MAX_SUBTREE_SIZE_IN_BYTES)
+	{
+		return;
+	}
+	int leftChildNodexIndex = nodeIndex+1;
+	const btQuantizedBvhNode& leftChildNode = m_quantizedContiguousNodes[leftChildNodexIndex];
+	int rightChildNodexIndex = leftChildNodexIndex + (leftChildNode.isLeafNode() ? 1 : leftChildNode.getEscapeIndex());
+	buildSubtreeHeaders(leftChildNodexIndex);
+	buildSubtreeHeaders(rightChildNodexIndex);
+	updateSubtreeHeaders(leftChildNodexIndex,rightChildNodexIndex);
 }
 
 void	btQuantizedBvh::updateSubtreeHeaders(int leftChildNodexIndex,int rightChildNodexIndex)
@@ -805,6 +1166,57 @@ void	btQuantizedBvh::reportBoxCastOverlappingNodex(btNodeOverlapCallback* nodeCa
 }
 
 
+void	btQuantizedBvh::reportRayPacketOverlappingNodes(btRayPacketNodeOverlapCallback* nodeCallback, const btRayPacket& packet) const
+{
+	//stackless, like the single ray walks. Without a stack the rays that missed a parent node are not known, so every node is tested with all active rays
+	int curIndex = 0;
+	if (m_useQuantization)
+	{
+		while (curIndex < m_curNodeIndex)
+		{
+			const btQuantizedBvhNode* node = &m_quantizedContiguousNodes[curIndex];
+			btVector3 nodeAabbMin = unQuantize(node->m_quantizedAabbMin);
+			btVector3 nodeAabbMax = unQuantize(node->m_quantizedAabbMax);
+			unsigned int rayMask = packet.testAabb(nodeAabbMin,nodeAabbMax,packet.m_activeMask);
+			bool isLeafNode = node->isLeafNode();
+			if (isLeafNode && rayMask)
+			{
+				nodeCallback->processNode(node->getPartId(),node->getTriangleIndex(),rayMask);
+			}
+			if (rayMask || isLeafNode)
+			{
+				curIndex++;
+			}
+			else
+			{
+				curIndex += node->getEscapeIndex();
+			}
+		}
+	}
+	else
+	{
+		while (curIndex < m_curNodeIndex)
+		{
+			const btOptimizedBvhNode* node = &m_contiguousNodes[curIndex];
+			unsigned int rayMask = packet.testAabb(node->m_aabbMinOrg,node->m_aabbMaxOrg,packet.m_activeMask);
+			bool isLeafNode = node->m_escapeIndex == -1;
+			if (isLeafNode && rayMask)
+			{
+				nodeCallback->processNode(node->m_subPart,node->m_triangleIndex,rayMask);
+			}
+			if (rayMask || isLeafNode)
+			{
+				curIndex++;
+			}
+			else
+			{
+				curIndex += node->m_escapeIndex;
+			}
+		}
+	}
+}
+
+
 void	btQuantizedBvh::swapLeafNodes(int i,int splitIndex)
 {
 	if (m_useQuantization)
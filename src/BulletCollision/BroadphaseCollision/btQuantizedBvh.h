@@ -30,6 +30,7 @@ class btSerializer;
 
 #include "LinearMath/btVector3.h"
 #include "LinearMath/btAlignedAllocator.h"
+#include "btRayPacket.h"
 
 #ifdef BT_USE_DOUBLE_PRECISION
 #define btQuantizedBvhData btQuantizedBvhDoubleData
@@ -49,6 +50,14 @@ class btSerializer;
 //Note: currently we have 16 bytes per quantized node
 #define MAX_SUBTREE_SIZE_IN_BYTES  2048
 
+///gQuantizedBvhSahBinCount selects how btQuantizedBvh::buildTree (and so btOptimizedBvh::build) splits the leaf nodes.
+///0 splits at the mean along the axis of largest variance. A positive value (up to BT_QUANTIZED_BVH_MAX_SAH_BINS) uses
+///the surface area heuristic, evaluated at that many bins per axis: more bins give a tree that is faster to query, but take longer to build.
+///Either way, the top of the tree is split on the calling thread and the subtrees below it are built in parallel with btParallelFor.
+extern int gQuantizedBvhSahBinCount;
+
+#define BT_QUANTIZED_BVH_MAX_SAH_BINS 32
+
 // 10 gives the potential for 1024 parts, with at most 2^21 (2097152) (minus one
 // actually) triangles each (since the sign bit is reserved
 #define MAX_NUM_PARTS_IN_BITS 10
@@ -157,6 +166,15 @@ public:
 	virtual void processNode(int subPart, int triangleIndex) = 0;
 };
 
+///btRayPacketNodeOverlapCallback receives the leaf nodes hit by a btRayPacket, rayMask has a bit set for each ray that hits the node
+class btRayPacketNodeOverlapCallback
+{
+public:
+	virtual ~btRayPacketNodeOverlapCallback() {};
+
+	virtual void processNode(int subPart, int triangleIndex, unsigned int rayMask) = 0;
+};
+
 #include "LinearMath/btAlignedAllocator.h"
 #include "LinearMath/btAlignedObjectArray.h"
 
@@ -167,6 +185,8 @@ typedef btAlignedObjectArray<btOptimizedBvhNode>	NodeArray;
 typedef btAlignedObjectArray<btQuantizedBvhNode>	QuantizedNodeArray;
 typedef btAlignedObjectArray<btBvhSubtreeInfo>		BvhSubtreeInfoArray;
 
+struct btQuantizedBvhRangeInfo;
+
 
 ///The btQuantizedBvh class stores an AABB tree that can be quickly traversed on CPU and Cell SPU.
 ///It is used by the btBvhTriangleMeshShape as midphase, and by the btMultiSapBroadphase.
@@ -305,6 +325,24 @@ protected:
 
 	void	buildTree	(int startIndex,int endIndex);
 
+	///builds the subtree of the leaf nodes [startIndex,endIndex) at nodeIndex. It leaves m_curNodeIndex and the subtree headers alone,
+	///so subtrees of disjoint ranges can be built in parallel
+	void	buildSubtree(int startIndex,int endIndex,int nodeIndex);
+
+	///sets the aabb of internal node nodeIndex to that of the leaf nodes [startIndex,endIndex), then sorts them and returns the splitting index.
+	///parallel runs the passes over the leaf nodes with btParallelFor
+	int	splitInternalNode(int startIndex,int endIndex,int nodeIndex,bool parallel);
+
+	void	calcRangeInfo(int startIndex,int endIndex,btQuantizedBvhRangeInfo& info,bool parallel) const;
+
+	void	calcRangeBins(int startIndex,int endIndex,int numBins,const btVector3& centroidMin,const btVector3& binScale,btQuantizedBvhRangeInfo& info,bool parallel) const;
+
+	///returns -1 if the surface area heuristic finds no split that keeps the tree balanced enough
+	int	sortAndCalcSahSplittingIndex(int startIndex,int endIndex,int numBins,const btQuantizedBvhRangeInfo& info,bool parallel);
+
+	///adds the subtree headers below nodeIndex, in the same order as buildTree used to add them during the recursion
+	void	buildSubtreeHeaders(int nodeIndex);
+
 	int	calcSplittingAxis(int startIndex,int endIndex);
 
 	int	sortAndCalcSplittingIndex(int startIndex,int endIndex,int splitAxis);
@@ -329,6 +367,9 @@ protected:
 
 	void	updateSubtreeHeaders(int leftChildNodexIndex,int rightChildNodexIndex);
 
+	friend struct btQuantizedBvhBuildLoop;
+	friend struct btQuantizedBvhRangeInfoLoop;
+
 public:
 	
 	BT_DECLARE_ALIGNED_ALLOCATOR();
@@ -348,6 +389,9 @@ public:
 	void	reportAabbOverlappingNodex(btNodeOverlapCallback* nodeCallback,const btVector3& aabbMin,const btVector3& aabbMax) const;
 	void	reportRayOverlappingNodex (btNodeOverlapCallback* nodeCallback, const btVector3& raySource, const btVector3& rayTarget) const;
 	void	reportBoxCastOverlappingNodex(btNodeOverlapCallback* nodeCallback, const btVector3& raySource, const btVector3& rayTarget, const btVector3& aabbMin,const btVector3& aabbMax) const;
+	///reportRayPacketOverlappingNodes walks the tree once for all rays of the packet, the rays are in the local space of the tree.
+	///The node callback may shorten rays of the packet (btRayPacket::clipRay), the rest of the walk then skips nodes beyond their new ends.
+	void	reportRayPacketOverlappingNodes(btRayPacketNodeOverlapCallback* nodeCallback, const btRayPacket& packet) const;
 
 		SIMD_FORCE_INLINE void quantize(unsigned short* out, const btVector3& point,int isMax) const
 	{
@@ -458,6 +502,65 @@ public:
 		return m_SubtreeHeaders;
 	}
 
+	///the stackless tree read as a binary tree, to build other layouts from it: node 0 is the root, the left child of an internal node
+	///directly follows it and the right child follows the subtree of the left child
+	int	getNumNodes() const
+	{
+		return m_curNodeIndex;
+	}
+
+	bool	isLeafNode(int nodeIndex) const
+	{
+		if (m_useQuantization)
+		{
+			return m_quantizedContiguousNodes[nodeIndex].isLeafNode();
+		}
+		return m_contiguousNodes[nodeIndex].m_escapeIndex == -1;
+	}
+
+	///number of nodes in the subtree of nodeIndex, including nodeIndex itself
+	int	getSubtreeSize(int nodeIndex) const
+	{
+		if (isLeafNode(nodeIndex))
+		{
+			return 1;
+		}
+		if (m_useQuantization)
+		{
+			return m_quantizedContiguousNodes[nodeIndex].getEscapeIndex();
+		}
+		return m_contiguousNodes[nodeIndex].m_escapeIndex;
+	}
+
+	void	getNodeAabb(int nodeIndex, btVector3& aabbMin, btVector3& aabbMax) const
+	{
+		if (m_useQuantization)
+		{
+			aabbMin = unQuantize(&m_quantizedContiguousNodes[nodeIndex].m_quantizedAabbMin[0]);
+			aabbMax = unQuantize(&m_quantizedContiguousNodes[nodeIndex].m_quantizedAabbMax[0]);
+		}
+		else
+		{
+			aabbMin = m_contiguousNodes[nodeIndex].m_aabbMinOrg;
+			aabbMax = m_contiguousNodes[nodeIndex].m_aabbMaxOrg;
+		}
+	}
+
+	void	getLeafNodeTriangle(int nodeIndex, int& partId, int& triangleIndex) const
+	{
+		btAssert(isLeafNode(nodeIndex));
+		if (m_useQuantization)
+		{
+			partId = m_quantizedContiguousNodes[nodeIndex].getPartId();
+			triangleIndex = m_quantizedContiguousNodes[nodeIndex].getTriangleIndex();
+		}
+		else
+		{
+			partId = m_contiguousNodes[nodeIndex].m_subPart;
+			triangleIndex = m_contiguousNodes[nodeIndex].m_triangleIndex;
+		}
+	}
+
 ////////////////////////////////////////////////////////////////////
 
 	/////Calculate space needed to store BVH for serialization
@@ -0,0 +1,127 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_RAY_PACKET_H
+#define BT_RAY_PACKET_H
+
+#include "LinearMath/btVector3.h"
+#include "LinearMath/btMinMax.h"
+
+///the packet aabb test only needs SSE on the SoA data, so it is also used where btVector3 itself doesn't use SSE
+#if !defined (BT_USE_DOUBLE_PRECISION) && (defined (USE_SIMD) || defined (__SSE2__) || defined (_M_X64) || defined (_M_AMD64))
+#define BT_USE_SSE_RAY_PACKET 1
+#include <xmmintrin.h>
+#endif
+
+
+///btRayPacket holds up to MAX_RAYS rays in structure-of-arrays layout, so a tree node can be tested against all of them at once.
+///Distances along a ray are measured along its normalized direction, like btBroadphaseRayCallback::m_lambda_max.
+///m_lambdaMax can be shortened while the packet is traversed (see clipRay), so nodes beyond the closest hit found so far are skipped.
+ATTRIBUTE_ALIGNED16(struct) btRayPacket
+{
+	enum { MAX_RAYS = 4 };
+
+	btScalar	m_rayFrom[3][MAX_RAYS];
+	btScalar	m_rayDirectionInverse[3][MAX_RAYS];
+	btScalar	m_lambdaMax[MAX_RAYS];
+	btScalar	m_rayLength[MAX_RAYS];
+	btVector3	m_rayFromWorld[MAX_RAYS];
+	btVector3	m_rayToWorld[MAX_RAYS];
+	int	m_numRays;
+	///bit i is set for each ray i that takes part in the traversal, degenerate (zero length) rays are left out
+	unsigned int	m_activeMask;
+
+	void	init(const btVector3* rayFrom, const btVector3* rayTo, int numRays)
+	{
+		btAssert(numRays>0 && numRays<=MAX_RAYS);
+		m_numRays = numRays;
+		m_activeMask = 0;
+		for (int i=0;i<MAX_RAYS;i++)
+		{
+			btVector3 from = i<numRays ? rayFrom[i] : btVector3(0,0,0);
+			btVector3 to = i<numRays ? rayTo[i] : from;
+			m_rayFromWorld[i] = from;
+			m_rayToWorld[i] = to;
+			btVector3 rayDir = to-from;
+			btScalar length = rayDir.length();
+			if (length > SIMD_EPSILON)
+			{
+				rayDir /= length;
+				m_activeMask |= 1u<<i;
+			}
+			else
+			{
+				//never hits anything: the exit distance of -1 is always before the entry distance of 0
+				rayDir.setValue(0,0,0);
+				length = btScalar(-1.);
+			}
+			for (int axis=0;axis<3;axis++)
+			{
+				m_rayFrom[axis][i] = from[axis];
+				///what about division by zero? --> just set rayDirection[i] to INF/BT_LARGE_FLOAT
+				m_rayDirectionInverse[axis][i] = rayDir[axis] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[axis];
+			}
+			m_lambdaMax[i] = length;
+			m_rayLength[i] = length;
+		}
+	}
+
+	///don't look for hits of a ray beyond hitFraction (relative to the full ray) any more.
+	///A little slack is kept, so a node whose entry distance rounds to just beyond the hit can still report an equally close hit
+	SIMD_FORCE_INLINE void	clipRay(int ray, btScalar hitFraction)
+	{
+		m_lambdaMax[ray] = btMin(m_lambdaMax[ray],(hitFraction+btScalar(1e-5))*m_rayLength[ray]);
+	}
+
+	///returns the rays of rayMask that enter the box before their m_lambdaMax, one bit per ray
+	SIMD_FORCE_INLINE unsigned int	testAabb(const btVector3& aabbMin, const btVector3& aabbMax, unsigned int rayMask) const
+	{
+#ifdef BT_USE_SSE_RAY_PACKET
+		__m128 tmin = _mm_setzero_ps();
+		__m128 tmax = _mm_loadu_ps(m_lambdaMax);
+		for (int axis=0;axis<3;axis++)
+		{
+			__m128 from = _mm_loadu_ps(m_rayFrom[axis]);
+			__m128 inv = _mm_loadu_ps(m_rayDirectionInverse[axis]);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabbMin[axis]),from),inv);
+			__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabbMax[axis]),from),inv);
+			tmin = _mm_max_ps(tmin,_mm_min_ps(t1,t2));
+			tmax = _mm_min_ps(tmax,_mm_max_ps(t1,t2));
+		}
+		return unsigned(_mm_movemask_ps(_mm_cmple_ps(tmin,tmax))) & rayMask;
+#else
+		unsigned int hitMask = 0;
+		for (int i=0;i<MAX_RAYS;i++)
+		{
+			btScalar tmin = btScalar(0.);
+			btScalar tmax = m_lambdaMax[i];
+			for (int axis=0;axis<3;axis++)
+			{
+				btScalar t1 = (aabbMin[axis]-m_rayFrom[axis][i])*m_rayDirectionInverse[axis][i];
+				btScalar t2 = (aabbMax[axis]-m_rayFrom[axis][i])*m_rayDirectionInverse[axis][i];
+				tmin = btMax(tmin,btMin(t1,t2));
+				tmax = btMin(tmax,btMax(t1,t2));
+			}
+			if (tmin <= tmax)
+			{
+				hitMask |= 1u<<i;
+			}
+		}
+		return hitMask & rayMask;
+#endif
+	}
+};
+
+#endif //BT_RAY_PACKET_H
@@ -0,0 +1,700 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btWideBvh.h"
+#include "LinearMath/btAabbUtil2.h"
+#include <new>
+
+///the node tests only need SSE2 on the SoA data, so they are also used where btVector3 itself doesn't use SSE
+#if !defined (BT_USE_DOUBLE_PRECISION) && (defined (USE_SIMD) || defined (__SSE2__) || defined (_M_X64) || defined (_M_AMD64))
+#define BT_USE_SSE_WIDE_BVH 1
+#include <emmintrin.h>
+#endif
+
+
+///traversal stack, on the program stack unless the tree is unusually deep
+struct btWideBvhStack
+{
+	enum { FIXED_SIZE = 128 };
+
+	int	m_fixed[FIXED_SIZE];
+	btAlignedObjectArray<int>	m_overflow;
+	int*	m_data;
+	int	m_size;
+
+	btWideBvhStack(int capacity)
+		:m_size(0)
+	{
+		if (capacity <= FIXED_SIZE)
+		{
+			m_data = m_fixed;
+		}
+		else
+		{
+			m_overflow.resize(capacity);
+			m_data = &m_overflow[0];
+		}
+	}
+
+	void	push(int nodeIndex)
+	{
+		m_data[m_size++] = nodeIndex;
+	}
+
+	int	pop()
+	{
+		return m_data[--m_size];
+	}
+};
+
+
+///dequantized child boxes of a node, cast boxes are added by passing their extents (zero for rays and plain boxes)
+static SIMD_FORCE_INLINE void	btDequantizeWideNode(const btWideBvhNode& node, const btVector3& bvhAabbMin, const btVector3& invQuantization,
+	const btVector3& extentMin, const btVector3& extentMax, btScalar (*mins)[btWideBvhNode::WIDTH], btScalar (*maxs)[btWideBvhNode::WIDTH])
+{
+#ifdef BT_USE_SSE_WIDE_BVH
+	__m128i zero = _mm_setzero_si128();
+	for (int axis=0;axis<3;axis++)
+	{
+		__m128i qmin = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)node.m_quantizedAabbMin[axis]),zero);
+		__m128i qmax = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)node.m_quantizedAabbMax[axis]),zero);
+		__m128 scale = _mm_set1_ps(invQuantization[axis]);
+		__m128 offset = _mm_set1_ps(bvhAabbMin[axis]);
+		_mm_storeu_ps(mins[axis],_mm_sub_ps(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(qmin),scale),offset),_mm_set1_ps(extentMax[axis])));
+		_mm_storeu_ps(maxs[axis],_mm_sub_ps(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(qmax),scale),offset),_mm_set1_ps(extentMin[axis])));
+	}
+#else
+	for (int axis=0;axis<3;axis++)
+	{
+		for (int i=0;i<btWideBvhNode::WIDTH;i++)
+		{
+			mins[axis][i] = btScalar(node.m_quantizedAabbMin[axis][i])*invQuantization[axis]+bvhAabbMin[axis]-extentMax[axis];
+			maxs[axis][i] = btScalar(node.m_quantizedAabbMax[axis][i])*invQuantization[axis]+bvhAabbMin[axis]-extentMin[axis];
+		}
+	}
+#endif
+}
+
+
+struct btWideBvhAabbTester
+{
+	btNodeOverlapCallback*	m_nodeCallback;
+	unsigned short int	m_quantizedQueryAabbMin[3];
+	unsigned short int	m_quantizedQueryAabbMax[3];
+
+	SIMD_FORCE_INLINE unsigned int	testNode(const btWideBvhNode& node) const
+	{
+#ifdef BT_USE_SSE_WIDE_BVH
+		__m128i zero = _mm_setzero_si128();
+		__m128i overlap = _mm_set1_epi32(-1);
+		for (int axis=0;axis<3;axis++)
+		{
+			__m128i nodeMin = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)node.m_quantizedAabbMin[axis]),zero);
+			__m128i nodeMax = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)node.m_quantizedAabbMax[axis]),zero);
+			overlap = _mm_andnot_si128(_mm_cmpgt_epi32(nodeMin,_mm_set1_epi32(m_quantizedQueryAabbMax[axis])),overlap);
+			overlap = _mm_andnot_si128(_mm_cmplt_epi32(nodeMax,_mm_set1_epi32(m_quantizedQueryAabbMin[axis])),overlap);
+		}
+		return unsigned(_mm_movemask_ps(_mm_castsi128_ps(overlap)));
+#else
+		unsigned int mask = 0;
+		for (int i=0;i<btWideBvhNode::WIDTH;i++)
+		{
+			bool overlap = true;
+			for (int axis=0;axis<3;axis++)
+			{
+				overlap = overlap && node.m_quantizedAabbMin[axis][i] <= m_quantizedQueryAabbMax[axis]
+					&& node.m_quantizedAabbMax[axis][i] >= m_quantizedQueryAabbMin[axis];
+			}
+			if (overlap)
+			{
+				mask |= 1u<<i;
+			}
+		}
+		return mask;
+#endif
+	}
+
+	SIMD_FORCE_INLINE void	processLeaf(const btWideBvhLeaf& leaf, int /*child*/)
+	{
+		m_nodeCallback->processNode(leaf.m_partId,leaf.m_triangleIndex);
+	}
+};
+
+struct btWideBvhRayTester
+{
+	btNodeOverlapCallback*	m_nodeCallback;
+	btVector3	m_bvhAabbMin;
+	btVector3	m_invQuantization;
+	btVector3	m_castAabbMin;
+	btVector3	m_castAabbMax;
+	btVector3	m_rayFrom;
+	btVector3	m_rayDirectionInverse;
+	btScalar	m_lambdaMax;
+
+	SIMD_FORCE_INLINE unsigned int	testNode(const btWideBvhNode& node) const
+	{
+		btScalar mins[3][btWideBvhNode::WIDTH];
+		btScalar maxs[3][btWideBvhNode::WIDTH];
+		btDequantizeWideNode(node,m_bvhAabbMin,m_invQuantization,m_castAabbMin,m_castAabbMax,mins,maxs);
+#ifdef BT_USE_SSE_WIDE_BVH
+		__m128 tmin = _mm_setzero_ps();
+		__m128 tmax = _mm_set1_ps(m_lambdaMax);
+		for (int axis=0;axis<3;axis++)
+		{
+			__m128 from = _mm_set1_ps(m_rayFrom[axis]);
+			__m128 inv = _mm_set1_ps(m_rayDirectionInverse[axis]);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(mins[axis]),from),inv);
+			__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxs[axis]),from),inv);
+			tmin = _mm_max_ps(tmin,_mm_min_ps(t1,t2));
+			tmax = _mm_min_ps(tmax,_mm_max_ps(t1,t2));
+		}
+		return unsigned(_mm_movemask_ps(_mm_cmple_ps(tmin,tmax)));
+#else
+		unsigned int mask = 0;
+		for (int i=0;i<btWideBvhNode::WIDTH;i++)
+		{
+			btScalar tmin = btScalar(0.);
+			btScalar tmax = m_lambdaMax;
+			for (int axis=0;axis<3;axis++)
+			{
+				btScalar t1 = (mins[axis][i]-m_rayFrom[axis])*m_rayDirectionInverse[axis];
+				btScalar t2 = (maxs[axis][i]-m_rayFrom[axis])*m_rayDirectionInverse[axis];
+				tmin = btMax(tmin,btMin(t1,t2));
+				tmax = btMin(tmax,btMax(t1,t2));
+			}
+			if (tmin <= tmax)
+			{
+				mask |= 1u<<i;
+			}
+		}
+		return mask;
+#endif
+	}
+
+	SIMD_FORCE_INLINE void	processLeaf(const btWideBvhLeaf& leaf, int /*child*/)
+	{
+		m_nodeCallback->processNode(leaf.m_partId,leaf.m_triangleIndex);
+	}
+};
+
+struct btWideBvhRayPacketTester
+{
+	btRayPacketNodeOverlapCallback*	m_nodeCallback;
+	const btRayPacket*	m_packet;
+	btVector3	m_bvhAabbMin;
+	btVector3	m_invQuantization;
+	unsigned int	m_rayMasks[btWideBvhNode::WIDTH];
+
+	SIMD_FORCE_INLINE unsigned int	testNode(const btWideBvhNode& node)
+	{
+		btScalar mins[3][btWideBvhNode::WIDTH];
+		btScalar maxs[3][btWideBvhNode::WIDTH];
+		btVector3 zero(0,0,0);
+		btDequantizeWideNode(node,m_bvhAabbMin,m_invQuantization,zero,zero,mins,maxs);
+		unsigned int childMask = 0;
+		for (int i=0;i<btWideBvhNode::WIDTH;i++)
+		{
+			m_rayMasks[i] = m_packet->testAabb(btVector3(mins[0][i],mins[1][i],mins[2][i]),btVector3(maxs[0][i],maxs[1][i],maxs[2][i]),m_packet->m_activeMask);
+			if (m_rayMasks[i])
+			{
+				childMask |= 1u<<i;
+			}
+		}
+		return childMask;
+	}
+
+	SIMD_FORCE_INLINE void	processLeaf(const btWideBvhLeaf& leaf, int child)
+	{
+		m_nodeCallback->processNode(leaf.m_partId,leaf.m_triangleIndex,m_rayMasks[child]);
+	}
+};
+
+
+btWideBvh::btWideBvh()
+	:m_bvhAabbMin(0,0,0),
+	m_bvhAabbMax(0,0,0),
+	m_bvhQuantization(1,1,1),
+	m_numNodes(0),
+	m_numLeaves(0),
+	m_maxDepth(0)
+{
+}
+
+btWideBvh::~btWideBvh()
+{
+}
+
+void	btWideBvh::quantize(unsigned short* out, const btVector3& point, int isMax) const
+{
+	btVector3 v = (point - m_bvhAabbMin) * m_bvhQuantization;
+	for (int axis=0;axis<3;axis++)
+	{
+		//round outwards by a full step, so the dequantized box always contains the original
+		btScalar q = isMax ? btScalar(ceil(v[axis]))+btScalar(1.) : btScalar(floor(v[axis]))-btScalar(1.);
+		q = btMax(btScalar(0.),btMin(btScalar(65535.),q));
+		out[axis] = (unsigned short) q;
+	}
+}
+
+void	btWideBvh::build(const btQuantizedBvh& bvh)
+{
+	m_nodes.resize(0);
+	m_leaves.resize(0);
+	m_leafBinaryNodes.resize(0);
+	m_numNodes = 0;
+	m_numLeaves = 0;
+	m_maxDepth = 0;
+
+	int numBinaryNodes = bvh.getNumNodes();
+	if (!numBinaryNodes)
+	{
+		return;
+	}
+
+	btVector3 rootAabbMin,rootAabbMax;
+	bvh.getNodeAabb(0,rootAabbMin,rootAabbMax);
+	btVector3 margin = (rootAabbMax-rootAabbMin)*btScalar(0.001)+btVector3(btScalar(0.001),btScalar(0.001),btScalar(0.001));
+	m_bvhAabbMin = rootAabbMin-margin;
+	m_bvhAabbMax = rootAabbMax+margin;
+	btVector3 extent = m_bvhAabbMax-m_bvhAabbMin;
+	m_bvhQuantization = btVector3(btScalar(65535.),btScalar(65535.),btScalar(65535.))/extent;
+
+	// a wide node replaces at least one internal binary node, so this is enough to never reallocate during the build
+	m_nodes.reserve(numBinaryNodes/2+1);
+	m_leaves.reserve(numBinaryNodes/2+1);
+	m_leafBinaryNodes.reserve(numBinaryNodes/2+1);
+	buildNode(bvh,0,1);
+	m_numNodes = m_nodes.size();
+	m_numLeaves = m_leaves.size();
+}
+
+int	btWideBvh::buildNode(const btQuantizedBvh& bvh, int binaryNodeIndex, int depth)
+{
+	int slots[btWideBvhNode::WIDTH];
+	int numSlots = 0;
+	if (bvh.isLeafNode(binaryNodeIndex))
+	{
+		//only for a tree with a single triangle
+		slots[numSlots++] = binaryNodeIndex;
+	}
+	else
+	{
+		int leftChild = binaryNodeIndex+1;
+		slots[numSlots++] = leftChild;
+		slots[numSlots++] = leftChild+bvh.getSubtreeSize(leftChild);
+	}
+
+	// keep opening the internal child with the largest surface until the node is full
+	while (numSlots < btWideBvhNode::WIDTH)
+	{
+		int best = -1;
+		btScalar bestArea = btScalar(-1.);
+		for (int i=0;i<numSlots;i++)
+		{
+			if (!bvh.isLeafNode(slots[i]))
+			{
+				btVector3 aabbMin,aabbMax;
+				bvh.getNodeAabb(slots[i],aabbMin,aabbMax);
+				btVector3 e = aabbMax-aabbMin;
+				btScalar area = e[0]*e[1]+e[1]*e[2]+e[2]*e[0];
+				if (area > bestArea)
+				{
+					bestArea = area;
+					best = i;
+				}
+			}
+		}
+		if (best < 0)
+		{
+			break;
+		}
+		int leftChild = slots[best]+1;
+		slots[best] = leftChild;
+		slots[numSlots++] = leftChild+bvh.getSubtreeSize(leftChild);
+	}
+
+	int nodeIndex = m_nodes.size();
+	m_nodes.expand();
+	m_maxDepth = btMax(m_maxDepth,depth);
+	for (int i=0;i<btWideBvhNode::WIDTH;i++)
+	{
+		btWideBvhNode& node = m_nodes[nodeIndex];
+		if (i >= numSlots)
+		{
+			for (int axis=0;axis<3;axis++)
+			{
+				node.m_quantizedAabbMin[axis][i] = 0xffff;
+				node.m_quantizedAabbMax[axis][i] = 0;
+			}
+			node.m_children[i] = BT_WIDE_BVH_EMPTY;
+			continue;
+		}
+
+		btVector3 aabbMin,aabbMax;
+		bvh.getNodeAabb(slots[i],aabbMin,aabbMax);
+		unsigned short quantizedAabbMin[3];
+		unsigned short quantizedAabbMax[3];
+		quantize(quantizedAabbMin,aabbMin,0);
+		quantize(quantizedAabbMax,aabbMax,1);
+		for (int axis=0;axis<3;axis++)
+		{
+			node.m_quantizedAabbMin[axis][i] = quantizedAabbMin[axis];
+			node.m_quantizedAabbMax[axis][i] = quantizedAabbMax[axis];
+		}
+
+		if (bvh.isLeafNode(slots[i]))
+		{
+			btWideBvhLeaf& leaf = m_leaves.expand();
+			bvh.getLeafNodeTriangle(slots[i],leaf.m_partId,leaf.m_triangleIndex);
+			m_leafBinaryNodes.push_back(slots[i]);
+			node.m_children[i] = m_leaves.size()-1;
+		}
+		else
+		{
+			int childIndex = buildNode(bvh,slots[i],depth+1);
+			m_nodes[nodeIndex].m_children[i] = ~childIndex;
+		}
+	}
+	return nodeIndex;
+}
+
+bool	btWideBvh::refitPartial(const btQuantizedBvh& bvh, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	if (m_leafBinaryNodes.size() != m_numLeaves)
+	{
+		return false;
+	}
+	if (!m_numNodes)
+	{
+		return true;
+	}
+	unsigned short quantizedQueryAabbMin[3];
+	unsigned short quantizedQueryAabbMax[3];
+	quantize(quantizedQueryAabbMin,aabbMin,0);
+	quantize(quantizedQueryAabbMax,aabbMax,1);
+	return refitNode(bvh,0,quantizedQueryAabbMin,quantizedQueryAabbMax,aabbMin,aabbMax);
+}
+
+bool	btWideBvh::refitNode(const btQuantizedBvh& bvh, int nodeIndex, const unsigned short* quantizedQueryAabbMin, const unsigned short* quantizedQueryAabbMax, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	for (int i=0;i<btWideBvhNode::WIDTH;i++)
+	{
+		int child = m_nodes[nodeIndex].m_children[i];
+		if (child == BT_WIDE_BVH_EMPTY)
+		{
+			continue;
+		}
+		// like btOptimizedBvh::refitPartial, only what overlapped the box before can have changed
+		bool overlap = true;
+		for (int axis=0;axis<3;axis++)
+		{
+			overlap = overlap && m_nodes[nodeIndex].m_quantizedAabbMin[axis][i] <= quantizedQueryAabbMax[axis]
+				&& m_nodes[nodeIndex].m_quantizedAabbMax[axis][i] >= quantizedQueryAabbMin[axis];
+		}
+		unsigned short quantizedAabbMin[3];
+		unsigned short quantizedAabbMax[3];
+		if (child >= 0)
+		{
+			btVector3 leafAabbMin,leafAabbMax;
+			bvh.getNodeAabb(m_leafBinaryNodes[child],leafAabbMin,leafAabbMax);
+			// a leaf can also have moved into the box
+			if (!overlap && !TestAabbAgainstAabb2(leafAabbMin,leafAabbMax,aabbMin,aabbMax))
+			{
+				continue;
+			}
+			for (int axis=0;axis<3;axis++)
+			{
+				if (leafAabbMin[axis] < m_bvhAabbMin[axis] || leafAabbMax[axis] > m_bvhAabbMax[axis])
+				{
+					return false;
+				}
+			}
+			quantize(quantizedAabbMin,leafAabbMin,0);
+			quantize(quantizedAabbMax,leafAabbMax,1);
+		}
+		else
+		{
+			if (!overlap)
+			{
+				continue;
+			}
+			if (!refitNode(bvh,~child,quantizedQueryAabbMin,quantizedQueryAabbMax,aabbMin,aabbMax))
+			{
+				return false;
+			}
+			// the union of the child boxes, the same as quantizing the box of the binary node
+			const btWideBvhNode& childNode = m_nodes[~child];
+			for (int axis=0;axis<3;axis++)
+			{
+				quantizedAabbMin[axis] = 0xffff;
+				quantizedAabbMax[axis] = 0;
+				for (int j=0;j<btWideBvhNode::WIDTH;j++)
+				{
+					if (childNode.m_children[j] != BT_WIDE_BVH_EMPTY)
+					{
+						quantizedAabbMin[axis] = btMin(quantizedAabbMin[axis],childNode.m_quantizedAabbMin[axis][j]);
+						quantizedAabbMax[axis] = btMax(quantizedAabbMax[axis],childNode.m_quantizedAabbMax[axis][j]);
+					}
+				}
+			}
+		}
+		for (int axis=0;axis<3;axis++)
+		{
+			m_nodes[nodeIndex].m_quantizedAabbMin[axis][i] = quantizedAabbMin[axis];
+			m_nodes[nodeIndex].m_quantizedAabbMax[axis][i] = quantizedAabbMax[axis];
+		}
+	}
+	return true;
+}
+
+template <typename POLICY>
+void	btWideBvh::walkTree(POLICY& policy) const
+{
+	if (!m_numNodes)
+	{
+		return;
+	}
+	// every node visit pops one entry and pushes at most WIDTH
+	btWideBvhStack stack((btWideBvhNode::WIDTH-1)*m_maxDepth+2);
+	stack.push(0);
+	while (stack.m_size)
+	{
+		const btWideBvhNode& node = m_nodes[stack.pop()];
+		unsigned int childMask = policy.testNode(node);
+		for (int i=0;i<btWideBvhNode::WIDTH;i++)
+		{
+			int child = node.m_children[i];
+			if (!(childMask & (1u<<i)) || child == BT_WIDE_BVH_EMPTY)
+			{
+				continue;
+			}
+			if (child >= 0)
+			{
+				policy.processLeaf(m_leaves[child],i);
+			}
+			else
+			{
+				stack.push(~child);
+			}
+		}
+	}
+}
+
+void	btWideBvh::reportAabbOverlappingNodex(btNodeOverlapCallback* nodeCallback,const btVector3& aabbMin,const btVector3& aabbMax) const
+{
+	btWideBvhAabbTester tester;
+	tester.m_nodeCallback = nodeCallback;
+	quantize(tester.m_quantizedQueryAabbMin,aabbMin,0);
+	quantize(tester.m_quantizedQueryAabbMax,aabbMax,1);
+	walkTree(tester);
+}
+
+void	btWideBvh::reportRayOverlappingNodex (btNodeOverlapCallback* nodeCallback, const btVector3& raySource, const btVector3& rayTarget) const
+{
+	reportBoxCastOverlappingNodex(nodeCallback,raySource,rayTarget,btVector3(0,0,0),btVector3(0,0,0));
+}
+
+void	btWideBvh::reportBoxCastOverlappingNodex(btNodeOverlapCallback* nodeCallback, const btVector3& raySource, const btVector3& rayTarget, const btVector3& aabbMin,const btVector3& aabbMax) const
+{
+	btVector3 rayDir = rayTarget-raySource;
+	btScalar rayLength = rayDir.length();
+	if (rayLength < SIMD_EPSILON)
+	{
+		reportAabbOverlappingNodex(nodeCallback,raySource+aabbMin,raySource+aabbMax);
+		return;
+	}
+	rayDir /= rayLength;
+
+	btWideBvhRayTester tester;
+	tester.m_nodeCallback = nodeCallback;
+	tester.m_bvhAabbMin = m_bvhAabbMin;
+	tester.m_invQuantization = btVector3(btScalar(1.),btScalar(1.),btScalar(1.))/m_bvhQuantization;
+	tester.m_castAabbMin = aabbMin;
+	tester.m_castAabbMax = aabbMax;
+	tester.m_rayFrom = raySource;
+	///what about division by zero? --> just set rayDirection[i] to INF/BT_LARGE_FLOAT
+	tester.m_rayDirectionInverse[0] = rayDir[0] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[0];
+	tester.m_rayDirectionInverse[1] = rayDir[1] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[1];
+	tester.m_rayDirectionInverse[2] = rayDir[2] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[2];
+	tester.m_lambdaMax = rayLength;
+	walkTree(tester);
+}
+
+void	btWideBvh::reportRayPacketOverlappingNodes(btRayPacketNodeOverlapCallback* nodeCallback, const btRayPacket& packet) const
+{
+	btWideBvhRayPacketTester tester;
+	tester.m_nodeCallback = nodeCallback;
+	tester.m_packet = &packet;
+	tester.m_bvhAabbMin = m_bvhAabbMin;
+	tester.m_invQuantization = btVector3(btScalar(1.),btScalar(1.),btScalar(1.))/m_bvhQuantization;
+	walkTree(tester);
+}
+
+
+unsigned btWideBvh::calculateSerializeBufferSize() const
+{
+	return sizeof(btWideBvh) + m_numNodes*sizeof(btWideBvhNode) + m_numLeaves*sizeof(btWideBvhLeaf);
+}
+
+static void	btSwapWideBvhNodeEndian(const btWideBvhNode& source, btWideBvhNode& dest)
+{
+	for (int axis=0;axis<3;axis++)
+	{
+		for (int i=0;i<btWideBvhNode::WIDTH;i++)
+		{
+			dest.m_quantizedAabbMin[axis][i] = btSwapEndian(source.m_quantizedAabbMin[axis][i]);
+			dest.m_quantizedAabbMax[axis][i] = btSwapEndian(source.m_quantizedAabbMax[axis][i]);
+		}
+	}
+	for (int i=0;i<btWideBvhNode::WIDTH;i++)
+	{
+		dest.m_children[i] = static_cast<int>(btSwapEndian(source.m_children[i]));
+	}
+}
+
+bool btWideBvh::serializeInPlace(void *o_alignedDataBuffer, unsigned i_dataBufferSize, bool i_swapEndian) const
+{
+	if (o_alignedDataBuffer == NULL || i_dataBufferSize < calculateSerializeBufferSize())
+	{
+		btAssert(0);
+		return false;
+	}
+
+	btWideBvh *targetBvh = (btWideBvh *)o_alignedDataBuffer;
+
+	// construct the class so the virtual function table, etc will be set up
+	new (targetBvh) btWideBvh;
+
+	if (i_swapEndian)
+	{
+		btSwapVector3Endian(m_bvhAabbMin,targetBvh->m_bvhAabbMin);
+		btSwapVector3Endian(m_bvhAabbMax,targetBvh->m_bvhAabbMax);
+		btSwapVector3Endian(m_bvhQuantization,targetBvh->m_bvhQuantization);
+		targetBvh->m_numNodes = static_cast<int>(btSwapEndian(m_numNodes));
+		targetBvh->m_numLeaves = static_cast<int>(btSwapEndian(m_numLeaves));
+		targetBvh->m_maxDepth = static_cast<int>(btSwapEndian(m_maxDepth));
+	}
+	else
+	{
+		targetBvh->m_bvhAabbMin = m_bvhAabbMin;
+		targetBvh->m_bvhAabbMax = m_bvhAabbMax;
+		targetBvh->m_bvhQuantization = m_bvhQuantization;
+		targetBvh->m_numNodes = m_numNodes;
+		targetBvh->m_numLeaves = m_numLeaves;
+		targetBvh->m_maxDepth = m_maxDepth;
+	}
+
+	unsigned char *nodeData = (unsigned char *)targetBvh;
+	nodeData += sizeof(btWideBvh);
+
+	targetBvh->m_nodes.initializeFromBuffer(nodeData, m_numNodes, m_numNodes);
+	for (int nodeIndex = 0; nodeIndex < m_numNodes; nodeIndex++)
+	{
+		if (i_swapEndian)
+		{
+			btSwapWideBvhNodeEndian(m_nodes[nodeIndex],targetBvh->m_nodes[nodeIndex]);
+		}
+		else
+		{
+			targetBvh->m_nodes[nodeIndex] = m_nodes[nodeIndex];
+		}
+	}
+	nodeData += sizeof(btWideBvhNode) * m_numNodes;
+
+	targetBvh->m_leaves.initializeFromBuffer(nodeData, m_numLeaves, m_numLeaves);
+	for (int leafIndex = 0; leafIndex < m_numLeaves; leafIndex++)
+	{
+		if (i_swapEndian)
+		{
+			targetBvh->m_leaves[leafIndex].m_partId = static_cast<int>(btSwapEndian(m_leaves[leafIndex].m_partId));
+			targetBvh->m_leaves[leafIndex].m_triangleIndex = static_cast<int>(btSwapEndian(m_leaves[leafIndex].m_triangleIndex));
+		}
+		else
+		{
+			targetBvh->m_leaves[leafIndex] = m_leaves[leafIndex];
+		}
+	}
+
+	// this clears the pointers in the member variables
+	targetBvh->m_nodes.initializeFromBuffer(NULL, 0, 0);
+	targetBvh->m_leaves.initializeFromBuffer(NULL, 0, 0);
+	return true;
+}
+
+btWideBvh *btWideBvh::deSerializeInPlace(void *i_alignedDataBuffer, unsigned int i_dataBufferSize, bool i_swapEndian)
+{
+	if (i_alignedDataBuffer == NULL)
+	{
+		return NULL;
+	}
+	btWideBvh *bvh = (btWideBvh *)i_alignedDataBuffer;
+
+	if (i_swapEndian)
+	{
+		btUnSwapVector3Endian(bvh->m_bvhAabbMin);
+		btUnSwapVector3Endian(bvh->m_bvhAabbMax);
+		btUnSwapVector3Endian(bvh->m_bvhQuantization);
+		bvh->m_numNodes = static_cast<int>(btSwapEndian(bvh->m_numNodes));
+		bvh->m_numLeaves = static_cast<int>(btSwapEndian(bvh->m_numLeaves));
+		bvh->m_maxDepth = static_cast<int>(btSwapEndian(bvh->m_maxDepth));
+	}
+
+	unsigned int calculatedBufSize = bvh->calculateSerializeBufferSize();
+	btAssert(calculatedBufSize <= i_dataBufferSize);
+	if (calculatedBufSize > i_dataBufferSize)
+	{
+		return NULL;
+	}
+
+	unsigned char *nodeData = (unsigned char *)bvh;
+	nodeData += sizeof(btWideBvh);
+
+	// Must call placement new to fill in virtual function table, etc, but we don't want to overwrite most data, so call a special version of the constructor
+	new (bvh) btWideBvh(*bvh, false);
+
+	bvh->m_nodes.initializeFromBuffer(nodeData, bvh->m_numNodes, bvh->m_numNodes);
+	if (i_swapEndian)
+	{
+		for (int nodeIndex = 0; nodeIndex < bvh->m_numNodes; nodeIndex++)
+		{
+			btWideBvhNode node = bvh->m_nodes[nodeIndex];
+			btSwapWideBvhNodeEndian(node,bvh->m_nodes[nodeIndex]);
+		}
+	}
+	nodeData += sizeof(btWideBvhNode) * bvh->m_numNodes;
+
+	bvh->m_leaves.initializeFromBuffer(nodeData, bvh->m_numLeaves, bvh->m_numLeaves);
+	if (i_swapEndian)
+	{
+		for (int leafIndex = 0; leafIndex < bvh->m_numLeaves; leafIndex++)
+		{
+			bvh->m_leaves[leafIndex].m_partId = static_cast<int>(btSwapEndian(bvh->m_leaves[leafIndex].m_partId));
+			bvh->m_leaves[leafIndex].m_triangleIndex = static_cast<int>(btSwapEndian(bvh->m_leaves[leafIndex].m_triangleIndex));
+		}
+	}
+
+	return bvh;
+}
+
+// Constructor that prevents btVector3's default constructor from being called
+btWideBvh::btWideBvh(btWideBvh &self, bool /* ownsMemory */) :
+m_bvhAabbMin(self.m_bvhAabbMin),
+m_bvhAabbMax(self.m_bvhAabbMax),
+m_bvhQuantization(self.m_bvhQuantization),
+m_numNodes(self.m_numNodes),
+m_numLeaves(self.m_numLeaves),
+m_maxDepth(self.m_maxDepth)
+{
+}
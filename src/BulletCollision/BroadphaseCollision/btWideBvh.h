@@ -0,0 +1,134 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_WIDE_BVH_H
+#define BT_WIDE_BVH_H
+
+#include "btQuantizedBvh.h"
+#include "btRayPacket.h"
+
+
+///marks an unused child slot of a btWideBvhNode (~0 would be the root, which is never a child)
+#define BT_WIDE_BVH_EMPTY (-1)
+
+///btWideBvhNode stores the quantized boxes of up to four children in structure-of-arrays layout, 64 bytes per node.
+///A child is a leaf index (>= 0), ~nodeIndex for an internal node or BT_WIDE_BVH_EMPTY.
+ATTRIBUTE_ALIGNED16	(struct) btWideBvhNode
+{
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	enum { WIDTH = 4 };
+
+	unsigned short int	m_quantizedAabbMin[3][WIDTH];
+	unsigned short int	m_quantizedAabbMax[3][WIDTH];
+	int	m_children[WIDTH];
+};
+
+struct	btWideBvhLeaf
+{
+	int	m_partId;
+	int	m_triangleIndex;
+};
+
+
+///btWideBvh is a 4-ary bounding volume hierarchy, made by collapsing the binary tree of a btQuantizedBvh.
+///A node visit tests all four child boxes at once with SSE, and the tree has about a third of the nodes and half the depth of the binary tree.
+///It is an alternative midphase for btBvhTriangleMeshShape, see btBvhTriangleMeshShape::buildWideBvh.
+///It serializes in place, like btOptimizedBvh::serializeInPlace.
+ATTRIBUTE_ALIGNED16(class) btWideBvh
+{
+protected:
+
+	btVector3			m_bvhAabbMin;
+	btVector3			m_bvhAabbMax;
+	btVector3			m_bvhQuantization;
+
+	int					m_numNodes;
+	int					m_numLeaves;
+	int					m_maxDepth;
+
+	btAlignedObjectArray<btWideBvhNode>	m_nodes;
+	btAlignedObjectArray<btWideBvhLeaf>	m_leaves;
+	///the binary leaf node of each leaf, for refitPartial. It is not serialized
+	btAlignedObjectArray<int>	m_leafBinaryNodes;
+
+	int		buildNode(const btQuantizedBvh& bvh, int binaryNodeIndex, int depth);
+
+	bool	refitNode(const btQuantizedBvh& bvh, int nodeIndex, const unsigned short* quantizedQueryAabbMin, const unsigned short* quantizedQueryAabbMax, const btVector3& aabbMin, const btVector3& aabbMax);
+
+	void	quantize(unsigned short* out, const btVector3& point, int isMax) const;
+
+	template <typename POLICY>
+	void	walkTree(POLICY& policy) const;
+
+public:
+
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btWideBvh();
+
+	virtual ~btWideBvh();
+
+	///build (or rebuild, after the binary tree was refit) from the nodes of bvh
+	void	build(const btQuantizedBvh& bvh);
+
+	///update the boxes of the nodes that overlap aabbMin/aabbMax from the leaf nodes of bvh, after btOptimizedBvh::refitPartial with the same box.
+	///Returns false if the tree can't be refit (a leaf moved outside the quantization range, or the tree was deserialized), then call build instead
+	bool	refitPartial(const btQuantizedBvh& bvh, const btVector3& aabbMin, const btVector3& aabbMax);
+
+	void	reportAabbOverlappingNodex(btNodeOverlapCallback* nodeCallback,const btVector3& aabbMin,const btVector3& aabbMax) const;
+	void	reportRayOverlappingNodex (btNodeOverlapCallback* nodeCallback, const btVector3& raySource, const btVector3& rayTarget) const;
+	void	reportBoxCastOverlappingNodex(btNodeOverlapCallback* nodeCallback, const btVector3& raySource, const btVector3& rayTarget, const btVector3& aabbMin,const btVector3& aabbMax) const;
+	///same as btQuantizedBvh::reportRayPacketOverlappingNodes
+	void	reportRayPacketOverlappingNodes(btRayPacketNodeOverlapCallback* nodeCallback, const btRayPacket& packet) const;
+
+	int	getNumNodes() const
+	{
+		return m_numNodes;
+	}
+
+	const btWideBvhNode*	getNodes() const
+	{
+		return m_numNodes ? &m_nodes[0] : 0;
+	}
+
+	SIMD_FORCE_INLINE btVector3	unQuantize(int node, int child, bool isMax) const
+	{
+		const unsigned short int* q = isMax ? &m_nodes[node].m_quantizedAabbMax[0][child] : &m_nodes[node].m_quantizedAabbMin[0][child];
+		btVector3	vecOut;
+		vecOut.setValue(
+			(btScalar)(q[0]) / (m_bvhQuantization.getX()),
+			(btScalar)(q[btWideBvhNode::WIDTH]) / (m_bvhQuantization.getY()),
+			(btScalar)(q[2*btWideBvhNode::WIDTH]) / (m_bvhQuantization.getZ()));
+		vecOut += m_bvhAabbMin;
+		return vecOut;
+	}
+
+	/////Calculate space needed to store the tree for serialization
+	unsigned calculateSerializeBufferSize() const;
+
+	/// Data buffer MUST be 16 byte aligned
+	bool serializeInPlace(void *o_alignedDataBuffer, unsigned i_dataBufferSize, bool i_swapEndian) const;
+
+	///deSerializeInPlace loads and initializes a tree from a buffer in memory 'in place'
+	static btWideBvh *deSerializeInPlace(void *i_alignedDataBuffer, unsigned int i_dataBufferSize, bool i_swapEndian);
+
+private:
+	// Special "copy" constructor that allows for in-place deserialization, see btQuantizedBvh
+	btWideBvh(btWideBvh &other, bool ownsMemory);
+
+};
+
+#endif //BT_WIDE_BVH_H
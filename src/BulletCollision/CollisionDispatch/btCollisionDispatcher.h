@@ -123,6 +123,7 @@ public:
 	
 	virtual void	dispatchAllCollisionPairs(btOverlappingPairCache* pairCache,const btDispatcherInfo& dispatchInfo,btDispatcher* dispatcher) ;
 
+	///btCollisionDispatcherMt calls the near callback from several threads at once, it must not add or remove overlapping pairs
 	void	setNearCallback(btNearCallback	nearCallback)
 	{
 		m_nearCallback = nearCallback; 
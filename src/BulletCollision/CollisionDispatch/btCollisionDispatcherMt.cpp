@@ -0,0 +1,344 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+
+#include "btCollisionDispatcherMt.h"
+
+
+#include "BulletCollision/BroadphaseCollision/btCollisionAlgorithm.h"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "BulletCollision/NarrowPhaseCollision/btPersistentManifold.h"
+#include "BulletCollision/CollisionDispatch/btCollisionObject.h"
+#include "BulletCollision/CollisionShapes/btCollisionShape.h"
+#include "LinearMath/btPoolAllocator.h"
+#include "LinearMath/btQuickprof.h"
+#include "BulletCollision/CollisionDispatch/btCollisionConfiguration.h"
+
+extern int gNumManifold;
+
+
+btCollisionDispatcherMt::btCollisionDispatcherMt(btCollisionConfiguration* collisionConfiguration, int grainSize)
+:btCollisionDispatcher(collisionConfiguration),
+m_grainSize(grainSize)
+{
+	AlgorithmPool& pool = m_algorithmPools.expandNonInitializing();
+	pool.m_pool = m_collisionAlgorithmPoolAllocator;
+	pool.m_mutex = btSpinMutex();
+	pool.m_ownsPool = false;
+
+	m_threadManifolds.resize(BT_MAX_THREAD_COUNT);
+	for (int i=0;i<m_threadManifolds.size();i++)
+	{
+		ThreadManifolds& threadManifolds = m_threadManifolds[i];
+		threadManifolds.m_pool = (i==0) ? m_persistentManifoldPoolAllocator : 0;
+		threadManifolds.m_ownsPool = false;
+		threadManifolds.m_pairIndex = 0;
+		threadManifolds.m_sequence = 0;
+	}
+	m_batchUpdating = false;
+}
+
+
+btCollisionDispatcherMt::~btCollisionDispatcherMt()
+{
+	for (int i=0;i<m_algorithmPools.size();i++)
+	{
+		AlgorithmPool& pool = m_algorithmPools[i];
+		if (pool.m_ownsPool)
+		{
+			pool.m_pool->~btPoolAllocator();
+			btAlignedFree(pool.m_pool);
+		}
+	}
+	for (int i=0;i<m_threadManifolds.size();i++)
+	{
+		ThreadManifolds& threadManifolds = m_threadManifolds[i];
+		if (threadManifolds.m_ownsPool)
+		{
+			threadManifolds.m_pool->~btPoolAllocator();
+			btAlignedFree(threadManifolds.m_pool);
+		}
+	}
+}
+
+
+void	btCollisionDispatcherMt::growAlgorithmPools(int numPools)
+{
+	//only called from the main thread, while no pairs are being processed
+	btAssert(!btThreadsAreRunning());
+	int elemSize = m_collisionAlgorithmPoolAllocator->getElementSize();
+	int maxElements = m_collisionAlgorithmPoolAllocator->getMaxCount();
+	while (m_algorithmPools.size() < numPools)
+	{
+		void* mem = btAlignedAlloc(sizeof(btPoolAllocator),16);
+		AlgorithmPool& pool = m_algorithmPools.expandNonInitializing();
+		pool.m_pool = new (mem) btPoolAllocator(elemSize,maxElements);
+		pool.m_mutex = btSpinMutex();
+		pool.m_ownsPool = true;
+	}
+}
+
+
+btCollisionDispatcherMt::AlgorithmPool*	btCollisionDispatcherMt::findAlgorithmPool(void* ptr)
+{
+	for (int i=0;i<m_algorithmPools.size();i++)
+	{
+		if (m_algorithmPools[i].m_pool->validPtr(ptr))
+			return &m_algorithmPools[i];
+	}
+	return 0;
+}
+
+
+btPersistentManifold*	btCollisionDispatcherMt::getNewManifold(const btCollisionObject* body0,const btCollisionObject* body1)
+{
+	if (!m_batchUpdating)
+	{
+		return btCollisionDispatcher::getNewManifold(body0,body1);
+	}
+
+	//same as btCollisionDispatcher::getNewManifold, but the manifold is added to m_manifoldsPtr later by replayManifoldEvents
+	btScalar contactBreakingThreshold =  (m_dispatcherFlags & btCollisionDispatcher::CD_USE_RELATIVE_CONTACT_BREAKING_THRESHOLD) ? 
+		btMin(body0->getCollisionShape()->getContactBreakingThreshold(gContactBreakingThreshold) , body1->getCollisionShape()->getContactBreakingThreshold(gContactBreakingThreshold))
+		: gContactBreakingThreshold ;
+
+	btScalar contactProcessingThreshold = btMin(body0->getContactProcessingThreshold(),body1->getContactProcessingThreshold());
+
+	ThreadManifolds& threadManifolds = m_threadManifolds[btGetCurrentThreadIndex()];
+	if (!threadManifolds.m_pool)
+	{
+		//the first manifold of a worker thread, the pool has the size of the main pool
+		void* poolMem = btAlignedAlloc(sizeof(btPoolAllocator),16);
+		threadManifolds.m_pool = new (poolMem) btPoolAllocator(sizeof(btPersistentManifold),m_persistentManifoldPoolAllocator->getMaxCount());
+		threadManifolds.m_ownsPool = true;
+	}
+
+	void* mem = 0;
+	if (threadManifolds.m_pool->getFreeCount())
+	{
+		mem = threadManifolds.m_pool->allocate(sizeof(btPersistentManifold));
+	} else
+	{
+		//we got a pool memory overflow, by default we fallback to dynamically allocate memory. If we require a contiguous contact pool then assert.
+		if ((m_dispatcherFlags&CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION)==0)
+		{
+			mem = btAlignedAlloc(sizeof(btPersistentManifold),16);
+		} else
+		{
+			btAssert(0);
+			//make sure to increase the m_defaultMaxPersistentManifoldPoolSize in the btDefaultCollisionConstructionInfo/btDefaultCollisionConfiguration
+			return 0;
+		}
+	}
+	btPersistentManifold* manifold = new(mem) btPersistentManifold (body0,body1,0,contactBreakingThreshold,contactProcessingThreshold);
+
+	ManifoldEvent& event = threadManifolds.m_events.expandNonInitializing();
+	event.m_manifold = manifold;
+	event.m_pairIndex = threadManifolds.m_pairIndex;
+	event.m_sequence = threadManifolds.m_sequence++;
+	event.m_release = false;
+	return manifold;
+}
+
+
+void btCollisionDispatcherMt::releaseManifold(btPersistentManifold* manifold)
+{
+	clearManifold(manifold);
+	if (!m_batchUpdating)
+	{
+		removeManifold(manifold);
+		return;
+	}
+
+	//removed from m_manifoldsPtr and freed later by replayManifoldEvents
+	ThreadManifolds& threadManifolds = m_threadManifolds[btGetCurrentThreadIndex()];
+	ManifoldEvent& event = threadManifolds.m_events.expandNonInitializing();
+	event.m_manifold = manifold;
+	event.m_pairIndex = threadManifolds.m_pairIndex;
+	event.m_sequence = threadManifolds.m_sequence++;
+	event.m_release = true;
+}
+
+
+void	btCollisionDispatcherMt::freeManifoldMemory(btPersistentManifold* manifold)
+{
+	for (int i=0;i<m_threadManifolds.size();i++)
+	{
+		btPoolAllocator* pool = m_threadManifolds[i].m_pool;
+		if (pool && pool->validPtr(manifold))
+		{
+			pool->freeMemory(manifold);
+			return;
+		}
+	}
+	btAlignedFree(manifold);
+}
+
+
+void	btCollisionDispatcherMt::removeManifold(btPersistentManifold* manifold)
+{
+	gNumManifold--;
+
+	int findIndex = manifold->m_index1a;
+	btAssert(findIndex < m_manifoldsPtr.size());
+	m_manifoldsPtr.swap(findIndex,m_manifoldsPtr.size()-1);
+	m_manifoldsPtr[findIndex]->m_index1a = findIndex;
+	m_manifoldsPtr.pop_back();
+
+	manifold->~btPersistentManifold();
+	freeManifoldMemory(manifold);
+}
+
+
+struct ManifoldEventSortPredicate
+{
+	template <typename T>
+	bool operator() ( const T& a, const T& b ) const
+	{
+		return a.m_pairIndex < b.m_pairIndex || (a.m_pairIndex == b.m_pairIndex && a.m_sequence < b.m_sequence);
+	}
+};
+
+
+void	btCollisionDispatcherMt::replayManifoldEvents()
+{
+	BT_PROFILE("replayManifoldEvents");
+	m_manifoldEvents.resize(0);
+	for (int i=0;i<m_threadManifolds.size();i++)
+	{
+		btAlignedObjectArray<ManifoldEvent>& events = m_threadManifolds[i].m_events;
+		for (int j=0;j<events.size();j++)
+		{
+			m_manifoldEvents.push_back(events[j]);
+		}
+		events.resize(0);
+	}
+
+	//the pairs of one thread are in order, but the threads are interleaved
+	m_manifoldEvents.quickSort(ManifoldEventSortPredicate());
+
+	for (int i=0;i<m_manifoldEvents.size();i++)
+	{
+		const ManifoldEvent& event = m_manifoldEvents[i];
+		if (event.m_release)
+		{
+			removeManifold(event.m_manifold);
+		} else
+		{
+			gNumManifold++;
+			event.m_manifold->m_index1a = m_manifoldsPtr.size();
+			m_manifoldsPtr.push_back(event.m_manifold);
+		}
+	}
+}
+
+
+void* btCollisionDispatcherMt::allocateCollisionAlgorithm(int size)
+{
+	AlgorithmPool& pool = m_algorithmPools[btGetCurrentThreadIndex() % m_algorithmPools.size()];
+	void* mem = 0;
+	btMutexLock(&pool.m_mutex);
+	if (pool.m_pool->getFreeCount())
+	{
+		mem = pool.m_pool->allocate(size);
+	}
+	btMutexUnlock(&pool.m_mutex);
+	if (mem)
+		return mem;
+
+	//warn user for overflow?
+	return	btAlignedAlloc(static_cast<size_t>(size), 16);
+}
+
+
+void btCollisionDispatcherMt::freeCollisionAlgorithm(void* ptr)
+{
+	//algorithms may be destroyed by a different thread than the one that created them
+	AlgorithmPool* pool = findAlgorithmPool(ptr);
+	if (pool)
+	{
+		btMutexLock(&pool->m_mutex);
+		pool->m_pool->freeMemory(ptr);
+		btMutexUnlock(&pool->m_mutex);
+	} else
+	{
+		btAlignedFree(ptr);
+	}
+}
+
+
+struct CollisionDispatcherUpdater : public btIParallelForBody
+{
+	btBroadphasePair* mPairArray;
+	btNearCallback mCallback;
+	btCollisionDispatcherMt* mDispatcher;
+	const btDispatcherInfo* mInfo;
+
+	CollisionDispatcherUpdater()
+	{
+		mPairArray = NULL;
+		mCallback = NULL;
+		mDispatcher = NULL;
+		mInfo = NULL;
+	}
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "dispatchAllCollisionPairs loop" );
+		btCollisionDispatcherMt::ThreadManifolds& threadManifolds = mDispatcher->m_threadManifolds[ btGetCurrentThreadIndex() ];
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			//the manifold events are ordered by pair
+			threadManifolds.m_pairIndex = i;
+			threadManifolds.m_sequence = 0;
+			btBroadphasePair* pair = &mPairArray[ i ];
+			mCallback( *pair, *mDispatcher, *mInfo );
+		}
+	}
+};
+
+
+void	btCollisionDispatcherMt::dispatchAllCollisionPairs(btOverlappingPairCache* pairCache,const btDispatcherInfo& dispatchInfo,btDispatcher* dispatcher)
+{
+	if (dispatchInfo.m_dispatchFunc != btDispatcherInfo::DISPATCH_DISCRETE)
+	{
+		//the time of impact is reduced into dispatchInfo.m_timeOfImpact, which can't be done concurrently
+		btCollisionDispatcher::dispatchAllCollisionPairs(pairCache,dispatchInfo,dispatcher);
+		return;
+	}
+
+	int pairCount = pairCache->getNumOverlappingPairs();
+	if (pairCount == 0)
+	{
+		return;
+	}
+
+	growAlgorithmPools(btGetTaskScheduler()->getNumThreads());
+
+	//btCollisionPairCallback never asks for pairs to be removed, so calling the near callback for each pair is equivalent
+	//to pairCache->processAllOverlappingPairs, as long as the near callback doesn't change the pair cache (see the class comment)
+	CollisionDispatcherUpdater updater;
+	updater.mCallback = getNearCallback();
+	updater.mPairArray = pairCache->getOverlappingPairArrayPtr();
+	updater.mDispatcher = this;
+	updater.mInfo = &dispatchInfo;
+
+	m_batchUpdating = true;
+	btParallelFor( 0, pairCount, m_grainSize, updater );
+	m_batchUpdating = false;
+	btAssert( pairCache->getNumOverlappingPairs() == pairCount );
+
+	replayManifoldEvents();
+}
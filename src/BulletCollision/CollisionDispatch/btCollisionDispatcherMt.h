@@ -0,0 +1,115 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_COLLISION_DISPATCHER_MT_H
+#define BT_COLLISION_DISPATCHER_MT_H
+
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
+#include "LinearMath/btThreads.h"
+
+
+///btCollisionDispatcherMt processes the overlapping pairs on several threads, using btParallelFor.
+///Each thread allocates collision algorithms from its own pool. The pairs are processed exactly like btCollisionDispatcher
+///does, so the contacts don't change. Continuous (time of impact) dispatch is done serially.
+///While the pairs are processed, each thread allocates manifolds from its own pool without any locking, and records the
+///manifolds it creates and releases. Afterwards the records are sorted by pair index and replayed on m_manifoldsPtr,
+///which gives the same manifold order as the serial dispatcher, for any number of threads.
+///A custom near callback (see setNearCallback) is called for different pairs at the same time. It may only change its own pair
+///and use the dispatcher, it must not add or remove overlapping pairs or touch other state shared between the pairs.
+class btCollisionDispatcherMt : public btCollisionDispatcher
+{
+protected:
+
+	friend struct CollisionDispatcherUpdater;
+
+	struct ManifoldEvent
+	{
+		btPersistentManifold*	m_manifold;
+		int	m_pairIndex;
+		int	m_sequence;	///< order of the event within the pair
+		bool	m_release;
+	};
+
+	///the manifold pool and manifold events of one thread, only touched by that thread while the pairs are processed
+	struct ThreadManifolds
+	{
+		btPoolAllocator*	m_pool;
+		bool	m_ownsPool;
+		int	m_pairIndex;
+		int	m_sequence;
+		btAlignedObjectArray<ManifoldEvent>	m_events;
+		char	m_padding[64];	///< keep threads off each others cache lines
+	};
+
+	struct AlgorithmPool
+	{
+		btPoolAllocator*	m_pool;
+		btSpinMutex	m_mutex;
+		bool	m_ownsPool;
+	};
+
+	///pool 0 is the collision algorithm pool of the collision configuration, the others are created on demand
+	btAlignedObjectArray<AlgorithmPool>	m_algorithmPools;
+
+	///indexed by btGetCurrentThreadIndex, thread 0 uses the manifold pool of the collision configuration
+	btAlignedObjectArray<ThreadManifolds>	m_threadManifolds;
+
+	btAlignedObjectArray<ManifoldEvent>	m_manifoldEvents;
+
+	///true while dispatchAllCollisionPairs processes the pairs in parallel
+	bool	m_batchUpdating;
+
+	int	m_grainSize;
+
+	void	growAlgorithmPools(int numPools);
+
+	AlgorithmPool*	findAlgorithmPool(void* ptr);
+
+	void	freeManifoldMemory(btPersistentManifold* manifold);
+
+	void	removeManifold(btPersistentManifold* manifold);
+
+	///adds the manifolds created while the pairs were processed to m_manifoldsPtr, and removes the released ones, in pair order
+	void	replayManifoldEvents();
+
+public:
+
+	btCollisionDispatcherMt(btCollisionConfiguration* collisionConfiguration, int grainSize = 40);
+
+	virtual ~btCollisionDispatcherMt();
+
+	virtual btPersistentManifold*	getNewManifold(const btCollisionObject* body0,const btCollisionObject* body1);
+
+	virtual void releaseManifold(btPersistentManifold* manifold);
+
+	virtual void	dispatchAllCollisionPairs(btOverlappingPairCache* pairCache,const btDispatcherInfo& dispatchInfo,btDispatcher* dispatcher);
+
+	virtual	void* allocateCollisionAlgorithm(int size);
+
+	virtual	void freeCollisionAlgorithm(void* ptr);
+
+	///number of overlapping pairs per task
+	void	setGrainSize(int grainSize)
+	{
+		m_grainSize = grainSize;
+	}
+
+	int	getGrainSize() const
+	{
+		return m_grainSize;
+	}
+};
+
+#endif //BT_COLLISION_DISPATCHER_MT_H
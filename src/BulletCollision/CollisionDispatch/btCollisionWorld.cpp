@@ -21,8 +21,12 @@ subject to the following restrictions:
 #include "BulletCollision/NarrowPhaseCollision/btGjkEpaPenetrationDepthSolver.h"
 #include "BulletCollision/CollisionShapes/btSphereShape.h" //for raycasting
 #include "BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h" //for raycasting
+#include "BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h" //for raycasting
 #include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
 #include "BulletCollision/CollisionShapes/btCompoundShape.h"
+#include "BulletCollision/CollisionShapes/btBoxShape.h"
+#include "BulletCollision/CollisionShapes/btCapsuleShape.h"
+#include "BulletCollision/CollisionShapes/btConvexHullShape.h"
 #include "BulletCollision/NarrowPhaseCollision/btSubSimplexConvexCast.h"
 #include "BulletCollision/NarrowPhaseCollision/btGjkConvexCast.h"
 #include "BulletCollision/NarrowPhaseCollision/btContinuousConvexCollision.h"
@@ -31,6 +35,7 @@ subject to the following restrictions:
 #include "BulletCollision/BroadphaseCollision/btDbvt.h"
 #include "LinearMath/btAabbUtil2.h"
 #include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
 #include "LinearMath/btSerializer.h"
 #include "BulletCollision/CollisionShapes/btConvexPolyhedron.h"
 #include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
@@ -144,10 +149,59 @@ void	btCollisionWorld::addCollisionObject(btCollisionObject* collisionObject,sho
 
 
 
-void	btCollisionWorld::updateSingleAabb(btCollisionObject* colObj)
+///the shape aabb kernels of computeObjectAabb, for the most common convex shapes this is the math of their getAabb
+///without virtual calls. Like btConvexShape::getAabbNonVirtual, this assumes these shape types don't override getAabb.
+static SIMD_FORCE_INLINE void	btCalculateShapeAabb(const btCollisionShape* shape, const btTransform& t, btVector3& aabbMin, btVector3& aabbMax)
 {
-	btVector3 minAabb,maxAabb;
-	colObj->getCollisionShape()->getAabb(colObj->getWorldTransform(), minAabb,maxAabb);
+	switch (shape->getShapeType())
+	{
+	case SPHERE_SHAPE_PROXYTYPE:
+		{
+			//the margin of a sphere is its radius
+			btScalar radius = static_cast<const btSphereShape*>(shape)->getRadius();
+			const btVector3& center = t.getOrigin();
+			btVector3 extent(radius,radius,radius);
+			aabbMin = center - extent;
+			aabbMax = center + extent;
+			break;
+		}
+	case BOX_SHAPE_PROXYTYPE:
+		{
+			const btBoxShape* boxShape = static_cast<const btBoxShape*>(shape);
+			btTransformAabb(boxShape->getHalfExtentsWithoutMargin(),boxShape->btConvexInternalShape::getMargin(),t,aabbMin,aabbMax);
+			break;
+		}
+	case CAPSULE_SHAPE_PROXYTYPE:
+		{
+			const btCapsuleShape* capsuleShape = static_cast<const btCapsuleShape*>(shape);
+			btScalar radius = capsuleShape->getRadius();
+			btScalar margin = capsuleShape->btConvexInternalShape::getMargin();
+			btVector3 halfExtents(radius,radius,radius);
+			halfExtents[capsuleShape->getUpAxis()] = radius + capsuleShape->getHalfHeight();
+			halfExtents += btVector3(margin,margin,margin);
+			btMatrix3x3 abs_b = t.getBasis().absolute();
+			btVector3 center = t.getOrigin();
+			btVector3 extent = halfExtents.dot3(abs_b[0], abs_b[1], abs_b[2]);
+			aabbMin = center - extent;
+			aabbMax = center + extent;
+			break;
+		}
+	case CONVEX_HULL_SHAPE_PROXYTYPE:
+		{
+			const btConvexHullShape* hullShape = static_cast<const btConvexHullShape*>(shape);
+			hullShape->getNonvirtualAabb(t,aabbMin,aabbMax,hullShape->btConvexInternalShape::getMargin());
+			break;
+		}
+	default:
+		shape->getAabb(t,aabbMin,aabbMax);
+		break;
+	}
+}
+
+void	btCollisionWorld::computeObjectAabb(const btCollisionObject* colObj, btVector3& minAabb, btVector3& maxAabb) const
+{
+	const btCollisionShape* shape = colObj->getCollisionShape();
+	btCalculateShapeAabb(shape,colObj->getWorldTransform(),minAabb,maxAabb);
 	//need to increase the aabb for contact thresholds
 	btVector3 contactThreshold(gContactBreakingThreshold,gContactBreakingThreshold,gContactBreakingThreshold);
 	minAabb -= contactThreshold;
@@ -156,19 +210,20 @@ void	btCollisionWorld::updateSingleAabb(btCollisionObject* colObj)
 	if(getDispatchInfo().m_useContinuous && colObj->getInternalType()==btCollisionObject::CO_RIGID_BODY && !colObj->isStaticOrKinematicObject())
 	{
 		btVector3 minAabb2,maxAabb2;
-		colObj->getCollisionShape()->getAabb(colObj->getInterpolationWorldTransform(),minAabb2,maxAabb2);
+		btCalculateShapeAabb(shape,colObj->getInterpolationWorldTransform(),minAabb2,maxAabb2);
 		minAabb2 -= contactThreshold;
 		maxAabb2 += contactThreshold;
 		minAabb.setMin(minAabb2);
 		maxAabb.setMax(maxAabb2);
 	}
+}
 
-	btBroadphaseInterface* bp = (btBroadphaseInterface*)m_broadphasePairCache;
-
+bool	btCollisionWorld::checkSingleAabb(btCollisionObject* colObj, const btVector3& minAabb, const btVector3& maxAabb)
+{
 	//moving objects should be moderately sized, probably something wrong if not
 	if ( colObj->isStaticObject() || ((maxAabb-minAabb).length2() < btScalar(1e12)))
 	{
-		bp->setAabb(colObj->getBroadphaseHandle(),minAabb,maxAabb, m_dispatcher1);
+		return true;
 	} else
 	{
 		//something went wrong, investigate
@@ -184,24 +239,99 @@ void	btCollisionWorld::updateSingleAabb(btCollisionObject* colObj)
 			m_debugDrawer->reportErrorWarning("Please include above information, your Platform, version of OS.\n");
 			m_debugDrawer->reportErrorWarning("Thanks.\n");
 		}
+		return false;
+	}
+}
+
+bool	btCollisionWorld::calculateSingleAabb(btCollisionObject* colObj, btVector3& minAabb, btVector3& maxAabb)
+{
+	computeObjectAabb(colObj,minAabb,maxAabb);
+	return checkSingleAabb(colObj,minAabb,maxAabb);
+}
+
+void	btCollisionWorld::updateSingleAabb(btCollisionObject* colObj)
+{
+	btVector3 minAabb,maxAabb;
+	if (calculateSingleAabb(colObj,minAabb,maxAabb))
+	{
+		btBroadphaseInterface* bp = (btBroadphaseInterface*)m_broadphasePairCache;
+		bp->setAabb(colObj->getBroadphaseHandle(),minAabb,maxAabb, m_dispatcher1);
 	}
 }
 
+///objects per task of the parallel aabb computation in updateAabbs
+static int	gUpdateAabbsGrainSize = 64;
+
+struct btUpdateAabbsLoop : public btIParallelForBody
+{
+	const btCollisionWorld* m_world;
+	btCollisionObject* const* m_objects;
+	btVector3* m_aabbMins;
+	btVector3* m_aabbMaxs;
+
+	btUpdateAabbsLoop(const btCollisionWorld* world, btCollisionObject* const* objects, btVector3* aabbMins, btVector3* aabbMaxs)
+		:m_world(world),
+		m_objects(objects),
+		m_aabbMins(aabbMins),
+		m_aabbMaxs(aabbMaxs)
+	{
+	}
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "updateAabbs loop" );
+		for (int i=iBegin;i<iEnd;i++)
+		{
+			m_world->computeObjectAabb(m_objects[i],m_aabbMins[i],m_aabbMaxs[i]);
+		}
+	}
+};
+
 void	btCollisionWorld::updateAabbs()
 {
 	BT_PROFILE("updateAabbs");
 
-	btTransform predictedTrans;
+	//only update aabb of active objects
+	m_aabbBatchObjects.resize(0);
 	for ( int i=0;i<m_collisionObjects.size();i++)
 	{
 		btCollisionObject* colObj = m_collisionObjects[i];
-
-		//only update aabb of active objects
 		if (m_forceUpdateAllAabbs || colObj->isActive())
 		{
-			updateSingleAabb(colObj);
+			m_aabbBatchObjects.push_back(colObj);
+		}
+	}
+	int numObjects = m_aabbBatchObjects.size();
+	if (numObjects==0)
+	{
+		return;
+	}
+
+	m_aabbBatchMins.resizeNoInitialize(numObjects);
+	m_aabbBatchMaxs.resizeNoInitialize(numObjects);
+	{
+		BT_PROFILE("computeObjectAabbs");
+		btUpdateAabbsLoop loop(this,&m_aabbBatchObjects[0],&m_aabbBatchMins[0],&m_aabbBatchMaxs[0]);
+		btParallelFor(0,numObjects,gUpdateAabbsGrainSize,loop);
+	}
+
+	//drop the invalid aabbs, the valid ones are moved down in place
+	m_aabbBatchProxies.resize(0);
+	for ( int i=0;i<numObjects;i++)
+	{
+		btCollisionObject* colObj = m_aabbBatchObjects[i];
+		if (checkSingleAabb(colObj,m_aabbBatchMins[i],m_aabbBatchMaxs[i]))
+		{
+			int j = m_aabbBatchProxies.size();
+			m_aabbBatchMins[j] = m_aabbBatchMins[i];
+			m_aabbBatchMaxs[j] = m_aabbBatchMaxs[i];
+			m_aabbBatchProxies.push_back(colObj->getBroadphaseHandle());
 		}
 	}
+	if (m_aabbBatchProxies.size())
+	{
+		m_broadphasePairCache->setAabbBatch(&m_aabbBatchProxies[0],&m_aabbBatchMins[0],&m_aabbBatchMaxs[0],m_aabbBatchProxies.size(),m_dispatcher1);
+	}
 }
 
 
@@ -221,6 +351,13 @@ void	btCollisionWorld::performDiscreteCollisionDetection()
 
 	computeOverlappingPairs();
 
+	if (dispatchInfo.m_deterministicOrder)
+	{
+		//new manifolds are created in pair order, so it shouldn't depend on the order the pairs were found in
+		BT_PROFILE("sortOverlappingPairs");
+		m_broadphasePairCache->getOverlappingPairCache()->sortOverlappingPairs(m_dispatcher1);
+	}
+
 	btDispatcher* dispatcher = getDispatcher();
 	{
 		BT_PROFILE("dispatchAllCollisionPairs");
@@ -450,7 +587,16 @@ void	btCollisionWorld::rayTestSingleInternal(const btTransform& rayFromTrans,con
 				btVector3 rayAabbMaxLocal = rayFromLocal;
 				rayAabbMaxLocal.setMax(rayToLocal);
 
-				concaveShape->processAllTriangles(&rcb,rayAabbMinLocal,rayAabbMaxLocal);
+				if (collisionShape->getShapeType()==TERRAIN_SHAPE_PROXYTYPE)
+				{
+					///walks the min/max mips along the ray, when the heightfield has them
+					btHeightfieldTerrainShape* terrainShape = (btHeightfieldTerrainShape*)concaveShape;
+					terrainShape->performRaycast(&rcb,rayFromLocal,rayToLocal);
+				}
+				else
+				{
+					concaveShape->processAllTriangles(&rcb,rayAabbMinLocal,rayAabbMaxLocal);
+				}
 			}
 		} else {
 			//			BT_PROFILE("rayTestCompound");
@@ -940,6 +1086,211 @@ void	btCollisionWorld::rayTest(const btVector3& rayFromWorld, const btVector3& r
 }
 
 
+///writes the closest hit of one ray of rayTestBatch straight into its BatchedRayResult
+struct btBatchedRayResultCallback : public btCollisionWorld::RayResultCallback
+{
+	btVector3	m_rayFromWorld;
+	btVector3	m_rayToWorld;
+	btCollisionWorld::BatchedRayResult*	m_result;
+
+	virtual	btScalar	addSingleResult(btCollisionWorld::LocalRayResult& rayResult,bool normalInWorldSpace)
+	{
+		//caller already does the filter on the m_closestHitFraction
+		btAssert(rayResult.m_hitFraction <= m_closestHitFraction);
+
+		m_closestHitFraction = rayResult.m_hitFraction;
+		m_collisionObject = rayResult.m_collisionObject;
+		m_result->m_collisionObject = rayResult.m_collisionObject;
+		if (normalInWorldSpace)
+		{
+			m_result->m_hitNormalWorld = rayResult.m_hitNormalLocal;
+		} else
+		{
+			///need to transform normal into worldspace
+			m_result->m_hitNormalWorld = m_collisionObject->getWorldTransform().getBasis()*rayResult.m_hitNormalLocal;
+		}
+		m_result->m_hitPointWorld.setInterpolate3(m_rayFromWorld,m_rayToWorld,rayResult.m_hitFraction);
+		m_result->m_hitFraction = rayResult.m_hitFraction;
+		return rayResult.m_hitFraction;
+	}
+};
+
+///same as the BridgeTriangleRaycastCallback of rayTestSingleInternal, for the rays of a packet that hit a btBvhTriangleMeshShape
+struct btBatchedTriangleRaycastCallback : public btTriangleRaycastCallback
+{
+	btCollisionWorld::RayResultCallback*	m_resultCallback;
+	const btCollisionObject*	m_collisionObject;
+
+	btBatchedTriangleRaycastCallback()
+		:btTriangleRaycastCallback(btVector3(0,0,0),btVector3(0,0,0)),
+		m_resultCallback(0),
+		m_collisionObject(0)
+	{
+	}
+
+	virtual btScalar reportHit(const btVector3& hitNormalLocal, btScalar hitFraction, int partId, int triangleIndex )
+	{
+		btCollisionWorld::LocalShapeInfo	shapeInfo;
+		shapeInfo.m_shapePart = partId;
+		shapeInfo.m_triangleIndex = triangleIndex;
+
+		btVector3 hitNormalWorld = m_collisionObject->getWorldTransform().getBasis() * hitNormalLocal;
+
+		btCollisionWorld::LocalRayResult rayResult
+			(m_collisionObject,
+			&shapeInfo,
+			hitNormalWorld,
+			hitFraction);
+
+		bool	normalInWorldSpace = true;
+		return m_resultCallback->addSingleResult(rayResult,normalInWorldSpace);
+	}
+};
+
+struct btRayPacketCallback : public btBroadphaseRayPacketCallback
+{
+	btBatchedRayResultCallback	m_rayCallbacks[btRayPacket::MAX_RAYS];
+	btTransform	m_rayFromTrans[btRayPacket::MAX_RAYS];
+	btTransform	m_rayToTrans[btRayPacket::MAX_RAYS];
+
+	btRayPacketCallback(const btVector3* rayFromWorld,const btVector3* rayToWorld,int numRays,btCollisionWorld::BatchedRayResult* results,short int collisionFilterGroup,short int collisionFilterMask)
+	{
+		m_packet.init(rayFromWorld,rayToWorld,numRays);
+		for (int i=0;i<numRays;i++)
+		{
+			btBatchedRayResultCallback& rayCallback = m_rayCallbacks[i];
+			rayCallback.m_rayFromWorld = rayFromWorld[i];
+			rayCallback.m_rayToWorld = rayToWorld[i];
+			rayCallback.m_result = &results[i];
+			rayCallback.m_collisionFilterGroup = collisionFilterGroup;
+			rayCallback.m_collisionFilterMask = collisionFilterMask;
+			m_rayFromTrans[i].setIdentity();
+			m_rayFromTrans[i].setOrigin(rayFromWorld[i]);
+			m_rayToTrans[i].setIdentity();
+			m_rayToTrans[i].setOrigin(rayToWorld[i]);
+			results[i].m_collisionObject = 0;
+			results[i].m_hitPointWorld = rayToWorld[i];
+			results[i].m_hitNormalWorld.setValue(0,0,0);
+			results[i].m_hitFraction = btScalar(1.);
+		}
+	}
+
+	virtual bool	process(const btBroadphaseProxy* proxy, unsigned int rayMask)
+	{
+		btCollisionObject*	collisionObject = (btCollisionObject*)proxy->m_clientObject;
+
+		//all rays of the packet use the same filter
+		if (!m_rayCallbacks[0].needsCollision(collisionObject->getBroadphaseHandle()))
+		{
+			return true;
+		}
+
+		const btCollisionShape* collisionShape = collisionObject->getCollisionShape();
+		if (collisionShape->getShapeType()==TRIANGLE_MESH_SHAPE_PROXYTYPE && (rayMask & (rayMask-1)))
+		{
+			processTriangleMesh(collisionObject,(btBvhTriangleMeshShape*)collisionShape,rayMask);
+			return true;
+		}
+
+		for (int i=0;i<btRayPacket::MAX_RAYS;i++)
+		{
+			if (rayMask & (1u<<i))
+			{
+				btBatchedRayResultCallback& rayCallback = m_rayCallbacks[i];
+				btCollisionWorld::rayTestSingle(m_rayFromTrans[i],m_rayToTrans[i],
+					collisionObject,
+					collisionShape,
+					collisionObject->getWorldTransform(),
+					rayCallback);
+				m_packet.clipRay(i,rayCallback.m_closestHitFraction);
+			}
+		}
+		return true;
+	}
+
+	///several rays hit the mesh, walk its bvh once for all of them
+	void	processTriangleMesh(const btCollisionObject* collisionObject, btBvhTriangleMeshShape* triangleMesh, unsigned int rayMask)
+	{
+		btTransform worldTocollisionObject = collisionObject->getWorldTransform().inverse();
+		btVector3 rayFromLocal[btRayPacket::MAX_RAYS];
+		btVector3 rayToLocal[btRayPacket::MAX_RAYS];
+		btBatchedTriangleRaycastCallback triangleCallbacks[btRayPacket::MAX_RAYS];
+		btTriangleRaycastCallback* triangleCallbackPtrs[btRayPacket::MAX_RAYS];
+		for (int i=0;i<m_packet.m_numRays;i++)
+		{
+			rayFromLocal[i] = worldTocollisionObject * m_packet.m_rayFromWorld[i];
+			rayToLocal[i] = worldTocollisionObject * m_packet.m_rayToWorld[i];
+		}
+		btRayPacket localPacket;
+		localPacket.init(rayFromLocal,rayToLocal,m_packet.m_numRays);
+		localPacket.m_activeMask &= rayMask;
+		for (int i=0;i<m_packet.m_numRays;i++)
+		{
+			//the transform is rigid, so distances along the rays are the same in both spaces
+			localPacket.m_lambdaMax[i] = m_packet.m_lambdaMax[i];
+			btBatchedTriangleRaycastCallback& triangleCallback = triangleCallbacks[i];
+			triangleCallback.m_from = rayFromLocal[i];
+			triangleCallback.m_to = rayToLocal[i];
+			triangleCallback.m_flags = m_rayCallbacks[i].m_flags;
+			triangleCallback.m_hitFraction = m_rayCallbacks[i].m_closestHitFraction;
+			triangleCallback.m_resultCallback = &m_rayCallbacks[i];
+			triangleCallback.m_collisionObject = collisionObject;
+			triangleCallbackPtrs[i] = &triangleCallback;
+		}
+
+		triangleMesh->performRaycastPacket(triangleCallbackPtrs,localPacket);
+
+		for (int i=0;i<m_packet.m_numRays;i++)
+		{
+			if (rayMask & (1u<<i))
+			{
+				m_packet.clipRay(i,m_rayCallbacks[i].m_closestHitFraction);
+			}
+		}
+	}
+};
+
+static int	gRayTestBatchGrainSize = 16;
+
+struct btRayTestBatchLoop : public btIParallelForBody
+{
+	btBroadphaseInterface*	m_broadphase;
+	const btVector3*	m_rayFromWorld;
+	const btVector3*	m_rayToWorld;
+	int	m_numRays;
+	btCollisionWorld::BatchedRayResult*	m_results;
+	short int	m_collisionFilterGroup;
+	short int	m_collisionFilterMask;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "rayTestBatch loop" );
+		for (int i=iBegin;i<iEnd;i++)
+		{
+			int firstRay = i*btRayPacket::MAX_RAYS;
+			int numPacketRays = btMin(int(btRayPacket::MAX_RAYS),m_numRays-firstRay);
+			btRayPacketCallback packetCallback(m_rayFromWorld+firstRay,m_rayToWorld+firstRay,numPacketRays,m_results+firstRay,m_collisionFilterGroup,m_collisionFilterMask);
+			m_broadphase->rayTestPacket(packetCallback);
+		}
+	}
+};
+
+void	btCollisionWorld::rayTestBatch(const btVector3* rayFromWorld, const btVector3* rayToWorld, int numRays, BatchedRayResult* results, short int collisionFilterGroup, short int collisionFilterMask) const
+{
+	BT_PROFILE("rayTestBatch");
+	btRayTestBatchLoop loop;
+	loop.m_broadphase = m_broadphasePairCache;
+	loop.m_rayFromWorld = rayFromWorld;
+	loop.m_rayToWorld = rayToWorld;
+	loop.m_numRays = numRays;
+	loop.m_results = results;
+	loop.m_collisionFilterGroup = collisionFilterGroup;
+	loop.m_collisionFilterMask = collisionFilterMask;
+	int numPackets = (numRays+btRayPacket::MAX_RAYS-1)/btRayPacket::MAX_RAYS;
+	btParallelFor(0,numPackets,gRayTestBatchGrainSize,loop);
+}
+
+
 struct btSingleSweepCallback : public btBroadphaseRayCallback
 {
 
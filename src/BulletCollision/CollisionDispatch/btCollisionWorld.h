@@ -105,8 +105,21 @@ protected:
 	///it is true by default, because it is error-prone (setting the position of static objects wouldn't update their AABB)
 	bool m_forceUpdateAllAabbs;
 
+	///the objects of updateAabbs, and the moved proxies with their new aabbs, handed to the broadphase in one setAabbBatch call
+	///the aabbs are kept as separate contiguous min and max arrays, filled in parallel
+	btAlignedObjectArray<btCollisionObject*>	m_aabbBatchObjects;
+	btAlignedObjectArray<btBroadphaseProxy*>	m_aabbBatchProxies;
+	btAlignedObjectArray<btVector3>	m_aabbBatchMins;
+	btAlignedObjectArray<btVector3>	m_aabbBatchMaxs;
+
 	void	serializeCollisionObjects(btSerializer* serializer);
 
+	///computes the broadphase aabb of a collision object, returns false (and disables the object) if the aabb is invalid
+	bool	calculateSingleAabb(btCollisionObject* colObj, btVector3& minAabb, btVector3& maxAabb);
+
+	///returns false (and disables the object) if the aabb is too large for a moving object
+	bool	checkSingleAabb(btCollisionObject* colObj, const btVector3& minAabb, const btVector3& maxAabb);
+
 public:
 
 	//this constructor doesn't own the dispatcher and paircache/broadphase
@@ -147,6 +160,12 @@ public:
 
 	void	updateSingleAabb(btCollisionObject* colObj);
 
+	///computes the shape aabb, expanded by the contact breaking threshold and the continuous motion.
+	///It doesn't modify anything, so it can be called for many objects in parallel (see updateAabbs).
+	///Spheres, boxes, capsules and convex hulls use the same math as their getAabb, without the virtual calls.
+	void	computeObjectAabb(const btCollisionObject* colObj, btVector3& minAabb, btVector3& maxAabb) const;
+
+	///computes the aabbs of all active objects in parallel, and passes them to the broadphase with one setAabbBatch call
 	virtual void	updateAabbs();
 
 	///the computeOverlappingPairs is usually already called by performDiscreteCollisionDetection (or stepSimulation)
@@ -273,6 +292,15 @@ public:
 		}
 	};
 
+	///BatchedRayResult is the closest hit of one ray of rayTestBatch, m_collisionObject is 0 if the ray doesn't hit anything
+	struct	BatchedRayResult
+	{
+		const btCollisionObject*	m_collisionObject;
+		btVector3	m_hitPointWorld;
+		btVector3	m_hitNormalWorld;
+		btScalar	m_hitFraction;
+	};
+
 	struct	AllHitsRayResultCallback : public RayResultCallback
 	{
 		AllHitsRayResultCallback(const btVector3&	rayFromWorld,const btVector3&	rayToWorld)
@@ -444,6 +472,11 @@ public:
 	/// This allows for several queries: first hit, all hits, any hit, dependent on the value returned by the callback.
 	virtual void rayTest(const btVector3& rayFromWorld, const btVector3& rayToWorld, RayResultCallback& resultCallback) const; 
 
+	/// rayTestBatch finds the closest hit of each ray and writes it to results, the same hits as rayTest with a ClosestRayResultCallback per ray.
+	/// Consecutive rays are traversed together as a btRayPacket, so coherent rays (a common origin, neighbouring directions) should be next to each other.
+	/// The packets are cast in parallel with btParallelFor.
+	virtual void rayTestBatch(const btVector3* rayFromWorld, const btVector3* rayToWorld, int numRays, BatchedRayResult* results, short int collisionFilterGroup=btBroadphaseProxy::DefaultFilter, short int collisionFilterMask=btBroadphaseProxy::AllFilter) const;
+
 	/// convexTest performs a swept convex cast on all objects in the btCollisionWorld, and calls the resultCallback
 	/// This allows for several queries: first hit, all hits, any hit, dependent on the value return by the callback.
 	void    convexSweepTest (const btConvexShape* castShape, const btTransform& from, const btTransform& to, ConvexResultCallback& resultCallback,  btScalar allowedCcdPenetration = btScalar(0.)) const;
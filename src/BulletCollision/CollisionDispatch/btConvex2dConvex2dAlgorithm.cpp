@@ -24,6 +24,7 @@ subject to the following restrictions:
 
 
 #include "BulletCollision/NarrowPhaseCollision/btGjkPairDetector.h"
+#include "LinearMath/btThreads.h"
 #include "BulletCollision/BroadphaseCollision/btBroadphaseProxy.h"
 #include "BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
 #include "BulletCollision/CollisionShapes/btBoxShape.h"
@@ -118,7 +119,13 @@ void btConvex2dConvex2dAlgorithm ::processCollision (const btCollisionObjectWrap
 
 		btGjkPairDetector::ClosestPointInput input;
 
+#if BT_THREADSAFE
+		//shared simplex solver is not threadsafe, see btConvexConvexAlgorithm::processCollision
+		btVoronoiSimplexSolver	simplexSolver;
+		btGjkPairDetector	gjkPairDetector(min0,min1,&simplexSolver,m_pdSolver);
+#else
 		btGjkPairDetector	gjkPairDetector(min0,min1,m_simplexSolver,m_pdSolver);
+#endif //BT_THREADSAFE
 		//TODO: if (dispatchInfo.m_useContinuous)
 		gjkPairDetector.setMinkowskiA(min0);
 		gjkPairDetector.setMinkowskiB(min1);
@@ -32,6 +32,7 @@ subject to the following restrictions:
 
 
 #include "BulletCollision/NarrowPhaseCollision/btGjkPairDetector.h"
+#include "LinearMath/btThreads.h"
 #include "BulletCollision/BroadphaseCollision/btBroadphaseProxy.h"
 #include "BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
 #include "BulletCollision/CollisionShapes/btBoxShape.h"
@@ -193,20 +194,17 @@ btConvexConvexAlgorithm::CreateFunc::~CreateFunc()
 
 btConvexConvexAlgorithm::btConvexConvexAlgorithm(btPersistentManifold* mf,const btCollisionAlgorithmConstructionInfo& ci,const btCollisionObjectWrapper* body0Wrap,const btCollisionObjectWrapper* body1Wrap,btSimplexSolverInterface* simplexSolver, btConvexPenetrationDepthSolver* pdSolver,int numPerturbationIterations, int minimumPointsPerturbationThreshold)
 : btActivatingCollisionAlgorithm(ci,body0Wrap,body1Wrap),
+m_sepDistance(body0Wrap->getCollisionShape()->getAngularMotionDisc(),
+			  body1Wrap->getCollisionShape()->getAngularMotionDisc()),
 m_simplexSolver(simplexSolver),
 m_pdSolver(pdSolver),
 m_ownManifold (false),
 m_manifoldPtr(mf),
 m_lowLevelOfDetail(false),
-#ifdef USE_SEPDISTANCE_UTIL2
-m_sepDistance((static_cast<btConvexShape*>(body0->getCollisionShape()))->getAngularMotionDisc(),
-			  (static_cast<btConvexShape*>(body1->getCollisionShape()))->getAngularMotionDisc()),
-#endif
 m_numPerturbationIterations(numPerturbationIterations),
-m_minimumPointsPerturbationThreshold(minimumPointsPerturbationThreshold)
+m_minimumPointsPerturbationThreshold(minimumPointsPerturbationThreshold),
+m_cachedSeparatingAxis(btScalar(0.),btScalar(1.),btScalar(0.))
 {
-	(void)body0Wrap;
-	(void)body1Wrap;
 }
 
 
@@ -226,6 +224,38 @@ void	btConvexConvexAlgorithm ::setLowLevelOfDetail(bool useLowLevel)
 	m_lowLevelOfDetail = useLowLevel;
 }
 
+void	btConvexConvexAlgorithm::cacheSeparatingAxis(const btVector3& separatingAxis)
+{
+	btScalar l2 = separatingAxis.length2();
+	if (l2>SIMD_EPSILON)
+	{
+		m_cachedSeparatingAxis = separatingAxis/btSqrt(l2);
+	}
+}
+
+void	btConvexConvexAlgorithm::computeClosestPoints(const btConvexShape* min0,const btConvexShape* min1,const btGjkPairDetector::ClosestPointInput& input,btDiscreteCollisionDetectorInterface::Result& output,btIDebugDraw* debugDraw,btVector3& separatingAxis)
+{
+#if BT_THREADSAFE
+	btVoronoiSimplexSolver	simplexSolver;
+	btGjkPairDetector	gjkPairDetector(min0,min1,&simplexSolver,m_pdSolver);
+#else
+	btGjkPairDetector	gjkPairDetector(min0,min1,m_simplexSolver,m_pdSolver);
+#endif //BT_THREADSAFE
+	gjkPairDetector.setCachedSeperatingAxis(separatingAxis);
+	gjkPairDetector.setWarmStart(true);
+	gjkPairDetector.getClosestPoints(input,output,debugDraw);
+	separatingAxis = gjkPairDetector.getCachedSeparatingAxis();
+}
+
+///distance between the two convex objects (including margins) along separatingAxis, which points from B to A.
+///It is a lower bound of their real distance, so a positive value proves that they are separated.
+static btScalar	btSeparationAlongAxis(const btConvexShape* convexA,const btConvexShape* convexB,const btTransform& transA,const btTransform& transB,const btVector3& separatingAxis)
+{
+	btVector3 pointOnA = transA(convexA->localGetSupportingVertex((-separatingAxis)*transA.getBasis()));
+	btVector3 pointOnB = transB(convexB->localGetSupportingVertex(separatingAxis*transB.getBasis()));
+	return separatingAxis.dot(pointOnA-pointOnB);
+}
+
 
 struct btPerturbedContactResult : public btManifoldResult
 {
@@ -336,31 +366,47 @@ void btConvexConvexAlgorithm ::processCollision (const btCollisionObjectWrapper*
 
 
 
-#ifdef USE_SEPDISTANCE_UTIL2
 	if (dispatchInfo.m_useConvexConservativeDistanceUtil)
 	{
-		m_sepDistance.updateSeparatingDistance(body0->getWorldTransform(),body1->getWorldTransform());
+		const btTransform& transA = body0Wrap->getWorldTransform();
+		const btTransform& transB = body1Wrap->getWorldTransform();
+		btScalar threshold = m_manifoldPtr->getContactBreakingThreshold()+dispatchInfo.m_convexConservativeDistanceThreshold;
+		m_sepDistance.updateSeparatingDistance(transA,transB);
+		//objects that touched in the last frame are most likely still touching, don't bother with the cached axis
+		if (m_sepDistance.getConservativeSeparatingDistance()<=threshold && m_manifoldPtr->getNumContacts()==0)
+		{
+			btScalar separation = btSeparationAlongAxis(min0,min1,transA,transB,m_cachedSeparatingAxis);
+			m_sepDistance.initSeparatingDistance(m_cachedSeparatingAxis,separation,transA,transB);
+		}
+		if (m_sepDistance.getConservativeSeparatingDistance()>threshold)
+		{
+			if (m_ownManifold)
+			{
+				resultOut->refreshContactPoints();
+			}
+			return;
+		}
 	}
 
-	if (!dispatchInfo.m_useConvexConservativeDistanceUtil || m_sepDistance.getConservativeSeparatingDistance()<=0.f)
-#endif //USE_SEPDISTANCE_UTIL2
-
 	{
 
 	
 	btGjkPairDetector::ClosestPointInput input;
 
+#if BT_THREADSAFE
+	///the simplex solver of the collision configuration is shared by all algorithms, use a private one
+	///so pairs can be processed on several threads (gjk resets the simplex on entry, so results don't change)
+	btVoronoiSimplexSolver	simplexSolver;
+	btGjkPairDetector	gjkPairDetector(min0,min1,&simplexSolver,m_pdSolver);
+#else
 	btGjkPairDetector	gjkPairDetector(min0,min1,m_simplexSolver,m_pdSolver);
+#endif //BT_THREADSAFE
 	//TODO: if (dispatchInfo.m_useContinuous)
 	gjkPairDetector.setMinkowskiA(min0);
 	gjkPairDetector.setMinkowskiB(min1);
+	gjkPairDetector.setCachedSeperatingAxis(m_cachedSeparatingAxis);
+	gjkPairDetector.setWarmStart(true);
 
-#ifdef USE_SEPDISTANCE_UTIL2
-	if (dispatchInfo.m_useConvexConservativeDistanceUtil)
-	{
-		input.m_maximumDistanceSquared = BT_LARGE_FLOAT;
-	} else
-#endif //USE_SEPDISTANCE_UTIL2
 	{
 		//if (dispatchInfo.m_convexMaxDistanceUseCPT)
 		//{
@@ -380,20 +426,6 @@ void btConvexConvexAlgorithm ::processCollision (const btCollisionObjectWrapper*
 
 	
 
-#ifdef USE_SEPDISTANCE_UTIL2
-	btScalar sepDist = 0.f;
-	if (dispatchInfo.m_useConvexConservativeDistanceUtil)
-	{
-		sepDist = gjkPairDetector.getCachedSeparatingDistance();
-		if (sepDist>SIMD_EPSILON)
-		{
-			sepDist += dispatchInfo.m_convexConservativeDistanceThreshold;
-			//now perturbe directions to get multiple contact points
-			
-		}
-	}
-#endif //USE_SEPDISTANCE_UTIL2
-
 	if (min0->isPolyhedral() && min1->isPolyhedral())
 	{
 
@@ -472,7 +504,11 @@ void btConvexConvexAlgorithm ::processCollision (const btCollisionObjectWrapper*
 					*polyhedronA->getConvexPolyhedron(), *polyhedronB->getConvexPolyhedron(),
 					body0Wrap->getWorldTransform(), 
 					body1Wrap->getWorldTransform(),
-					sepNormalWorldSpace,*resultOut);
+					sepNormalWorldSpace,*resultOut,&m_satFeatureCache);
+				if (foundSepAxis)
+				{
+					m_cachedSeparatingAxis = sepNormalWorldSpace;
+				}
 			} else
 			{
 #ifdef ZERO_MARGIN
@@ -484,6 +520,7 @@ void btConvexConvexAlgorithm ::processCollision (const btCollisionObjectWrapper*
 				gjkPairDetector.getClosestPoints(input,withoutMargin,dispatchInfo.m_debugDraw);
 				//gjkPairDetector.getClosestPoints(input,dummy,dispatchInfo.m_debugDraw);
 #endif //ZERO_MARGIN
+				cacheSeparatingAxis(gjkPairDetector.getCachedSeparatingAxis());
 				//btScalar l2 = gjkPairDetector.getCachedSeparatingAxis().length2();
 				//if (l2>SIMD_EPSILON)
 				{
@@ -505,7 +542,7 @@ void btConvexConvexAlgorithm ::processCollision (const btCollisionObjectWrapper*
 
 				btPolyhedralContactClipping::clipHullAgainstHull(sepNormalWorldSpace, *polyhedronA->getConvexPolyhedron(), *polyhedronB->getConvexPolyhedron(),
 					body0Wrap->getWorldTransform(), 
-					body1Wrap->getWorldTransform(), minDist-threshold, threshold, *resultOut);
+					body1Wrap->getWorldTransform(), minDist-threshold, threshold, m_worldVertsB1, m_worldVertsB2, *resultOut);
  				
 			}
 			if (m_ownManifold)
@@ -520,7 +557,8 @@ void btConvexConvexAlgorithm ::processCollision (const btCollisionObjectWrapper*
 			if (polyhedronA->getConvexPolyhedron() && polyhedronB->getShapeType()==TRIANGLE_SHAPE_PROXYTYPE)
 			{
 
-				btVertexArray vertices;
+				btVertexArray& vertices = m_worldVertsB1;
+				vertices.resize(0);
 				btTriangleShape* tri = (btTriangleShape*)polyhedronB;
 				vertices.push_back(	body1Wrap->getWorldTransform()*tri->m_vertices1[0]);
 				vertices.push_back(	body1Wrap->getWorldTransform()*tri->m_vertices1[1]);
@@ -553,6 +591,7 @@ void btConvexConvexAlgorithm ::processCollision (const btCollisionObjectWrapper*
 #else
 					gjkPairDetector.getClosestPoints(input,dummy,dispatchInfo.m_debugDraw);
 #endif//ZERO_MARGIN
+					cacheSeparatingAxis(gjkPairDetector.getCachedSeparatingAxis());
 					
 					btScalar l2 = gjkPairDetector.getCachedSeparatingAxis().length2();
 					if (l2>SIMD_EPSILON)
@@ -569,7 +608,7 @@ void btConvexConvexAlgorithm ::processCollision (const btCollisionObjectWrapper*
 			if (foundSepAxis)
 			{
 				btPolyhedralContactClipping::clipFaceAgainstHull(sepNormalWorldSpace, *polyhedronA->getConvexPolyhedron(), 
-					body0Wrap->getWorldTransform(), vertices, minDist-threshold, maxDist, *resultOut);
+					body0Wrap->getWorldTransform(), vertices, m_worldVertsB2, minDist-threshold, maxDist, *resultOut);
 			}
 				
 				
@@ -586,7 +625,9 @@ void btConvexConvexAlgorithm ::processCollision (const btCollisionObjectWrapper*
 
 	}
 	
-	gjkPairDetector.getClosestPoints(input,*resultOut,dispatchInfo.m_debugDraw);
+	btVector3 separatingAxis = m_cachedSeparatingAxis;
+	computeClosestPoints(min0,min1,input,*resultOut,dispatchInfo.m_debugDraw,separatingAxis);
+	cacheSeparatingAxis(separatingAxis);
 
 	//now perform 'm_numPerturbationIterations' collision queries with the perturbated collision objects
 	
@@ -597,11 +638,11 @@ void btConvexConvexAlgorithm ::processCollision (const btCollisionObjectWrapper*
 		int i;
 		btVector3 v0,v1;
 		btVector3 sepNormalWorldSpace;
-		btScalar l2 = gjkPairDetector.getCachedSeparatingAxis().length2();
+		btScalar l2 = separatingAxis.length2();
 	
 		if (l2>SIMD_EPSILON)
 		{
-			sepNormalWorldSpace = gjkPairDetector.getCachedSeparatingAxis()*(1.f/l2);
+			sepNormalWorldSpace = separatingAxis*(1.f/l2);
 			
 			btPlaneSpace1(sepNormalWorldSpace,v0,v1);
 
@@ -658,7 +699,7 @@ void btConvexConvexAlgorithm ::processCollision (const btCollisionObjectWrapper*
 				}
 				
 				btPerturbedContactResult perturbedResultOut(resultOut,input.m_transformA,input.m_transformB,unPerturbedTransform,perturbeA,dispatchInfo.m_debugDraw);
-				gjkPairDetector.getClosestPoints(input,perturbedResultOut,dispatchInfo.m_debugDraw);
+				computeClosestPoints(min0,min1,input,perturbedResultOut,dispatchInfo.m_debugDraw,separatingAxis);
 				}
 			}
 		}
@@ -666,12 +707,6 @@ void btConvexConvexAlgorithm ::processCollision (const btCollisionObjectWrapper*
 
 	
 
-#ifdef USE_SEPDISTANCE_UTIL2
-	if (dispatchInfo.m_useConvexConservativeDistanceUtil && (sepDist>SIMD_EPSILON))
-	{
-		m_sepDistance.initSeparatingDistance(gjkPairDetector.getCachedSeparatingAxis(),sepDist,body0->getWorldTransform(),body1->getWorldTransform());
-	}
-#endif //USE_SEPDISTANCE_UTIL2
 
 
 	}
@@ -21,27 +21,23 @@ subject to the following restrictions:
 #include "BulletCollision/NarrowPhaseCollision/btPersistentManifold.h"
 #include "BulletCollision/BroadphaseCollision/btBroadphaseProxy.h"
 #include "BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h"
+#include "BulletCollision/NarrowPhaseCollision/btPolyhedralContactClipping.h"
 #include "btCollisionCreateFunc.h"
 #include "btCollisionDispatcher.h"
 #include "LinearMath/btTransformUtil.h" //for btConvexSeparatingDistanceUtil
 
 class btConvexPenetrationDepthSolver;
 
-///Enabling USE_SEPDISTANCE_UTIL2 requires 100% reliable distance computation. However, when using large size ratios GJK can be imprecise
-///so the distance is not conservative. In that case, enabling this USE_SEPDISTANCE_UTIL2 would result in failing/missing collisions.
-///Either improve GJK for large size ratios (testing a 100 units versus a 0.1 unit object) or only enable the util
-///for certain pairs that have a small size ratio
-
-//#define USE_SEPDISTANCE_UTIL2 1
-
 ///The convexConvexAlgorithm collision algorithm implements time of impact, convex closest points and penetration depth calculations between two convex objects.
 ///Multiple contact points are calculated by perturbing the orientation of the smallest object orthogonal to the separating normal.
 ///This idea was described by Gino van den Bergen in this forum topic http://www.bulletphysics.com/Bullet/phpBB3/viewtopic.php?f=4&t=288&p=888#p888
+///The separating axis of the last query is cached: GJK starts from it, and when btDispatcherInfo::m_useConvexConservativeDistanceUtil is set,
+///the pair is skipped as long as the cached axis still separates the objects by more than the contact breaking threshold.
+///The distance along the axis is measured with the support functions (GJK can be imprecise for large size ratios, so its distance is not conservative),
+///and btConvexSeparatingDistanceUtil keeps it valid under the motion of the objects, so most frames of a separated pair need no support calls at all.
 class btConvexConvexAlgorithm : public btActivatingCollisionAlgorithm
 {
-#ifdef USE_SEPDISTANCE_UTIL2
 	btConvexSeparatingDistanceUtil	m_sepDistance;
-#endif
 	btSimplexSolverInterface*		m_simplexSolver;
 	btConvexPenetrationDepthSolver* m_pdSolver;
 
@@ -54,8 +50,23 @@ class btConvexConvexAlgorithm : public btActivatingCollisionAlgorithm
 	int m_minimumPointsPerturbationThreshold;
 
 
-	///cache separating vector to speedup collision detection
-	
+	///cache separating vector to speedup collision detection, it points from object B to object A
+	btVector3	m_cachedSeparatingAxis;
+
+	///the face or edge pair of the last separating axis test of the polyhedral path (btDispatcherInfo::m_enableSatConvex)
+	btSatFeatureCache	m_satFeatureCache;
+	///scratch space of the contact clipping, kept with the pair so it doesn't allocate every frame
+	btVertexArray	m_worldVertsB1;
+	btVertexArray	m_worldVertsB2;
+
+	void	cacheSeparatingAxis(const btVector3& separatingAxis);
+
+protected:
+
+	///computes the closest points of the two convex objects and reports them to output, this is the GJK/EPA query of the general (non-polyhedral) path.
+	///separatingAxis is the direction the search starts from, on return it is the separating axis found.
+	///btConvexConvexKernelAlgorithm overrides it with support functions that are known at compile time.
+	virtual void	computeClosestPoints(const btConvexShape* min0,const btConvexShape* min1,const btGjkPairDetector::ClosestPointInput& input,btDiscreteCollisionDetectorInterface::Result& output,btIDebugDraw* debugDraw,btVector3& separatingAxis);
 
 public:
 
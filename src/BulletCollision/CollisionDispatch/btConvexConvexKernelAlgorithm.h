@@ -0,0 +1,98 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_CONVEX_CONVEX_KERNEL_ALGORITHM_H
+#define BT_CONVEX_CONVEX_KERNEL_ALGORITHM_H
+
+#include "btConvexConvexAlgorithm.h"
+#include "BulletCollision/CollisionShapes/btConvexSupportKernels.h"
+#include "BulletCollision/NarrowPhaseCollision/btComputeGjkEpaPenetration.h"
+
+struct btConvexKernelDistanceInfo
+{
+	btVector3	m_pointOnA;
+	btVector3	m_pointOnB;
+	btVector3	m_normalBtoA;
+	btScalar	m_distance;
+};
+
+///btConvexConvexKernelAlgorithm is the convex-convex algorithm for a pair of shape types that are known when the algorithm is created.
+///The closest points are computed by the GJK/EPA templates of btComputeGjkEpaPenetration.h on support kernels (see btConvexSupportKernels.h),
+///so the support functions are inlined in the GJK loop instead of going through btConvexShape::localGetSupportVertexWithoutMarginNonVirtual.
+///Everything else (the separating axis cache, the polyhedral path and the perturbed contacts) is shared with btConvexConvexAlgorithm.
+///btDefaultCollisionConfiguration registers it for the pairs of spheres, boxes, capsules and convex hulls that have no dedicated algorithm.
+template <typename btSupportKernelA, typename btSupportKernelB>
+class btConvexConvexKernelAlgorithm : public btConvexConvexAlgorithm
+{
+	///where the hill climbing kernels of the two objects start, see btConvexHullSupportKernel
+	int	m_supportVertexCache[2];
+
+protected:
+
+	virtual void	computeClosestPoints(const btConvexShape* min0,const btConvexShape* min1,const btGjkPairDetector::ClosestPointInput& input,btDiscreteCollisionDetectorInterface::Result& output,btIDebugDraw* debugDraw,btVector3& separatingAxis)
+	{
+		(void)debugDraw;
+		///compute in the frame of the midpoint of the two objects, like btGjkPairDetector, to reduce numerical issues for objects far from the origin
+		btVector3 positionOffset = (input.m_transformA.getOrigin() + input.m_transformB.getOrigin()) * btScalar(0.5);
+		btTransform transA = input.m_transformA;
+		btTransform transB = input.m_transformB;
+		transA.getOrigin() -= positionOffset;
+		transB.getOrigin() -= positionOffset;
+
+		btSupportKernelA a(min0,transA);
+		btSupportKernelB b(min1,transB);
+		a.setSupportVertexCache(&m_supportVertexCache[0]);
+		b.setSupportVertexCache(&m_supportVertexCache[1]);
+
+		btGjkCollisionDescription colDesc;
+		colDesc.m_firstDir = separatingAxis;
+		colDesc.m_maximumDistanceSquared = input.m_maximumDistanceSquared;
+
+		btVoronoiSimplexSolver simplexSolver;
+		btConvexKernelDistanceInfo distInfo;
+		int result = btComputeGjkEpaPenetration(a,b,colDesc,simplexSolver,&distInfo);
+		separatingAxis = distInfo.m_normalBtoA;
+		if (result == 0)
+		{
+			output.addContactPoint(distInfo.m_normalBtoA,distInfo.m_pointOnB+positionOffset,distInfo.m_distance);
+		}
+	}
+
+public:
+
+	btConvexConvexKernelAlgorithm(btPersistentManifold* mf,const btCollisionAlgorithmConstructionInfo& ci,const btCollisionObjectWrapper* body0Wrap,const btCollisionObjectWrapper* body1Wrap, btSimplexSolverInterface* simplexSolver, btConvexPenetrationDepthSolver* pdSolver, int numPerturbationIterations, int minimumPointsPerturbationThreshold)
+		:btConvexConvexAlgorithm(mf,ci,body0Wrap,body1Wrap,simplexSolver,pdSolver,numPerturbationIterations,minimumPointsPerturbationThreshold)
+	{
+		m_supportVertexCache[0] = -1;
+		m_supportVertexCache[1] = -1;
+	}
+
+	struct CreateFunc :public 	btConvexConvexAlgorithm::CreateFunc
+	{
+		CreateFunc(btSimplexSolverInterface*			simplexSolver, btConvexPenetrationDepthSolver* pdSolver)
+			:btConvexConvexAlgorithm::CreateFunc(simplexSolver,pdSolver)
+		{
+		}
+
+		virtual	btCollisionAlgorithm* CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo& ci, const btCollisionObjectWrapper* body0Wrap,const btCollisionObjectWrapper* body1Wrap)
+		{
+			void* mem = ci.m_dispatcher1->allocateCollisionAlgorithm(sizeof(btConvexConvexKernelAlgorithm));
+			return new(mem) btConvexConvexKernelAlgorithm(ci.m_manifold,ci,body0Wrap,body1Wrap,m_simplexSolver,m_pdSolver,m_numPerturbationIterations,m_minimumPointsPerturbationThreshold);
+		}
+	};
+
+};
+
+#endif //BT_CONVEX_CONVEX_KERNEL_ALGORITHM_H
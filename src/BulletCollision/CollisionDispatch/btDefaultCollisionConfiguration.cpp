@@ -16,6 +16,7 @@ subject to the following restrictions:
 #include "btDefaultCollisionConfiguration.h"
 
 #include "BulletCollision/CollisionDispatch/btConvexConvexAlgorithm.h"
+#include "BulletCollision/CollisionDispatch/btConvexConvexKernelAlgorithm.h"
 #include "BulletCollision/CollisionDispatch/btEmptyCollisionAlgorithm.h"
 #include "BulletCollision/CollisionDispatch/btConvexConcaveCollisionAlgorithm.h"
 #include "BulletCollision/CollisionDispatch/btCompoundCollisionAlgorithm.h"
@@ -40,6 +41,48 @@ subject to the following restrictions:
 
 
 
+///the index of the support kernel of a convex shape type in m_convexKernelCF, or -1 when the shape type has none
+static int	btGetConvexKernelIndex(int proxyType)
+{
+	switch (proxyType)
+	{
+	case SPHERE_SHAPE_PROXYTYPE:
+		return 0;
+	case BOX_SHAPE_PROXYTYPE:
+		return 1;
+	case CAPSULE_SHAPE_PROXYTYPE:
+		return 2;
+	case CONVEX_HULL_SHAPE_PROXYTYPE:
+		return 3;
+	default:
+		return -1;
+	}
+}
+
+template <typename btSupportKernelA, typename btSupportKernelB>
+static btCollisionAlgorithmCreateFunc*	btNewConvexKernelCreateFunc(btVoronoiSimplexSolver* simplexSolver,btConvexPenetrationDepthSolver* pdSolver)
+{
+	typedef typename btConvexConvexKernelAlgorithm<btSupportKernelA,btSupportKernelB>::CreateFunc KernelCreateFunc;
+	void* mem = btAlignedAlloc(sizeof(KernelCreateFunc),16);
+	return new (mem) KernelCreateFunc(simplexSolver,pdSolver);
+}
+
+template <typename btSupportKernelA>
+static btCollisionAlgorithmCreateFunc*	btNewConvexKernelCreateFunc(int kernelIndexB,btVoronoiSimplexSolver* simplexSolver,btConvexPenetrationDepthSolver* pdSolver)
+{
+	switch (kernelIndexB)
+	{
+	case 0:
+		return btNewConvexKernelCreateFunc<btSupportKernelA,btSphereSupportKernel>(simplexSolver,pdSolver);
+	case 1:
+		return btNewConvexKernelCreateFunc<btSupportKernelA,btBoxSupportKernel>(simplexSolver,pdSolver);
+	case 2:
+		return btNewConvexKernelCreateFunc<btSupportKernelA,btCapsuleSupportKernel>(simplexSolver,pdSolver);
+	default:
+		return btNewConvexKernelCreateFunc<btSupportKernelA,btConvexHullSupportKernel>(simplexSolver,pdSolver);
+	}
+}
+
 btDefaultCollisionConfiguration::btDefaultCollisionConfiguration(const btDefaultCollisionConstructionInfo& constructionInfo)
 //btDefaultCollisionConfiguration::btDefaultCollisionConfiguration(btStackAlloc*	stackAlloc,btPoolAllocator*	persistentManifoldPool,btPoolAllocator*	collisionAlgorithmPool)
 {
@@ -100,9 +143,37 @@ btDefaultCollisionConfiguration::btDefaultCollisionConfiguration(const btDefault
 	mem = btAlignedAlloc (sizeof(btConvexPlaneCollisionAlgorithm::CreateFunc),16);
 	m_planeConvexCF = new (mem) btConvexPlaneCollisionAlgorithm::CreateFunc;
 	m_planeConvexCF->m_swapped = true;
+
+	///the kernels use the GJK/EPA templates, so they replace the generic algorithm only when EPA is the penetration depth solver.
+	///Sphere-sphere and box-box have dedicated algorithms, and capsule-capsule is solved analytically by btConvexConvexAlgorithm
+	for (int i=0;i<NUM_CONVEX_KERNELS;i++)
+	{
+		for (int j=0;j<NUM_CONVEX_KERNELS;j++)
+		{
+			m_convexKernelCF[i][j] = 0;
+			if (!constructionInfo.m_useEpaPenetrationAlgorithm || (i==j && i!=3))
+			{
+				continue;
+			}
+			switch (i)
+			{
+			case 0:
+				m_convexKernelCF[i][j] = btNewConvexKernelCreateFunc<btSphereSupportKernel>(j,m_simplexSolver,m_pdSolver);
+				break;
+			case 1:
+				m_convexKernelCF[i][j] = btNewConvexKernelCreateFunc<btBoxSupportKernel>(j,m_simplexSolver,m_pdSolver);
+				break;
+			case 2:
+				m_convexKernelCF[i][j] = btNewConvexKernelCreateFunc<btCapsuleSupportKernel>(j,m_simplexSolver,m_pdSolver);
+				break;
+			default:
+				m_convexKernelCF[i][j] = btNewConvexKernelCreateFunc<btConvexHullSupportKernel>(j,m_simplexSolver,m_pdSolver);
+			}
+		}
+	}
 	
 	///calculate maximum element size, big enough to fit any collision algorithm in the memory pool
-	int maxSize = sizeof(btConvexConvexAlgorithm);
+	int maxSize = sizeof(btConvexConvexKernelAlgorithm<btConvexHullSupportKernel,btConvexHullSupportKernel>);
 	int maxSize2 = sizeof(btConvexConcaveCollisionAlgorithm);
 	int maxSize3 = sizeof(btCompoundCollisionAlgorithm);
 	int maxSize4 = sizeof(btCompoundCompoundCollisionAlgorithm);
@@ -153,6 +224,18 @@ btDefaultCollisionConfiguration::~btDefaultCollisionConfiguration()
 	m_convexConvexCreateFunc->~btCollisionAlgorithmCreateFunc();
 	btAlignedFree(	m_convexConvexCreateFunc);
 
+	for (int i=0;i<NUM_CONVEX_KERNELS;i++)
+	{
+		for (int j=0;j<NUM_CONVEX_KERNELS;j++)
+		{
+			if (m_convexKernelCF[i][j])
+			{
+				m_convexKernelCF[i][j]->~btCollisionAlgorithmCreateFunc();
+				btAlignedFree(m_convexKernelCF[i][j]);
+			}
+		}
+	}
+
 	m_convexConcaveCreateFunc->~btCollisionAlgorithmCreateFunc();
 	btAlignedFree( m_convexConcaveCreateFunc);
 	m_swappedConvexConcaveCreateFunc->~btCollisionAlgorithmCreateFunc();
@@ -254,6 +337,12 @@ btCollisionAlgorithmCreateFunc* btDefaultCollisionConfiguration::getCollisionAlg
 
 	if (btBroadphaseProxy::isConvex(proxyType0) && btBroadphaseProxy::isConvex(proxyType1))
 	{
+		int kernelIndex0 = btGetConvexKernelIndex(proxyType0);
+		int kernelIndex1 = btGetConvexKernelIndex(proxyType1);
+		if (kernelIndex0>=0 && kernelIndex1>=0 && m_convexKernelCF[kernelIndex0][kernelIndex1])
+		{
+			return m_convexKernelCF[kernelIndex0][kernelIndex1];
+		}
 		return m_convexConvexCreateFunc;
 	}
 
@@ -293,6 +382,19 @@ void btDefaultCollisionConfiguration::setConvexConvexMultipointIterations(int nu
 	btConvexConvexAlgorithm::CreateFunc* convexConvex = (btConvexConvexAlgorithm::CreateFunc*) m_convexConvexCreateFunc;
 	convexConvex->m_numPerturbationIterations = numPerturbationIterations;
 	convexConvex->m_minimumPointsPerturbationThreshold = minimumPointsPerturbationThreshold;
+
+	for (int i=0;i<NUM_CONVEX_KERNELS;i++)
+	{
+		for (int j=0;j<NUM_CONVEX_KERNELS;j++)
+		{
+			convexConvex = (btConvexConvexAlgorithm::CreateFunc*) m_convexKernelCF[i][j];
+			if (convexConvex)
+			{
+				convexConvex->m_numPerturbationIterations = numPerturbationIterations;
+				convexConvex->m_minimumPointsPerturbationThreshold = minimumPointsPerturbationThreshold;
+			}
+		}
+	}
 }
 
 void	btDefaultCollisionConfiguration::setPlaneConvexMultipointIterations(int numPerturbationIterations, int minimumPointsPerturbationThreshold)
@@ -82,6 +82,11 @@ protected:
 	btCollisionAlgorithmCreateFunc*	m_triangleSphereCF;
 	btCollisionAlgorithmCreateFunc*	m_planeConvexCF;
 	btCollisionAlgorithmCreateFunc*	m_convexPlaneCF;
+
+	///convex-convex algorithms with inlined support functions, indexed by the kernel of each shape type (see btConvexConvexKernelAlgorithm).
+	///An entry is 0 when the pair uses m_convexConvexCreateFunc or a dedicated algorithm
+	enum { NUM_CONVEX_KERNELS = 4 };
+	btCollisionAlgorithmCreateFunc*	m_convexKernelCF[NUM_CONVEX_KERNELS][NUM_CONVEX_KERNELS];
 	
 public:
 
@@ -26,7 +26,8 @@ subject to the following restrictions:
 #include "LinearMath/btQuickprof.h"
 
 btSimulationIslandManager::btSimulationIslandManager():
-m_splitIslands(true)
+m_splitIslands(true),
+m_deterministicManifoldOrder(false)
 {
 }
 
@@ -199,6 +200,50 @@ class btPersistentManifoldSortPredicate
 		}
 };
 
+inline	int	getManifoldObjectId(const btCollisionObject* colObj)
+{
+	const btBroadphaseProxy* proxy = colObj->getBroadphaseHandle();
+	return proxy ? proxy->m_uniqueId : -1;
+}
+
+/// sorts by island, then by the unique ids of the two objects. Manifolds between the same objects keep the dispatcher order
+class btPersistentManifoldObjectIdSortPredicate
+{
+	public:
+
+		SIMD_FORCE_INLINE bool operator() ( const btPersistentManifold* lhs, const btPersistentManifold* rhs ) const
+		{
+			int lhsIsland = getIslandId(lhs);
+			int rhsIsland = getIslandId(rhs);
+			if (lhsIsland != rhsIsland)
+				return lhsIsland < rhsIsland;
+			int lhsId0 = getManifoldObjectId(lhs->getBody0());
+			int rhsId0 = getManifoldObjectId(rhs->getBody0());
+			if (lhsId0 != rhsId0)
+				return lhsId0 < rhsId0;
+			int lhsId1 = getManifoldObjectId(lhs->getBody1());
+			int rhsId1 = getManifoldObjectId(rhs->getBody1());
+			if (lhsId1 != rhsId1)
+				return lhsId1 < rhsId1;
+			return lhs->m_index1a < rhs->m_index1a;
+		}
+};
+
+
+void btSimulationIslandManager::sortIslandManifolds()
+{
+	//tried a radix sort, but quicksort/heapsort seems still faster
+	//@todo rewrite island management
+	if (m_deterministicManifoldOrder)
+	{
+		m_islandmanifold.quickSort(btPersistentManifoldObjectIdSortPredicate());
+	} else
+	{
+		m_islandmanifold.quickSort(btPersistentManifoldSortPredicate());
+	}
+	//m_islandmanifold.heapSort(btPersistentManifoldSortPredicate());
+}
+
 
 void btSimulationIslandManager::buildIslands(btDispatcher* dispatcher,btCollisionWorld* collisionWorld)
 {
@@ -208,6 +253,7 @@ void btSimulationIslandManager::buildIslands(btDispatcher* dispatcher,btCollisio
 	btCollisionObjectArray& collisionObjects = collisionWorld->getCollisionObjectArray();
 
 	m_islandmanifold.resize(0);
+	m_deterministicManifoldOrder = collisionWorld->getDispatchInfo().m_deterministicOrder;
 
 	//we are going to sort the unionfind array, and store the element id in the size
 	//afterwards, we clean unionfind, to make sure no-one uses it anymore
@@ -377,10 +423,7 @@ void btSimulationIslandManager::buildAndProcessIslands(btDispatcher* dispatcher,
 
 		int numManifolds = int (m_islandmanifold.size());
 
-		//tried a radix sort, but quicksort/heapsort seems still faster
-		//@todo rewrite island management
-		m_islandmanifold.quickSort(btPersistentManifoldSortPredicate());
-		//m_islandmanifold.heapSort(btPersistentManifoldSortPredicate());
+		sortIslandManifolds();
 
 		//now process all active islands (sets of manifolds for now)
 
@@ -30,12 +30,19 @@ class btPersistentManifold;
 ///SimulationIslandManager creates and handles simulation islands, using btUnionFind
 class btSimulationIslandManager
 {
+protected:
 	btUnionFind m_unionFind;
 
 	btAlignedObjectArray<btPersistentManifold*>  m_islandmanifold;
 	btAlignedObjectArray<btCollisionObject* >  m_islandBodies;
 	
 	bool m_splitIslands;
+
+	///copied from btDispatcherInfo::m_deterministicOrder by buildIslands
+	bool m_deterministicManifoldOrder;
+
+	///sorts m_islandmanifold by island, and by the unique ids of the objects within an island if m_deterministicManifoldOrder is set
+	void	sortIslandManifolds();
 	
 public:
 	btSimulationIslandManager();
@@ -17,6 +17,7 @@ subject to the following restrictions:
 
 #include "BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h"
 #include "BulletCollision/CollisionShapes/btOptimizedBvh.h"
+#include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
 #include "LinearMath/btSerializer.h"
 
 ///Bvh Concave triangle mesh is a static-triangle mesh shape with Bounding Volume Hierarchy optimization.
@@ -25,8 +26,10 @@ btBvhTriangleMeshShape::btBvhTriangleMeshShape(btStridingMeshInterface* meshInte
 :btTriangleMeshShape(meshInterface),
 m_bvh(0),
 m_triangleInfoMap(0),
+m_wideBvh(0),
 m_useQuantizedAabbCompression(useQuantizedAabbCompression),
-m_ownsBvh(false)
+m_ownsBvh(false),
+m_ownsWideBvh(false)
 {
 	m_shapeType = TRIANGLE_MESH_SHAPE_PROXYTYPE;
 	//construct bvh from meshInterface
@@ -45,8 +48,10 @@ btBvhTriangleMeshShape::btBvhTriangleMeshShape(btStridingMeshInterface* meshInte
 :btTriangleMeshShape(meshInterface),
 m_bvh(0),
 m_triangleInfoMap(0),
+m_wideBvh(0),
 m_useQuantizedAabbCompression(useQuantizedAabbCompression),
-m_ownsBvh(false)
+m_ownsBvh(false),
+m_ownsWideBvh(false)
 {
 	m_shapeType = TRIANGLE_MESH_SHAPE_PROXYTYPE;
 	//construct bvh from meshInterface
@@ -68,6 +73,10 @@ m_ownsBvh(false)
 void	btBvhTriangleMeshShape::partialRefitTree(const btVector3& aabbMin,const btVector3& aabbMax)
 {
 	m_bvh->refitPartial( m_meshInterface,aabbMin,aabbMax );
+	if (m_wideBvh && !(m_ownsWideBvh && m_wideBvh->refitPartial(*m_bvh,aabbMin,aabbMax)))
+	{
+		buildWideBvh();
+	}
 	
 	m_localAabbMin.setMin(aabbMin);
 	m_localAabbMax.setMax(aabbMax);
@@ -77,6 +86,10 @@ void	btBvhTriangleMeshShape::partialRefitTree(const btVector3& aabbMin,const btV
 void	btBvhTriangleMeshShape::refitTree(const btVector3& aabbMin,const btVector3& aabbMax)
 {
 	m_bvh->refit( m_meshInterface, aabbMin,aabbMax );
+	if (m_wideBvh)
+	{
+		buildWideBvh();
+	}
 	
 	recalcLocalAabb();
 }
@@ -88,6 +101,11 @@ btBvhTriangleMeshShape::~btBvhTriangleMeshShape()
 		m_bvh->~btOptimizedBvh();
 		btAlignedFree(m_bvh);
 	}
+	if (m_ownsWideBvh)
+	{
+		m_wideBvh->~btWideBvh();
+		btAlignedFree(m_wideBvh);
+	}
 }
 
 void	btBvhTriangleMeshShape::performRaycast (btTriangleCallback* callback, const btVector3& raySource, const btVector3& rayTarget)
@@ -156,7 +174,99 @@ void	btBvhTriangleMeshShape::performRaycast (btTriangleCallback* callback, const
 
 	MyNodeOverlapCallback	myNodeCallback(callback,m_meshInterface);
 
-	m_bvh->reportRayOverlappingNodex(&myNodeCallback,raySource,rayTarget);
+	if (m_wideBvh)
+	{
+		m_wideBvh->reportRayOverlappingNodex(&myNodeCallback,raySource,rayTarget);
+	}
+	else
+	{
+		m_bvh->reportRayOverlappingNodex(&myNodeCallback,raySource,rayTarget);
+	}
+}
+
+void	btBvhTriangleMeshShape::performRaycastPacket (btTriangleRaycastCallback** callbacks, btRayPacket& packet)
+{
+	struct	MyNodeOverlapCallback : public btRayPacketNodeOverlapCallback
+	{
+		btStridingMeshInterface*	m_meshInterface;
+		btTriangleRaycastCallback** m_callbacks;
+		btRayPacket&	m_packet;
+
+		MyNodeOverlapCallback(btTriangleRaycastCallback** callbacks,btStridingMeshInterface* meshInterface,btRayPacket& packet)
+			:m_meshInterface(meshInterface),
+			m_callbacks(callbacks),
+			m_packet(packet)
+		{
+		}
+				
+		virtual void processNode(int nodeSubPart, int nodeTriangleIndex, unsigned int rayMask)
+		{
+			btVector3 m_triangle[3];
+			const unsigned char *vertexbase;
+			int numverts;
+			PHY_ScalarType type;
+			int stride;
+			const unsigned char *indexbase;
+			int indexstride;
+			int numfaces;
+			PHY_ScalarType indicestype;
+
+			m_meshInterface->getLockedReadOnlyVertexIndexBase(
+				&vertexbase,
+				numverts,
+				type,
+				stride,
+				&indexbase,
+				indexstride,
+				numfaces,
+				indicestype,
+				nodeSubPart);
+
+			unsigned int* gfxbase = (unsigned int*)(indexbase+nodeTriangleIndex*indexstride);
+			btAssert(indicestype==PHY_INTEGER||indicestype==PHY_SHORT);
+	
+			const btVector3& meshScaling = m_meshInterface->getScaling();
+			for (int j=2;j>=0;j--)
+			{
+				int graphicsindex = indicestype==PHY_SHORT?((unsigned short*)gfxbase)[j]:gfxbase[j];
+				
+				if (type == PHY_FLOAT)
+				{
+					float* graphicsbase = (float*)(vertexbase+graphicsindex*stride);
+					
+					m_triangle[j] = btVector3(graphicsbase[0]*meshScaling.getX(),graphicsbase[1]*meshScaling.getY(),graphicsbase[2]*meshScaling.getZ());		
+				}
+				else
+				{
+					double* graphicsbase = (double*)(vertexbase+graphicsindex*stride);
+					
+					m_triangle[j] = btVector3(btScalar(graphicsbase[0])*meshScaling.getX(),btScalar(graphicsbase[1])*meshScaling.getY(),btScalar(graphicsbase[2])*meshScaling.getZ());		
+				}
+			}
+
+			/* Perform ray vs. triangle collision for each ray that hit the node */
+			for (int i=0;i<btRayPacket::MAX_RAYS;i++)
+			{
+				if (rayMask & (1u<<i))
+				{
+					m_callbacks[i]->processTriangle(m_triangle,nodeSubPart,nodeTriangleIndex);
+					m_packet.clipRay(i,m_callbacks[i]->m_hitFraction);
+				}
+			}
+			m_meshInterface->unLockReadOnlyVertexBase(nodeSubPart);
+		}
+	};
+
+	MyNodeOverlapCallback	myNodeCallback(callbacks,m_meshInterface,packet);
+
+	if (m_wideBvh)
+	{
+		m_wideBvh->reportRayPacketOverlappingNodes(&myNodeCallback,packet);
+	}
+	else
+	{
+		m_bvh->reportRayPacketOverlappingNodes(&myNodeCallback,packet);
+	}
 }
 
 void	btBvhTriangleMeshShape::performConvexcast (btTriangleCallback* callback, const btVector3& raySource, const btVector3& rayTarget, const btVector3& aabbMin, const btVector3& aabbMax)
@@ -225,7 +335,14 @@ void	btBvhTriangleMeshShape::performConvexcast (btTriangleCallback* callback, co
 
 	MyNodeOverlapCallback	myNodeCallback(callback,m_meshInterface);
 
-	m_bvh->reportBoxCastOverlappingNodex (&myNodeCallback, raySource, rayTarget, aabbMin, aabbMax);
+	if (m_wideBvh)
+	{
+		m_wideBvh->reportBoxCastOverlappingNodex (&myNodeCallback, raySource, rayTarget, aabbMin, aabbMax);
+	}
+	else
+	{
+		m_bvh->reportBoxCastOverlappingNodex (&myNodeCallback, raySource, rayTarget, aabbMin, aabbMax);
+	}
 }
 
 //perform bvh tree traversal and report overlapping triangles to 'callback'
@@ -320,7 +437,14 @@ void	btBvhTriangleMeshShape::processAllTriangles(btTriangleCallback* callback,co
 
 	MyNodeOverlapCallback	myNodeCallback(callback,m_meshInterface);
 
-	m_bvh->reportAabbOverlappingNodex(&myNodeCallback,aabbMin,aabbMax);
+	if (m_wideBvh)
+	{
+		m_wideBvh->reportAabbOverlappingNodex(&myNodeCallback,aabbMin,aabbMax);
+	}
+	else
+	{
+		m_bvh->reportAabbOverlappingNodex(&myNodeCallback,aabbMin,aabbMax);
+	}
 
 
 #endif//DISABLE_BVH
@@ -350,6 +474,34 @@ void   btBvhTriangleMeshShape::buildOptimizedBvh()
 	//rebuild the bvh...
 	m_bvh->build(m_meshInterface,m_useQuantizedAabbCompression,m_localAabbMin,m_localAabbMax);
 	m_ownsBvh = true;
+	if (m_wideBvh)
+	{
+		buildWideBvh();
+	}
+}
+
+void	btBvhTriangleMeshShape::buildWideBvh()
+{
+	btAssert(m_bvh);
+	if (!m_ownsWideBvh)
+	{
+		//a wide tree that was passed in (and maybe lives in a read only buffer) is replaced, not rebuilt in place
+		void* mem = btAlignedAlloc(sizeof(btWideBvh),16);
+		m_wideBvh = new(mem) btWideBvh();
+		m_ownsWideBvh = true;
+	}
+	m_wideBvh->build(*m_bvh);
+}
+
+void	btBvhTriangleMeshShape::setWideBvh(btWideBvh* wideBvh)
+{
+	if (m_ownsWideBvh)
+	{
+		m_wideBvh->~btWideBvh();
+		btAlignedFree(m_wideBvh);
+	}
+	m_wideBvh = wideBvh;
+	m_ownsWideBvh = false;
 }
 
 void   btBvhTriangleMeshShape::setOptimizedBvh(btOptimizedBvh* bvh, const btVector3& scaling)
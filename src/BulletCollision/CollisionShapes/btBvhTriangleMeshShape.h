@@ -18,9 +18,12 @@ subject to the following restrictions:
 
 #include "btTriangleMeshShape.h"
 #include "btOptimizedBvh.h"
+#include "BulletCollision/BroadphaseCollision/btWideBvh.h"
 #include "LinearMath/btAlignedAllocator.h"
 #include "btTriangleInfoMap.h"
 
+class btTriangleRaycastCallback;
+
 ///The btBvhTriangleMeshShape is a static-triangle mesh shape, it can only be used for fixed/non-moving objects.
 ///If you required moving concave triangle meshes, it is recommended to perform convex decomposition
 ///using HACD, see Bullet/Demos/ConvexDecompositionDemo. 
@@ -36,13 +39,15 @@ ATTRIBUTE_ALIGNED16(class) btBvhTriangleMeshShape : public btTriangleMeshShape
 
 	btOptimizedBvh*	m_bvh;
 	btTriangleInfoMap*	m_triangleInfoMap;
+	btWideBvh*	m_wideBvh;
 
 	bool m_useQuantizedAabbCompression;
 	bool m_ownsBvh;
+	bool m_ownsWideBvh;
 #ifdef __clang__
-	bool m_pad[11] __attribute__((unused));////need padding due to alignment
+	bool m_pad[10] __attribute__((unused));////need padding due to alignment
 #else
-	bool m_pad[11];////need padding due to alignment
+	bool m_pad[10];////need padding due to alignment
 #endif
 
 public:
@@ -65,6 +70,9 @@ public:
 
 	
 	void performRaycast (btTriangleCallback* callback, const btVector3& raySource, const btVector3& rayTarget);
+	///performRaycastPacket traverses the bvh once for all rays of a packet in local space, callbacks has one entry per ray of the packet.
+	///Each triangle is fetched once and passed to the callbacks of the rays that hit its node, the rays are shortened to their closest hit.
+	void performRaycastPacket (btTriangleRaycastCallback** callbacks, btRayPacket& packet);
 	void performConvexcast (btTriangleCallback* callback, const btVector3& boxSource, const btVector3& boxTarget, const btVector3& boxMin, const btVector3& boxMax);
 
 	virtual void	processAllTriangles(btTriangleCallback* callback,const btVector3& aabbMin,const btVector3& aabbMax) const;
@@ -89,6 +97,18 @@ public:
 
 	void    buildOptimizedBvh();
 
+	///buildWideBvh collapses the optimized bvh into a 4-ary btWideBvh, which is then used for all queries instead.
+	///The wide tree is rebuilt when the optimized bvh is rebuilt or refit, partialRefitTree only refits the wide nodes that overlap the box.
+	void	buildWideBvh();
+
+	///use a wide tree that was built for the current optimized bvh, for example one loaded with btWideBvh::deSerializeInPlace
+	void	setWideBvh(btWideBvh* wideBvh);
+
+	btWideBvh*	getWideBvh()
+	{
+		return m_wideBvh;
+	}
+
 	bool	usesQuantizedAabbCompression() const
 	{
 		return	m_useQuantizedAabbCompression;
@@ -22,6 +22,7 @@ subject to the following restrictions:
 
 #include "LinearMath/btQuaternion.h"
 #include "LinearMath/btSerializer.h"
+#include "LinearMath/btConvexHullComputer.h"
 
 btConvexHullShape ::btConvexHullShape (const btScalar* points,int numPoints,int stride) : btPolyhedralConvexAabbCachingShape ()
 {
@@ -52,21 +53,73 @@ void btConvexHullShape::setLocalScaling(const btVector3& scaling)
 void btConvexHullShape::addPoint(const btVector3& point, bool recalculateLocalAabb)
 {
 	m_unscaledPoints.push_back(point);
+	m_supportVertexGraph.clear();
 	if (recalculateLocalAabb)
 		recalcLocalAabb();
 
 }
 
+void	btConvexHullShape::buildSupportVertexGraph()
+{
+	m_supportVertexGraph.clear();
+	int numPoints = m_unscaledPoints.size();
+	if (numPoints < 2)
+	{
+		return;
+	}
+
+	btConvexHullComputer conv;
+	conv.compute(&m_unscaledPoints[0].getX(), sizeof(btVector3),numPoints,0.f,0.f);
+	if (conv.vertices.size()==0)
+	{
+		return;
+	}
+
+	//the hull vertices are (up to rounding) a subset of the points, map them back to the closest point
+	btAlignedObjectArray<int> pointIndices;
+	pointIndices.resize(conv.vertices.size());
+	for (int i=0;i<conv.vertices.size();i++)
+	{
+		int closest = 0;
+		btScalar closestDist2 = BT_LARGE_FLOAT;
+		for (int p=0;p<numPoints;p++)
+		{
+			btScalar dist2 = (m_unscaledPoints[p]-conv.vertices[i]).length2();
+			if (dist2 < closestDist2)
+			{
+				closestDist2 = dist2;
+				closest = p;
+				if (dist2 == btScalar(0.))
+				{
+					break;
+				}
+			}
+		}
+		pointIndices[i] = closest;
+	}
+
+	btAlignedObjectArray<int> edgeVertices;
+	edgeVertices.resize(conv.edges.size()*2);
+	for (int i=0;i<conv.edges.size();i++)
+	{
+		edgeVertices[i*2] = pointIndices[conv.edges[i].getSourceVertex()];
+		edgeVertices[i*2+1] = pointIndices[conv.edges[i].getTargetVertex()];
+	}
+	if (edgeVertices.size())
+	{
+		m_supportVertexGraph.build(&m_unscaledPoints[0],numPoints,&edgeVertices[0],conv.edges.size());
+	}
+}
+
 btVector3	btConvexHullShape::localGetSupportingVertexWithoutMargin(const btVector3& vec)const
 {
 	btVector3 supVec(btScalar(0.),btScalar(0.),btScalar(0.));
-	btScalar maxDot = btScalar(-BT_LARGE_FLOAT);
 
     // Here we take advantage of dot(a, b*c) = dot(a*b, c).  Note: This is true mathematically, but not numerically. 
     if( 0 < m_unscaledPoints.size() )
     {
         btVector3 scaled = vec * m_localScaling;
-        int index = (int) scaled.maxDot( &m_unscaledPoints[0], m_unscaledPoints.size(), maxDot); // FIXME: may violate encapsulation of m_unscaledPoints
+        int index = getSupportVertexIndex(scaled);
         return m_unscaledPoints[index] * m_localScaling;
     }
 
@@ -89,7 +142,8 @@ void	btConvexHullShape::batchedUnitVectorGetSupportingVertexWithoutMargin(const
         btVector3 vec = vectors[j] * m_localScaling;        // dot(a*b,c) = dot(a,b*c)
         if( 0 <  m_unscaledPoints.size() )
         {
-            int i = (int) vec.maxDot( &m_unscaledPoints[0], m_unscaledPoints.size(), newDot);
+            int i = getSupportVertexIndex(vec);
+            newDot = vec.dot(m_unscaledPoints[i]);
             supportVerticesOut[j] = getScaledPoint(i);
             supportVerticesOut[j][3] = newDot;        
         }
@@ -208,6 +262,15 @@ const char*	btConvexHullShape::serialize(void* dataBuffer, btSerializer* seriali
 
 void btConvexHullShape::project(const btTransform& trans, const btVector3& dir, btScalar& minProj, btScalar& maxProj, btVector3& witnesPtMin,btVector3& witnesPtMax) const
 {
+	if (useSupportVertexGraph())
+	{
+		btVector3 localAxis = (dir*trans.getBasis())*m_localScaling;
+		witnesPtMin = trans(getScaledPoint(getSupportVertexIndex(-localAxis)));
+		witnesPtMax = trans(getScaledPoint(getSupportVertexIndex(localAxis)));
+		minProj = witnesPtMin.dot(dir);
+		maxProj = witnesPtMax.dot(dir);
+		return;
+	}
 #if 1
 	minProj = FLT_MAX;
 	maxProj = -FLT_MAX;
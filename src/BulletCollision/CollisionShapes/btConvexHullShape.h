@@ -17,16 +17,20 @@ subject to the following restrictions:
 #define BT_CONVEX_HULL_SHAPE_H
 
 #include "btPolyhedralConvexShape.h"
+#include "btSupportVertexGraph.h"
 #include "BulletCollision/BroadphaseCollision/btBroadphaseProxy.h" // for the types
 #include "LinearMath/btAlignedObjectArray.h"
 
 
 ///The btConvexHullShape implements an implicit convex hull of an array of vertices.
 ///Bullet provides a general and fast collision detector for convex shapes based on GJK and EPA using localGetSupportingVertex.
+///For hulls with many points, call buildSupportVertexGraph once all points are added, so support queries climb over the hull instead of scanning all points.
 ATTRIBUTE_ALIGNED16(class) btConvexHullShape : public btPolyhedralConvexAabbCachingShape
 {
 	btAlignedObjectArray<btVector3>	m_unscaledPoints;
 
+	btSupportVertexGraph	m_supportVertexGraph;
+
 public:
 	BT_DECLARE_ALIGNED_ALLOCATOR();
 
@@ -68,6 +72,34 @@ public:
 		return m_unscaledPoints.size();
 	}
 
+	///computes the edges of the convex hull of the points, for support queries by hill climbing (see btSupportVertexGraph).
+	///addPoint removes the graph again, so call this after the last point is added
+	void	buildSupportVertexGraph();
+
+	const btSupportVertexGraph&	getSupportVertexGraph() const
+	{
+		return m_supportVertexGraph;
+	}
+
+	///true when support queries use the graph instead of a scan of all points
+	SIMD_FORCE_INLINE bool	useSupportVertexGraph() const
+	{
+		return !m_supportVertexGraph.isEmpty() && m_unscaledPoints.size() >= gSupportVertexGraphMinVertices;
+	}
+
+	///returns the index of the support point along scaledDir, which is the local direction multiplied by the local scaling.
+	///startVertex is where hill climbing starts, for example the result of a previous query of the same pair (-1 if there is none). There must be at least one point
+	SIMD_FORCE_INLINE int	getSupportVertexIndex(const btVector3& scaledDir, int startVertex=-1) const
+	{
+		btAssert(m_unscaledPoints.size());
+		if (useSupportVertexGraph())
+		{
+			return m_supportVertexGraph.findSupportVertex(&m_unscaledPoints[0],scaledDir,startVertex);
+		}
+		btScalar maxDot;
+		return (int) scaledDir.maxDot( &m_unscaledPoints[0], m_unscaledPoints.size(), maxDot);
+	}
+
 	virtual btVector3	localGetSupportingVertex(const btVector3& vec)const;
 	virtual btVector3	localGetSupportingVertexWithoutMargin(const btVector3& vec)const;
 	virtual void	batchedUnitVectorGetSupportingVertexWithoutMargin(const btVector3* vectors,btVector3* supportVerticesOut,int numVectors) const;
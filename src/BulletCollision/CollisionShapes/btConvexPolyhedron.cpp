@@ -63,11 +63,15 @@ struct btInternalEdge
 {
 	btInternalEdge()
 		:m_face0(-1),
-		m_face1(-1)
+		m_face1(-1),
+		m_uniqueEdge(-1),
+		m_planar(true)
 	{
 	}
 	short int m_face0;
 	short int m_face1;
+	int m_uniqueEdge;
+	bool m_planar;
 };
 
 //
@@ -103,6 +107,33 @@ void	btConvexPolyhedron::initialize()
 {
 
 	btHashMap<btInternalVertexPair,btInternalEdge> edges;
+	//every edge of a face loop, so each hull edge shows up once in each direction
+	btAlignedObjectArray<int> edgeVertices;
+
+	//faces merged by btPolyhedralConvexShape::initializePolyhedralFeatures aren't exactly planar, they hide the edges between the merged
+	//faces so the Gauss map of their edges isn't reliable
+	btAlignedObjectArray<bool> planarFaces;
+	{
+		btScalar scale = btScalar(0.);
+		for (int i=0;i<m_vertices.size();i++)
+		{
+			scale = btMax(scale,m_vertices[i].length2());
+		}
+		const btScalar planarTolerance = btSqrt(scale)*btScalar(1e-4);
+		planarFaces.resize(m_faces.size(),true);
+		for (int i=0;i<m_faces.size();i++)
+		{
+			const btVector3 faceNormal(m_faces[i].m_plane[0],m_faces[i].m_plane[1],m_faces[i].m_plane[2]);
+			for (int j=0;j<m_faces[i].m_indices.size();j++)
+			{
+				if (btFabs(faceNormal.dot(m_vertices[m_faces[i].m_indices[j]])+m_faces[i].m_plane[3]) > planarTolerance)
+				{
+					planarFaces[i] = false;
+					break;
+				}
+			}
+		}
+	}
 
 	btScalar TotalArea = 0.0f;
 	
@@ -114,12 +145,16 @@ void	btConvexPolyhedron::initialize()
 		for(int j=0;j<NbTris;j++)
 		{
 			int k = (j+1)%numVertices;
+			edgeVertices.push_back(m_faces[i].m_indices[j]);
+			edgeVertices.push_back(m_faces[i].m_indices[k]);
 			btInternalVertexPair vp(m_faces[i].m_indices[j],m_faces[i].m_indices[k]);
 			btInternalEdge* edptr = edges.find(vp);
 			btVector3 edge = m_vertices[vp.m_v1]-m_vertices[vp.m_v0];
 			edge.normalize();
+			const bool planar = planarFaces[i];
 
 			bool found = false;
+			int uniqueEdge = -1;
 
 			for (int p=0;p<m_uniqueEdges.size();p++)
 			{
@@ -128,12 +163,14 @@ void	btConvexPolyhedron::initialize()
 					IsAlmostZero(m_uniqueEdges[p]+edge))
 				{
 					found = true;
+					uniqueEdge = p;
 					break;
 				}
 			}
 
 			if (!found)
 			{
+				uniqueEdge = m_uniqueEdges.size();
 				m_uniqueEdges.push_back(edge);
 			}
 
@@ -142,15 +179,83 @@ void	btConvexPolyhedron::initialize()
 				btAssert(edptr->m_face0>=0);
 				btAssert(edptr->m_face1<0);
 				edptr->m_face1 = i;
+				edptr->m_planar = edptr->m_planar && planar;
 			} else
 			{
 				btInternalEdge ed;
 				ed.m_face0 = i;
+				ed.m_uniqueEdge = uniqueEdge;
+				ed.m_planar = planar;
 				edges.insert(vp,ed);
 			}
 		}
 	}
 
+	m_uniqueEdgeFaceOffsets.resize(0);
+	m_uniqueEdgeFaces.resize(0);
+	{
+		bool closed = edges.size()>0;
+		for (int i=0;i<edges.size();i++)
+		{
+			if (edges.getAtIndex(i)->m_face1<0)
+			{
+				closed = false;
+				break;
+			}
+		}
+		if (closed)
+		{
+			//a unique edge with an edge of a face that isn't planar gets no face pairs, it is never skipped
+			int numUniqueEdges = m_uniqueEdges.size();
+			btAlignedObjectArray<bool> planarUniqueEdge;
+			planarUniqueEdge.resize(numUniqueEdges,true);
+			for (int i=0;i<edges.size();i++)
+			{
+				const btInternalEdge* ed = edges.getAtIndex(i);
+				if (!ed->m_planar)
+				{
+					planarUniqueEdge[ed->m_uniqueEdge] = false;
+				}
+			}
+			m_uniqueEdgeFaceOffsets.resize(numUniqueEdges+1,0);
+			for (int i=0;i<edges.size();i++)
+			{
+				int uniqueEdge = edges.getAtIndex(i)->m_uniqueEdge;
+				if (planarUniqueEdge[uniqueEdge])
+				{
+					m_uniqueEdgeFaceOffsets[uniqueEdge+1]++;
+				}
+			}
+			for (int i=0;i<numUniqueEdges;i++)
+			{
+				m_uniqueEdgeFaceOffsets[i+1] += m_uniqueEdgeFaceOffsets[i];
+			}
+			btAlignedObjectArray<int> fill;
+			fill.resize(numUniqueEdges);
+			for (int i=0;i<numUniqueEdges;i++)
+			{
+				fill[i] = m_uniqueEdgeFaceOffsets[i];
+			}
+			m_uniqueEdgeFaces.resize(m_uniqueEdgeFaceOffsets[numUniqueEdges]*2);
+			for (int i=0;i<edges.size();i++)
+			{
+				const btInternalEdge* ed = edges.getAtIndex(i);
+				if (planarUniqueEdge[ed->m_uniqueEdge])
+				{
+					int k = fill[ed->m_uniqueEdge]++;
+					m_uniqueEdgeFaces[k*2] = ed->m_face0;
+					m_uniqueEdgeFaces[k*2+1] = ed->m_face1;
+				}
+			}
+		}
+	}
+
+	m_supportVertexGraph.clear();
+	if (edgeVertices.size())
+	{
+		m_supportVertexGraph.build(&m_vertices[0],m_vertices.size(),&edgeVertices[0],edgeVertices.size()/2);
+	}
+
 #ifdef USE_CONNECTED_FACES
 	for(int i=0;i<m_faces.size();i++)
 	{
@@ -277,6 +382,15 @@ void	btConvexPolyhedron::initialize()
 
 void btConvexPolyhedron::project(const btTransform& trans, const btVector3& dir, btScalar& minProj, btScalar& maxProj, btVector3& witnesPtMin,btVector3& witnesPtMax) const
 {
+	if (!m_supportVertexGraph.isEmpty() && m_vertices.size() >= gSupportVertexGraphMinVertices)
+	{
+		btVector3 localAxis = dir*trans.getBasis();
+		witnesPtMin = trans(m_vertices[m_supportVertexGraph.findSupportVertex(&m_vertices[0],-localAxis,-1)]);
+		witnesPtMax = trans(m_vertices[m_supportVertexGraph.findSupportVertex(&m_vertices[0],localAxis,-1)]);
+		minProj = witnesPtMin.dot(dir);
+		maxProj = witnesPtMax.dot(dir);
+		return;
+	}
 	minProj = FLT_MAX;
 	maxProj = -FLT_MAX;
 	int numVerts = m_vertices.size();
@@ -22,6 +22,7 @@ subject to the following restrictions:
 
 #include "LinearMath/btTransform.h"
 #include "LinearMath/btAlignedObjectArray.h"
+#include "btSupportVertexGraph.h"
 
 #define TEST_INTERNAL_OBJECTS 1
 
@@ -46,6 +47,12 @@ ATTRIBUTE_ALIGNED16(class) btConvexPolyhedron
 	btAlignedObjectArray<btVector3>	m_vertices;
 	btAlignedObjectArray<btFace>	m_faces;
 	btAlignedObjectArray<btVector3> m_uniqueEdges;
+	///the faces on both sides of the edges of each unique edge direction, as pairs of face indices: the pairs of unique edge i
+	///are m_uniqueEdgeFaces[2*k] and m_uniqueEdgeFaces[2*k+1] for m_uniqueEdgeFaceOffsets[i] <= k < m_uniqueEdgeFaceOffsets[i+1].
+	///btPolyhedralContactClipping::findSeparatingAxis uses them to skip edge pairs that can't form a face of the Minkowski difference.
+	///Unique edges with an edge of a face that isn't planar have no pairs. Both arrays are empty when some edge doesn't have a face on each side
+	btAlignedObjectArray<int>	m_uniqueEdgeFaceOffsets;
+	btAlignedObjectArray<int>	m_uniqueEdgeFaces;
 
 	btVector3		m_localCenter;
 	btVector3		m_extents;
@@ -53,6 +60,9 @@ ATTRIBUTE_ALIGNED16(class) btConvexPolyhedron
 	btVector3		mC;
 	btVector3		mE;
 
+	///vertex adjacency from the face loops, built by initialize. project climbs over it for large polyhedra
+	btSupportVertexGraph	m_supportVertexGraph;
+
 	void	initialize();
 	bool testContainment() const;
 
@@ -287,6 +287,11 @@ btVector3 btConvexShape::localGetSupportVertexWithoutMarginNonVirtual (const btV
 	case CONVEX_HULL_SHAPE_PROXYTYPE:
 	{
 		btConvexHullShape* convexHullShape = (btConvexHullShape*)this;
+		if (convexHullShape->useSupportVertexGraph())
+		{
+			int index = convexHullShape->getSupportVertexIndex(localDir*convexHullShape->getLocalScalingNV());
+			return convexHullShape->getScaledPoint(index);
+		}
 		btVector3* points = convexHullShape->getUnscaledPoints();
 		int numPoints = convexHullShape->getNumPoints ();
 		return convexHullSupport (localDir, points, numPoints,convexHullShape->getLocalScalingNV());
@@ -0,0 +1,242 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_CONVEX_SUPPORT_KERNELS_H
+#define BT_CONVEX_SUPPORT_KERNELS_H
+
+#include "btSphereShape.h"
+#include "btBoxShape.h"
+#include "btCapsuleShape.h"
+#include "btConvexHullShape.h"
+
+///The support kernels are support mappings of a single shape type, with the interface that the templates of
+///btComputeGjkEpaPenetration.h, btGjkEpa3.h and btMprPenetration.h expect. They copy what they need from the shape
+///when they are created, so the GJK and EPA loops run without virtual calls or switches on the shape type.
+///The margin is applied like btConvexShape::localGetSupportVertexNonVirtual does: a sphere swept around the support without margin.
+///setSupportVertexCache gives a kernel a place to keep state between queries of the same pair, only kernels that hill climb use it.
+
+SIMD_FORCE_INLINE btVector3	btSupportKernelAddMargin(const btVector3& supportWithoutMargin,const btVector3& dir,btScalar margin)
+{
+	btVector3 dirNorm = dir;
+	if (dirNorm.length2() < (SIMD_EPSILON*SIMD_EPSILON))
+	{
+		dirNorm.setValue(btScalar(-1.),btScalar(-1.),btScalar(-1.));
+	}
+	dirNorm.normalize();
+	return supportWithoutMargin + margin*dirNorm;
+}
+
+///a sphere is a point with the radius as margin
+struct btSphereSupportKernel
+{
+	btTransform	m_worldTrans;
+	btScalar	m_margin;
+
+	btSphereSupportKernel(const btConvexShape* shape,const btTransform& worldTrans)
+		:m_worldTrans(worldTrans),
+		m_margin(static_cast<const btSphereShape*>(shape)->getRadius())
+	{
+	}
+	SIMD_FORCE_INLINE void	setSupportVertexCache(int* /*cache*/)
+	{
+	}
+	SIMD_FORCE_INLINE btScalar	getMargin() const
+	{
+		return m_margin;
+	}
+	SIMD_FORCE_INLINE btVector3	getObjectCenterInWorld() const
+	{
+		return m_worldTrans.getOrigin();
+	}
+	SIMD_FORCE_INLINE const btTransform&	getWorldTransform() const
+	{
+		return m_worldTrans;
+	}
+	SIMD_FORCE_INLINE btVector3	getLocalSupportWithoutMargin(const btVector3& dir) const
+	{
+		(void)dir;
+		return btVector3(btScalar(0.),btScalar(0.),btScalar(0.));
+	}
+	SIMD_FORCE_INLINE btVector3	getLocalSupportWithMargin(const btVector3& dir) const
+	{
+		return btSupportKernelAddMargin(getLocalSupportWithoutMargin(dir),dir,m_margin);
+	}
+};
+
+///the half extents of btBoxShape::getImplicitShapeDimensions don't include the margin
+struct btBoxSupportKernel
+{
+	btTransform	m_worldTrans;
+	btVector3	m_halfExtents;
+	btScalar	m_margin;
+
+	btBoxSupportKernel(const btConvexShape* shape,const btTransform& worldTrans)
+		:m_worldTrans(worldTrans),
+		m_halfExtents(static_cast<const btBoxShape*>(shape)->getImplicitShapeDimensions()),
+		m_margin(static_cast<const btBoxShape*>(shape)->getMarginNV())
+	{
+	}
+	SIMD_FORCE_INLINE void	setSupportVertexCache(int* /*cache*/)
+	{
+	}
+	SIMD_FORCE_INLINE btScalar	getMargin() const
+	{
+		return m_margin;
+	}
+	SIMD_FORCE_INLINE btVector3	getObjectCenterInWorld() const
+	{
+		return m_worldTrans.getOrigin();
+	}
+	SIMD_FORCE_INLINE const btTransform&	getWorldTransform() const
+	{
+		return m_worldTrans;
+	}
+	SIMD_FORCE_INLINE btVector3	getLocalSupportWithoutMargin(const btVector3& dir) const
+	{
+		return btVector3(btFsels(dir.x(), m_halfExtents.x(), -m_halfExtents.x()),
+			btFsels(dir.y(), m_halfExtents.y(), -m_halfExtents.y()),
+			btFsels(dir.z(), m_halfExtents.z(), -m_halfExtents.z()));
+	}
+	SIMD_FORCE_INLINE btVector3	getLocalSupportWithMargin(const btVector3& dir) const
+	{
+		return btSupportKernelAddMargin(getLocalSupportWithoutMargin(dir),dir,m_margin);
+	}
+};
+
+///a capsule is a segment along its up axis, swept by the part of the radius that isn't margin
+struct btCapsuleSupportKernel
+{
+	btTransform	m_worldTrans;
+	btScalar	m_halfHeight;
+	btScalar	m_coreRadius;
+	btScalar	m_margin;
+	int			m_upAxis;
+
+	btCapsuleSupportKernel(const btConvexShape* shape,const btTransform& worldTrans)
+		:m_worldTrans(worldTrans)
+	{
+		const btCapsuleShape* capsule = static_cast<const btCapsuleShape*>(shape);
+		m_halfHeight = capsule->getHalfHeight();
+		m_margin = capsule->getMarginNV();
+		m_coreRadius = capsule->getRadius()-m_margin;
+		m_upAxis = capsule->getUpAxis();
+	}
+	SIMD_FORCE_INLINE void	setSupportVertexCache(int* /*cache*/)
+	{
+	}
+	SIMD_FORCE_INLINE btScalar	getMargin() const
+	{
+		return m_margin;
+	}
+	SIMD_FORCE_INLINE btVector3	getObjectCenterInWorld() const
+	{
+		return m_worldTrans.getOrigin();
+	}
+	SIMD_FORCE_INLINE const btTransform&	getWorldTransform() const
+	{
+		return m_worldTrans;
+	}
+	SIMD_FORCE_INLINE btVector3	getLocalSupportWithoutMargin(const btVector3& dir) const
+	{
+		btVector3 vec = dir;
+		btScalar lenSqr = vec.length2();
+		if (lenSqr < btScalar(0.0001))
+		{
+			vec.setValue(1,0,0);
+		} else
+		{
+			vec *= btScalar(1.) / btSqrt(lenSqr);
+		}
+		btVector3 support = vec*m_coreRadius;
+		support[m_upAxis] += vec[m_upAxis] < btScalar(0.) ? -m_halfHeight : m_halfHeight;
+		return support;
+	}
+	SIMD_FORCE_INLINE btVector3	getLocalSupportWithMargin(const btVector3& dir) const
+	{
+		return btSupportKernelAddMargin(getLocalSupportWithoutMargin(dir),dir,m_margin);
+	}
+};
+
+///the vertices of a btConvexHullShape are unscaled, the local scaling is applied to the direction and to the support point.
+///When the hull has a support vertex graph, each query climbs from the support vertex of the previous query, which is close
+///because GJK directions change little from one iteration to the next, and from one frame to the next when the pair caches the vertex
+struct btConvexHullSupportKernel
+{
+	btTransform	m_worldTrans;
+	btVector3	m_localScaling;
+	const btVector3*	m_points;
+	const btSupportVertexGraph*	m_supportVertexGraph;
+	int			m_numPoints;
+	btScalar	m_margin;
+	mutable int	m_supportVertex;
+	int*		m_supportVertexCache;
+
+	btConvexHullSupportKernel(const btConvexShape* shape,const btTransform& worldTrans)
+		:m_worldTrans(worldTrans),
+		m_supportVertex(-1),
+		m_supportVertexCache(0)
+	{
+		const btConvexHullShape* hull = static_cast<const btConvexHullShape*>(shape);
+		m_localScaling = hull->getLocalScalingNV();
+		m_points = hull->getUnscaledPoints();
+		m_numPoints = hull->getNumPoints();
+		m_margin = hull->getMarginNV();
+		m_supportVertexGraph = hull->useSupportVertexGraph() ? &hull->getSupportVertexGraph() : 0;
+	}
+	///the vertex in *cache is where the first query climbs from, and the last support vertex is stored there
+	SIMD_FORCE_INLINE void	setSupportVertexCache(int* cache)
+	{
+		m_supportVertexCache = cache;
+		m_supportVertex = *cache;
+	}
+	SIMD_FORCE_INLINE btScalar	getMargin() const
+	{
+		return m_margin;
+	}
+	SIMD_FORCE_INLINE btVector3	getObjectCenterInWorld() const
+	{
+		return m_worldTrans.getOrigin();
+	}
+	SIMD_FORCE_INLINE const btTransform&	getWorldTransform() const
+	{
+		return m_worldTrans;
+	}
+	SIMD_FORCE_INLINE btVector3	getLocalSupportWithoutMargin(const btVector3& dir) const
+	{
+		btVector3 vec = dir * m_localScaling;
+		if (m_supportVertexGraph)
+		{
+			m_supportVertex = m_supportVertexGraph->findSupportVertex(m_points,vec,m_supportVertex);
+			if (m_supportVertexCache)
+			{
+				*m_supportVertexCache = m_supportVertex;
+			}
+			return m_points[m_supportVertex] * m_localScaling;
+		}
+		btScalar maxDot;
+		long ptIndex = vec.maxDot(m_points,m_numPoints,maxDot);
+		if (ptIndex < 0)
+		{
+			return btVector3(btScalar(0.),btScalar(0.),btScalar(0.));
+		}
+		return m_points[ptIndex] * m_localScaling;
+	}
+	SIMD_FORCE_INLINE btVector3	getLocalSupportWithMargin(const btVector3& dir) const
+	{
+		return btSupportKernelAddMargin(getLocalSupportWithoutMargin(dir),dir,m_margin);
+	}
+};
+
+#endif //BT_CONVEX_SUPPORT_KERNELS_H
@@ -16,6 +16,7 @@ subject to the following restrictions:
 #include "btHeightfieldTerrainShape.h"
 
 #include "LinearMath/btTransformUtil.h"
+#include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
 
 
 
@@ -83,6 +84,7 @@ PHY_ScalarType hdt, bool flipQuadEdges
 	m_useZigzagSubdivision = false;
 	m_upAxis = upAxis;
 	m_localScaling.setValue(btScalar(1.), btScalar(1.), btScalar(1.));
+	m_mipBlockSize = 0;
 
 	// determine min/max axis-aligned bounding box (aabb) values
 	switch (m_upAxis)
@@ -354,42 +356,86 @@ void	btHeightfieldTerrainShape::processAllTriangles(btTriangleCallback* callback
 	
   
 
+	if (!m_mipLevels.size())
+	{
+		for(int j=startJ; j<endJ; j++)
+		{
+			for(int x=startX; x<endX; x++)
+			{
+				processCellTriangles(callback,x,j);
+			}
+		}
+		return;
+	}
+
+	// skip the blocks and cells that are entirely above or below the aabb, in the same order as above
+	btScalar heightMin = btMin(localAabbMin[m_upAxis],localAabbMax[m_upAxis]);
+	btScalar heightMax = btMax(localAabbMin[m_upAxis],localAabbMax[m_upAxis]);
+	btScalar heightEpsilon = btScalar(1e-5)*(m_maxHeight-m_minHeight)+btScalar(1e-4);
+	heightMin -= heightEpsilon;
+	heightMax += heightEpsilon;
 	for(int j=startJ; j<endJ; j++)
 	{
-		for(int x=startX; x<endX; x++)
+		int x=startX;
+		while (x<endX)
 		{
-			btVector3 vertices[3];
-			if (m_flipQuadEdges || (m_useDiamondSubdivision && !((j+x) & 1))|| (m_useZigzagSubdivision  && !(j & 1)))
+			int blockX = x/m_mipBlockSize;
+			const btScalar* blockMinMax = getMipMinMax(0,blockX,j/m_mipBlockSize);
+			if (blockMinMax[0] > heightMax || blockMinMax[1] < heightMin)
+			{
+				x = (blockX+1)*m_mipBlockSize;
+				continue;
+			}
+			btScalar cellMin,cellMax;
+			getCellMinMax(x,j,cellMin,cellMax);
+			if (cellMin <= heightMax && cellMax >= heightMin)
 			{
-        //first triangle
-        getVertex(x,j,vertices[0]);
+				processCellTriangles(callback,x,j);
+			}
+			x++;
+		}
+	}
+}
+
+void	btHeightfieldTerrainShape::processCellTriangles(btTriangleCallback* callback,int x,int j) const
+{
+	btVector3 vertices[3];
+	if (m_flipQuadEdges || (m_useDiamondSubdivision && !((j+x) & 1))|| (m_useZigzagSubdivision  && !(j & 1)))
+	{
+		//first triangle
+		getVertex(x,j,vertices[0]);
 		getVertex(x, j + 1, vertices[1]);
 		getVertex(x + 1, j + 1, vertices[2]);
-        callback->processTriangle(vertices,x,j);
-        //second triangle
-      //  getVertex(x,j,vertices[0]);//already got this vertex before, thanks to Danny Chapman
-        getVertex(x+1,j+1,vertices[1]);
+		callback->processTriangle(vertices,x,j);
+		//second triangle
+		//  getVertex(x,j,vertices[0]);//already got this vertex before, thanks to Danny Chapman
+		getVertex(x+1,j+1,vertices[1]);
 		getVertex(x + 1, j, vertices[2]);
 		callback->processTriangle(vertices, x, j);
 
-			} else
-			{
-        //first triangle
-        getVertex(x,j,vertices[0]);
-        getVertex(x,j+1,vertices[1]);
-        getVertex(x+1,j,vertices[2]);
-        callback->processTriangle(vertices,x,j);
-        //second triangle
-        getVertex(x+1,j,vertices[0]);
-        //getVertex(x,j+1,vertices[1]);
-        getVertex(x+1,j+1,vertices[2]);
-        callback->processTriangle(vertices,x,j);
-			}
-		}
+	} else
+	{
+		//first triangle
+		getVertex(x,j,vertices[0]);
+		getVertex(x,j+1,vertices[1]);
+		getVertex(x+1,j,vertices[2]);
+		callback->processTriangle(vertices,x,j);
+		//second triangle
+		getVertex(x+1,j,vertices[0]);
+		//getVertex(x,j+1,vertices[1]);
+		getVertex(x+1,j+1,vertices[2]);
+		callback->processTriangle(vertices,x,j);
 	}
+}
 
-	
-
+void	btHeightfieldTerrainShape::getCellMinMax(int x,int y,btScalar& minHeight,btScalar& maxHeight) const
+{
+	btScalar h00 = getRawHeightFieldValue(x,y);
+	btScalar h10 = getRawHeightFieldValue(x+1,y);
+	btScalar h01 = getRawHeightFieldValue(x,y+1);
+	btScalar h11 = getRawHeightFieldValue(x+1,y+1);
+	minHeight = btMin(btMin(h00,h10),btMin(h01,h11));
+	maxHeight = btMax(btMax(h00,h10),btMax(h01,h11));
 }
 
 void	btHeightfieldTerrainShape::calculateLocalInertia(btScalar ,btVector3& inertia) const
@@ -407,3 +453,307 @@ const btVector3& btHeightfieldTerrainShape::getLocalScaling() const
 {
 	return m_localScaling;
 }
+
+
+
+void	btHeightfieldTerrainShape::buildMinMaxMips(int blockSize)
+{
+	btAssert(blockSize > 0);
+	m_mipBlockSize = blockSize;
+	m_mipLevels.resize(0);
+
+	int numCellsX = m_heightStickWidth-1;
+	int numCellsY = m_heightStickLength-1;
+	MinMaxMipLevel level;
+	level.m_width = (numCellsX+blockSize-1)/blockSize;
+	level.m_length = (numCellsY+blockSize-1)/blockSize;
+	level.m_offset = 0;
+	m_mipLevels.push_back(level);
+	while (level.m_width > 1 || level.m_length > 1)
+	{
+		level.m_offset += level.m_width*level.m_length;
+		level.m_width = (level.m_width+1)/2;
+		level.m_length = (level.m_length+1)/2;
+		m_mipLevels.push_back(level);
+	}
+	m_mipMinMax.resize(2*(level.m_offset+1));
+
+	updateMinMaxMips(0,0,numCellsX,numCellsY);
+}
+
+void	btHeightfieldTerrainShape::updateMinMaxMips(int startX,int startY,int endX,int endY)
+{
+	btAssert(m_mipLevels.size());
+	int numCellsX = m_heightStickWidth-1;
+	int numCellsY = m_heightStickLength-1;
+
+	// a grid point is a corner of the cells on both sides of it
+	int blockStartX = btMax(startX-1,0)/m_mipBlockSize;
+	int blockStartY = btMax(startY-1,0)/m_mipBlockSize;
+	int blockEndX = btMin(endX,numCellsX-1)/m_mipBlockSize;
+	int blockEndY = btMin(endY,numCellsY-1)/m_mipBlockSize;
+
+	for (int j=blockStartY;j<=blockEndY;j++)
+	{
+		for (int i=blockStartX;i<=blockEndX;i++)
+		{
+			int lastX = btMin((i+1)*m_mipBlockSize,numCellsX);
+			int lastY = btMin((j+1)*m_mipBlockSize,numCellsY);
+			btScalar minHeight = getRawHeightFieldValue(i*m_mipBlockSize,j*m_mipBlockSize);
+			btScalar maxHeight = minHeight;
+			for (int y=j*m_mipBlockSize;y<=lastY;y++)
+			{
+				for (int x=i*m_mipBlockSize;x<=lastX;x++)
+				{
+					btScalar height = getRawHeightFieldValue(x,y);
+					minHeight = btMin(minHeight,height);
+					maxHeight = btMax(maxHeight,height);
+				}
+			}
+			btScalar* minMax = (btScalar*)getMipMinMax(0,i,j);
+			minMax[0] = minHeight;
+			minMax[1] = maxHeight;
+		}
+	}
+
+	for (int levelIndex=1;levelIndex<m_mipLevels.size();levelIndex++)
+	{
+		const MinMaxMipLevel& childLevel = m_mipLevels[levelIndex-1];
+		blockStartX /= 2;
+		blockStartY /= 2;
+		blockEndX /= 2;
+		blockEndY /= 2;
+		for (int j=blockStartY;j<=blockEndY;j++)
+		{
+			for (int i=blockStartX;i<=blockEndX;i++)
+			{
+				const btScalar* childMinMax = getMipMinMax(levelIndex-1,2*i,2*j);
+				btScalar minHeight = childMinMax[0];
+				btScalar maxHeight = childMinMax[1];
+				for (int child=1;child<4;child++)
+				{
+					int childX = 2*i+(child&1);
+					int childY = 2*j+(child>>1);
+					if (childX < childLevel.m_width && childY < childLevel.m_length)
+					{
+						childMinMax = getMipMinMax(levelIndex-1,childX,childY);
+						minHeight = btMin(minHeight,childMinMax[0]);
+						maxHeight = btMax(maxHeight,childMinMax[1]);
+					}
+				}
+				btScalar* minMax = (btScalar*)getMipMinMax(levelIndex,i,j);
+				minMax[0] = minHeight;
+				minMax[1] = maxHeight;
+			}
+		}
+	}
+}
+
+
+///the ray in raw heightfield coordinates: grid x, grid y and raw height. The ray parameter is the same as in local space.
+struct btHeightfieldRaycastInfo
+{
+	btTriangleRaycastCallback*	m_callback;
+	btScalar	m_from[3];
+	btScalar	m_direction[3];
+	btScalar	m_directionInverse[2];
+	btScalar	m_heightEpsilon;
+
+	///clips [tMin,tMax] to the part of the ray above the grid rectangle, returns false if it misses
+	bool	clipToRect(btScalar minX,btScalar minY,btScalar maxX,btScalar maxY,btScalar& tMin,btScalar& tMax) const
+	{
+		// a little slack, so rays along the border between two blocks visit both of them
+		const btScalar epsilon = btScalar(1e-4);
+		btScalar rectMin[2] = {minX-epsilon,minY-epsilon};
+		btScalar rectMax[2] = {maxX+epsilon,maxY+epsilon};
+		for (int axis=0;axis<2;axis++)
+		{
+			if (m_direction[axis] == btScalar(0.))
+			{
+				if (m_from[axis] < rectMin[axis] || m_from[axis] > rectMax[axis])
+				{
+					return false;
+				}
+				continue;
+			}
+			btScalar t1 = (rectMin[axis]-m_from[axis])*m_directionInverse[axis];
+			btScalar t2 = (rectMax[axis]-m_from[axis])*m_directionInverse[axis];
+			tMin = btMax(tMin,btMin(t1,t2));
+			tMax = btMin(tMax,btMax(t1,t2));
+		}
+		return tMin <= tMax;
+	}
+
+	///returns true if the ray between tMin and tMax can touch heights between minHeight and maxHeight
+	bool	overlapsHeights(btScalar tMin,btScalar tMax,btScalar minHeight,btScalar maxHeight) const
+	{
+		btScalar h0 = m_from[2]+m_direction[2]*tMin;
+		btScalar h1 = m_from[2]+m_direction[2]*tMax;
+		return btMax(h0,h1) >= minHeight-m_heightEpsilon && btMin(h0,h1) <= maxHeight+m_heightEpsilon;
+	}
+};
+
+void	btHeightfieldTerrainShape::performRaycast(btTriangleRaycastCallback* callback,const btVector3& raySource,const btVector3& rayTarget) const
+{
+	if (!m_mipLevels.size())
+	{
+		btVector3 rayAabbMin = raySource;
+		rayAabbMin.setMin(rayTarget);
+		btVector3 rayAabbMax = raySource;
+		rayAabbMax.setMax(rayTarget);
+		processAllTriangles(callback,rayAabbMin,rayAabbMax);
+		return;
+	}
+
+	// same conversion as in processAllTriangles
+	btVector3 invScaling(btScalar(1.)/m_localScaling[0],btScalar(1.)/m_localScaling[1],btScalar(1.)/m_localScaling[2]);
+	btVector3 from = raySource*invScaling+m_localOrigin;
+	btVector3 to = rayTarget*invScaling+m_localOrigin;
+
+	int gridAxisX = m_upAxis==0 ? 1 : 0;
+	int gridAxisY = m_upAxis==2 ? 1 : 2;
+	int axes[3] = {gridAxisX,gridAxisY,m_upAxis};
+
+	btHeightfieldRaycastInfo ray;
+	ray.m_callback = callback;
+	for (int i=0;i<3;i++)
+	{
+		ray.m_from[i] = from[axes[i]];
+		ray.m_direction[i] = to[axes[i]]-from[axes[i]];
+	}
+	for (int i=0;i<2;i++)
+	{
+		ray.m_directionInverse[i] = ray.m_direction[i] == btScalar(0.) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.)/ray.m_direction[i];
+	}
+	ray.m_heightEpsilon = btScalar(1e-5)*(m_maxHeight-m_minHeight)+btScalar(1e-4);
+
+	btScalar tMin = btScalar(0.);
+	btScalar tMax = btMin(btScalar(1.),callback->m_hitFraction);
+	int rootLevel = m_mipLevels.size()-1;
+	if (ray.clipToRect(0,0,m_width,m_length,tMin,tMax))
+	{
+		raycastMipNode(ray,rootLevel,0,0,tMin,tMax);
+	}
+}
+
+void	btHeightfieldTerrainShape::raycastMipNode(const btHeightfieldRaycastInfo& ray,int level,int i,int j,btScalar tMin,btScalar tMax) const
+{
+	tMax = btMin(tMax,ray.m_callback->m_hitFraction);
+	if (tMin > tMax)
+	{
+		return;
+	}
+	const btScalar* minMax = getMipMinMax(level,i,j);
+	if (!ray.overlapsHeights(tMin,tMax,minMax[0],minMax[1]))
+	{
+		return;
+	}
+	if (level == 0)
+	{
+		raycastBlock(ray,i,j,tMin,tMax);
+		return;
+	}
+
+	// visit the children in the order the ray enters them
+	const MinMaxMipLevel& childLevel = m_mipLevels[level-1];
+	const int childSize = m_mipBlockSize<<(level-1);
+	int children[4][2];
+	btScalar childTMin[4];
+	btScalar childTMax[4];
+	int numChildren = 0;
+	for (int child=0;child<4;child++)
+	{
+		int childX = 2*i+(child&1);
+		int childY = 2*j+(child>>1);
+		if (childX >= childLevel.m_width || childY >= childLevel.m_length)
+		{
+			continue;
+		}
+		btScalar t0 = tMin;
+		btScalar t1 = tMax;
+		btScalar minX = btScalar(childX*childSize);
+		btScalar minY = btScalar(childY*childSize);
+		btScalar maxX = btMin(btScalar((childX+1)*childSize),m_width);
+		btScalar maxY = btMin(btScalar((childY+1)*childSize),m_length);
+		if (!ray.clipToRect(minX,minY,maxX,maxY,t0,t1))
+		{
+			continue;
+		}
+		int k = numChildren++;
+		while (k > 0 && childTMin[k-1] > t0)
+		{
+			children[k][0] = children[k-1][0];
+			children[k][1] = children[k-1][1];
+			childTMin[k] = childTMin[k-1];
+			childTMax[k] = childTMax[k-1];
+			k--;
+		}
+		children[k][0] = childX;
+		children[k][1] = childY;
+		childTMin[k] = t0;
+		childTMax[k] = t1;
+	}
+	for (int k=0;k<numChildren;k++)
+	{
+		raycastMipNode(ray,level-1,children[k][0],children[k][1],childTMin[k],childTMax[k]);
+	}
+}
+
+///walks the cells of a block along the ray (2D DDA), tMin/tMax are the part of the ray above the block
+void	btHeightfieldTerrainShape::raycastBlock(const btHeightfieldRaycastInfo& ray,int i,int j,btScalar tMin,btScalar tMax) const
+{
+	int startX = i*m_mipBlockSize;
+	int startY = j*m_mipBlockSize;
+	int endX = btMin(startX+m_mipBlockSize,m_heightStickWidth-1);
+	int endY = btMin(startY+m_mipBlockSize,m_heightStickLength-1);
+
+	int cell[2];
+	int step[2];
+	int cellStart[2] = {startX,startY};
+	int cellEnd[2] = {endX,endY};
+	btScalar tNext[2];
+	for (int axis=0;axis<2;axis++)
+	{
+		btScalar position = ray.m_from[axis]+ray.m_direction[axis]*tMin;
+		cell[axis] = btMax(cellStart[axis],btMin(int(position),cellEnd[axis]-1));
+		step[axis] = ray.m_direction[axis] > btScalar(0.) ? 1 : (ray.m_direction[axis] < btScalar(0.) ? -1 : 0);
+	}
+
+	btScalar t = tMin;
+	for (;;)
+	{
+		for (int axis=0;axis<2;axis++)
+		{
+			if (step[axis])
+			{
+				int boundary = step[axis] > 0 ? cell[axis]+1 : cell[axis];
+				tNext[axis] = (btScalar(boundary)-ray.m_from[axis])*ray.m_directionInverse[axis];
+			}
+			else
+			{
+				tNext[axis] = btScalar(BT_LARGE_FLOAT);
+			}
+		}
+		btScalar tEnd = btMin(btMin(tNext[0],tNext[1]),tMax);
+
+		btScalar cellMin,cellMax;
+		getCellMinMax(cell[0],cell[1],cellMin,cellMax);
+		if (ray.overlapsHeights(t,tEnd,cellMin,cellMax))
+		{
+			processCellTriangles(ray.m_callback,cell[0],cell[1]);
+			tMax = btMin(tMax,ray.m_callback->m_hitFraction);
+		}
+		if (tEnd >= tMax)
+		{
+			break;
+		}
+
+		int axis = tNext[0] < tNext[1] ? 0 : 1;
+		cell[axis] += step[axis];
+		if (cell[axis] < cellStart[axis] || cell[axis] >= cellEnd[axis])
+		{
+			break;
+		}
+		t = tNext[axis];
+	}
+}
@@ -17,6 +17,10 @@ subject to the following restrictions:
 #define BT_HEIGHTFIELD_TERRAIN_SHAPE_H
 
 #include "btConcaveShape.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+class btTriangleRaycastCallback;
+struct btHeightfieldRaycastInfo;
 
 ///btHeightfieldTerrainShape simulates a 2D heightfield terrain
 /**
@@ -66,6 +70,12 @@ subject to the following restrictions:
   or maximum heights.  These values are used to determine the heightfield's
   axis-aligned bounding box, multiplied by localScaling.
 
+  buildMinMaxMips builds min/max height mips over blocks of cells. With them,
+  performRaycast walks the grid front to back and skips blocks and cells the ray
+  passes above or below, and processAllTriangles skips the cells outside the
+  height range of the query aabb. They are a snapshot of the heights, so call
+  updateMinMaxMips for the changed region after modifying the heightfield.
+
   For usage and testing see the TerrainDemo.
  */
 ATTRIBUTE_ALIGNED16(class) btHeightfieldTerrainShape : public btConcaveShape
@@ -100,10 +110,35 @@ protected:
 	
 	btVector3	m_localScaling;
 
+	///level 0 of the min/max mips has an entry per block of m_mipBlockSize x m_mipBlockSize cells,
+	///each further level halves both dimensions, down to a single entry for the whole heightfield
+	struct MinMaxMipLevel
+	{
+		int	m_width;
+		int	m_length;
+		int	m_offset;	///< first entry of the level in m_mipMinMax
+	};
+	btAlignedObjectArray<MinMaxMipLevel>	m_mipLevels;
+	btAlignedObjectArray<btScalar>	m_mipMinMax;	///< minimum and maximum raw height per entry
+	int	m_mipBlockSize;
+
 	virtual btScalar	getRawHeightFieldValue(int x,int y) const;
 	void		quantizeWithClamp(int* out, const btVector3& point,int isMax) const;
 	void		getVertex(int x,int y,btVector3& vertex) const;
 
+	///reports the two triangles of the cell between grid points x,y and x+1,y+1
+	void		processCellTriangles(btTriangleCallback* callback,int x,int y) const;
+	void		getCellMinMax(int x,int y,btScalar& minHeight,btScalar& maxHeight) const;
+
+	const btScalar*	getMipMinMax(int level,int i,int j) const
+	{
+		const MinMaxMipLevel& mipLevel = m_mipLevels[level];
+		return &m_mipMinMax[2*(mipLevel.m_offset+j*mipLevel.m_width+i)];
+	}
+
+	void		raycastMipNode(const btHeightfieldRaycastInfo& ray,int level,int i,int j,btScalar tMin,btScalar tMax) const;
+	void		raycastBlock(const btHeightfieldRaycastInfo& ray,int i,int j,btScalar tMin,btScalar tMax) const;
+
 
 
 	/// protected initialization
@@ -153,6 +188,21 @@ public:
 
 	virtual void	processAllTriangles(btTriangleCallback* callback,const btVector3& aabbMin,const btVector3& aabbMax) const;
 
+	///performRaycast reports the triangles along the ray (in local space) to callback, nearest first, and stops beyond callback->m_hitFraction.
+	///Without min/max mips it falls back to processAllTriangles with the aabb of the ray.
+	void	performRaycast(btTriangleRaycastCallback* callback,const btVector3& raySource,const btVector3& rayTarget) const;
+
+	///builds the min/max mips for the whole heightfield, see the class description
+	void	buildMinMaxMips(int blockSize=8);
+
+	///refreshes the min/max mips after the heights of grid points startX..endX, startY..endY (inclusive) changed
+	void	updateMinMaxMips(int startX,int startY,int endX,int endY);
+
+	bool	hasMinMaxMips() const
+	{
+		return m_mipLevels.size()!=0;
+	}
+
 	virtual void	calculateLocalInertia(btScalar mass,btVector3& inertia) const;
 
 	virtual void	setLocalScaling(const btVector3& scaling);
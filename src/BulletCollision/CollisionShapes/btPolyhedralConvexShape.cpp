@@ -314,6 +314,19 @@ bool	btPolyhedralConvexShape::initializePolyhedralFeatures(int shiftVerticesByMa
 	
 	m_polyhedron->initialize();
 
+	//merged faces can leave vertices out of the face loops, so the support vertex graph uses the edges of the hull itself
+	if (conv.edges.size())
+	{
+		btAlignedObjectArray<int> edgeVertices;
+		edgeVertices.resize(conv.edges.size()*2);
+		for (int i=0;i<conv.edges.size();i++)
+		{
+			edgeVertices[i*2] = conv.edges[i].getSourceVertex();
+			edgeVertices[i*2+1] = conv.edges[i].getTargetVertex();
+		}
+		m_polyhedron->m_supportVertexGraph.build(&m_polyhedron->m_vertices[0],m_polyhedron->m_vertices.size(),&edgeVertices[0],conv.edges.size());
+	}
+
 	return true;
 }
 
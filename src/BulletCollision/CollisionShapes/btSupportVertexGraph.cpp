@@ -0,0 +1,168 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btSupportVertexGraph.h"
+
+int gSupportVertexGraphMinVertices = 32;
+
+
+struct btSupportGraphEdge
+{
+	int	m_from;
+	int	m_to;
+};
+
+struct btSupportGraphEdgeSortPredicate
+{
+	bool operator() ( const btSupportGraphEdge& a, const btSupportGraphEdge& b ) const
+	{
+		return a.m_from < b.m_from || (a.m_from == b.m_from && a.m_to < b.m_to);
+	}
+};
+
+
+btSupportVertexGraph::btSupportVertexGraph()
+{
+	for (int i=0;i<6;i++)
+	{
+		m_seeds[i] = 0;
+	}
+}
+
+void	btSupportVertexGraph::clear()
+{
+	m_neighborOffsets.clear();
+	m_neighbors.clear();
+}
+
+void	btSupportVertexGraph::build(const btVector3* vertices, int numVertices, const int* edgeVertices, int numEdges)
+{
+	clear();
+
+	btAlignedObjectArray<btSupportGraphEdge> edges;
+	edges.reserve(numEdges*2);
+	for (int i=0;i<numEdges;i++)
+	{
+		int v0 = edgeVertices[i*2];
+		int v1 = edgeVertices[i*2+1];
+		btAssert(v0>=0 && v0<numVertices && v1>=0 && v1<numVertices);
+		if (v0 == v1)
+		{
+			continue;
+		}
+		btSupportGraphEdge& e0 = edges.expand();
+		e0.m_from = v0;
+		e0.m_to = v1;
+		btSupportGraphEdge& e1 = edges.expand();
+		e1.m_from = v1;
+		e1.m_to = v0;
+	}
+	if (edges.size()==0)
+	{
+		return;
+	}
+	edges.quickSort(btSupportGraphEdgeSortPredicate());
+
+	m_neighborOffsets.resize(numVertices+1);
+	m_neighbors.reserve(edges.size());
+	int edgeIndex = 0;
+	for (int v=0;v<numVertices;v++)
+	{
+		m_neighborOffsets[v] = m_neighbors.size();
+		for (;edgeIndex<edges.size() && edges[edgeIndex].m_from==v;edgeIndex++)
+		{
+			// edges given in both directions show up twice
+			if (m_neighbors.size()>m_neighborOffsets[v] && m_neighbors[m_neighbors.size()-1]==edges[edgeIndex].m_to)
+			{
+				continue;
+			}
+			m_neighbors.push_back(edges[edgeIndex].m_to);
+		}
+	}
+	m_neighborOffsets[numVertices] = m_neighbors.size();
+
+	// the extremes along +x,-x,+y,-y,+z,-z, among the vertices on the hull
+	btScalar seedDots[6];
+	for (int i=0;i<6;i++)
+	{
+		seedDots[i] = -BT_LARGE_FLOAT;
+	}
+	for (int v=0;v<numVertices;v++)
+	{
+		if (m_neighborOffsets[v]==m_neighborOffsets[v+1])
+		{
+			continue;
+		}
+		for (int axis=0;axis<3;axis++)
+		{
+			btScalar c = vertices[v][axis];
+			if (c > seedDots[axis*2])
+			{
+				seedDots[axis*2] = c;
+				m_seeds[axis*2] = v;
+			}
+			if (-c > seedDots[axis*2+1])
+			{
+				seedDots[axis*2+1] = -c;
+				m_seeds[axis*2+1] = v;
+			}
+		}
+	}
+}
+
+int	btSupportVertexGraph::findSupportVertex(const btVector3* vertices, const btVector3& dir, int startVertex) const
+{
+	btAssert(!isEmpty());
+	int current = startVertex;
+	if (current<0 || current>=getNumVertices() || m_neighborOffsets[current]==m_neighborOffsets[current+1])
+	{
+		current = m_seeds[0];
+		btScalar bestDot = vertices[current].dot(dir);
+		for (int i=1;i<6;i++)
+		{
+			btScalar d = vertices[m_seeds[i]].dot(dir);
+			if (d > bestDot)
+			{
+				bestDot = d;
+				current = m_seeds[i];
+			}
+		}
+	}
+
+	// steepest ascent, the dot product strictly increases with every step so this terminates
+	btScalar currentDot = vertices[current].dot(dir);
+	for (;;)
+	{
+		int best = current;
+		btScalar bestDot = currentDot;
+		int end = m_neighborOffsets[current+1];
+		for (int i=m_neighborOffsets[current];i<end;i++)
+		{
+			int neighbor = m_neighbors[i];
+			btScalar d = vertices[neighbor].dot(dir);
+			if (d > bestDot)
+			{
+				bestDot = d;
+				best = neighbor;
+			}
+		}
+		if (best == current)
+		{
+			return current;
+		}
+		current = best;
+		currentDot = bestDot;
+	}
+}
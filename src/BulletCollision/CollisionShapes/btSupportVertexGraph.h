@@ -0,0 +1,63 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SUPPORT_VERTEX_GRAPH_H
+#define BT_SUPPORT_VERTEX_GRAPH_H
+
+#include "LinearMath/btVector3.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+///hulls with fewer vertices than this use the btVector3::maxDot scan, which is faster than hill climbing for small vertex counts
+extern int gSupportVertexGraphMinVertices;
+
+///btSupportVertexGraph is the vertex adjacency of a convex polytope, for support vertex queries by hill climbing.
+///The search starts at some vertex and moves to the neighbour that is furthest along the direction, until no neighbour is further.
+///On the vertices of a convex polytope a linear function has no other local maximum, so that vertex is the support vertex.
+///A query only visits the vertices along a path over the hull, so it is much cheaper than a scan of all vertices for large hulls,
+///in particular when it starts at the support vertex of a previous, similar direction (see btConvexHullSupportKernel).
+///Without such a start vertex, the search starts at the best of the six vertices that are extreme along the local axes.
+class btSupportVertexGraph
+{
+	///the neighbours of vertex i are m_neighbors[m_neighborOffsets[i]] up to m_neighbors[m_neighborOffsets[i+1]]
+	btAlignedObjectArray<int>	m_neighborOffsets;
+	btAlignedObjectArray<int>	m_neighbors;
+	int	m_seeds[6];
+
+public:
+
+	btSupportVertexGraph();
+
+	void	clear();
+
+	///edgeVertices holds numEdges pairs of vertex indices. An edge can be given once or in both directions.
+	///Vertices without edges (points inside the hull) are never returned by findSupportVertex
+	void	build(const btVector3* vertices, int numVertices, const int* edgeVertices, int numEdges);
+
+	bool	isEmpty() const
+	{
+		return m_neighbors.size()==0;
+	}
+
+	int	getNumVertices() const
+	{
+		return m_neighborOffsets.size() ? m_neighborOffsets.size()-1 : 0;
+	}
+
+	///returns the index of the vertex that is furthest along dir. vertices must be the array the graph was built for.
+	///startVertex is the vertex the search starts from, -1 (or a vertex that is not on the hull) starts at the best seed vertex
+	int	findSupportVertex(const btVector3* vertices, const btVector3& dir, int startVertex) const;
+};
+
+#endif //BT_SUPPORT_VERTEX_GRAPH_H
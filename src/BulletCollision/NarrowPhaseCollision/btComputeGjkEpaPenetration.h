@@ -26,8 +26,8 @@ subject to the following restrictions:
 
 
 
-template <typename btConvexTemplate>
-bool btGjkEpaCalcPenDepth(const btConvexTemplate& a, const btConvexTemplate& b,
+template <typename btConvexTemplateA, typename btConvexTemplateB>
+bool btGjkEpaCalcPenDepth(const btConvexTemplateA& a, const btConvexTemplateB& b,
                           const btGjkCollisionDescription& colDesc,
                           btVector3& v, btVector3& wWitnessOnA, btVector3& wWitnessOnB)
 {
@@ -62,12 +62,11 @@ bool btGjkEpaCalcPenDepth(const btConvexTemplate& a, const btConvexTemplate& b,
     return false;
 }
 
-template <typename btConvexTemplate, typename btGjkDistanceTemplate>
-int	btComputeGjkEpaPenetration(const btConvexTemplate& a, const btConvexTemplate& b, const btGjkCollisionDescription& colDesc, btVoronoiSimplexSolver& simplexSolver, btGjkDistanceTemplate* distInfo)
+template <typename btConvexTemplateA, typename btConvexTemplateB, typename btGjkDistanceTemplate>
+int	btComputeGjkEpaPenetration(const btConvexTemplateA& a, const btConvexTemplateB& b, const btGjkCollisionDescription& colDesc, btVoronoiSimplexSolver& simplexSolver, btGjkDistanceTemplate* distInfo)
 {
     
     bool m_catchDegeneracies  = true;
-    btScalar m_cachedSeparatingDistance = 0.f;
     
     btScalar distance=btScalar(0.);
     btVector3	normalInB(btScalar(0.),btScalar(0.),btScalar(0.));
@@ -353,13 +352,14 @@ int	btComputeGjkEpaPenetration(const btConvexTemplate& a, const btConvexTemplate
     {
         
         m_cachedSeparatingAxis = normalInB;
-        m_cachedSeparatingDistance = distance;
         distInfo->m_distance = distance;
         distInfo->m_normalBtoA = normalInB;
         distInfo->m_pointOnB = pointOnB;
         distInfo->m_pointOnA = pointOnB+normalInB*distance;
         return 0;
     }
+    ///no contact: the last search direction is still a good first direction for the next query of this pair
+    distInfo->m_normalBtoA = m_cachedSeparatingAxis;
     return -m_lastUsedMethod;
 }
 
@@ -88,11 +88,11 @@ struct	sResults
     typedef unsigned char	U1;
     
     // MinkowskiDiff
-    template <typename btConvexTemplate>
+    template <typename btConvexTemplateA, typename btConvexTemplateB>
     struct	MinkowskiDiff
     {
-        const btConvexTemplate* m_convexAPtr;
-        const btConvexTemplate* m_convexBPtr;
+        const btConvexTemplateA* m_convexAPtr;
+        const btConvexTemplateB* m_convexBPtr;
         
         btMatrix3x3				m_toshape1;
         btTransform				m_toshape0;
@@ -100,7 +100,7 @@ struct	sResults
         bool					m_enableMargin;
         
         
-        MinkowskiDiff(const btConvexTemplate& a, const btConvexTemplate& b)
+        MinkowskiDiff(const btConvexTemplateA& a, const btConvexTemplateB& b)
         :m_convexAPtr(&a),
         m_convexBPtr(&b)
         {
@@ -141,7 +141,7 @@ enum	eGjkStatus
 };
 
     // GJK
-    template <typename btConvexTemplate>
+    template <typename btConvexTemplateA, typename btConvexTemplateB>
     struct	GJK
     {
         /* Types		*/
@@ -158,7 +158,7 @@ enum	eGjkStatus
         
         /* Fields		*/
         
-        MinkowskiDiff<btConvexTemplate>			m_shape;
+        MinkowskiDiff<btConvexTemplateA,btConvexTemplateB>			m_shape;
         btVector3		m_ray;
         btScalar		m_distance;
         sSimplex		m_simplices[2];
@@ -170,7 +170,7 @@ enum	eGjkStatus
         eGjkStatus      m_status;
         /* Methods		*/
         
-        GJK(const btConvexTemplate& a, const btConvexTemplate& b)
+        GJK(const btConvexTemplateA& a, const btConvexTemplateB& b)
         :m_shape(a,b)
         {
             Initialize();
@@ -183,7 +183,7 @@ enum	eGjkStatus
             m_current	=	0;
             m_distance	=	0;
         }
-        eGjkStatus			Evaluate(const MinkowskiDiff<btConvexTemplate>& shapearg,const btVector3& guess)
+        eGjkStatus			Evaluate(const MinkowskiDiff<btConvexTemplateA,btConvexTemplateB>& shapearg,const btVector3& guess)
         {
             U			iterations=0;
             btScalar	sqdist=0;
@@ -522,7 +522,7 @@ enum	eEpaStatus
 
 
     // EPA
-template <typename btConvexTemplate>
+template <typename btConvexTemplateA, typename btConvexTemplateB>
     struct	EPA
     {
         /* Types		*/
@@ -531,7 +531,7 @@ template <typename btConvexTemplate>
         {
             btVector3	n;
             btScalar	d;
-            typename GJK<btConvexTemplate>::sSV*		c[3];
+            typename GJK<btConvexTemplateA,btConvexTemplateB>::sSV*		c[3];
             sFace*		f[3];
             sFace*		l[2];
             U1			e[3];
@@ -553,10 +553,10 @@ template <typename btConvexTemplate>
        
         /* Fields		*/
         eEpaStatus		m_status;
-        typename GJK<btConvexTemplate>::sSimplex	m_result;
+        typename GJK<btConvexTemplateA,btConvexTemplateB>::sSimplex	m_result;
         btVector3		m_normal;
         btScalar		m_depth;
-        typename GJK<btConvexTemplate>::sSV				m_sv_store[EPA_MAX_VERTICES];
+        typename GJK<btConvexTemplateA,btConvexTemplateB>::sSV				m_sv_store[EPA_MAX_VERTICES];
         sFace			m_fc_store[EPA_MAX_FACES];
         U				m_nextsv;
         sList			m_hull;
@@ -601,9 +601,9 @@ template <typename btConvexTemplate>
                 append(m_stock,&m_fc_store[EPA_MAX_FACES-i-1]);
             }
         }
-        eEpaStatus			Evaluate(GJK<btConvexTemplate>& gjk,const btVector3& guess)
+        eEpaStatus			Evaluate(GJK<btConvexTemplateA,btConvexTemplateB>& gjk,const btVector3& guess)
         {
-            typename GJK<btConvexTemplate>::sSimplex&	simplex=*gjk.m_simplex;
+            typename GJK<btConvexTemplateA,btConvexTemplateB>::sSimplex&	simplex=*gjk.m_simplex;
             if((simplex.rank>1)&&gjk.EncloseOrigin())
             {
                 
@@ -647,7 +647,7 @@ template <typename btConvexTemplate>
                         if(m_nextsv<EPA_MAX_VERTICES)
                         {
                             sHorizon		horizon;
-                            typename GJK<btConvexTemplate>::sSV*			w=&m_sv_store[m_nextsv++];
+                            typename GJK<btConvexTemplateA,btConvexTemplateB>::sSV*			w=&m_sv_store[m_nextsv++];
                             bool			valid=true;
                             best->pass	=	(U1)(++pass);
                             gjk.getsupport(best->n,*w);
@@ -705,7 +705,7 @@ template <typename btConvexTemplate>
             m_result.p[0]=1;
             return(m_status);
         }
-        bool getedgedist(sFace* face, typename GJK<btConvexTemplate>::sSV* a, typename GJK<btConvexTemplate>::sSV* b, btScalar& dist)
+        bool getedgedist(sFace* face, typename GJK<btConvexTemplateA,btConvexTemplateB>::sSV* a, typename GJK<btConvexTemplateA,btConvexTemplateB>::sSV* b, btScalar& dist)
         {
             const btVector3 ba = b->w - a->w;
             const btVector3 n_ab = btCross(ba, face->n); // Outward facing edge normal direction, on triangle plane
@@ -741,7 +741,7 @@ template <typename btConvexTemplate>
             
             return false;
         }
-        sFace*				newface(typename GJK<btConvexTemplate>::sSV* a,typename GJK<btConvexTemplate>::sSV* b,typename GJK<btConvexTemplate>::sSV* c,bool forced)
+        sFace*				newface(typename GJK<btConvexTemplateA,btConvexTemplateB>::sSV* a,typename GJK<btConvexTemplateA,btConvexTemplateB>::sSV* b,typename GJK<btConvexTemplateA,btConvexTemplateB>::sSV* c,bool forced)
         {
             if(m_stock.root)
             {
@@ -801,7 +801,7 @@ template <typename btConvexTemplate>
             }
             return(minf);
         }
-        bool				expand(U pass,typename GJK<btConvexTemplate>::sSV* w,sFace* f,U e,sHorizon& horizon)
+        bool				expand(U pass,typename GJK<btConvexTemplateA,btConvexTemplateB>::sSV* w,sFace* f,U e,sHorizon& horizon)
         {
             static const U	i1m3[]={1,2,0};
             static const U	i2m3[]={2,0,1};
@@ -838,10 +838,10 @@ template <typename btConvexTemplate>
         
     };
     
-    template <typename btConvexTemplate>
-    static void	Initialize(	const btConvexTemplate& a, const btConvexTemplate& b,
+    template <typename btConvexTemplateA, typename btConvexTemplateB>
+    static void	Initialize(	const btConvexTemplateA& a, const btConvexTemplateB& b,
                            btGjkEpaSolver3::sResults& results,
-                           MinkowskiDiff<btConvexTemplate>& shape)
+                           MinkowskiDiff<btConvexTemplateA,btConvexTemplateB>& shape)
     {
         /* Results		*/ 
         results.witnesses[0]	=
@@ -862,14 +862,14 @@ template <typename btConvexTemplate>
 
 
 //
-template <typename btConvexTemplate>
-bool		btGjkEpaSolver3_Distance(const btConvexTemplate& a, const btConvexTemplate& b,
+template <typename btConvexTemplateA, typename btConvexTemplateB>
+bool		btGjkEpaSolver3_Distance(const btConvexTemplateA& a, const btConvexTemplateB& b,
                                       const btVector3& guess,
                                       btGjkEpaSolver3::sResults& results)
 {
-    MinkowskiDiff<btConvexTemplate>			shape(a,b);
+    MinkowskiDiff<btConvexTemplateA,btConvexTemplateB>			shape(a,b);
     Initialize(a,b,results,shape);
-    GJK<btConvexTemplate>				gjk(a,b);
+    GJK<btConvexTemplateA,btConvexTemplateB>				gjk(a,b);
     eGjkStatus	gjk_status=gjk.Evaluate(shape,guess);
     if(gjk_status==eGjkValid)
     {
@@ -898,21 +898,21 @@ bool		btGjkEpaSolver3_Distance(const btConvexTemplate& a, const btConvexTemplate
 }
 
 
-template <typename btConvexTemplate>
-bool	btGjkEpaSolver3_Penetration(const btConvexTemplate& a,
-                                     const btConvexTemplate& b,
+template <typename btConvexTemplateA, typename btConvexTemplateB>
+bool	btGjkEpaSolver3_Penetration(const btConvexTemplateA& a,
+                                     const btConvexTemplateB& b,
                                      const btVector3& guess,
                                      btGjkEpaSolver3::sResults& results)
 {
-    MinkowskiDiff<btConvexTemplate>			shape(a,b);
+    MinkowskiDiff<btConvexTemplateA,btConvexTemplateB>			shape(a,b);
     Initialize(a,b,results,shape);
-    GJK<btConvexTemplate>				gjk(a,b);
+    GJK<btConvexTemplateA,btConvexTemplateB>				gjk(a,b);
     eGjkStatus	gjk_status=gjk.Evaluate(shape,-guess);
     switch(gjk_status)
     {
         case	eGjkInside:
         {
-            EPA<btConvexTemplate>				epa;
+            EPA<btConvexTemplateA,btConvexTemplateB>				epa;
             eEpaStatus	epa_status=epa.Evaluate(gjk,-guess);
             if(epa_status!=eEpaFailed)
             {
@@ -989,8 +989,8 @@ int	btComputeGjkEpaPenetration2(const btCollisionDescription& colDesc, btDistanc
 }
 #endif
 
-template <typename btConvexTemplate, typename btDistanceInfoTemplate>
-int	btComputeGjkDistance(const btConvexTemplate& a, const btConvexTemplate& b,
+template <typename btConvexTemplateA, typename btConvexTemplateB, typename btDistanceInfoTemplate>
+int	btComputeGjkDistance(const btConvexTemplateA& a, const btConvexTemplateB& b,
                          const btGjkCollisionDescription& colDesc, btDistanceInfoTemplate* distInfo)
 {
     btGjkEpaSolver3::sResults results;
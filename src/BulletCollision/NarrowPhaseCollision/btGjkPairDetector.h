@@ -42,6 +42,7 @@ class btGjkPairDetector : public btDiscreteCollisionDetectorInterface
 	btScalar	m_marginB;
 
 	bool		m_ignoreMargin;
+	bool		m_warmStart;
 	btScalar	m_cachedSeparatingDistance;
 	
 
@@ -77,6 +78,13 @@ public:
 		m_cachedSeparatingAxis = seperatingAxis;
 	}
 
+	///with warm start, getClosestPoints starts its search from the cached separating axis (see setCachedSeperatingAxis)
+	///instead of a fixed direction. Seeding it with the axis of the previous frame saves most iterations for coherent motion.
+	void	setWarmStart(bool warmStart)
+	{
+		m_warmStart = warmStart;
+	}
+
 	const btVector3& getCachedSeparatingAxis() const
 	{
 		return m_cachedSeparatingAxis;
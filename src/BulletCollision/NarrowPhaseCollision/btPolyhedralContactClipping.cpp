@@ -27,6 +27,7 @@ subject to the following restrictions:
 int gExpectedNbTests=0;
 int gActualNbTests = 0;
 bool gUseInternalObject = true;
+bool gUseGaussMapPruning = true;
 
 // Clips a face to the back of a plane
 void btPolyhedralContactClipping::clipFace(const btVertexArray& pVtxIn, btVertexArray& ppVtxOut, const btVector3& planeNormalWS,btScalar planeEqWS)
@@ -237,134 +238,231 @@ void InverseTransformPoint3x3(btVector3& out, const btVector3& in, const btTrans
 
 
 
-bool btPolyhedralContactClipping::findSeparatingAxis(	const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA,const btTransform& transB, btVector3& sep, btDiscreteCollisionDetectorInterface::Result& resultOut)
+///Gauss map test of Dirk Gregorius: the edge between the faces with normals a and b and the edge between the faces with normals c and d
+///form a face of the Minkowski difference when their arcs on the unit sphere intersect. c and d are the normals of the second hull negated.
+///Arcs that only touch count as intersecting, so the degenerate cases are tested like before
+static SIMD_FORCE_INLINE bool btIsMinkowskiFace(const btVector3& a, const btVector3& b, const btVector3& c, const btVector3& d)
 {
-	gActualSATPairTests++;
-
-//#ifdef TEST_INTERNAL_OBJECTS
-	const btVector3 c0 = transA * hullA.m_localCenter;
-	const btVector3 c1 = transB * hullB.m_localCenter;
-	const btVector3 DeltaC2 = c0 - c1;
-//#endif
-
-	btScalar dmin = FLT_MAX;
-	int curPlaneTests=0;
+	const btVector3 bxa = b.cross(a);
+	const btVector3 dxc = d.cross(c);
+	const btScalar cba = c.dot(bxa);
+	const btScalar dba = d.dot(bxa);
+	const btScalar adc = a.dot(dxc);
+	const btScalar bdc = b.dot(dxc);
+	return cba*dba <= btScalar(0.) && adc*bdc <= btScalar(0.) && cba*bdc >= btScalar(0.);
+}
 
-	int numFacesA = hullA.m_faces.size();
-	// Test normals from hullA
-	for(int i=0;i<numFacesA;i++)
+///the state of one separating axis test of two hulls, so the cached feature is tested the same way as the faces and edge pairs in the loops
+struct btSeparatingAxisQuery
+{
+	const btConvexPolyhedron&	m_hullA;
+	const btConvexPolyhedron&	m_hullB;
+	const btTransform&	m_transA;
+	const btTransform&	m_transB;
+	btVector3	m_deltaC2;
+	btScalar	m_dmin;
+	btVector3	m_sep;
+	btSatFeatureCache	m_minFeature;
+	btSatFeatureCache	m_separatingFeature;
+	btVector3	m_witnessPointA;
+	btVector3	m_witnessPointB;
+
+	btSeparatingAxisQuery(const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA,const btTransform& transB, const btVector3& sep)
+		:m_hullA(hullA),
+		m_hullB(hullB),
+		m_transA(transA),
+		m_transB(transB),
+		m_dmin(FLT_MAX),
+		m_sep(sep),
+		m_witnessPointA(0,0,0),
+		m_witnessPointB(0,0,0)
 	{
-		const btVector3 Normal(hullA.m_faces[i].m_plane[0], hullA.m_faces[i].m_plane[1], hullA.m_faces[i].m_plane[2]);
-		btVector3 faceANormalWS = transA.getBasis() * Normal;
-		if (DeltaC2.dot(faceANormalWS)<0)
-			faceANormalWS*=-1.f;
+		const btVector3 c0 = transA * hullA.m_localCenter;
+		const btVector3 c1 = transB * hullB.m_localCenter;
+		m_deltaC2 = c0 - c1;
+	}
 
-		curPlaneTests++;
+	///returns false if the axis separates the hulls
+	bool	testAxis(const btVector3& axis, int featureType, int index0, int index1)
+	{
 #ifdef TEST_INTERNAL_OBJECTS
 		gExpectedNbTests++;
-		if(gUseInternalObject && !TestInternalObjects(transA,transB, DeltaC2, faceANormalWS, hullA, hullB, dmin))
-			continue;
+		if(gUseInternalObject && !TestInternalObjects(m_transA,m_transB,m_deltaC2, axis, m_hullA, m_hullB, m_dmin))
+			return true;
 		gActualNbTests++;
 #endif
 
 		btScalar d;
 		btVector3 wA,wB;
-		if(!TestSepAxis( hullA, hullB, transA,transB, faceANormalWS, d,wA,wB))
+		if(!TestSepAxis( m_hullA, m_hullB, m_transA,m_transB, axis, d,wA,wB))
+		{
+			m_separatingFeature.m_type = featureType;
+			m_separatingFeature.m_index0 = index0;
+			m_separatingFeature.m_index1 = index1;
 			return false;
+		}
 
-		if(d<dmin)
+		if(d<m_dmin)
 		{
-			dmin = d;
-			sep = faceANormalWS;
+			m_dmin = d;
+			m_sep = axis;
+			m_minFeature.m_type = featureType;
+			m_minFeature.m_index0 = index0;
+			m_minFeature.m_index1 = index1;
+			m_witnessPointA = wA;
+			m_witnessPointB = wB;
 		}
+		return true;
 	}
 
-	int numFacesB = hullB.m_faces.size();
-	// Test normals from hullB
-	for(int i=0;i<numFacesB;i++)
+	bool	testFaceA(int i)
 	{
-		const btVector3 Normal(hullB.m_faces[i].m_plane[0], hullB.m_faces[i].m_plane[1], hullB.m_faces[i].m_plane[2]);
-		btVector3 WorldNormal = transB.getBasis() * Normal;
-		if (DeltaC2.dot(WorldNormal)<0)
+		const btVector3 Normal(m_hullA.m_faces[i].m_plane[0], m_hullA.m_faces[i].m_plane[1], m_hullA.m_faces[i].m_plane[2]);
+		btVector3 faceANormalWS = m_transA.getBasis() * Normal;
+		if (m_deltaC2.dot(faceANormalWS)<0)
+			faceANormalWS*=-1.f;
+		return testAxis(faceANormalWS,btSatFeatureCache::SAT_FACE_A,i,-1);
+	}
+
+	bool	testFaceB(int i)
+	{
+		const btVector3 Normal(m_hullB.m_faces[i].m_plane[0], m_hullB.m_faces[i].m_plane[1], m_hullB.m_faces[i].m_plane[2]);
+		btVector3 WorldNormal = m_transB.getBasis() * Normal;
+		if (m_deltaC2.dot(WorldNormal)<0)
 			WorldNormal *=-1.f;
+		return testAxis(WorldNormal,btSatFeatureCache::SAT_FACE_B,i,-1);
+	}
 
-		curPlaneTests++;
-#ifdef TEST_INTERNAL_OBJECTS
-		gExpectedNbTests++;
-		if(gUseInternalObject && !TestInternalObjects(transA,transB,DeltaC2, WorldNormal, hullA, hullB, dmin))
-			continue;
-		gActualNbTests++;
-#endif
+	bool	testEdges(int e0, int e1)
+	{
+		const btVector3 WorldEdge0 = m_transA.getBasis() * m_hullA.m_uniqueEdges[e0];
+		const btVector3 WorldEdge1 = m_transB.getBasis() * m_hullB.m_uniqueEdges[e1];
+
+		btVector3 Cross = WorldEdge0.cross(WorldEdge1);
+		if(IsAlmostZero(Cross))
+			return true;
+		Cross = Cross.normalize();
+		if (m_deltaC2.dot(Cross)<0)
+			Cross *= -1.f;
+		return testAxis(Cross,btSatFeatureCache::SAT_EDGE_EDGE,e0,e1);
+	}
 
-		btScalar d;
-		btVector3 wA,wB;
-		if(!TestSepAxis(hullA, hullB,transA,transB, WorldNormal,d,wA,wB))
+	bool	testFeature(const btSatFeatureCache& feature)
+	{
+		switch (feature.m_type)
+		{
+		case btSatFeatureCache::SAT_FACE_A:
+			return feature.m_index0>=m_hullA.m_faces.size() || testFaceA(feature.m_index0);
+		case btSatFeatureCache::SAT_FACE_B:
+			return feature.m_index0>=m_hullB.m_faces.size() || testFaceB(feature.m_index0);
+		case btSatFeatureCache::SAT_EDGE_EDGE:
+			return feature.m_index0>=m_hullA.m_uniqueEdges.size() || feature.m_index1>=m_hullB.m_uniqueEdges.size() || testEdges(feature.m_index0,feature.m_index1);
+		default:
+			return true;
+		}
+	}
+
+	static bool	isFeature(const btSatFeatureCache& feature, int featureType, int index0, int index1)
+	{
+		return feature.m_type==featureType && feature.m_index0==index0 && feature.m_index1==index1;
+	}
+};
+
+///relBasis takes the normals of hull B to the frame of hull A. Unique edges without face pairs can't be skipped
+static bool btIsMinkowskiEdgePair(const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btMatrix3x3& relBasis, int e0, int e1)
+{
+	if (hullA.m_uniqueEdgeFaceOffsets[e0]==hullA.m_uniqueEdgeFaceOffsets[e0+1] || hullB.m_uniqueEdgeFaceOffsets[e1]==hullB.m_uniqueEdgeFaceOffsets[e1+1])
+		return true;
+	for (int i=hullA.m_uniqueEdgeFaceOffsets[e0];i<hullA.m_uniqueEdgeFaceOffsets[e0+1];i++)
+	{
+		const btFace& faceA0 = hullA.m_faces[hullA.m_uniqueEdgeFaces[i*2]];
+		const btFace& faceA1 = hullA.m_faces[hullA.m_uniqueEdgeFaces[i*2+1]];
+		const btVector3 a(faceA0.m_plane[0],faceA0.m_plane[1],faceA0.m_plane[2]);
+		const btVector3 b(faceA1.m_plane[0],faceA1.m_plane[1],faceA1.m_plane[2]);
+		for (int j=hullB.m_uniqueEdgeFaceOffsets[e1];j<hullB.m_uniqueEdgeFaceOffsets[e1+1];j++)
+		{
+			const btFace& faceB0 = hullB.m_faces[hullB.m_uniqueEdgeFaces[j*2]];
+			const btFace& faceB1 = hullB.m_faces[hullB.m_uniqueEdgeFaces[j*2+1]];
+			const btVector3 c = -(relBasis * btVector3(faceB0.m_plane[0],faceB0.m_plane[1],faceB0.m_plane[2]));
+			const btVector3 d = -(relBasis * btVector3(faceB1.m_plane[0],faceB1.m_plane[1],faceB1.m_plane[2]));
+			if (btIsMinkowskiFace(a,b,c,d))
+				return true;
+		}
+	}
+	return false;
+}
+
+bool btPolyhedralContactClipping::findSeparatingAxis(	const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA,const btTransform& transB, btVector3& sep, btDiscreteCollisionDetectorInterface::Result& resultOut, btSatFeatureCache* featureCache)
+{
+	gActualSATPairTests++;
+
+	btSeparatingAxisQuery query(hullA,hullB,transA,transB,sep);
+	const btVector3& DeltaC2 = query.m_deltaC2;
+
+	// Test the feature of the previous call first, it usually still separates the hulls
+	btSatFeatureCache cachedFeature;
+	if (featureCache)
+	{
+		cachedFeature = *featureCache;
+		if (!query.testFeature(cachedFeature))
 			return false;
+	}
 
-		if(d<dmin)
+	int numFacesA = hullA.m_faces.size();
+	// Test normals from hullA
+	for(int i=0;i<numFacesA;i++)
+	{
+		if (btSeparatingAxisQuery::isFeature(cachedFeature,btSatFeatureCache::SAT_FACE_A,i,-1))
+			continue;
+		if (!query.testFaceA(i))
 		{
-			dmin = d;
-			sep = WorldNormal;
+			if (featureCache)
+				*featureCache = query.m_separatingFeature;
+			return false;
 		}
 	}
 
-	btVector3 edgeAstart,edgeAend,edgeBstart,edgeBend;
-	int edgeA=-1;
-	int edgeB=-1;
-	btVector3 worldEdgeA;
-	btVector3 worldEdgeB;
-	btVector3 witnessPointA(0,0,0),witnessPointB(0,0,0);
-	
+	int numFacesB = hullB.m_faces.size();
+	// Test normals from hullB
+	for(int i=0;i<numFacesB;i++)
+	{
+		if (btSeparatingAxisQuery::isFeature(cachedFeature,btSatFeatureCache::SAT_FACE_B,i,-1))
+			continue;
+		if (!query.testFaceB(i))
+		{
+			if (featureCache)
+				*featureCache = query.m_separatingFeature;
+			return false;
+		}
+	}
+
+	const bool useGaussMap = gUseGaussMapPruning && hullA.m_uniqueEdgeFaceOffsets.size() && hullB.m_uniqueEdgeFaceOffsets.size();
+	const btMatrix3x3 relBasis = transA.getBasis().transposeTimes(transB.getBasis());
 
-	int curEdgeEdge = 0;
 	// Test edges
 	for(int e0=0;e0<hullA.m_uniqueEdges.size();e0++)
 	{
-		const btVector3 edge0 = hullA.m_uniqueEdges[e0];
-		const btVector3 WorldEdge0 = transA.getBasis() * edge0;
 		for(int e1=0;e1<hullB.m_uniqueEdges.size();e1++)
 		{
-			const btVector3 edge1 = hullB.m_uniqueEdges[e1];
-			const btVector3 WorldEdge1 = transB.getBasis() * edge1;
-
-			btVector3 Cross = WorldEdge0.cross(WorldEdge1);
-			curEdgeEdge++;
-			if(!IsAlmostZero(Cross))
+			if (btSeparatingAxisQuery::isFeature(cachedFeature,btSatFeatureCache::SAT_EDGE_EDGE,e0,e1))
+				continue;
+			if (useGaussMap && !btIsMinkowskiEdgePair(hullA,hullB,relBasis,e0,e1))
+				continue;
+			if (!query.testEdges(e0,e1))
 			{
-				Cross = Cross.normalize();
-				if (DeltaC2.dot(Cross)<0)
-					Cross *= -1.f;
-
-
-#ifdef TEST_INTERNAL_OBJECTS
-				gExpectedNbTests++;
-				if(gUseInternalObject && !TestInternalObjects(transA,transB,DeltaC2, Cross, hullA, hullB, dmin))
-					continue;
-				gActualNbTests++;
-#endif
-
-				btScalar dist;
-				btVector3 wA,wB;
-				if(!TestSepAxis( hullA, hullB, transA,transB, Cross, dist,wA,wB))
-					return false;
-
-				if(dist<dmin)
-				{
-					dmin = dist;
-					sep = Cross;
-					edgeA=e0;
-					edgeB=e1;
-					worldEdgeA = WorldEdge0;
-					worldEdgeB = WorldEdge1;
-					witnessPointA=wA;
-					witnessPointB=wB;
-				}
+				if (featureCache)
+					*featureCache = query.m_separatingFeature;
+				return false;
 			}
 		}
-
 	}
 
-	if (edgeA>=0&&edgeB>=0)
+	if (featureCache)
+		*featureCache = query.m_minFeature;
+
+	sep = query.m_sep;
+
+	if (query.m_minFeature.m_type==btSatFeatureCache::SAT_EDGE_EDGE)
 	{
 //		printf("edge-edge\n");
 		//add an edge-edge contact
@@ -375,10 +473,12 @@ bool btPolyhedralContactClipping::findSeparatingAxis(	const btConvexPolyhedron&
 		btScalar tA;
 		btScalar tB;
 
+		btVector3 witnessPointA = query.m_witnessPointA;
+		btVector3 witnessPointB = query.m_witnessPointB;
 		btVector3 translation = witnessPointB-witnessPointA;
 
-		btVector3 dirA = worldEdgeA;
-		btVector3 dirB = worldEdgeB;
+		btVector3 dirA = transA.getBasis() * hullA.m_uniqueEdges[query.m_minFeature.m_index0];
+		btVector3 dirB = transB.getBasis() * hullB.m_uniqueEdges[query.m_minFeature.m_index1];
 		
 		btScalar hlenB = 1e30f;
 		btScalar hlenA = 1e30f;
@@ -414,6 +514,12 @@ bool btPolyhedralContactClipping::findSeparatingAxis(	const btConvexPolyhedron&
 void	btPolyhedralContactClipping::clipFaceAgainstHull(const btVector3& separatingNormal, const btConvexPolyhedron& hullA,  const btTransform& transA, btVertexArray& worldVertsB1, const btScalar minDist, btScalar maxDist,btDiscreteCollisionDetectorInterface::Result& resultOut)
 {
 	btVertexArray worldVertsB2;
+	clipFaceAgainstHull(separatingNormal,hullA,transA,worldVertsB1,worldVertsB2,minDist,maxDist,resultOut);
+}
+
+void	btPolyhedralContactClipping::clipFaceAgainstHull(const btVector3& separatingNormal, const btConvexPolyhedron& hullA,  const btTransform& transA, btVertexArray& worldVertsB1, btVertexArray& worldVertsB2, const btScalar minDist, btScalar maxDist,btDiscreteCollisionDetectorInterface::Result& resultOut)
+{
+	worldVertsB2.resize(0);
 	btVertexArray* pVtxIn = &worldVertsB1;
 	btVertexArray* pVtxOut = &worldVertsB2;
 	pVtxOut->reserve(pVtxIn->size());
@@ -528,6 +634,13 @@ void	btPolyhedralContactClipping::clipFaceAgainstHull(const btVector3& separatin
 
 
 void	btPolyhedralContactClipping::clipHullAgainstHull(const btVector3& separatingNormal1, const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA,const btTransform& transB, const btScalar minDist, btScalar maxDist,btDiscreteCollisionDetectorInterface::Result& resultOut)
+{
+	btVertexArray worldVertsB1;
+	btVertexArray worldVertsB2;
+	clipHullAgainstHull(separatingNormal1,hullA,hullB,transA,transB,minDist,maxDist,worldVertsB1,worldVertsB2,resultOut);
+}
+
+void	btPolyhedralContactClipping::clipHullAgainstHull(const btVector3& separatingNormal1, const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA,const btTransform& transB, const btScalar minDist, btScalar maxDist,btVertexArray& worldVertsB1,btVertexArray& worldVertsB2,btDiscreteCollisionDetectorInterface::Result& resultOut)
 {
 
 	btVector3 separatingNormal = separatingNormal1.normalized();
@@ -552,7 +665,7 @@ void	btPolyhedralContactClipping::clipHullAgainstHull(const btVector3& separatin
 			}
 		}
 	}
-				btVertexArray worldVertsB1;
+				worldVertsB1.resize(0);
 				{
 					const btFace& polyB = hullB.m_faces[closestFaceB];
 					const int numVertices = polyB.m_indices.size();
@@ -565,6 +678,6 @@ void	btPolyhedralContactClipping::clipHullAgainstHull(const btVector3& separatin
 
 	
 	if (closestFaceB>=0)
-		clipFaceAgainstHull(separatingNormal, hullA, transA,worldVertsB1, minDist, maxDist,resultOut);
+		clipFaceAgainstHull(separatingNormal, hullA, transA,worldVertsB1, worldVertsB2, minDist, maxDist,resultOut);
 
 }
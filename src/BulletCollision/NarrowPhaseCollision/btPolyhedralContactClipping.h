@@ -29,13 +29,53 @@ class btConvexPolyhedron;
 
 typedef btAlignedObjectArray<btVector3> btVertexArray;
 
+///skip the edge pairs whose arcs on the Gauss map don't intersect, they don't form a face of the Minkowski difference so their axis can't
+///separate the hulls or give the minimum penetration. Only hulls whose btConvexPolyhedron::m_uniqueEdgeFaces is filled in are pruned
+extern bool gUseGaussMapPruning;
+
+///btSatFeatureCache keeps the feature of the axis that findSeparatingAxis found for a pair of hulls: the face or edge pair that separated them,
+///or else the one of minimum penetration. The next call tests that axis first. In coherent motion it usually still separates the hulls,
+///so none of the other faces and edge pairs need to be tested, and otherwise its depth is a tight bound to prune the other axes with
+struct btSatFeatureCache
+{
+	enum btSatFeatureType
+	{
+		SAT_NO_FEATURE,
+		SAT_FACE_A,
+		SAT_FACE_B,
+		SAT_EDGE_EDGE
+	};
+
+	int	m_type;
+	///the face index for SAT_FACE_A and SAT_FACE_B, the unique edges of hull A and hull B for SAT_EDGE_EDGE
+	int	m_index0;
+	int	m_index1;
+
+	btSatFeatureCache()
+	{
+		reset();
+	}
+
+	void	reset()
+	{
+		m_type = SAT_NO_FEATURE;
+		m_index0 = -1;
+		m_index1 = -1;
+	}
+};
+
 // Clips a face to the back of a plane
 struct btPolyhedralContactClipping
 {
+	///worldVertsB1 and worldVertsB2 are scratch space, the caller can keep them around so their memory is reused from call to call
+	static void clipHullAgainstHull(const btVector3& separatingNormal, const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA,const btTransform& transB, const btScalar minDist, btScalar maxDist, btVertexArray& worldVertsB1, btVertexArray& worldVertsB2, btDiscreteCollisionDetectorInterface::Result& resultOut);
 	static void clipHullAgainstHull(const btVector3& separatingNormal, const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA,const btTransform& transB, const btScalar minDist, btScalar maxDist, btDiscreteCollisionDetectorInterface::Result& resultOut);
+	///worldVertsB1 holds the face to clip and is overwritten, worldVertsB2 is scratch space
+	static void	clipFaceAgainstHull(const btVector3& separatingNormal, const btConvexPolyhedron& hullA,  const btTransform& transA, btVertexArray& worldVertsB1, btVertexArray& worldVertsB2, const btScalar minDist, btScalar maxDist,btDiscreteCollisionDetectorInterface::Result& resultOut);
 	static void	clipFaceAgainstHull(const btVector3& separatingNormal, const btConvexPolyhedron& hullA,  const btTransform& transA, btVertexArray& worldVertsB1, const btScalar minDist, btScalar maxDist,btDiscreteCollisionDetectorInterface::Result& resultOut);
 
-	static bool findSeparatingAxis(	const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA,const btTransform& transB, btVector3& sep, btDiscreteCollisionDetectorInterface::Result& resultOut);
+	///featureCache is optional, see btSatFeatureCache
+	static bool findSeparatingAxis(	const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA,const btTransform& transB, btVector3& sep, btDiscreteCollisionDetectorInterface::Result& resultOut, btSatFeatureCache* featureCache=0);
 
 	///the clipFace method is used internally
 	static void clipFace(const btVertexArray& pVtxIn, btVertexArray& ppVtxOut, const btVector3& planeNormalWS,btScalar planeEqWS);
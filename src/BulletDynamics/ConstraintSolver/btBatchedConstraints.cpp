@@ -0,0 +1,101 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btBatchedConstraints.h"
+#include "BulletDynamics/Dynamics/btRigidBody.h"
+#include "LinearMath/btQuickprof.h"
+
+
+void	btBatchedConstraints::setup( const btConstraintArray& rows, const btAlignedObjectArray<btSolverBody>& bodies, int minBatchSize )
+{
+	BT_PROFILE( "btBatchedConstraints::setup" );
+	clear();
+
+	int numRows = rows.size();
+	if ( numRows == 0 )
+	{
+		return;
+	}
+
+	// only bodies that can be moved by an impulse can conflict
+	m_bodyIsDynamic.resizeNoInitialize( bodies.size() );
+	m_bodyBatchIds.resizeNoInitialize( bodies.size() );
+	for ( int i = 0; i < bodies.size(); ++i )
+	{
+		const btRigidBody* body = bodies[ i ].m_originalBody;
+		m_bodyIsDynamic[ i ] = ( body && body->getInvMass() != btScalar( 0 ) ) ? 1 : 0;
+		m_bodyBatchIds[ i ] = -1;
+	}
+
+	btAlignedObjectArray<Range>* pendingGroups = &m_pendingGroups;
+	btAlignedObjectArray<Range>* deferredGroups = &m_deferredGroups;
+
+	// consecutive rows between the same bodies form a group
+	pendingGroups->resizeNoInitialize( 0 );
+	int groupBegin = 0;
+	for ( int i = 1; i <= numRows; ++i )
+	{
+		if ( i == numRows
+			|| rows[ i ].m_solverBodyIdA != rows[ groupBegin ].m_solverBodyIdA
+			|| rows[ i ].m_solverBodyIdB != rows[ groupBegin ].m_solverBodyIdB )
+		{
+			pendingGroups->push_back( Range( groupBegin, i ) );
+			groupBegin = i;
+		}
+	}
+
+	// greedy coloring, each pass takes every group that doesn't touch a body already claimed in this pass
+	int batchId = 0;
+	while ( pendingGroups->size() )
+	{
+		int batchBegin = m_groups.size();
+		deferredGroups->resizeNoInitialize( 0 );
+		for ( int i = 0; i < pendingGroups->size(); ++i )
+		{
+			const Range& group = ( *pendingGroups )[ i ];
+			const btSolverConstraint& row = rows[ group.begin ];
+			int bodyA = row.m_solverBodyIdA;
+			int bodyB = row.m_solverBodyIdB;
+			bool conflict = ( m_bodyIsDynamic[ bodyA ] && m_bodyBatchIds[ bodyA ] == batchId )
+				|| ( m_bodyIsDynamic[ bodyB ] && m_bodyBatchIds[ bodyB ] == batchId );
+			if ( conflict )
+			{
+				deferredGroups->push_back( group );
+			}
+			else
+			{
+				m_bodyBatchIds[ bodyA ] = batchId;
+				m_bodyBatchIds[ bodyB ] = batchId;
+				m_groups.push_back( group );
+			}
+		}
+
+		if ( ( m_groups.size() - batchBegin ) < minBatchSize && deferredGroups->size() )
+		{
+			// not worth another batch, everything that is left is solved by one thread
+			for ( int i = 0; i < deferredGroups->size(); ++i )
+			{
+				m_groups.push_back( ( *deferredGroups )[ i ] );
+			}
+			m_batches.push_back( Range( batchBegin, m_groups.size() ) );
+			m_lastBatchIsSerial = true;
+			break;
+		}
+		m_batches.push_back( Range( batchBegin, m_groups.size() ) );
+
+		btSwap( pendingGroups, deferredGroups );
+		batchId++;
+	}
+}
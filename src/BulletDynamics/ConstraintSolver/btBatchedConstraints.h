@@ -0,0 +1,74 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_BATCHED_CONSTRAINTS_H
+#define BT_BATCHED_CONSTRAINTS_H
+
+#include "LinearMath/btAlignedObjectArray.h"
+#include "btSolverBody.h"
+#include "btSolverConstraint.h"
+
+
+///btBatchedConstraints colors a pool of solver rows into batches, so that no two rows in a batch act on the same
+///dynamic solver body. The rows of one batch can then be solved in parallel without changing the result, and the
+///batches are solved one after the other in a fixed order.
+///Consecutive rows between the same pair of bodies (the points of a manifold, the rows of a joint) form a group,
+///a group is always solved in order by a single thread. Bodies without mass (static, kinematic) never cause a conflict.
+///This is the same greedy batching as used by the OpenCL b3GpuPgsContactSolver, done on the cpu.
+class btBatchedConstraints
+{
+public:
+	struct Range
+	{
+		int begin;
+		int end;
+
+		Range() : begin( 0 ), end( 0 ) {}
+		Range( int b, int e ) : begin( b ), end( e ) {}
+	};
+
+	btAlignedObjectArray<Range>	m_groups;	///< ranges of rows in the constraint pool, sorted by batch
+	btAlignedObjectArray<Range>	m_batches;	///< ranges of m_groups
+	bool	m_lastBatchIsSerial;	///< the groups that didn't fit in a batch of useful size, they have to be solved by one thread
+
+	btBatchedConstraints()
+		: m_lastBatchIsSerial( false )
+	{
+	}
+
+	///groups are only put into a new batch while it gets at least minBatchSize groups, the rest ends up in one serial batch
+	void	setup( const btConstraintArray& rows, const btAlignedObjectArray<btSolverBody>& bodies, int minBatchSize );
+
+	void	clear()
+	{
+		m_groups.resizeNoInitialize( 0 );
+		m_batches.resizeNoInitialize( 0 );
+		m_lastBatchIsSerial = false;
+	}
+
+	bool	isSerialBatch( int iBatch ) const
+	{
+		return m_lastBatchIsSerial && iBatch == m_batches.size() - 1;
+	}
+
+private:
+	// scratch memory, kept to avoid allocations every frame
+	btAlignedObjectArray<Range>	m_pendingGroups;
+	btAlignedObjectArray<Range>	m_deferredGroups;
+	btAlignedObjectArray<int>	m_bodyBatchIds;
+	btAlignedObjectArray<char>	m_bodyIsDynamic;
+};
+
+#endif //BT_BATCHED_CONSTRAINTS_H
@@ -29,7 +29,10 @@ enum	btSolverMode
 	SOLVER_CACHE_FRIENDLY = 128,
 	SOLVER_SIMD = 256,
 	SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS = 512,
-	SOLVER_ALLOW_ZERO_LENGTH_FRICTION_DIRECTIONS = 1024
+	SOLVER_ALLOW_ZERO_LENGTH_FRICTION_DIRECTIONS = 1024,
+	SOLVER_PARALLEL_BATCHES = 2048, ///< color the rows into independent batches and solve each batch with btParallelFor, ignores SOLVER_RANDMIZE_ORDER
+	SOLVER_CONTACT_ROW_BLOCKS = 4096, ///< with SOLVER_PARALLEL_BATCHES, solve 4 contact rows at once in SoA blocks (not used when interleaving friction)
+	SOLVER_MULTIBODY_SPARSE_JACOBIANS = 8192 ///< btMultiBodyConstraintSolver only stores the base and root to link entries of the contact Jacobians of a btMultiBody
 };
 
 struct btContactSolverInfoData
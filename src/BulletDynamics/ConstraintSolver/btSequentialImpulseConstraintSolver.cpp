@@ -716,6 +716,20 @@ btSolverConstraint&	btSequentialImpulseConstraintSolver::addRollingFrictionConst
 
 int	btSequentialImpulseConstraintSolver::getOrInitSolverBody(btCollisionObject& body,btScalar timeStep)
 {
+#if BT_THREADSAFE
+	if (body.isKinematicObject() && btRigidBody::upcast(&body))
+	{
+		const int* solverBodyIdPtr = m_kinematicBodyToSolverBodyTable.find(btHashPtr(&body));
+		if (solverBodyIdPtr)
+			return *solverBodyIdPtr;
+
+		int solverBodyId = m_tmpSolverBodyPool.size();
+		btSolverBody& solverBody = m_tmpSolverBodyPool.expand();
+		initSolverBody(&solverBody,&body,timeStep);
+		m_kinematicBodyToSolverBodyTable.insert(btHashPtr(&body),solverBodyId);
+		return solverBodyId;
+	}
+#endif //BT_THREADSAFE
 
 	int solverBodyIdA = -1;
 
@@ -1253,6 +1267,10 @@ btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySetup(btCol
 
 	m_tmpSolverBodyPool.reserve(numBodies+1);
 	m_tmpSolverBodyPool.resize(0);
+#if BT_THREADSAFE
+	if (m_kinematicBodyToSolverBodyTable.size())
+		m_kinematicBodyToSolverBodyTable.clear();
+#endif //BT_THREADSAFE
 
 	//btSolverBody& fixedBody = m_tmpSolverBodyPool.expand();
     //initSolverBody(&fixedBody,0);
@@ -1521,6 +1539,11 @@ btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySetup(btCol
 		}
 	}
 
+	if (infoGlobal.m_solverMode & SOLVER_PARALLEL_BATCHES)
+	{
+		setupBatchedConstraints(infoGlobal);
+	}
+
 	return 0.f;
 
 }
@@ -1533,6 +1556,11 @@ btScalar btSequentialImpulseConstraintSolver::solveSingleIteration(int iteration
 	int numConstraintPool = m_tmpSolverContactConstraintPool.size();
 	int numFrictionPool = m_tmpSolverContactFrictionConstraintPool.size();
 
+	if (infoGlobal.m_solverMode & SOLVER_PARALLEL_BATCHES)
+	{
+		return solveSingleIterationBatched(iteration, constraints, numConstraints, infoGlobal);
+	}
+
 	if (infoGlobal.m_solverMode & SOLVER_RANDMIZE_ORDER)
 	{
 		if (1)			// uncomment this for a bit less random ((iteration & 7) == 0)
@@ -1762,12 +1790,335 @@ btScalar btSequentialImpulseConstraintSolver::solveSingleIteration(int iteration
 }
 
 
+///groups of rows handed to one task, and the smallest batch that is still solved with btParallelFor
+static const int gBatchedGroupsGrainSize = 16;
+static const int gMinParallelBatchSize = 2 * gBatchedGroupsGrainSize;
+
+
+struct btSequentialImpulseConstraintSolver::BatchedRowSolverLoop : public btIParallelForBody
+{
+	btSequentialImpulseConstraintSolver* m_solver;
+	const btBatchedConstraints::Range* m_groups;
+	const btContactSolverInfo* m_infoGlobal;
+	int m_rowType;
+	int m_iteration;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "solveBatchedRows loop" );
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			const btBatchedConstraints::Range& group = m_groups[ i ];
+			m_solver->solveBatchedRows( m_rowType, group.begin, group.end, m_iteration, *m_infoGlobal );
+		}
+	}
+};
+
+
+void btSequentialImpulseConstraintSolver::setupBatchedConstraints(const btContactSolverInfo& infoGlobal)
+{
+	BT_PROFILE("setupBatchedConstraints");
+	m_batchedNonContactConstraints.setup(m_tmpSolverNonContactConstraintPool, m_tmpSolverBodyPool, gMinParallelBatchSize);
+	m_batchedContactConstraints.setup(m_tmpSolverContactConstraintPool, m_tmpSolverBodyPool, gMinParallelBatchSize);
+	if (infoGlobal.m_solverMode & SOLVER_SIMD && infoGlobal.m_solverMode & SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS)
+	{
+		//friction rows are solved together with their contact row
+		m_batchedFrictionConstraints.clear();
+		m_batchedRollingFrictionConstraints.clear();
+	}
+	else
+	{
+		m_batchedFrictionConstraints.setup(m_tmpSolverContactFrictionConstraintPool, m_tmpSolverBodyPool, gMinParallelBatchSize);
+		m_batchedRollingFrictionConstraints.setup(m_tmpSolverContactRollingFrictionConstraintPool, m_tmpSolverBodyPool, gMinParallelBatchSize);
+	}
+	if (infoGlobal.m_solverMode & SOLVER_CONTACT_ROW_BLOCKS)
+	{
+		setupContactBlocks();
+	}
+	else
+	{
+		m_contactBlocks.resizeNoInitialize(0);
+		m_batchedContactBlocks.clear();
+	}
+}
+
+
+void btSequentialImpulseConstraintSolver::setupContactBlocks()
+{
+	BT_PROFILE("setupContactBlocks");
+	m_contactBlocks.resizeNoInitialize(0);
+	m_batchedContactBlocks.clear();
+	const int laneCount = btSolverContactBlock::LANE_COUNT;
+	const btBatchedConstraints& batched = m_batchedContactConstraints;
+	for (int iBatch=0;iBatch<batched.m_batches.size();iBatch++)
+	{
+		if (batched.isSerialBatch(iBatch))
+		{
+			//the groups of the serial batch share bodies, they are solved row by row
+			break;
+		}
+		const btBatchedConstraints::Range& batch = batched.m_batches[iBatch];
+		int chunkBegin = m_batchedContactBlocks.m_groups.size();
+		//each lane of a block takes the rows of one group, so the rows of a group are still solved in order
+		for (int iGroup=batch.begin;iGroup<batch.end;iGroup+=laneCount)
+		{
+			int numLanes = btMin(laneCount, batch.end-iGroup);
+			int maxGroupSize = 0;
+			for (int lane=0;lane<numLanes;lane++)
+			{
+				const btBatchedConstraints::Range& group = batched.m_groups[iGroup+lane];
+				maxGroupSize = btMax(maxGroupSize, group.end-group.begin);
+			}
+			int blockBegin = m_contactBlocks.size();
+			for (int j=0;j<maxGroupSize;j++)
+			{
+				int rowIndices[btSolverContactBlock::LANE_COUNT];
+				for (int lane=0;lane<laneCount;lane++)
+				{
+					rowIndices[lane] = -1;
+					if (lane < numLanes)
+					{
+						const btBatchedConstraints::Range& group = batched.m_groups[iGroup+lane];
+						if (group.begin+j < group.end)
+							rowIndices[lane] = group.begin+j;
+					}
+				}
+				m_contactBlocks.expandNonInitializing().init(rowIndices, &m_tmpSolverContactConstraintPool[0], &m_tmpSolverBodyPool[0]);
+			}
+			m_batchedContactBlocks.m_groups.push_back(btBatchedConstraints::Range(blockBegin, m_contactBlocks.size()));
+		}
+		m_batchedContactBlocks.m_batches.push_back(btBatchedConstraints::Range(chunkBegin, m_batchedContactBlocks.m_groups.size()));
+	}
+}
+
+
+///groups solved at the same time may share bodies with zero inverse mass (static and kinematic bodies), see btBatchedConstraints.
+///The row solvers would still write their (unchanging) velocity deltas, so these rows get a private copy of such a body instead,
+///the same bodies btSolverContactBlock leaves out of m_writeMask
+static SIMD_FORCE_INLINE btSolverBody& getBatchedRowBody(btAlignedObjectArray<btSolverBody>& pool, int solverBodyId, btSolverBody& privateCopy)
+{
+	btSolverBody& body = pool[solverBodyId];
+	if (body.m_originalBody && body.m_originalBody->getInvMass() != btScalar(0))
+	{
+		return body;
+	}
+	privateCopy = body;
+	return privateCopy;
+}
+
+
+void btSequentialImpulseConstraintSolver::solveBatchedRows(int rowType, int rowBegin, int rowEnd, int iteration, const btContactSolverInfo& infoGlobal)
+{
+	//same row solvers as solveSingleIteration
+	bool useSimd = (infoGlobal.m_solverMode & SOLVER_SIMD) != 0;
+	btSolverBody copyA;
+	btSolverBody copyB;
+	switch (rowType)
+	{
+	case BATCHED_NON_CONTACT_ROWS:
+		for (int j=rowBegin;j<rowEnd;j++)
+		{
+			btSolverConstraint& constraint = m_tmpSolverNonContactConstraintPool[j];
+			if (iteration < constraint.m_overrideNumSolverIterations)
+			{
+				if (useSimd)
+					resolveSingleConstraintRowGenericSIMD(getBatchedRowBody(m_tmpSolverBodyPool,constraint.m_solverBodyIdA,copyA),getBatchedRowBody(m_tmpSolverBodyPool,constraint.m_solverBodyIdB,copyB),constraint);
+				else
+					resolveSingleConstraintRowGeneric(getBatchedRowBody(m_tmpSolverBodyPool,constraint.m_solverBodyIdA,copyA),getBatchedRowBody(m_tmpSolverBodyPool,constraint.m_solverBodyIdB,copyB),constraint);
+			}
+		}
+		break;
+
+	case BATCHED_CONTACT_ROWS:
+		for (int j=rowBegin;j<rowEnd;j++)
+		{
+			const btSolverConstraint& solveManifold = m_tmpSolverContactConstraintPool[j];
+			if (useSimd)
+				resolveSingleConstraintRowLowerLimitSIMD(getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdA,copyA),getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdB,copyB),solveManifold);
+			else
+				resolveSingleConstraintRowLowerLimit(getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdA,copyA),getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdB,copyB),solveManifold);
+		}
+		break;
+
+	case BATCHED_CONTACT_AND_FRICTION_ROWS:
+		{
+			int multiplier = (infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS)? 2 : 1;
+			for (int c=rowBegin;c<rowEnd;c++)
+			{
+				const btSolverConstraint& contact = m_tmpSolverContactConstraintPool[c];
+				resolveSingleConstraintRowLowerLimitSIMD(getBatchedRowBody(m_tmpSolverBodyPool,contact.m_solverBodyIdA,copyA),getBatchedRowBody(m_tmpSolverBodyPool,contact.m_solverBodyIdB,copyB),contact);
+				btScalar totalImpulse = contact.m_appliedImpulse;
+				if (totalImpulse>btScalar(0))
+				{
+					for (int k=0;k<multiplier;k++)
+					{
+						btSolverConstraint& solveManifold = m_tmpSolverContactFrictionConstraintPool[c*multiplier+k];
+						solveManifold.m_lowerLimit = -(solveManifold.m_friction*totalImpulse);
+						solveManifold.m_upperLimit = solveManifold.m_friction*totalImpulse;
+						resolveSingleConstraintRowGenericSIMD(getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdA,copyA),getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdB,copyB),solveManifold);
+					}
+				}
+			}
+		}
+		break;
+
+	case BATCHED_FRICTION_ROWS:
+		for (int j=rowBegin;j<rowEnd;j++)
+		{
+			btSolverConstraint& solveManifold = m_tmpSolverContactFrictionConstraintPool[j];
+			btScalar totalImpulse = m_tmpSolverContactConstraintPool[solveManifold.m_frictionIndex].m_appliedImpulse;
+			if (totalImpulse>btScalar(0))
+			{
+				solveManifold.m_lowerLimit = -(solveManifold.m_friction*totalImpulse);
+				solveManifold.m_upperLimit = solveManifold.m_friction*totalImpulse;
+				if (useSimd)
+					resolveSingleConstraintRowGenericSIMD(getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdA,copyA),getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdB,copyB),solveManifold);
+				else
+					resolveSingleConstraintRowGeneric(getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdA,copyA),getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdB,copyB),solveManifold);
+			}
+		}
+		break;
+
+	case BATCHED_ROLLING_FRICTION_ROWS:
+		for (int j=rowBegin;j<rowEnd;j++)
+		{
+			btSolverConstraint& rollingFrictionConstraint = m_tmpSolverContactRollingFrictionConstraintPool[j];
+			btScalar totalImpulse = m_tmpSolverContactConstraintPool[rollingFrictionConstraint.m_frictionIndex].m_appliedImpulse;
+			if (totalImpulse>btScalar(0))
+			{
+				btScalar rollingFrictionMagnitude = rollingFrictionConstraint.m_friction*totalImpulse;
+				if (rollingFrictionMagnitude>rollingFrictionConstraint.m_friction)
+					rollingFrictionMagnitude = rollingFrictionConstraint.m_friction;
+
+				rollingFrictionConstraint.m_lowerLimit = -rollingFrictionMagnitude;
+				rollingFrictionConstraint.m_upperLimit = rollingFrictionMagnitude;
+				if (useSimd)
+					resolveSingleConstraintRowGenericSIMD(getBatchedRowBody(m_tmpSolverBodyPool,rollingFrictionConstraint.m_solverBodyIdA,copyA),getBatchedRowBody(m_tmpSolverBodyPool,rollingFrictionConstraint.m_solverBodyIdB,copyB),rollingFrictionConstraint);
+				else
+					resolveSingleConstraintRowGeneric(getBatchedRowBody(m_tmpSolverBodyPool,rollingFrictionConstraint.m_solverBodyIdA,copyA),getBatchedRowBody(m_tmpSolverBodyPool,rollingFrictionConstraint.m_solverBodyIdB,copyB),rollingFrictionConstraint);
+			}
+		}
+		break;
+
+	case BATCHED_SPLIT_PENETRATION_ROWS:
+		for (int j=rowBegin;j<rowEnd;j++)
+		{
+			const btSolverConstraint& solveManifold = m_tmpSolverContactConstraintPool[j];
+			if (useSimd)
+				resolveSplitPenetrationSIMD(getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdA,copyA),getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdB,copyB),solveManifold);
+			else
+				resolveSplitPenetrationImpulseCacheFriendly(getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdA,copyA),getBatchedRowBody(m_tmpSolverBodyPool,solveManifold.m_solverBodyIdB,copyB),solveManifold);
+		}
+		break;
+
+	case BATCHED_CONTACT_BLOCKS:
+		for (int j=rowBegin;j<rowEnd;j++)
+		{
+			m_contactBlocks[j].solveLowerLimit(&m_tmpSolverBodyPool[0], &m_tmpSolverContactConstraintPool[0]);
+		}
+		break;
+
+	default:
+		btAssert(0);
+	}
+}
+
+
+void btSequentialImpulseConstraintSolver::solveBatches(const btBatchedConstraints& batchedConstraints, int rowType, int iteration, const btContactSolverInfo& infoGlobal, int grainSize)
+{
+	BatchedRowSolverLoop loop;
+	loop.m_solver = this;
+	loop.m_groups = batchedConstraints.m_groups.size() ? &batchedConstraints.m_groups[0] : NULL;
+	loop.m_infoGlobal = &infoGlobal;
+	loop.m_rowType = rowType;
+	loop.m_iteration = iteration;
+
+	//the batches have to be solved one after the other, the groups within a batch don't share any dynamic body
+	for (int iBatch=0;iBatch<batchedConstraints.m_batches.size();iBatch++)
+	{
+		const btBatchedConstraints::Range& batch = batchedConstraints.m_batches[iBatch];
+		if (batchedConstraints.isSerialBatch(iBatch))
+		{
+			loop.forLoop(batch.begin, batch.end);
+		}
+		else
+		{
+			btParallelFor(batch.begin, batch.end, grainSize, loop);
+		}
+	}
+}
+
+
+void btSequentialImpulseConstraintSolver::solveContactBatches(int iteration, const btContactSolverInfo& infoGlobal)
+{
+	if (!(infoGlobal.m_solverMode & SOLVER_CONTACT_ROW_BLOCKS))
+	{
+		solveBatches(m_batchedContactConstraints, BATCHED_CONTACT_ROWS, iteration, infoGlobal, gBatchedGroupsGrainSize);
+		return;
+	}
+	//a chunk of blocks holds LANE_COUNT groups
+	solveBatches(m_batchedContactBlocks, BATCHED_CONTACT_BLOCKS, iteration, infoGlobal, btMax(1, gBatchedGroupsGrainSize/int(btSolverContactBlock::LANE_COUNT)));
+	const btBatchedConstraints& batched = m_batchedContactConstraints;
+	if (batched.m_lastBatchIsSerial)
+	{
+		const btBatchedConstraints::Range& batch = batched.m_batches[batched.m_batches.size()-1];
+		for (int iGroup=batch.begin;iGroup<batch.end;iGroup++)
+		{
+			const btBatchedConstraints::Range& group = batched.m_groups[iGroup];
+			solveBatchedRows(BATCHED_CONTACT_ROWS, group.begin, group.end, iteration, infoGlobal);
+		}
+	}
+}
+
+
+btScalar btSequentialImpulseConstraintSolver::solveSingleIterationBatched(int iteration, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal)
+{
+	///solve all joint constraints
+	solveBatches(m_batchedNonContactConstraints, BATCHED_NON_CONTACT_ROWS, iteration, infoGlobal, gBatchedGroupsGrainSize);
+
+	if (iteration< infoGlobal.m_numIterations)
+	{
+		//obsolete constraints solve themselves, they can't be batched
+		for (int j=0;j<numConstraints;j++)
+		{
+			if (constraints[j]->isEnabled())
+			{
+				int bodyAid = getOrInitSolverBody(constraints[j]->getRigidBodyA(),infoGlobal.m_timeStep);
+				int bodyBid = getOrInitSolverBody(constraints[j]->getRigidBodyB(),infoGlobal.m_timeStep);
+				btSolverBody& bodyA = m_tmpSolverBodyPool[bodyAid];
+				btSolverBody& bodyB = m_tmpSolverBodyPool[bodyBid];
+				constraints[j]->solveConstraintObsolete(bodyA,bodyB,infoGlobal.m_timeStep);
+			}
+		}
+
+		if (infoGlobal.m_solverMode & SOLVER_SIMD && infoGlobal.m_solverMode & SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS)
+		{
+			solveBatches(m_batchedContactConstraints, BATCHED_CONTACT_AND_FRICTION_ROWS, iteration, infoGlobal, gBatchedGroupsGrainSize);
+		}
+		else
+		{
+			solveContactBatches(iteration, infoGlobal);
+			solveBatches(m_batchedFrictionConstraints, BATCHED_FRICTION_ROWS, iteration, infoGlobal, gBatchedGroupsGrainSize);
+			solveBatches(m_batchedRollingFrictionConstraints, BATCHED_ROLLING_FRICTION_ROWS, iteration, infoGlobal, gBatchedGroupsGrainSize);
+		}
+	}
+	return 0.f;
+}
+
+
 void btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySplitImpulseIterations(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifoldPtr, int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal,btIDebugDraw* debugDrawer)
 {
 	int iteration;
 	if (infoGlobal.m_splitImpulse)
 	{
-		if (infoGlobal.m_solverMode & SOLVER_SIMD)
+		if (infoGlobal.m_solverMode & SOLVER_PARALLEL_BATCHES)
+		{
+			for ( iteration = 0;iteration<infoGlobal.m_numIterations;iteration++)
+			{
+				solveBatches(m_batchedContactConstraints, BATCHED_SPLIT_PENETRATION_ROWS, iteration, infoGlobal, gBatchedGroupsGrainSize);
+			}
+		}
+		else if (infoGlobal.m_solverMode & SOLVER_SIMD)
 		{
 			for ( iteration = 0;iteration<infoGlobal.m_numIterations;iteration++)
 			{
@@ -1874,6 +2225,11 @@ btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlyFinish(btCo
 	for ( i=0;i<m_tmpSolverBodyPool.size();i++)
 	{
 		btRigidBody* body = m_tmpSolverBodyPool[i].m_originalBody;
+#if BT_THREADSAFE
+		///kinematic bodies may be in use by islands solved on other threads, and the solver doesn't change their velocity
+		if (body && body->isKinematicObject())
+			continue;
+#endif //BT_THREADSAFE
 		if (body)
 		{
 			if (infoGlobal.m_splitImpulse)
@@ -26,6 +26,10 @@ class btCollisionObject;
 #include "BulletDynamics/ConstraintSolver/btSolverConstraint.h"
 #include "BulletCollision/NarrowPhaseCollision/btManifoldPoint.h"
 #include "BulletDynamics/ConstraintSolver/btConstraintSolver.h"
+#include "BulletDynamics/ConstraintSolver/btBatchedConstraints.h"
+#include "BulletDynamics/ConstraintSolver/btSolverContactBlock.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btHashMap.h"
 
 typedef btSimdScalar(*btSingleConstraintRowSolver)(btSolverBody&, btSolverBody&, const btSolverConstraint&);
 
@@ -45,6 +49,32 @@ protected:
 	btAlignedObjectArray<btTypedConstraint::btConstraintInfo1> m_tmpConstraintSizesPool;
 	int							m_maxOverrideNumSolverIterations;
 	int m_fixedBodyId;
+#if BT_THREADSAFE
+	///kinematic bodies can be shared by islands that are solved concurrently, so their solver body index is kept here instead of in the companion id
+	btHashMap<btHashPtr,int>	m_kinematicBodyToSolverBodyTable;
+#endif //BT_THREADSAFE
+
+	///used with SOLVER_PARALLEL_BATCHES, one coloring per constraint pool
+	btBatchedConstraints	m_batchedNonContactConstraints;
+	btBatchedConstraints	m_batchedContactConstraints;
+	btBatchedConstraints	m_batchedFrictionConstraints;
+	btBatchedConstraints	m_batchedRollingFrictionConstraints;
+	///used with SOLVER_CONTACT_ROW_BLOCKS, the parallel contact batches packed into blocks of rows from different groups
+	btAlignedObjectArray<btSolverContactBlock>	m_contactBlocks;
+	///the groups are ranges of m_contactBlocks that have to be solved in order, the batches match m_batchedContactConstraints
+	btBatchedConstraints	m_batchedContactBlocks;
+
+	enum BatchedRowType
+	{
+		BATCHED_NON_CONTACT_ROWS,
+		BATCHED_CONTACT_ROWS,
+		BATCHED_CONTACT_AND_FRICTION_ROWS,
+		BATCHED_FRICTION_ROWS,
+		BATCHED_ROLLING_FRICTION_ROWS,
+		BATCHED_SPLIT_PENETRATION_ROWS,
+		BATCHED_CONTACT_BLOCKS
+	};
+	struct BatchedRowSolverLoop;
 
 	btSingleConstraintRowSolver m_resolveSingleConstraintRowGeneric;
 	btSingleConstraintRowSolver m_resolveSingleConstraintRowLowerLimit;
@@ -98,6 +128,13 @@ protected:
 	btSimdScalar	resolveSingleConstraintRowGenericSIMD(btSolverBody& bodyA,btSolverBody& bodyB,const btSolverConstraint& contactConstraint);
 	btSimdScalar	resolveSingleConstraintRowLowerLimit(btSolverBody& bodyA,btSolverBody& bodyB,const btSolverConstraint& contactConstraint);
 	btSimdScalar	resolveSingleConstraintRowLowerLimitSIMD(btSolverBody& bodyA,btSolverBody& bodyB,const btSolverConstraint& contactConstraint);
+
+	void	setupBatchedConstraints(const btContactSolverInfo& infoGlobal);
+	void	solveBatchedRows(int rowType, int rowBegin, int rowEnd, int iteration, const btContactSolverInfo& infoGlobal);
+	void	setupContactBlocks();
+	void	solveBatches(const btBatchedConstraints& batchedConstraints, int rowType, int iteration, const btContactSolverInfo& infoGlobal, int grainSize);
+	void	solveContactBatches(int iteration, const btContactSolverInfo& infoGlobal);
+	btScalar	solveSingleIterationBatched(int iteration, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal);
 		
 protected:
 	
@@ -0,0 +1,254 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btSolverContactBlock.h"
+#include "BulletDynamics/Dynamics/btRigidBody.h"
+
+///the block kernel only needs SSE2 on the SoA data, so it is also used where btVector3 itself doesn't use SSE
+#if !defined (BT_USE_DOUBLE_PRECISION) && (defined (USE_SIMD) || defined (__SSE2__) || defined (_M_X64) || defined (_M_AMD64))
+#define BT_USE_SSE_CONTACT_BLOCK 1
+#include <emmintrin.h>
+#endif
+
+
+static void storeLane( btScalar (*dst)[ btSolverContactBlock::LANE_COUNT ], int lane, const btVector3& v )
+{
+	dst[ 0 ][ lane ] = v.getX();
+	dst[ 1 ][ lane ] = v.getY();
+	dst[ 2 ][ lane ] = v.getZ();
+}
+
+
+// same test as btBatchedConstraints, only these bodies are kept apart by the batches
+static bool isDynamic( const btSolverBody& body )
+{
+	return body.m_originalBody && body.m_originalBody->getInvMass() != btScalar( 0 );
+}
+
+
+void btSolverContactBlock::init( const int* rowIndices, const btSolverConstraint* rows, const btSolverBody* bodies )
+{
+	const btVector3 zero( 0, 0, 0 );
+	for ( int lane = 0; lane < LANE_COUNT; ++lane )
+	{
+		int rowIndex = rowIndices[ lane ];
+		if ( rowIndex < 0 )
+		{
+			// an unused lane never changes the impulse or the velocities
+			m_rowIndex[ lane ] = -1;
+			m_writeMask[ lane ] = 0;
+			m_solverBodyIdA[ lane ] = 0;
+			m_solverBodyIdB[ lane ] = 0;
+			storeLane( m_contactNormal1, lane, zero );
+			storeLane( m_relpos1CrossNormal, lane, zero );
+			storeLane( m_contactNormal2, lane, zero );
+			storeLane( m_relpos2CrossNormal, lane, zero );
+			storeLane( m_linearComponentA, lane, zero );
+			storeLane( m_angularComponentA, lane, zero );
+			storeLane( m_linearComponentB, lane, zero );
+			storeLane( m_angularComponentB, lane, zero );
+			m_rhs[ lane ] = btScalar( 0 );
+			m_cfm[ lane ] = btScalar( 0 );
+			m_jacDiagABInv[ lane ] = btScalar( 0 );
+			m_lowerLimit[ lane ] = btScalar( 0 );
+			continue;
+		}
+		const btSolverConstraint& c = rows[ rowIndex ];
+		const btSolverBody& bodyA = bodies[ c.m_solverBodyIdA ];
+		const btSolverBody& bodyB = bodies[ c.m_solverBodyIdB ];
+		m_rowIndex[ lane ] = rowIndex;
+		m_solverBodyIdA[ lane ] = c.m_solverBodyIdA;
+		m_solverBodyIdB[ lane ] = c.m_solverBodyIdB;
+		m_writeMask[ lane ] = ( isDynamic( bodyA ) ? 1 : 0 ) | ( isDynamic( bodyB ) ? 2 : 0 );
+		storeLane( m_contactNormal1, lane, c.m_contactNormal1 );
+		storeLane( m_relpos1CrossNormal, lane, c.m_relpos1CrossNormal );
+		storeLane( m_contactNormal2, lane, c.m_contactNormal2 );
+		storeLane( m_relpos2CrossNormal, lane, c.m_relpos2CrossNormal );
+		// see btSolverBody::internalApplyImpulse, bodies without m_originalBody are never changed. The factors are applied
+		// here instead of after the multiplication with the impulse, so the result only agrees to rounding
+		storeLane( m_linearComponentA, lane, bodyA.m_originalBody ? c.m_contactNormal1 * bodyA.m_invMass * bodyA.m_linearFactor : zero );
+		storeLane( m_angularComponentA, lane, bodyA.m_originalBody ? c.m_angularComponentA * bodyA.m_angularFactor : zero );
+		storeLane( m_linearComponentB, lane, bodyB.m_originalBody ? c.m_contactNormal2 * bodyB.m_invMass * bodyB.m_linearFactor : zero );
+		storeLane( m_angularComponentB, lane, bodyB.m_originalBody ? c.m_angularComponentB * bodyB.m_angularFactor : zero );
+		m_rhs[ lane ] = c.m_rhs;
+		m_cfm[ lane ] = c.m_cfm;
+		m_jacDiagABInv[ lane ] = c.m_jacDiagABInv;
+		m_lowerLimit[ lane ] = c.m_lowerLimit;
+	}
+}
+
+
+#ifdef BT_USE_SSE_CONTACT_BLOCK
+
+static SIMD_FORCE_INLINE __m128 blockDot3( const btScalar (*a)[ btSolverContactBlock::LANE_COUNT ], __m128 x, __m128 y, __m128 z )
+{
+	__m128 result = _mm_mul_ps( _mm_load_ps( a[ 0 ] ), x );
+	result = _mm_add_ps( result, _mm_mul_ps( _mm_load_ps( a[ 1 ] ), y ) );
+	result = _mm_add_ps( result, _mm_mul_ps( _mm_load_ps( a[ 2 ] ), z ) );
+	return result;
+}
+
+
+static SIMD_FORCE_INLINE void blockMadd3( const btScalar (*a)[ btSolverContactBlock::LANE_COUNT ], __m128 scale, __m128& x, __m128& y, __m128& z )
+{
+	x = _mm_add_ps( x, _mm_mul_ps( _mm_load_ps( a[ 0 ] ), scale ) );
+	y = _mm_add_ps( y, _mm_mul_ps( _mm_load_ps( a[ 1 ] ), scale ) );
+	z = _mm_add_ps( z, _mm_mul_ps( _mm_load_ps( a[ 2 ] ), scale ) );
+}
+
+
+void btSolverContactBlock::solveLowerLimit( btSolverBody* bodies, btSolverConstraint* rows ) const
+{
+	// btSolverBody is not padded to 16 bytes on every platform, so the body velocities use unaligned loads and stores
+	btScalar unusedLane[ 4 ] = { 0, 0, 0, 0 };
+	btScalar appliedImpulse[ LANE_COUNT ];
+	btScalar* linVelA[ LANE_COUNT ];
+	btScalar* angVelA[ LANE_COUNT ];
+	btScalar* linVelB[ LANE_COUNT ];
+	btScalar* angVelB[ LANE_COUNT ];
+	for ( int lane = 0; lane < LANE_COUNT; ++lane )
+	{
+		if ( m_rowIndex[ lane ] >= 0 )
+		{
+			btSolverBody& bodyA = bodies[ m_solverBodyIdA[ lane ] ];
+			btSolverBody& bodyB = bodies[ m_solverBodyIdB[ lane ] ];
+			linVelA[ lane ] = bodyA.internalGetDeltaLinearVelocity().m_floats;
+			angVelA[ lane ] = bodyA.internalGetDeltaAngularVelocity().m_floats;
+			linVelB[ lane ] = bodyB.internalGetDeltaLinearVelocity().m_floats;
+			angVelB[ lane ] = bodyB.internalGetDeltaAngularVelocity().m_floats;
+			appliedImpulse[ lane ] = rows[ m_rowIndex[ lane ] ].m_appliedImpulse;
+		}
+		else
+		{
+			linVelA[ lane ] = angVelA[ lane ] = linVelB[ lane ] = angVelB[ lane ] = unusedLane;
+			appliedImpulse[ lane ] = btScalar( 0 );
+		}
+	}
+
+	// gather, the fourth vector holds the unused w components and is only carried along
+	__m128 lax = _mm_loadu_ps( linVelA[ 0 ] ), lay = _mm_loadu_ps( linVelA[ 1 ] ), laz = _mm_loadu_ps( linVelA[ 2 ] ), law = _mm_loadu_ps( linVelA[ 3 ] );
+	__m128 aax = _mm_loadu_ps( angVelA[ 0 ] ), aay = _mm_loadu_ps( angVelA[ 1 ] ), aaz = _mm_loadu_ps( angVelA[ 2 ] ), aaw = _mm_loadu_ps( angVelA[ 3 ] );
+	__m128 lbx = _mm_loadu_ps( linVelB[ 0 ] ), lby = _mm_loadu_ps( linVelB[ 1 ] ), lbz = _mm_loadu_ps( linVelB[ 2 ] ), lbw = _mm_loadu_ps( linVelB[ 3 ] );
+	__m128 abx = _mm_loadu_ps( angVelB[ 0 ] ), aby = _mm_loadu_ps( angVelB[ 1 ] ), abz = _mm_loadu_ps( angVelB[ 2 ] ), abw = _mm_loadu_ps( angVelB[ 3 ] );
+	_MM_TRANSPOSE4_PS( lax, lay, laz, law );
+	_MM_TRANSPOSE4_PS( aax, aay, aaz, aaw );
+	_MM_TRANSPOSE4_PS( lbx, lby, lbz, lbw );
+	_MM_TRANSPOSE4_PS( abx, aby, abz, abw );
+
+	__m128 applied = _mm_loadu_ps( appliedImpulse );
+	__m128 jacDiagABInv = _mm_load_ps( m_jacDiagABInv );
+	__m128 deltaImpulse = _mm_sub_ps( _mm_load_ps( m_rhs ), _mm_mul_ps( applied, _mm_load_ps( m_cfm ) ) );
+	__m128 deltaVel1Dotn = _mm_add_ps( blockDot3( m_contactNormal1, lax, lay, laz ), blockDot3( m_relpos1CrossNormal, aax, aay, aaz ) );
+	__m128 deltaVel2Dotn = _mm_add_ps( blockDot3( m_contactNormal2, lbx, lby, lbz ), blockDot3( m_relpos2CrossNormal, abx, aby, abz ) );
+	deltaImpulse = _mm_sub_ps( deltaImpulse, _mm_mul_ps( deltaVel1Dotn, jacDiagABInv ) );
+	deltaImpulse = _mm_sub_ps( deltaImpulse, _mm_mul_ps( deltaVel2Dotn, jacDiagABInv ) );
+
+	__m128 lowerLimit = _mm_load_ps( m_lowerLimit );
+	__m128 sum = _mm_add_ps( applied, deltaImpulse );
+	__m128 belowLowerLimit = _mm_cmplt_ps( sum, lowerLimit );
+	deltaImpulse = _mm_or_ps( _mm_and_ps( belowLowerLimit, _mm_sub_ps( lowerLimit, applied ) ), _mm_andnot_ps( belowLowerLimit, deltaImpulse ) );
+	applied = _mm_or_ps( _mm_and_ps( belowLowerLimit, lowerLimit ), _mm_andnot_ps( belowLowerLimit, sum ) );
+	_mm_storeu_ps( appliedImpulse, applied );
+
+	blockMadd3( m_linearComponentA, deltaImpulse, lax, lay, laz );
+	blockMadd3( m_angularComponentA, deltaImpulse, aax, aay, aaz );
+	blockMadd3( m_linearComponentB, deltaImpulse, lbx, lby, lbz );
+	blockMadd3( m_angularComponentB, deltaImpulse, abx, aby, abz );
+
+	// scatter
+	_MM_TRANSPOSE4_PS( lax, lay, laz, law );
+	_MM_TRANSPOSE4_PS( aax, aay, aaz, aaw );
+	_MM_TRANSPOSE4_PS( lbx, lby, lbz, lbw );
+	_MM_TRANSPOSE4_PS( abx, aby, abz, abw );
+	const __m128 linA[ LANE_COUNT ] = { lax, lay, laz, law };
+	const __m128 angA[ LANE_COUNT ] = { aax, aay, aaz, aaw };
+	const __m128 linB[ LANE_COUNT ] = { lbx, lby, lbz, lbw };
+	const __m128 angB[ LANE_COUNT ] = { abx, aby, abz, abw };
+	for ( int lane = 0; lane < LANE_COUNT; ++lane )
+	{
+		if ( m_rowIndex[ lane ] >= 0 )
+		{
+			if ( m_writeMask[ lane ] & 1 )
+			{
+				_mm_storeu_ps( linVelA[ lane ], linA[ lane ] );
+				_mm_storeu_ps( angVelA[ lane ], angA[ lane ] );
+			}
+			if ( m_writeMask[ lane ] & 2 )
+			{
+				_mm_storeu_ps( linVelB[ lane ], linB[ lane ] );
+				_mm_storeu_ps( angVelB[ lane ], angB[ lane ] );
+			}
+			rows[ m_rowIndex[ lane ] ].m_appliedImpulse = appliedImpulse[ lane ];
+		}
+	}
+}
+
+#else //BT_USE_SSE_CONTACT_BLOCK
+
+void btSolverContactBlock::solveLowerLimit( btSolverBody* bodies, btSolverConstraint* rows ) const
+{
+	for ( int lane = 0; lane < LANE_COUNT; ++lane )
+	{
+		if ( m_rowIndex[ lane ] < 0 )
+		{
+			continue;
+		}
+		btSolverConstraint& c = rows[ m_rowIndex[ lane ] ];
+		btVector3& linVelA = bodies[ m_solverBodyIdA[ lane ] ].internalGetDeltaLinearVelocity();
+		btVector3& angVelA = bodies[ m_solverBodyIdA[ lane ] ].internalGetDeltaAngularVelocity();
+		btVector3& linVelB = bodies[ m_solverBodyIdB[ lane ] ].internalGetDeltaLinearVelocity();
+		btVector3& angVelB = bodies[ m_solverBodyIdB[ lane ] ].internalGetDeltaAngularVelocity();
+
+		btScalar applied = c.m_appliedImpulse;
+		btScalar deltaImpulse = m_rhs[ lane ] - applied * m_cfm[ lane ];
+		btScalar deltaVel1Dotn = 0;
+		btScalar deltaVel2Dotn = 0;
+		for ( int i = 0; i < 3; ++i )
+		{
+			deltaVel1Dotn += m_contactNormal1[ i ][ lane ] * linVelA[ i ] + m_relpos1CrossNormal[ i ][ lane ] * angVelA[ i ];
+			deltaVel2Dotn += m_contactNormal2[ i ][ lane ] * linVelB[ i ] + m_relpos2CrossNormal[ i ][ lane ] * angVelB[ i ];
+		}
+		deltaImpulse -= deltaVel1Dotn * m_jacDiagABInv[ lane ];
+		deltaImpulse -= deltaVel2Dotn * m_jacDiagABInv[ lane ];
+		btScalar sum = applied + deltaImpulse;
+		if ( sum < m_lowerLimit[ lane ] )
+		{
+			deltaImpulse = m_lowerLimit[ lane ] - applied;
+			c.m_appliedImpulse = m_lowerLimit[ lane ];
+		}
+		else
+		{
+			c.m_appliedImpulse = sum;
+		}
+		if ( m_writeMask[ lane ] & 1 )
+		{
+			for ( int i = 0; i < 3; ++i )
+			{
+				linVelA[ i ] += m_linearComponentA[ i ][ lane ] * deltaImpulse;
+				angVelA[ i ] += m_angularComponentA[ i ][ lane ] * deltaImpulse;
+			}
+		}
+		if ( m_writeMask[ lane ] & 2 )
+		{
+			for ( int i = 0; i < 3; ++i )
+			{
+				linVelB[ i ] += m_linearComponentB[ i ][ lane ] * deltaImpulse;
+				angVelB[ i ] += m_angularComponentB[ i ][ lane ] * deltaImpulse;
+			}
+		}
+	}
+}
+
+#endif //BT_USE_SSE_CONTACT_BLOCK
@@ -0,0 +1,59 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SOLVER_CONTACT_BLOCK_H
+#define BT_SOLVER_CONTACT_BLOCK_H
+
+#include "btSolverBody.h"
+#include "btSolverConstraint.h"
+
+
+///btSolverContactBlock packs up to four contact rows in structure-of-arrays layout, so they can be solved together
+///with one SSE instruction per operation. The rows of a block must not share a dynamic solver body.
+///The solver body velocities are gathered and scattered for every solve, the applied impulse stays in the rows.
+///Without SSE (or in double precision) the lanes are solved one after the other with the same math.
+ATTRIBUTE_ALIGNED16(struct) btSolverContactBlock
+{
+	enum { LANE_COUNT = 4 };
+
+	btScalar	m_contactNormal1[3][LANE_COUNT];
+	btScalar	m_relpos1CrossNormal[3][LANE_COUNT];
+	btScalar	m_contactNormal2[3][LANE_COUNT];
+	btScalar	m_relpos2CrossNormal[3][LANE_COUNT];
+	///velocity change of body A per unit impulse, invMass and linear/angular factors are already applied
+	btScalar	m_linearComponentA[3][LANE_COUNT];
+	btScalar	m_angularComponentA[3][LANE_COUNT];
+	btScalar	m_linearComponentB[3][LANE_COUNT];
+	btScalar	m_angularComponentB[3][LANE_COUNT];
+	btScalar	m_rhs[LANE_COUNT];
+	btScalar	m_cfm[LANE_COUNT];
+	btScalar	m_jacDiagABInv[LANE_COUNT];
+	btScalar	m_lowerLimit[LANE_COUNT];
+	int	m_solverBodyIdA[LANE_COUNT];
+	int	m_solverBodyIdB[LANE_COUNT];
+	int	m_rowIndex[LANE_COUNT];	///< -1 for an unused lane
+	///bit 0 for body A, bit 1 for body B. Static and infinite-mass bodies can be shared by blocks that run in parallel,
+	///their velocities are only read, never written back
+	int	m_writeMask[LANE_COUNT];
+
+	///rowIndices has LANE_COUNT entries, negative entries are unused lanes
+	void	init( const int* rowIndices, const btSolverConstraint* rows, const btSolverBody* bodies );
+
+	///same as resolveSingleConstraintRowLowerLimit for each lane, up to rounding: the linear and angular factors are
+	///folded into m_linearComponentA/B and m_angularComponentA/B, so the velocity changes are multiplied in another order
+	void	solveLowerLimit( btSolverBody* bodies, btSolverConstraint* rows ) const;
+};
+
+#endif //BT_SOLVER_CONTACT_BLOCK_H
@@ -799,6 +799,7 @@ public:
 	btScalar m_allowedPenetration;
 	btOverlappingPairCache* m_pairCache;
 	btDispatcher* m_dispatcher;
+	bool m_staticOnly;
 
 public:
 	btClosestNotMeConvexResultCallback (btCollisionObject* me,const btVector3& fromA,const btVector3& toA,btOverlappingPairCache* pairCache,btDispatcher* dispatcher) :
@@ -806,7 +807,8 @@ public:
 		m_me(me),
 		m_allowedPenetration(0.0f),
 		m_pairCache(pairCache),
-		m_dispatcher(dispatcher)
+		m_dispatcher(dispatcher),
+		m_staticOnly(false)
 	{
 	}
 
@@ -843,6 +845,9 @@ public:
 
 		btCollisionObject* otherObj = (btCollisionObject*) proxy0->m_clientObject;
 
+		if (m_staticOnly && !otherObj->isStaticOrKinematicObject())
+			return false;
+
 		//call needsResponse, see http://code.google.com/p/bullet/issues/detail?id=179
 		if (m_dispatcher->needsResponse(m_me,otherObj))
 		{
@@ -877,21 +882,82 @@ public:
 ///internal debugging variable. this value shouldn't be too high
 int gNumClampedCcdMotions=0;
 
+bool	btDiscreteDynamicsWorld::needsCcdMotionClamping(btRigidBody* body, const btTransform& predictedTrans) const
+{
+	btScalar squareMotion = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin()).length2();
+	return getDispatchInfo().m_useContinuous && body->getCcdSquareMotionThreshold() && body->getCcdSquareMotionThreshold() < squareMotion
+		&& body->getCollisionShape()->isConvex();
+}
+
+bool	btDiscreteDynamicsWorld::ccdSweep(btRigidBody* body, const btTransform& predictedTrans, bool staticOnly, CcdSweepResult& result)
+{
+	btClosestNotMeConvexResultCallback sweepResults(body,body->getWorldTransform().getOrigin(),predictedTrans.getOrigin(),getBroadphase()->getOverlappingPairCache(),getDispatcher());
+	sweepResults.m_staticOnly = staticOnly;
+	//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
+	btSphereShape tmpSphere(body->getCcdSweptSphereRadius());//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
+	sweepResults.m_allowedPenetration=getDispatchInfo().m_allowedCcdPenetration;
+
+	sweepResults.m_collisionFilterGroup = body->getBroadphaseProxy()->m_collisionFilterGroup;
+	sweepResults.m_collisionFilterMask  = body->getBroadphaseProxy()->m_collisionFilterMask;
+	btTransform modifiedPredictedTrans = predictedTrans;
+	modifiedPredictedTrans.setBasis(body->getWorldTransform().getBasis());
+
+	convexSweepTest(&tmpSphere,body->getWorldTransform(),modifiedPredictedTrans,sweepResults);
+	if (sweepResults.hasHit() && (sweepResults.m_closestHitFraction < 1.f))
+	{
+		result.m_hitCollisionObject = sweepResults.m_hitCollisionObject;
+		result.m_closestHitFraction = sweepResults.m_closestHitFraction;
+		result.m_hitNormalWorld = sweepResults.m_hitNormalWorld;
+		return true;
+	}
+	return false;
+}
+
+void	btDiscreteDynamicsWorld::releasePredictiveContacts()
+{
+	BT_PROFILE("release predictive contact manifolds");
+
+	for (int i=0;i<m_predictiveManifolds.size();i++)
+	{
+		btPersistentManifold* manifold = m_predictiveManifolds[i];
+		this->m_dispatcher1->releaseManifold(manifold);
+	}
+	m_predictiveManifolds.clear();
+}
+
+void	btDiscreteDynamicsWorld::addPredictiveContact(btRigidBody* body, const btTransform& predictedTrans, const CcdSweepResult& sweepResult)
+{
+	btVector3 distVec = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin())*sweepResult.m_closestHitFraction;
+	btScalar distance = distVec.dot(-sweepResult.m_hitNormalWorld);
+
+	btPersistentManifold* manifold = m_dispatcher1->getNewManifold(body,sweepResult.m_hitCollisionObject);
+	m_predictiveManifolds.push_back(manifold);
+
+	btVector3 worldPointB = body->getWorldTransform().getOrigin()+distVec;
+	btVector3 localPointB = sweepResult.m_hitCollisionObject->getWorldTransform().inverse()*worldPointB;
+
+	btManifoldPoint newPoint(btVector3(0,0,0), localPointB,sweepResult.m_hitNormalWorld,distance);
+
+	bool isPredictive = true;
+	int index = manifold->addManifoldPoint(newPoint, isPredictive);
+	btManifoldPoint& pt = manifold->getContactPoint(index);
+	pt.m_combinedRestitution = 0;
+	pt.m_combinedFriction = btManifoldResult::calculateCombinedFriction(body,sweepResult.m_hitCollisionObject);
+	pt.m_positionWorldOnA = body->getWorldTransform().getOrigin();
+	pt.m_positionWorldOnB = worldPointB;
+}
 
 void	btDiscreteDynamicsWorld::createPredictiveContacts(btScalar timeStep)
 {
 	BT_PROFILE("createPredictiveContacts");
 
-	{
-		BT_PROFILE("release predictive contact manifolds");
+	releasePredictiveContacts();
 
-		for (int i=0;i<m_predictiveManifolds.size();i++)
-		{
-			btPersistentManifold* manifold = m_predictiveManifolds[i];
-			this->m_dispatcher1->releaseManifold(manifold);
-		}
-		m_predictiveManifolds.clear();
-	}
+#ifdef PREDICTIVE_CONTACT_USE_STATIC_ONLY
+	bool staticOnly = true;
+#else
+	bool staticOnly = false;
+#endif
 
 	btTransform predictedTrans;
 	for ( int i=0;i<m_nonStaticRigidBodies.size();i++)
@@ -901,79 +967,51 @@ void	btDiscreteDynamicsWorld::createPredictiveContacts(btScalar timeStep)
 
 		if (body->isActive() && (!body->isStaticOrKinematicObject()))
 		{
-
 			body->predictIntegratedTransform(timeStep, predictedTrans);
-
-			btScalar squareMotion = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin()).length2();
-
-			if (getDispatchInfo().m_useContinuous && body->getCcdSquareMotionThreshold() && body->getCcdSquareMotionThreshold() < squareMotion)
+			if (needsCcdMotionClamping(body, predictedTrans))
 			{
 				BT_PROFILE("predictive convexSweepTest");
-				if (body->getCollisionShape()->isConvex())
+				gNumClampedCcdMotions++;
+				CcdSweepResult sweepResult;
+				if (ccdSweep(body, predictedTrans, staticOnly, sweepResult))
 				{
-					gNumClampedCcdMotions++;
-#ifdef PREDICTIVE_CONTACT_USE_STATIC_ONLY
-					class StaticOnlyCallback : public btClosestNotMeConvexResultCallback
-					{
-					public:
-
-						StaticOnlyCallback (btCollisionObject* me,const btVector3& fromA,const btVector3& toA,btOverlappingPairCache* pairCache,btDispatcher* dispatcher) :
-						  btClosestNotMeConvexResultCallback(me,fromA,toA,pairCache,dispatcher)
-						{
-						}
-
-					  	virtual bool needsCollision(btBroadphaseProxy* proxy0) const
-						{
-							btCollisionObject* otherObj = (btCollisionObject*) proxy0->m_clientObject;
-							if (!otherObj->isStaticOrKinematicObject())
-								return false;
-							return btClosestNotMeConvexResultCallback::needsCollision(proxy0);
-						}
-					};
-
-					StaticOnlyCallback sweepResults(body,body->getWorldTransform().getOrigin(),predictedTrans.getOrigin(),getBroadphase()->getOverlappingPairCache(),getDispatcher());
-#else
-					btClosestNotMeConvexResultCallback sweepResults(body,body->getWorldTransform().getOrigin(),predictedTrans.getOrigin(),getBroadphase()->getOverlappingPairCache(),getDispatcher());
-#endif
-					//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
-					btSphereShape tmpSphere(body->getCcdSweptSphereRadius());//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
-					sweepResults.m_allowedPenetration=getDispatchInfo().m_allowedCcdPenetration;
-
-					sweepResults.m_collisionFilterGroup = body->getBroadphaseProxy()->m_collisionFilterGroup;
-					sweepResults.m_collisionFilterMask  = body->getBroadphaseProxy()->m_collisionFilterMask;
-					btTransform modifiedPredictedTrans = predictedTrans;
-					modifiedPredictedTrans.setBasis(body->getWorldTransform().getBasis());
-
-					convexSweepTest(&tmpSphere,body->getWorldTransform(),modifiedPredictedTrans,sweepResults);
-					if (sweepResults.hasHit() && (sweepResults.m_closestHitFraction < 1.f))
-					{
-
-						btVector3 distVec = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin())*sweepResults.m_closestHitFraction;
-						btScalar distance = distVec.dot(-sweepResults.m_hitNormalWorld);
-
-
-						btPersistentManifold* manifold = m_dispatcher1->getNewManifold(body,sweepResults.m_hitCollisionObject);
-						m_predictiveManifolds.push_back(manifold);
-
-						btVector3 worldPointB = body->getWorldTransform().getOrigin()+distVec;
-						btVector3 localPointB = sweepResults.m_hitCollisionObject->getWorldTransform().inverse()*worldPointB;
-
-						btManifoldPoint newPoint(btVector3(0,0,0), localPointB,sweepResults.m_hitNormalWorld,distance);
-
-						bool isPredictive = true;
-						int index = manifold->addManifoldPoint(newPoint, isPredictive);
-						btManifoldPoint& pt = manifold->getContactPoint(index);
-						pt.m_combinedRestitution = 0;
-						pt.m_combinedFriction = btManifoldResult::calculateCombinedFriction(body,sweepResults.m_hitCollisionObject);
-						pt.m_positionWorldOnA = body->getWorldTransform().getOrigin();
-						pt.m_positionWorldOnB = worldPointB;
-
-					}
+					addPredictiveContact(body, predictedTrans, sweepResult);
 				}
 			}
 		}
 	}
 }
+
+bool	btDiscreteDynamicsWorld::clampCcdMotion(btRigidBody* body, btScalar timeStep, btTransform& predictedTrans)
+{
+	BT_PROFILE("CCD motion clamping");
+
+#ifdef USE_STATIC_ONLY
+	bool staticOnly = true;
+#else
+	bool staticOnly = false;
+#endif
+
+	gNumClampedCcdMotions++;
+	CcdSweepResult sweepResult;
+	if (ccdSweep(body, predictedTrans, staticOnly, sweepResult))
+	{
+		//printf("clamped integration to hit fraction = %f\n",fraction);
+		body->setHitFraction(sweepResult.m_closestHitFraction);
+		body->predictIntegratedTransform(timeStep*body->getHitFraction(), predictedTrans);
+		body->setHitFraction(0.f);
+		body->proceedToTransform( predictedTrans);
+
+		//don't apply the collision response right now, it will happen next frame
+		//if you really need to, you can uncomment next 3 lines. Note that is uses zero restitution.
+		//btScalar appliedImpulse = 0.f;
+		//btScalar depth = 0.f;
+		//appliedImpulse = resolveSingleCollision(body,(btCollisionObject*)sweepResult.m_hitCollisionObject,sweepResults.m_hitPointWorld,sweepResult.m_hitNormalWorld,getSolverInfo(), depth);
+		return true;
+	}
+	return false;
+}
+
 void	btDiscreteDynamicsWorld::integrateTransforms(btScalar timeStep)
 {
 	BT_PROFILE("integrateTransforms");
@@ -985,101 +1023,22 @@ void	btDiscreteDynamicsWorld::integrateTransforms(btScalar timeStep)
 
 		if (body->isActive() && (!body->isStaticOrKinematicObject()))
 		{
-
 			body->predictIntegratedTransform(timeStep, predictedTrans);
 
-			btScalar squareMotion = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin()).length2();
-
-
-
-			if (getDispatchInfo().m_useContinuous && body->getCcdSquareMotionThreshold() && body->getCcdSquareMotionThreshold() < squareMotion)
+			if (needsCcdMotionClamping(body, predictedTrans) && clampCcdMotion(body, timeStep, predictedTrans))
 			{
-				BT_PROFILE("CCD motion clamping");
-				if (body->getCollisionShape()->isConvex())
-				{
-					gNumClampedCcdMotions++;
-#ifdef USE_STATIC_ONLY
-					class StaticOnlyCallback : public btClosestNotMeConvexResultCallback
-					{
-					public:
-
-						StaticOnlyCallback (btCollisionObject* me,const btVector3& fromA,const btVector3& toA,btOverlappingPairCache* pairCache,btDispatcher* dispatcher) :
-						  btClosestNotMeConvexResultCallback(me,fromA,toA,pairCache,dispatcher)
-						{
-						}
-
-					  	virtual bool needsCollision(btBroadphaseProxy* proxy0) const
-						{
-							btCollisionObject* otherObj = (btCollisionObject*) proxy0->m_clientObject;
-							if (!otherObj->isStaticOrKinematicObject())
-								return false;
-							return btClosestNotMeConvexResultCallback::needsCollision(proxy0);
-						}
-					};
-
-					StaticOnlyCallback sweepResults(body,body->getWorldTransform().getOrigin(),predictedTrans.getOrigin(),getBroadphase()->getOverlappingPairCache(),getDispatcher());
-#else
-					btClosestNotMeConvexResultCallback sweepResults(body,body->getWorldTransform().getOrigin(),predictedTrans.getOrigin(),getBroadphase()->getOverlappingPairCache(),getDispatcher());
-#endif
-					//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
-					btSphereShape tmpSphere(body->getCcdSweptSphereRadius());//btConvexShape* convexShape = static_cast<btConvexShape*>(body->getCollisionShape());
-					sweepResults.m_allowedPenetration=getDispatchInfo().m_allowedCcdPenetration;
-
-					sweepResults.m_collisionFilterGroup = body->getBroadphaseProxy()->m_collisionFilterGroup;
-					sweepResults.m_collisionFilterMask  = body->getBroadphaseProxy()->m_collisionFilterMask;
-					btTransform modifiedPredictedTrans = predictedTrans;
-					modifiedPredictedTrans.setBasis(body->getWorldTransform().getBasis());
-
-					convexSweepTest(&tmpSphere,body->getWorldTransform(),modifiedPredictedTrans,sweepResults);
-					if (sweepResults.hasHit() && (sweepResults.m_closestHitFraction < 1.f))
-					{
-
-						//printf("clamped integration to hit fraction = %f\n",fraction);
-						body->setHitFraction(sweepResults.m_closestHitFraction);
-						body->predictIntegratedTransform(timeStep*body->getHitFraction(), predictedTrans);
-						body->setHitFraction(0.f);
-						body->proceedToTransform( predictedTrans);
-
-#if 0
-						btVector3 linVel = body->getLinearVelocity();
-
-						btScalar maxSpeed = body->getCcdMotionThreshold()/getSolverInfo().m_timeStep;
-						btScalar maxSpeedSqr = maxSpeed*maxSpeed;
-						if (linVel.length2()>maxSpeedSqr)
-						{
-							linVel.normalize();
-							linVel*= maxSpeed;
-							body->setLinearVelocity(linVel);
-							btScalar ms2 = body->getLinearVelocity().length2();
-							body->predictIntegratedTransform(timeStep, predictedTrans);
-
-							btScalar sm2 = (predictedTrans.getOrigin()-body->getWorldTransform().getOrigin()).length2();
-							btScalar smt = body->getCcdSquareMotionThreshold();
-							printf("sm2=%f\n",sm2);
-						}
-#else
-
-						//don't apply the collision response right now, it will happen next frame
-						//if you really need to, you can uncomment next 3 lines. Note that is uses zero restitution.
-						//btScalar appliedImpulse = 0.f;
-						//btScalar depth = 0.f;
-						//appliedImpulse = resolveSingleCollision(body,(btCollisionObject*)sweepResults.m_hitCollisionObject,sweepResults.m_hitPointWorld,sweepResults.m_hitNormalWorld,getSolverInfo(), depth);
-
-
-#endif
-
-        				continue;
-					}
-				}
+				continue;
 			}
 
-
 			body->proceedToTransform( predictedTrans);
-
 		}
-
 	}
 
+	applySpeculativeContactRestitution();
+}
+
+void	btDiscreteDynamicsWorld::applySpeculativeContactRestitution()
+{
 	///this should probably be switched on by default, but it is not well tested yet
 	if (m_applySpeculativeContactRestitution)
 	{
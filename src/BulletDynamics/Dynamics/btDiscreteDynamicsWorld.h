@@ -69,9 +69,27 @@ protected:
 
 	btAlignedObjectArray<btPersistentManifold*>	m_predictiveManifolds;
 
+	///closest hit of the swept sphere used for predictive contacts and CCD motion clamping
+	struct CcdSweepResult
+	{
+		const btCollisionObject*	m_hitCollisionObject;
+		btScalar	m_closestHitFraction;
+		btVector3	m_hitNormalWorld;
+	};
+
 	virtual void	predictUnconstraintMotion(btScalar timeStep);
 	
 	virtual void	integrateTransforms(btScalar timeStep);
+
+	bool	needsCcdMotionClamping(btRigidBody* body, const btTransform& predictedTrans) const;
+
+	///sweeps the ccd sphere of the body towards predictedTrans, returns true if it hits something before reaching it
+	bool	ccdSweep(btRigidBody* body, const btTransform& predictedTrans, bool staticOnly, CcdSweepResult& result);
+
+	///returns true if the motion was clamped, in that case the body is already moved to the time of impact
+	bool	clampCcdMotion(btRigidBody* body, btScalar timeStep, btTransform& predictedTrans);
+
+	void	applySpeculativeContactRestitution();
 		
 	virtual void	calculateSimulationIslands();
 
@@ -85,7 +103,11 @@ protected:
 
 	virtual void	internalSingleStepSimulation( btScalar timeStep);
 
-	void	createPredictiveContacts(btScalar timeStep);
+	virtual void	createPredictiveContacts(btScalar timeStep);
+
+	void	releasePredictiveContacts();
+
+	void	addPredictiveContact(btRigidBody* body, const btTransform& predictedTrans, const CcdSweepResult& sweepResult);
 
 	virtual void	saveKinematicState(btScalar timeStep);
 
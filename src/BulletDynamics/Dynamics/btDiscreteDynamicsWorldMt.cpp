@@ -0,0 +1,521 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btDiscreteDynamicsWorldMt.h"
+
+//collision detection
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
+#include "BulletCollision/BroadphaseCollision/btSimpleBroadphase.h"
+#include "BulletCollision/BroadphaseCollision/btCollisionAlgorithm.h"
+#include "BulletCollision/CollisionShapes/btCollisionShape.h"
+#include "btSimulationIslandManagerMt.h"
+#include "LinearMath/btTransformUtil.h"
+#include "LinearMath/btQuickprof.h"
+
+//rigidbody & constraints
+#include "BulletDynamics/Dynamics/btRigidBody.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolver.h"
+#include "BulletDynamics/ConstraintSolver/btContactSolverInfo.h"
+#include "BulletDynamics/ConstraintSolver/btTypedConstraint.h"
+
+
+
+///
+/// btConstraintSolverPoolMt
+///
+
+btConstraintSolverPoolMt::ThreadSolver* btConstraintSolverPoolMt::getAndLockThreadSolver()
+{
+	int i = 0;
+#if BT_THREADSAFE
+	i = btGetCurrentThreadIndex() % m_solvers.size();
+#endif // #if BT_THREADSAFE
+	while ( true )
+	{
+		ThreadSolver& solver = m_solvers[ i ];
+		if ( btMutexTryLock( &solver.mutex ) )
+		{
+			return &solver;
+		}
+		// failed, try the next one
+		i = ( i + 1 ) % m_solvers.size();
+	}
+	return NULL;
+}
+
+void btConstraintSolverPoolMt::init( btConstraintSolver** solvers, int numSolvers )
+{
+	m_solverType = BT_SEQUENTIAL_IMPULSE_SOLVER;
+	m_solvers.resize( numSolvers );
+	for ( int i = 0; i < numSolvers; ++i )
+	{
+		m_solvers[ i ].solver = solvers[ i ];
+	}
+	if ( numSolvers > 0 )
+	{
+		m_solverType = solvers[ 0 ]->getSolverType();
+	}
+}
+
+// create the solvers for me
+btConstraintSolverPoolMt::btConstraintSolverPoolMt( int numSolvers )
+{
+	btAlignedObjectArray<btConstraintSolver*> solvers;
+	solvers.reserve( numSolvers );
+	for ( int i = 0; i < numSolvers; ++i )
+	{
+		void* mem = btAlignedAlloc( sizeof( btSequentialImpulseConstraintSolver ), 16 );
+		btConstraintSolver* solver = new ( mem ) btSequentialImpulseConstraintSolver();
+		solvers.push_back( solver );
+	}
+	init( &solvers[ 0 ], numSolvers );
+	m_ownsSolvers = true;
+}
+
+// pass in fully constructed solvers (destructor will NOT delete them)
+btConstraintSolverPoolMt::btConstraintSolverPoolMt( btConstraintSolver** solvers, int numSolvers )
+{
+	init( solvers, numSolvers );
+	m_ownsSolvers = false;
+}
+
+btConstraintSolverPoolMt::~btConstraintSolverPoolMt()
+{
+	// delete all solvers that we created
+	if ( m_ownsSolvers )
+	{
+		for ( int i = 0; i < m_solvers.size(); ++i )
+		{
+			ThreadSolver& solver = m_solvers[ i ];
+			solver.solver->~btConstraintSolver();
+			btAlignedFree( solver.solver );
+			solver.solver = NULL;
+		}
+	}
+}
+
+///solve a group of constraints
+btScalar btConstraintSolverPoolMt::solveGroup( btCollisionObject** bodies,
+	int numBodies,
+	btPersistentManifold** manifolds,
+	int numManifolds,
+	btTypedConstraint** constraints,
+	int numConstraints,
+	const btContactSolverInfo& info,
+	btIDebugDraw* debugDrawer,
+	btDispatcher* dispatcher
+)
+{
+	ThreadSolver* ts = getAndLockThreadSolver();
+	if ( info.m_solverMode & SOLVER_RANDMIZE_ORDER )
+	{
+		// which pooled solver gets a group depends on thread timing, so every group starts from the same random seed
+		ts->solver->reset();
+	}
+	ts->solver->solveGroup( bodies, numBodies, manifolds, numManifolds, constraints, numConstraints, info, debugDrawer, dispatcher );
+	btMutexUnlock( &ts->mutex );
+	return 0.0f;
+}
+
+void btConstraintSolverPoolMt::prepareSolve( int numBodies, int numManifolds )
+{
+	for ( int i = 0; i < m_solvers.size(); ++i )
+	{
+		m_solvers[ i ].solver->prepareSolve( numBodies, numManifolds );
+	}
+}
+
+void btConstraintSolverPoolMt::allSolved( const btContactSolverInfo& info, btIDebugDraw* debugDrawer )
+{
+	for ( int i = 0; i < m_solvers.size(); ++i )
+	{
+		m_solvers[ i ].solver->allSolved( info, debugDrawer );
+	}
+}
+
+void btConstraintSolverPoolMt::reset()
+{
+	for ( int i = 0; i < m_solvers.size(); ++i )
+	{
+		ThreadSolver& solver = m_solvers[ i ];
+		btMutexLock( &solver.mutex );
+		solver.solver->reset();
+		btMutexUnlock( &solver.mutex );
+	}
+}
+
+
+///
+/// btSolverIslandCallbackMt -- solves each island it is handed with the (pooled) constraint solver,
+///                             may be called from several threads at once
+///
+struct btSolverIslandCallbackMt : public btSimulationIslandManagerMt::IslandCallback
+{
+	btContactSolverInfo*	m_solverInfo;
+	btConstraintSolver*		m_solver;
+	btIDebugDraw*			m_debugDrawer;
+	btDispatcher*			m_dispatcher;
+
+	btSolverIslandCallbackMt(
+		btConstraintSolver*	solver,
+		btDispatcher* dispatcher)
+		:m_solverInfo(NULL),
+		m_solver(solver),
+		m_debugDrawer(NULL),
+		m_dispatcher(dispatcher)
+	{
+
+	}
+
+	btSolverIslandCallbackMt& operator=(btSolverIslandCallbackMt& other)
+	{
+		btAssert(0);
+		(void)other;
+		return *this;
+	}
+
+	SIMD_FORCE_INLINE void setup ( btContactSolverInfo* solverInfo, btIDebugDraw* debugDrawer)
+	{
+		btAssert(solverInfo);
+		m_solverInfo = solverInfo;
+		m_debugDrawer = debugDrawer;
+	}
+
+
+	virtual	void	processIsland( btCollisionObject** bodies,
+		int numBodies,
+		btPersistentManifold** manifolds,
+		int numManifolds,
+		btTypedConstraint** constraints,
+		int numConstraints,
+		int islandId
+		)
+	{
+		(void)islandId;
+		m_solver->solveGroup( bodies,
+			numBodies,
+			manifolds,
+			numManifolds,
+			constraints,
+			numConstraints,
+			*m_solverInfo,
+			m_debugDrawer,
+			m_dispatcher
+			);
+	}
+
+};
+
+
+///sorts the deferred ccd work back into body order, so it is processed like in the serial world
+class btCcdBodySweepSortPredicate
+{
+	public:
+
+		template <typename T>
+		SIMD_FORCE_INLINE bool operator() ( const T& lhs, const T& rhs ) const
+		{
+			return lhs.m_bodyIndex < rhs.m_bodyIndex;
+		}
+};
+
+extern int gNumClampedCcdMotions;
+
+
+struct btDiscreteDynamicsWorldMt::UpdaterUnconstrainedMotion : public btIParallelForBody
+{
+	btScalar timeStep;
+	btRigidBody** rigidBodies;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "predictUnconstraintMotion loop" );
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btRigidBody* body = rigidBodies[ i ];
+			if ( !body->isStaticOrKinematicObject() )
+			{
+				//don't integrate/update velocities here, it happens in the constraint solver
+				body->applyDamping( timeStep );
+				body->predictIntegratedTransform( timeStep, body->getInterpolationWorldTransform() );
+			}
+		}
+	}
+};
+
+
+struct btDiscreteDynamicsWorldMt::UpdaterCreatePredictiveContacts : public btIParallelForBody
+{
+	btScalar timeStep;
+	btRigidBody** rigidBodies;
+	bool staticOnly;
+	btDiscreteDynamicsWorldMt* world;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "createPredictiveContacts loop" );
+		btTransform predictedTrans;
+		int numSweeps = 0;
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btRigidBody* body = rigidBodies[ i ];
+			body->setHitFraction( 1.f );
+
+			if ( body->isActive() && ( !body->isStaticOrKinematicObject() ) )
+			{
+				body->predictIntegratedTransform( timeStep, predictedTrans );
+				if ( world->needsCcdMotionClamping( body, predictedTrans ) )
+				{
+					numSweeps++;
+					CcdBodySweep sweep;
+					if ( world->ccdSweep( body, predictedTrans, staticOnly, sweep.m_sweepResult ) )
+					{
+						// the manifold is created later on the calling thread
+						sweep.m_bodyIndex = i;
+						sweep.m_predictedTrans = predictedTrans;
+						btMutexLock( &world->m_ccdMutex );
+						world->m_ccdBodySweeps.push_back( sweep );
+						btMutexUnlock( &world->m_ccdMutex );
+					}
+				}
+			}
+		}
+		if ( numSweeps )
+		{
+			btMutexLock( &world->m_ccdMutex );
+			gNumClampedCcdMotions += numSweeps;
+			btMutexUnlock( &world->m_ccdMutex );
+		}
+	}
+};
+
+
+struct btDiscreteDynamicsWorldMt::UpdaterClassifyCcdMotion : public btIParallelForBody
+{
+	btScalar timeStep;
+	btRigidBody** rigidBodies;
+	btDiscreteDynamicsWorldMt* world;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "classify ccd motion loop" );
+		btTransform predictedTrans;
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btRigidBody* body = rigidBodies[ i ];
+			char needsClamping = 0;
+			if ( body->isActive() && ( !body->isStaticOrKinematicObject() ) )
+			{
+				body->predictIntegratedTransform( timeStep, predictedTrans );
+				needsClamping = world->needsCcdMotionClamping( body, predictedTrans ) ? 1 : 0;
+			}
+			world->m_needsCcdClamping[ i ] = needsClamping;
+		}
+	}
+};
+
+
+struct btDiscreteDynamicsWorldMt::UpdaterIntegrateTransforms : public btIParallelForBody
+{
+	btScalar timeStep;
+	btRigidBody** rigidBodies;
+	btDiscreteDynamicsWorldMt* world;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "integrateTransforms loop" );
+		btTransform predictedTrans;
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btRigidBody* body = rigidBodies[ i ];
+			body->setHitFraction( 1.f );
+
+			if ( body->isActive() && ( !body->isStaticOrKinematicObject() ) )
+			{
+				body->predictIntegratedTransform( timeStep, predictedTrans );
+				// the ranges never contain bodies that need CCD clamping, see integrateTransforms
+				btAssert( !world->m_needsCcdClamping[ i ] );
+				body->proceedToTransform( predictedTrans );
+			}
+		}
+	}
+};
+
+
+btDiscreteDynamicsWorldMt::btDiscreteDynamicsWorldMt(btDispatcher* dispatcher,btBroadphaseInterface* pairCache,btConstraintSolverPoolMt* constraintSolver, btCollisionConfiguration* collisionConfiguration)
+: btDiscreteDynamicsWorld(dispatcher,pairCache,constraintSolver,collisionConfiguration)
+{
+	if (m_ownsIslandManager)
+	{
+		m_islandManager->~btSimulationIslandManager();
+		btAlignedFree( m_islandManager);
+	}
+	{
+		void* mem = btAlignedAlloc(sizeof(btSimulationIslandManagerMt),16);
+		btSimulationIslandManagerMt* im = new (mem) btSimulationIslandManagerMt();
+		m_islandManager = im;
+		m_ownsIslandManager = true;
+	}
+	if (m_ownsConstraintSolver)
+	{
+		///a single solver can't solve several islands at once, replace the default one by a pool
+		m_constraintSolver->~btConstraintSolver();
+		btAlignedFree(m_constraintSolver);
+
+		void* mem = btAlignedAlloc(sizeof(btConstraintSolverPoolMt),16);
+		m_constraintSolver = new (mem) btConstraintSolverPoolMt(btGetTaskScheduler()->getMaxNumThreads());
+	}
+	{
+		void* mem = btAlignedAlloc(sizeof(btSolverIslandCallbackMt),16);
+		m_solverIslandCallbackMt = new (mem) btSolverIslandCallbackMt (m_constraintSolver, dispatcher);
+	}
+}
+
+
+btDiscreteDynamicsWorldMt::~btDiscreteDynamicsWorldMt()
+{
+	if (m_solverIslandCallbackMt)
+	{
+		m_solverIslandCallbackMt->~btSolverIslandCallbackMt();
+		btAlignedFree(m_solverIslandCallbackMt);
+	}
+}
+
+
+void	btDiscreteDynamicsWorldMt::solveConstraints(btContactSolverInfo& solverInfo)
+{
+	BT_PROFILE("solveConstraints");
+
+	m_solverIslandCallbackMt->setup(&solverInfo, getDebugDrawer());
+	m_constraintSolver->prepareSolve(getCollisionWorld()->getNumCollisionObjects(), getCollisionWorld()->getDispatcher()->getNumManifolds());
+
+	/// solve all the constraints for this island
+	btSimulationIslandManagerMt* im = static_cast<btSimulationIslandManagerMt*>(m_islandManager);
+	im->buildAndProcessIslands( getCollisionWorld()->getDispatcher(), getCollisionWorld(), m_constraints, m_solverIslandCallbackMt );
+
+	m_constraintSolver->allSolved(solverInfo, m_debugDrawer);
+}
+
+
+void	btDiscreteDynamicsWorldMt::predictUnconstraintMotion( btScalar timeStep )
+{
+	BT_PROFILE( "predictUnconstraintMotion" );
+	if ( m_nonStaticRigidBodies.size() > 0 )
+	{
+		UpdaterUnconstrainedMotion update;
+		update.timeStep = timeStep;
+		update.rigidBodies = &m_nonStaticRigidBodies[ 0 ];
+		int grainSize = 50;  // num of iterations per task for task scheduler
+		btParallelFor( 0, m_nonStaticRigidBodies.size(), grainSize, update );
+	}
+}
+
+
+void	btDiscreteDynamicsWorldMt::createPredictiveContacts( btScalar timeStep )
+{
+	BT_PROFILE( "createPredictiveContacts" );
+
+	releasePredictiveContacts();
+
+	if ( m_nonStaticRigidBodies.size() > 0 )
+	{
+		m_ccdBodySweeps.resize( 0 );
+
+		UpdaterCreatePredictiveContacts update;
+		update.world = this;
+		update.timeStep = timeStep;
+		update.rigidBodies = &m_nonStaticRigidBodies[ 0 ];
+#ifdef PREDICTIVE_CONTACT_USE_STATIC_ONLY
+		update.staticOnly = true;
+#else
+		update.staticOnly = false;
+#endif
+		int grainSize = 50;  // num of iterations per task for task scheduler
+		btParallelFor( 0, m_nonStaticRigidBodies.size(), grainSize, update );
+
+		// the dispatcher hands out manifolds in call order, so create them in body order
+		m_ccdBodySweeps.quickSort( btCcdBodySweepSortPredicate() );
+		for ( int i = 0; i < m_ccdBodySweeps.size(); ++i )
+		{
+			const CcdBodySweep& sweep = m_ccdBodySweeps[ i ];
+			addPredictiveContact( m_nonStaticRigidBodies[ sweep.m_bodyIndex ], sweep.m_predictedTrans, sweep.m_sweepResult );
+		}
+	}
+}
+
+
+void	btDiscreteDynamicsWorldMt::integrateTransforms( btScalar timeStep )
+{
+	BT_PROFILE( "integrateTransforms" );
+	if ( m_nonStaticRigidBodies.size() > 0 )
+	{
+		int numBodies = m_nonStaticRigidBodies.size();
+		int grainSize = 50;  // num of iterations per task for task scheduler
+
+		// the CCD sweep of a body sees the bodies before it moved and the bodies after it not yet moved,
+		// so first find the bodies that need clamping, without moving anything
+		m_needsCcdClamping.resize( numBodies );
+		UpdaterClassifyCcdMotion classify;
+		classify.world = this;
+		classify.timeStep = timeStep;
+		classify.rigidBodies = &m_nonStaticRigidBodies[ 0 ];
+		btParallelFor( 0, numBodies, grainSize, classify );
+
+		m_ccdBodyIndices.resize( 0 );
+		for ( int i = 0; i < numBodies; ++i )
+		{
+			if ( m_needsCcdClamping[ i ] )
+			{
+				m_ccdBodyIndices.push_back( i );
+			}
+		}
+		m_ccdBodyIndices.push_back( numBodies );
+
+		// then move the runs of bodies between them in parallel, and the clamped bodies serially in body order
+		UpdaterIntegrateTransforms update;
+		update.world = this;
+		update.timeStep = timeStep;
+		update.rigidBodies = &m_nonStaticRigidBodies[ 0 ];
+		btTransform predictedTrans;
+		int runBegin = 0;
+		for ( int i = 0; i < m_ccdBodyIndices.size(); ++i )
+		{
+			int runEnd = m_ccdBodyIndices[ i ];
+			if ( runEnd - runBegin > grainSize )
+			{
+				btParallelFor( runBegin, runEnd, grainSize, update );
+			}
+			else if ( runEnd > runBegin )
+			{
+				update.forLoop( runBegin, runEnd );
+			}
+			if ( runEnd < numBodies )
+			{
+				btRigidBody* body = m_nonStaticRigidBodies[ runEnd ];
+				body->setHitFraction( 1.f );
+				body->predictIntegratedTransform( timeStep, predictedTrans );
+				if ( !clampCcdMotion( body, timeStep, predictedTrans ) )
+				{
+					body->proceedToTransform( predictedTrans );
+				}
+			}
+			runBegin = runEnd + 1;
+		}
+	}
+
+	applySpeculativeContactRestitution();
+}
+
@@ -0,0 +1,148 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef BT_DISCRETE_DYNAMICS_WORLD_MT_H
+#define BT_DISCRETE_DYNAMICS_WORLD_MT_H
+
+#include "btDiscreteDynamicsWorld.h"
+#include "btSimulationIslandManagerMt.h"
+#include "BulletDynamics/ConstraintSolver/btConstraintSolver.h"
+#include "LinearMath/btThreads.h"
+
+struct btSolverIslandCallbackMt;
+
+
+///
+/// btConstraintSolverPoolMt - masquerades as a constraint solver, but really it is a threadsafe pool of them.
+///
+///  Each simulation island is solved by one of the pooled solvers, so several islands can be solved at
+///  the same time (one per thread). The solvers are created by the pool (btSequentialImpulseConstraintSolver)
+///  or passed in by the user, in which case the user keeps ownership.
+///
+ATTRIBUTE_ALIGNED16(class) btConstraintSolverPoolMt : public btConstraintSolver
+{
+public:
+	// create the solvers for me
+	explicit btConstraintSolverPoolMt( int numSolvers );
+
+	// pass in fully constructed solvers (destructor will NOT delete them)
+	btConstraintSolverPoolMt( btConstraintSolver** solvers, int numSolvers );
+
+	virtual ~btConstraintSolverPoolMt();
+
+	///solve a group of constraints
+	virtual btScalar solveGroup( btCollisionObject** bodies,
+		int numBodies,
+		btPersistentManifold** manifolds,
+		int numManifolds,
+		btTypedConstraint** constraints,
+		int numConstraints,
+		const btContactSolverInfo& info,
+		btIDebugDraw* debugDrawer,
+		btDispatcher* dispatcher
+		);
+
+	virtual void prepareSolve( int numBodies, int numManifolds );
+	virtual void allSolved( const btContactSolverInfo& info, btIDebugDraw* debugDrawer );
+
+	///clear internal cached data and reset random seed
+	virtual void reset();
+
+	virtual btConstraintSolverType getSolverType() const
+	{
+		return m_solverType;
+	}
+
+private:
+	const static size_t kCacheLineSize = 128;
+	struct ThreadSolver
+	{
+		btConstraintSolver* solver;
+		btSpinMutex mutex;
+		char _cachelinePad[ kCacheLineSize - sizeof( btSpinMutex ) - sizeof( void* ) ];  // keep mutexes from sharing a cache line
+	};
+	btAlignedObjectArray<ThreadSolver> m_solvers;
+	btConstraintSolverType m_solverType;
+	bool m_ownsSolvers;
+
+	ThreadSolver* getAndLockThreadSolver();
+	void init( btConstraintSolver** solvers, int numSolvers );
+};
+
+
+
+///
+/// btDiscreteDynamicsWorldMt -- a version of DiscreteDynamicsWorld with some minor changes to support
+///                              solving simulation islands on multiple threads.
+///
+///  Should function exactly like btDiscreteDynamicsWorld.
+///  3 methods that iterate over all of the rigidbodies can run in parallel:
+///     - predictUnconstraintMotion
+///     - integrateTransforms
+///     - createPredictiveContacts
+///  and the simulation islands are solved in parallel with one pooled solver per thread.
+///  Bodies whose motion gets clamped by CCD are moved serially, after the bodies before them and before the bodies
+///  after them, so every CCD sweep sees the same world as in btDiscreteDynamicsWorld.
+///
+ATTRIBUTE_ALIGNED16(class) btDiscreteDynamicsWorldMt : public btDiscreteDynamicsWorld
+{
+protected:
+	btSolverIslandCallbackMt* m_solverIslandCallbackMt;
+
+	///a ccd sweep that hit something, collected on worker threads and processed serially in body order
+	struct CcdBodySweep
+	{
+		int	m_bodyIndex;
+		btTransform	m_predictedTrans;
+		CcdSweepResult	m_sweepResult;
+
+		CcdBodySweep()
+			:m_bodyIndex(-1),
+			m_predictedTrans(btTransform::getIdentity())
+		{
+			m_sweepResult.m_hitCollisionObject = 0;
+			m_sweepResult.m_closestHitFraction = btScalar(1.);
+			m_sweepResult.m_hitNormalWorld.setZero();
+		}
+	};
+	btAlignedObjectArray<CcdBodySweep>	m_ccdBodySweeps;
+	///per body flag of integrateTransforms, set when the motion of the body needs CCD clamping
+	btAlignedObjectArray<char>	m_needsCcdClamping;
+	btAlignedObjectArray<int>	m_ccdBodyIndices;
+	btSpinMutex	m_ccdMutex;
+
+	struct UpdaterUnconstrainedMotion;
+	struct UpdaterCreatePredictiveContacts;
+	struct UpdaterClassifyCcdMotion;
+	struct UpdaterIntegrateTransforms;
+
+	virtual void solveConstraints(btContactSolverInfo& solverInfo);
+	virtual void predictUnconstraintMotion( btScalar timeStep );
+	virtual void createPredictiveContacts( btScalar timeStep );
+	virtual void integrateTransforms( btScalar timeStep );
+
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btDiscreteDynamicsWorldMt(btDispatcher* dispatcher,
+		btBroadphaseInterface* pairCache,
+		btConstraintSolverPoolMt* constraintSolver, // Note this should be a solver-pool for multi-threading
+		btCollisionConfiguration* collisionConfiguration
+		);
+	virtual ~btDiscreteDynamicsWorldMt();
+};
+
+#endif //BT_DISCRETE_DYNAMICS_WORLD_MT_H
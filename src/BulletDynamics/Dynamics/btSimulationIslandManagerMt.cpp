@@ -0,0 +1,445 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "LinearMath/btScalar.h"
+#include "LinearMath/btThreads.h"
+#include "btSimulationIslandManagerMt.h"
+#include "BulletCollision/BroadphaseCollision/btDispatcher.h"
+#include "BulletCollision/NarrowPhaseCollision/btPersistentManifold.h"
+#include "BulletCollision/CollisionDispatch/btCollisionObject.h"
+#include "BulletCollision/CollisionDispatch/btCollisionWorld.h"
+#include "BulletDynamics/ConstraintSolver/btTypedConstraint.h"
+
+//#include <stdio.h>
+#include "LinearMath/btQuickprof.h"
+
+
+SIMD_FORCE_INLINE int calcBatchCost( int bodies, int manifolds, int constraints )
+{
+	// rough estimate of the cost of a batch, used for merging
+	int batchCost = bodies + 8 * manifolds + 4 * constraints;
+	return batchCost;
+}
+
+
+SIMD_FORCE_INLINE int calcBatchCost( const btSimulationIslandManagerMt::Island* island )
+{
+	return calcBatchCost( island->bodyArray.size(), island->manifoldArray.size(), island->constraintArray.size() );
+}
+
+
+static inline int getManifoldIslandId(const btPersistentManifold* lhs)
+{
+	int islandId;
+	const btCollisionObject* rcolObj0 = static_cast<const btCollisionObject*>(lhs->getBody0());
+	const btCollisionObject* rcolObj1 = static_cast<const btCollisionObject*>(lhs->getBody1());
+	islandId= rcolObj0->getIslandTag()>=0?rcolObj0->getIslandTag():rcolObj1->getIslandTag();
+	return islandId;
+}
+
+
+static inline int getConstraintIslandId(const btTypedConstraint* lhs)
+{
+	int islandId;
+	const btCollisionObject& rcolObj0 = lhs->getRigidBodyA();
+	const btCollisionObject& rcolObj1 = lhs->getRigidBodyB();
+	islandId= rcolObj0.getIslandTag()>=0?rcolObj0.getIslandTag():rcolObj1.getIslandTag();
+	return islandId;
+}
+
+
+class btConstraintIslandSortPredicate
+{
+	public:
+
+		SIMD_FORCE_INLINE bool operator() ( const btTypedConstraint* lhs, const btTypedConstraint* rhs ) const
+		{
+			return getConstraintIslandId(lhs) < getConstraintIslandId(rhs);
+		}
+};
+
+
+class IslandBatchSizeSortPredicate
+{
+	public:
+
+		SIMD_FORCE_INLINE bool operator() ( const btSimulationIslandManagerMt::Island* lhs, const btSimulationIslandManagerMt::Island* rhs ) const
+		{
+			int lCost = calcBatchCost( lhs );
+			int rCost = calcBatchCost( rhs );
+			// ties are broken by island id, so the batches don't depend on the order the islands were found in
+			return lCost > rCost || ( lCost == rCost && lhs->id < rhs->id );
+		}
+};
+
+
+void btSimulationIslandManagerMt::Island::append( const Island& other )
+{
+	// append bodies
+	for ( int i = 0; i < other.bodyArray.size(); ++i )
+	{
+		bodyArray.push_back( other.bodyArray[ i ] );
+	}
+	// append manifolds
+	for ( int i = 0; i < other.manifoldArray.size(); ++i )
+	{
+		manifoldArray.push_back( other.manifoldArray[ i ] );
+	}
+	// append constraints
+	for ( int i = 0; i < other.constraintArray.size(); ++i )
+	{
+		constraintArray.push_back( other.constraintArray[ i ] );
+	}
+}
+
+
+btSimulationIslandManagerMt::btSimulationIslandManagerMt()
+{
+	m_islandDispatch = parallelIslandDispatch;
+	m_minimumSolverBatchSize = calcBatchCost( 0, 128, 0 );
+}
+
+
+btSimulationIslandManagerMt::~btSimulationIslandManagerMt()
+{
+	for ( int i = 0; i < m_allocatedIslands.size(); ++i )
+	{
+		m_allocatedIslands[ i ]->~Island();
+		btAlignedFree( m_allocatedIslands[ i ] );
+	}
+	m_allocatedIslands.resize( 0 );
+	m_activeIslands.resize( 0 );
+}
+
+
+btSimulationIslandManagerMt::Island* btSimulationIslandManagerMt::getIsland( int id )
+{
+	btAssert( id >= 0 );
+	btAssert( id < m_lookupIslandFromId.size() );
+	return m_lookupIslandFromId[ id ];
+}
+
+
+btSimulationIslandManagerMt::Island* btSimulationIslandManagerMt::allocateIsland( int id, int numBodies )
+{
+	// islands are recycled from frame to frame, so their arrays keep their capacity
+	Island* island = NULL;
+	int allocSize = m_activeIslands.size();
+	if ( allocSize < m_allocatedIslands.size() )
+	{
+		island = m_allocatedIslands[ allocSize ];
+	}
+	else
+	{
+		void* mem = btAlignedAlloc( sizeof( Island ), 16 );
+		island = new ( mem ) Island();
+		m_allocatedIslands.push_back( island );
+	}
+	island->id = id;
+	island->isSleeping = false;
+	island->bodyArray.resize( 0 );
+	island->bodyArray.reserve( numBodies );
+	island->manifoldArray.resize( 0 );
+	island->constraintArray.resize( 0 );
+
+	m_lookupIslandFromId[ id ] = island;
+	m_activeIslands.push_back( island );
+	return island;
+}
+
+
+void btSimulationIslandManagerMt::initIslandPools()
+{
+	// reset the lookup table, every island id maps to no island
+	int numElem = getUnionFind().getNumElements();
+	m_lookupIslandFromId.resize( numElem );
+	for ( int i = 0; i < m_lookupIslandFromId.size(); ++i )
+	{
+		m_lookupIslandFromId[ i ] = NULL;
+	}
+	m_activeIslands.resize( 0 );
+}
+
+
+void btSimulationIslandManagerMt::addBodiesToIslands( btCollisionWorld* collisionWorld )
+{
+	btCollisionObjectArray& collisionObjects = collisionWorld->getCollisionObjectArray();
+	int endIslandIndex = 1;
+	int startIslandIndex;
+	int numElem = getUnionFind().getNumElements();
+
+	// create explicit islands and add bodies to each
+	for ( startIslandIndex = 0; startIslandIndex < numElem; startIslandIndex = endIslandIndex )
+	{
+		int islandId = getUnionFind().getElement( startIslandIndex ).m_id;
+
+		// find end index
+		for ( endIslandIndex = startIslandIndex; ( endIslandIndex < numElem ) && ( getUnionFind().getElement( endIslandIndex ).m_id == islandId ); endIslandIndex++ )
+		{
+		}
+		// check if island is sleeping
+		bool islandSleeping = true;
+		for ( int iElem = startIslandIndex; iElem < endIslandIndex; iElem++ )
+		{
+			int i = getUnionFind().getElement( iElem ).m_sz;
+			btCollisionObject* colObj = collisionObjects[ i ];
+			if ( colObj->isActive() )
+			{
+				islandSleeping = false;
+			}
+		}
+		if ( !islandSleeping )
+		{
+			// want to count the number of bodies before allocating the island to optimize memory usage of the Island structures
+			int numBodies = endIslandIndex - startIslandIndex;
+			Island* island = allocateIsland( islandId, numBodies );
+
+			// add bodies to island
+			for ( int iElem = startIslandIndex; iElem < endIslandIndex; iElem++ )
+			{
+				int i = getUnionFind().getElement( iElem ).m_sz;
+				btCollisionObject* colObj = collisionObjects[ i ];
+				island->bodyArray.push_back( colObj );
+			}
+		}
+	}
+}
+
+
+void btSimulationIslandManagerMt::addManifoldsToIslands( btDispatcher* dispatcher )
+{
+	(void) dispatcher;
+	// sort the same way as btSimulationIslandManager::buildAndProcessIslands does,
+	// so each island sees its manifolds in the same order as with the serial island manager
+	sortIslandManifolds();
+
+	for ( int i = 0; i < m_islandmanifold.size(); i++ )
+	{
+		btPersistentManifold* manifold = m_islandmanifold[ i ];
+		int islandId = getManifoldIslandId( manifold );
+		if ( islandId >= 0 )
+		{
+			// if island is not sleeping,
+			if ( Island* island = getIsland( islandId ) )
+			{
+				island->manifoldArray.push_back( manifold );
+			}
+		}
+	}
+}
+
+
+void btSimulationIslandManagerMt::addConstraintsToIslands( btAlignedObjectArray<btTypedConstraint*>& constraints )
+{
+	// constraints are expected to be sorted by island already (see buildAndProcessIslands)
+	for ( int i = 0; i < constraints.size(); i++ )
+	{
+		btTypedConstraint* constraint = constraints[ i ];
+		int islandId = getConstraintIslandId( constraint );
+		if ( islandId >= 0 )
+		{
+			// if island is not sleeping,
+			if ( Island* island = getIsland( islandId ) )
+			{
+				island->constraintArray.push_back( constraint );
+			}
+		}
+	}
+}
+
+
+void btSimulationIslandManagerMt::mergeIslands()
+{
+	// sort islands in order of decreasing batch size, the big ones get dispatched first
+	m_activeIslands.quickSort( IslandBatchSizeSortPredicate() );
+
+	// merge small islands to satisfy minimum batch size
+	// find first small batch island
+	int destIslandIndex = m_activeIslands.size();
+	for ( int i = 0; i < m_activeIslands.size(); ++i )
+	{
+		Island* island = m_activeIslands[ i ];
+		int batchSize = calcBatchCost( island );
+		if ( batchSize < m_minimumSolverBatchSize )
+		{
+			destIslandIndex = i;
+			break;
+		}
+	}
+	int lastIndex = m_activeIslands.size() - 1;
+	while ( destIslandIndex < lastIndex )
+	{
+		// merge islands from the back of the list
+		Island* island = m_activeIslands[ destIslandIndex ];
+		int numBodies = island->bodyArray.size();
+		int numManifolds = island->manifoldArray.size();
+		int numConstraints = island->constraintArray.size();
+		int firstIndex = lastIndex;
+		// figure out how many islands we want to merge and find out how many bodies, manifolds and constraints we will have
+		while ( true )
+		{
+			Island* src = m_activeIslands[ firstIndex ];
+			numBodies += src->bodyArray.size();
+			numManifolds += src->manifoldArray.size();
+			numConstraints += src->constraintArray.size();
+			int batchCost = calcBatchCost( numBodies, numManifolds, numConstraints );
+			if ( batchCost >= m_minimumSolverBatchSize )
+			{
+				break;
+			}
+			if ( firstIndex - 1 == destIslandIndex )
+			{
+				break;
+			}
+			firstIndex--;
+		}
+		// reserve space for these pointers to minimize reallocation
+		island->bodyArray.reserve( numBodies );
+		island->manifoldArray.reserve( numManifolds );
+		island->constraintArray.reserve( numConstraints );
+		// merge islands
+		for ( int i = firstIndex; i <= lastIndex; ++i )
+		{
+			island->append( *m_activeIslands[ i ] );
+		}
+		// shrink array to exclude the islands that were merged from
+		m_activeIslands.resize( firstIndex );
+		lastIndex = firstIndex - 1;
+		destIslandIndex++;
+	}
+}
+
+
+void btSimulationIslandManagerMt::serialIslandDispatch( btAlignedObjectArray<Island*>* islandsPtr, IslandCallback* callback )
+{
+	BT_PROFILE( "serialIslandDispatch" );
+	// serial dispatch
+	btAlignedObjectArray<Island*>& islands = *islandsPtr;
+	for ( int i = 0; i < islands.size(); ++i )
+	{
+		Island* island = islands[ i ];
+		btPersistentManifold** manifolds = island->manifoldArray.size() ? &island->manifoldArray[ 0 ] : NULL;
+		btTypedConstraint** constraintsPtr = island->constraintArray.size() ? &island->constraintArray[ 0 ] : NULL;
+		callback->processIsland( &island->bodyArray[ 0 ],
+			island->bodyArray.size(),
+			manifolds,
+			island->manifoldArray.size(),
+			constraintsPtr,
+			island->constraintArray.size(),
+			island->id
+			);
+	}
+}
+
+
+struct UpdateIslandDispatcher : public btIParallelForBody
+{
+	btAlignedObjectArray<btSimulationIslandManagerMt::Island*>* islandsPtr;
+	btSimulationIslandManagerMt::IslandCallback* callback;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "islandDispatch loop" );
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btSimulationIslandManagerMt::Island* island = ( *islandsPtr )[ i ];
+			btPersistentManifold** manifolds = island->manifoldArray.size() ? &island->manifoldArray[ 0 ] : NULL;
+			btTypedConstraint** constraintsPtr = island->constraintArray.size() ? &island->constraintArray[ 0 ] : NULL;
+			callback->processIsland( &island->bodyArray[ 0 ],
+				island->bodyArray.size(),
+				manifolds,
+				island->manifoldArray.size(),
+				constraintsPtr,
+				island->constraintArray.size(),
+				island->id
+				);
+		}
+	}
+};
+
+
+void btSimulationIslandManagerMt::parallelIslandDispatch( btAlignedObjectArray<Island*>* islandsPtr, IslandCallback* callback )
+{
+	BT_PROFILE( "parallelIslandDispatch" );
+	if ( islandsPtr->size() == 1 )
+	{
+		// a single island is solved on this thread, so the solver can use the worker threads itself
+		serialIslandDispatch( islandsPtr, callback );
+		return;
+	}
+	int grainSize = 1;  // iterations per task
+	UpdateIslandDispatcher dispatcher;
+	dispatcher.islandsPtr = islandsPtr;
+	dispatcher.callback = callback;
+	btParallelFor( 0, islandsPtr->size(), grainSize, dispatcher );
+}
+
+
+///@todo: this is random access, it can be walked 'cache friendly'!
+void btSimulationIslandManagerMt::buildAndProcessIslands( btDispatcher* dispatcher,
+	btCollisionWorld* collisionWorld,
+	btAlignedObjectArray<btTypedConstraint*>& constraints,
+	IslandCallback* callback
+	)
+{
+	btCollisionObjectArray& collisionObjects = collisionWorld->getCollisionObjectArray();
+
+	buildIslands( dispatcher, collisionWorld );
+
+	BT_PROFILE( "processIslands" );
+
+	// same ordering as btDiscreteDynamicsWorld::solveConstraints, so the solver sees the same sequence of rows
+	m_sortedConstraints.resize( constraints.size() );
+	for ( int i = 0; i < constraints.size(); i++ )
+	{
+		m_sortedConstraints[ i ] = constraints[ i ];
+	}
+	m_sortedConstraints.quickSort( btConstraintIslandSortPredicate() );
+
+	if ( !getSplitIslands() )
+	{
+		btPersistentManifold** manifolds = dispatcher->getInternalManifoldPointer();
+		int maxNumManifolds = dispatcher->getNumManifolds();
+		btTypedConstraint** constraintsPtr = m_sortedConstraints.size() ? &m_sortedConstraints[ 0 ] : NULL;
+		callback->processIsland( &collisionObjects[ 0 ],
+			collisionObjects.size(),
+			manifolds,
+			maxNumManifolds,
+			constraintsPtr,
+			m_sortedConstraints.size(),
+			-1
+			);
+	}
+	else
+	{
+		initIslandPools();
+
+		//traverse the simulation islands, and call the solver, unless all objects are sleeping/deactivated
+		addBodiesToIslands( collisionWorld );
+		addManifoldsToIslands( dispatcher );
+		addConstraintsToIslands( m_sortedConstraints );
+
+		// m_activeIslands array should now contain all non-sleeping Islands, and each Island should
+		// have all the necessary bodies, manifolds and constraints.
+
+		// if we want to merge islands with small batch counts,
+		if ( m_minimumSolverBatchSize > 1 )
+		{
+			mergeIslands();
+		}
+		m_islandDispatch( &m_activeIslands, callback );
+	}
+}
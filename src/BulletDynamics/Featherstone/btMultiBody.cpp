@@ -327,7 +327,7 @@ void btMultiBody::setupPlanar(int i,
     m_links[i].m_eVector = parentComToThisComOffset;
 
 	//
-	static btVector3 vecNonParallelToRotAxis(1, 0, 0);
+	btVector3 vecNonParallelToRotAxis(1, 0, 0);
 	if(rotationAxis.normalized().dot(vecNonParallelToRotAxis) > 0.999)
 		vecNonParallelToRotAxis.setValue(0, 1, 0);
 	//
@@ -519,10 +519,10 @@ void btMultiBody::compTreeLinkVelocities(btVector3 *omega, btVector3 *vel) const
 btScalar btMultiBody::getKineticEnergy() const
 {
 	int num_links = getNumLinks();
-    // TODO: would be better not to allocate memory here
-    btAlignedObjectArray<btVector3> omega;omega.resize(num_links+1);
-	btAlignedObjectArray<btVector3> vel;vel.resize(num_links+1);
-    compTreeLinkVelocities(&omega[0], &vel[0]);
+    btScratchArenaScope scope(m_scratchArena);
+    btVector3* omega = m_scratchArena.allocate<btVector3>(num_links+1);
+    btVector3* vel = m_scratchArena.allocate<btVector3>(num_links+1);
+    compTreeLinkVelocities(omega, vel);
 
     // we will do the factor of 0.5 at the end
     btScalar result = m_baseMass * vel[0].dot(vel[0]);
@@ -539,11 +539,11 @@ btScalar btMultiBody::getKineticEnergy() const
 btVector3 btMultiBody::getAngularMomentum() const
 {
 	int num_links = getNumLinks();
-    // TODO: would be better not to allocate memory here
-    btAlignedObjectArray<btVector3> omega;omega.resize(num_links+1);
-	btAlignedObjectArray<btVector3> vel;vel.resize(num_links+1);
-    btAlignedObjectArray<btQuaternion> rot_from_world;rot_from_world.resize(num_links+1);
-    compTreeLinkVelocities(&omega[0], &vel[0]);
+    btScratchArenaScope scope(m_scratchArena);
+    btVector3* omega = m_scratchArena.allocate<btVector3>(num_links+1);
+    btVector3* vel = m_scratchArena.allocate<btVector3>(num_links+1);
+    btQuaternion* rot_from_world = m_scratchArena.allocate<btQuaternion>(num_links+1);
+    compTreeLinkVelocities(omega, vel);
 
     rot_from_world[0] = m_baseQuat;
     btVector3 result = quatRotate(rot_from_world[0].inverse() , (m_baseInertia * omega[0]));
@@ -739,15 +739,15 @@ void btMultiBody::stepVelocitiesMultiDof(btScalar dt,
 	btScalar * Y = &scratch_r[0];
 	//
 	//aux variables	
-	static btSpatialMotionVector spatJointVel;					//spatial velocity due to the joint motion (i.e. without predecessors' influence)
-	static btScalar D[36];										//"D" matrix; it's dofxdof for each body so asingle 6x6 D matrix will do	
-	static btScalar invD_times_Y[6];							//D^{-1} * Y [dofxdof x dofx1 = dofx1] <=> D^{-1} * u; better moved to buffers since it is recalced in calcAccelerationDeltasMultiDof; num_dof of btScalar would cover all bodies	
-	static btSpatialMotionVector result;							//holds results of the SolveImatrix op; it is a spatial motion vector (accel)
-	static btScalar Y_minus_hT_a[6];							//Y - h^{T} * a; it's dofx1 for each body so a single 6x1 temp is enough	
-	static btSpatialForceVector spatForceVecTemps[6];				//6 temporary spatial force vectors
-	static btSpatialTransformationMatrix fromParent;				//spatial transform from parent to child
-	static btSymmetricSpatialDyad dyadTemp;						//inertia matrix temp
-	static btSpatialTransformationMatrix fromWorld;
+	btSpatialMotionVector spatJointVel;					//spatial velocity due to the joint motion (i.e. without predecessors' influence)
+	btScalar D[36];										//"D" matrix; it's dofxdof for each body so asingle 6x6 D matrix will do	
+	btScalar invD_times_Y[6];							//D^{-1} * Y [dofxdof x dofx1 = dofx1] <=> D^{-1} * u; better moved to buffers since it is recalced in calcAccelerationDeltasMultiDof; num_dof of btScalar would cover all bodies	
+	btSpatialMotionVector result;							//holds results of the SolveImatrix op; it is a spatial motion vector (accel)
+	btScalar Y_minus_hT_a[6];							//Y - h^{T} * a; it's dofx1 for each body so a single 6x1 temp is enough	
+	btSpatialForceVector spatForceVecTemps[6];				//6 temporary spatial force vectors
+	btSpatialTransformationMatrix fromParent;				//spatial transform from parent to child
+	btSymmetricSpatialDyad dyadTemp;						//inertia matrix temp
+	btSpatialTransformationMatrix fromWorld;
 	fromWorld.m_trnVec.setZero();
 	/////////////////
 
@@ -944,8 +944,8 @@ void btMultiBody::stepVelocitiesMultiDof(btScalar dt,
 			case btMultibodyLink::eSpherical:
 			case btMultibodyLink::ePlanar:
 			{
-				static btMatrix3x3 D3x3; D3x3.setValue(D[0], D[1], D[2], D[3], D[4], D[5], D[6], D[7], D[8]);
-				static btMatrix3x3 invD3x3; invD3x3 = D3x3.inverse();
+				btMatrix3x3 D3x3; D3x3.setValue(D[0], D[1], D[2], D[3], D[4], D[5], D[6], D[7], D[8]);
+				btMatrix3x3 invD3x3; invD3x3 = D3x3.inverse();
 
 				//unroll the loop?
 				for(int row = 0; row < 3; ++row)
@@ -1662,11 +1662,11 @@ void btMultiBody::calcAccelerationDeltasMultiDof(const btScalar *force, btScalar
 	btScalar * Y = r_ptr; 
 	////////////////
 	//aux variables
-	static btScalar invD_times_Y[6];							//D^{-1} * Y [dofxdof x dofx1 = dofx1] <=> D^{-1} * u; better moved to buffers since it is recalced in calcAccelerationDeltasMultiDof; num_dof of btScalar would cover all bodies
-	static btSpatialMotionVector result;							//holds results of the SolveImatrix op; it is a spatial motion vector (accel)
-	static btScalar Y_minus_hT_a[6];							//Y - h^{T} * a; it's dofx1 for each body so a single 6x1 temp is enough	
-	static btSpatialForceVector spatForceVecTemps[6];				//6 temporary spatial force vectors
-	static btSpatialTransformationMatrix fromParent;	
+	btScalar invD_times_Y[6];							//D^{-1} * Y [dofxdof x dofx1 = dofx1] <=> D^{-1} * u; better moved to buffers since it is recalced in calcAccelerationDeltasMultiDof; num_dof of btScalar would cover all bodies
+	btSpatialMotionVector result;							//holds results of the SolveImatrix op; it is a spatial motion vector (accel)
+	btScalar Y_minus_hT_a[6];							//Y - h^{T} * a; it's dofx1 for each body so a single 6x1 temp is enough	
+	btSpatialForceVector spatForceVecTemps[6];				//6 temporary spatial force vectors
+	btSpatialTransformationMatrix fromParent;	
 	/////////////////
 
     // First 'upward' loop.
@@ -2041,8 +2041,8 @@ void btMultiBody::stepPositionsMultiDof(btScalar dt, btScalar *pq, btScalar *pqd
 	btScalar *pBaseQuat = pq ? pq : m_baseQuat;	
 	btScalar *pBaseOmega = pqd ? pqd : &m_realBuf[0];		//note: the !pqd case assumes m_realBuf starts with base omega (should be wrapped for safety)
 	//
-	static btQuaternion baseQuat; baseQuat.setValue(pBaseQuat[0], pBaseQuat[1], pBaseQuat[2], pBaseQuat[3]);
-	static btVector3 baseOmega; baseOmega.setValue(pBaseOmega[0], pBaseOmega[1], pBaseOmega[2]);
+	btQuaternion baseQuat; baseQuat.setValue(pBaseQuat[0], pBaseQuat[1], pBaseQuat[2], pBaseQuat[3]);
+	btVector3 baseOmega; baseOmega.setValue(pBaseOmega[0], pBaseOmega[1], pBaseOmega[2]);
 	pQuatUpdateFun(baseOmega, baseQuat, true, dt);
 	pBaseQuat[0] = baseQuat.x();
 	pBaseQuat[1] = baseQuat.y();
@@ -2076,8 +2076,8 @@ void btMultiBody::stepPositionsMultiDof(btScalar dt, btScalar *pq, btScalar *pqd
 			}
 			case btMultibodyLink::eSpherical:
 			{
-				static btVector3 jointVel; jointVel.setValue(pJointVel[0], pJointVel[1], pJointVel[2]);
-				static btQuaternion jointOri; jointOri.setValue(pJointPos[0], pJointPos[1], pJointPos[2], pJointPos[3]);
+				btVector3 jointVel; jointVel.setValue(pJointVel[0], pJointVel[1], pJointVel[2]);
+				btQuaternion jointOri; jointOri.setValue(pJointPos[0], pJointPos[1], pJointPos[2], pJointPos[3]);
 				pQuatUpdateFun(jointVel, jointOri, false, dt);
 				pJointPos[0] = jointOri.x(); pJointPos[1] = jointOri.y(); pJointPos[2] = jointOri.z(); pJointPos[3] = jointOri.w();
 				break;
@@ -2380,6 +2380,19 @@ void btMultiBody::checkMotionAndSleepIfRequired(btScalar timestep)
 
 
 void	btMultiBody::forwardKinematics(btAlignedObjectArray<btQuaternion>& world_to_local,btAlignedObjectArray<btVector3>& local_origin)
+{
+	world_to_local.resize(getNumLinks()+1);
+	local_origin.resize(getNumLinks()+1);
+	forwardKinematics(&world_to_local[0], &local_origin[0]);
+}
+
+void	btMultiBody::forwardKinematics()
+{
+	btScratchArenaScope scope(m_scratchArena);
+	forwardKinematics(m_scratchArena.allocate<btQuaternion>(getNumLinks()+1), m_scratchArena.allocate<btVector3>(getNumLinks()+1));
+}
+
+void	btMultiBody::forwardKinematics(btQuaternion* world_to_local, btVector3* local_origin)
 {
 	
 	int num_links = getNumLinks();
@@ -2393,11 +2406,6 @@ void	btMultiBody::forwardKinematics(btAlignedObjectArray<btQuaternion>& world_to
 	{
 		rot_from_parent[i+1] = btMatrix3x3(m_links[i].m_cachedRotParentToThis);
 	}
-		
-	int nLinks = getNumLinks();
-	///base + num m_links
-	world_to_local.resize(nLinks+1);
-	local_origin.resize(nLinks+1);
 
 	world_to_local[0] = getWorldToBaseRot();
 	local_origin[0] = getBasePos();
@@ -2429,7 +2437,17 @@ void	btMultiBody::updateCollisionObjectWorldTransforms(btAlignedObjectArray<btQu
 {
 	world_to_local.resize(getNumLinks()+1);
 	local_origin.resize(getNumLinks()+1);
-	
+	updateCollisionObjectWorldTransforms(&world_to_local[0], &local_origin[0]);
+}
+
+void	btMultiBody::updateCollisionObjectWorldTransforms()
+{
+	btScratchArenaScope scope(m_scratchArena);
+	updateCollisionObjectWorldTransforms(m_scratchArena.allocate<btQuaternion>(getNumLinks()+1), m_scratchArena.allocate<btVector3>(getNumLinks()+1));
+}
+
+void	btMultiBody::updateCollisionObjectWorldTransforms(btQuaternion* world_to_local, btVector3* local_origin)
+{
 	world_to_local[0] = getWorldToBaseRot();
 	local_origin[0] = getBasePos();
 	
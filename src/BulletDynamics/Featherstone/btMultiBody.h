@@ -29,6 +29,7 @@
 #include "LinearMath/btQuaternion.h"
 #include "LinearMath/btMatrix3x3.h"
 #include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btScratchArena.h"
 
 #ifdef BT_USE_DOUBLE_PRECISION
 	#define btMultiBodyData	btMultiBodyDoubleData
@@ -275,7 +276,7 @@ public:
 
     //
     // calculate kinetic energy and angular momentum
-    // useful for debugging.
+    // useful for debugging. The link velocities are kept in the scratch arena, so these don't allocate after the first call.
     //
 
     btScalar getKineticEnergy() const;
@@ -576,7 +577,7 @@ void addJointTorque(int i, btScalar Q);
 		return m_hasSelfCollision;
 	}
 
-	bool isMultiDof() { return m_isMultiDof; }
+	bool isMultiDof() const { return m_isMultiDof; }
 	void finalizeMultiDof();
 
 	void useRK4Integration(bool use) { m_useRK4 = use; }
@@ -601,6 +602,18 @@ void addJointTorque(int i, btScalar Q);
 	void	forwardKinematics(btAlignedObjectArray<btQuaternion>& scratch_q,btAlignedObjectArray<btVector3>& scratch_m);
 
 	void	updateCollisionObjectWorldTransforms(btAlignedObjectArray<btQuaternion>& scratch_q,btAlignedObjectArray<btVector3>& scratch_m);
+
+	///same as above, with the scratch arrays taken from the scratch arena of this body
+	void	forwardKinematics();
+
+	void	updateCollisionObjectWorldTransforms();
+
+	///persistent scratch memory of this body, for the temporary arrays of its queries and of the per body passes of the world.
+	///Only one thread may use the body (and its const queries) at a time.
+	btScratchArena&	getScratchArena() const
+	{
+		return m_scratchArena;
+	}
 	
 	virtual	int	calculateSerializeBufferSize()	const;
 
@@ -623,6 +636,9 @@ private:
 
     void compTreeLinkVelocities(btVector3 *omega, btVector3 *vel) const;
 
+	void	forwardKinematics(btQuaternion* world_to_local, btVector3* local_origin);
+	void	updateCollisionObjectWorldTransforms(btQuaternion* world_to_local, btVector3* local_origin);
+
 	void solveImatrix(const btVector3& rhs_top, const btVector3& rhs_bot, float result[6]) const;
 	void solveImatrix(const btSpatialForceVector &rhs, btSpatialMotionVector &result) const;
 	
@@ -680,6 +696,8 @@ private:
     btAlignedObjectArray<btVector3> m_vectorBuf;
     btAlignedObjectArray<btMatrix3x3> m_matrixBuf;
 
+	mutable btScratchArena	m_scratchArena;
+
 
 	btMatrix3x3 m_cachedInertiaTopLeft;
 	btMatrix3x3 m_cachedInertiaTopRight;
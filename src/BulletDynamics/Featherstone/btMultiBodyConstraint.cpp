@@ -75,6 +75,8 @@ btScalar btMultiBodyConstraint::fillMultiBodyConstraint(	btMultiBodySolverConstr
 	solverConstraint.m_multiBodyB = m_bodyB;
 	solverConstraint.m_linkA = m_linkA;
 	solverConstraint.m_linkB = m_linkB;
+	solverConstraint.m_sparseJacAindex = -1;
+	solverConstraint.m_sparseJacBindex = -1;
 
 	btMultiBody* multiBodyA = solverConstraint.m_multiBodyA;
 	btMultiBody* multiBodyB = solverConstraint.m_multiBodyB;
@@ -30,6 +30,8 @@ struct btMultiBodyJacobianData
 	btAlignedObjectArray<btScalar>		m_jacobians;
 	btAlignedObjectArray<btScalar>		m_deltaVelocitiesUnitImpulse;	//holds the joint-space response of the corresp. tree to the test impulse in each constraint space dimension
 	btAlignedObjectArray<btScalar>		m_deltaVelocities;				//holds joint-space vectors of all the constrained trees accumulating the effect of corrective impulses applied in SI
+	btAlignedObjectArray<btScalar>		m_sparseJacobians;				//the non-zero Jacobian entries of the contact rows with SOLVER_MULTIBODY_SPARSE_JACOBIANS
+	btAlignedObjectArray<int>			m_sparseDofs;					//the dof (index in the dense row) of each entry of m_sparseJacobians
 	btAlignedObjectArray<btScalar>		scratch_r;
 	btAlignedObjectArray<btVector3>		scratch_v;
 	btAlignedObjectArray<btMatrix3x3>	scratch_m;
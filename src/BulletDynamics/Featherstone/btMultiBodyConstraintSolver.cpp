@@ -22,8 +22,18 @@ subject to the following restrictions:
 #include "btMultiBodyConstraint.h"
 #include "BulletDynamics/ConstraintSolver/btContactSolverInfo.h"
 
+#include "BulletDynamics/MLCPSolvers/btMLCPSolverInterface.h"
+
 #include "LinearMath/btQuickprof.h"
 
+btMultiBodyConstraintSolver::btMultiBodyConstraintSolver()
+	:m_tmpMultiBodyConstraints(0),
+	m_tmpNumMultiBodyConstraints(0),
+	m_jointConstraintSolver(0),
+	m_fallback(0)
+{
+}
+
 btScalar btMultiBodyConstraintSolver::solveSingleIteration(int iteration, btCollisionObject** bodies ,int numBodies,btPersistentManifold** manifoldPtr, int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal,btIDebugDraw* debugDrawer)
 {
 	btScalar val = btSequentialImpulseConstraintSolver::solveSingleIteration(iteration, bodies ,numBodies,manifoldPtr, numManifolds,constraints,numConstraints,infoGlobal,debugDrawer);
@@ -36,13 +46,20 @@ btScalar btMultiBodyConstraintSolver::solveSingleIteration(int iteration, btColl
 		btMultiBodySolverConstraint& constraint = m_multiBodyNonContactConstraints[j];
 		//if (iteration < constraint.m_overrideNumSolverIterations)
 			//resolveSingleConstraintRowGenericMultiBody(constraint);
-		resolveSingleConstraintRowGeneric(constraint);
+		if (m_directBlockOfRow[j] < 0)
+			resolveSingleConstraintRowGeneric(constraint);
 		if(constraint.m_multiBodyA) 
 			constraint.m_multiBodyA->setPosUpdated(false);
 		if(constraint.m_multiBodyB) 
 			constraint.m_multiBodyB->setPosUpdated(false);
 	}
 
+	//solve the rows inside each btMultiBody at once, see setJointConstraintSolver
+	for (int j=0;j<m_directBlocks.size();j++)
+	{
+		solveDirectBlock(j,infoGlobal);
+	}
+
 	//solve featherstone normal contact
 	for (int j=0;j<m_multiBodyNormalContactConstraints.size();j++)
 	{
@@ -89,6 +106,8 @@ btScalar btMultiBodyConstraintSolver::solveGroupCacheFriendlySetup(btCollisionOb
 	m_data.m_jacobians.resize(0);
 	m_data.m_deltaVelocitiesUnitImpulse.resize(0);
 	m_data.m_deltaVelocities.resize(0);
+	m_data.m_sparseJacobians.resize(0);
+	m_data.m_sparseDofs.resize(0);
 
 	for (int i=0;i<numBodies;i++)
 	{
@@ -101,15 +120,315 @@ btScalar btMultiBodyConstraintSolver::solveGroupCacheFriendlySetup(btCollisionOb
 
 	btScalar val = btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySetup( bodies,numBodies,manifoldPtr, numManifolds, constraints,numConstraints,infoGlobal,debugDrawer);
 
+	setupDirectBlocks();
+
 	return val;
 }
 
+struct btDirectRowSortPredicate
+{
+	const btMultiBodyConstraintArray& m_rows;
+
+	btDirectRowSortPredicate(const btMultiBodyConstraintArray& rows)
+		:m_rows(rows)
+	{
+	}
+
+	bool operator() (int a, int b) const
+	{
+		//group the rows by btMultiBody, identified by its slot in m_deltaVelocities, and keep their order inside a group
+		if (m_rows[a].m_deltaVelAindex != m_rows[b].m_deltaVelAindex)
+			return m_rows[a].m_deltaVelAindex < m_rows[b].m_deltaVelAindex;
+		return a < b;
+	}
+};
+
+///lower triangular Cholesky factor L of the symmetric n x n matrix A, row major. Returns false if A is not clearly positive definite,
+///for example with two rows on the same dof
+static bool	btCholeskyFactor(const btMatrixXu& A, btScalar* L, int n)
+{
+	for (int i=0;i<n;i++)
+	{
+		for (int j=0;j<=i;j++)
+		{
+			btScalar sum = A(i,j);
+			for (int k=0;k<j;k++)
+			{
+				sum -= L[i*n+k]*L[j*n+k];
+			}
+			if (i==j)
+			{
+				if (!(sum > btScalar(1e-5)*A(i,i)))
+					return false;
+				L[i*n+i] = btSqrt(sum);
+			}
+			else
+			{
+				L[i*n+j] = sum/L[j*n+j];
+			}
+		}
+	}
+	return true;
+}
+
+///solves L L^T x = b
+static void	btCholeskySolve(const btScalar* L, int n, const btVectorXu& b, btVectorXu& x)
+{
+	for (int i=0;i<n;i++)
+	{
+		btScalar sum = b[i];
+		for (int k=0;k<i;k++)
+		{
+			sum -= L[i*n+k]*x[k];
+		}
+		x[i] = sum/L[i*n+i];
+	}
+	for (int i=n-1;i>=0;i--)
+	{
+		btScalar sum = x[i];
+		for (int k=i+1;k<n;k++)
+		{
+			sum -= L[k*n+i]*x[k];
+		}
+		x[i] = sum/L[i*n+i];
+	}
+}
+
+void	btMultiBodyConstraintSolver::setupDirectBlocks()
+{
+	m_directBlocks.resize(0);
+	m_directRows.resize(0);
+	m_directFactors.resize(0);
+	m_directBlockOfRow.resize(m_multiBodyNonContactConstraints.size());
+	for (int i=0;i<m_directBlockOfRow.size();i++)
+	{
+		m_directBlockOfRow[i] = -1;
+	}
+
+	if (!m_jointConstraintSolver)
+		return;
+
+	BT_PROFILE("setupDirectBlocks");
+
+	//only rows with both sides on the same btMultiBody, so both sides share the m_deltaVelocities of that body
+	for (int i=0;i<m_multiBodyNonContactConstraints.size();i++)
+	{
+		const btMultiBodySolverConstraint& c = m_multiBodyNonContactConstraints[i];
+		if (c.m_multiBodyA && c.m_multiBodyA == c.m_multiBodyB && c.m_jacDiagABInv != btScalar(0))
+		{
+			m_directRows.push_back(i);
+		}
+	}
+	m_directRows.quickSort(btDirectRowSortPredicate(m_multiBodyNonContactConstraints));
+
+	int firstRow = 0;
+	while (firstRow < m_directRows.size())
+	{
+		const btMultiBodySolverConstraint& first = m_multiBodyNonContactConstraints[m_directRows[firstRow]];
+		int numRows = 1;
+		while (firstRow+numRows < m_directRows.size() && m_multiBodyNonContactConstraints[m_directRows[firstRow+numRows]].m_deltaVelAindex == first.m_deltaVelAindex)
+		{
+			numRows++;
+		}
+
+		//a single row is solved exactly by PGS already
+		if (numRows > 1)
+		{
+			const int ndof = (first.m_multiBodyA->isMultiDof() ? first.m_multiBodyA->getNumDofs() : first.m_multiBodyA->getNumLinks()) + 6;
+
+			const int blockIndex = m_directBlocks.size();
+			btMultiBodyDirectBlock& block = m_directBlocks.expandNonInitializing();
+			block.m_firstRow = firstRow;
+			block.m_numRows = numRows;
+			//the matrices are kept from step to step, so their storage is only allocated when a body gets more rows
+			if (m_directMatrices.size() <= blockIndex)
+			{
+				m_directMatrices.expand();
+			}
+			btMatrixXu& A = m_directMatrices[blockIndex];
+			A.resize(numRows,numRows);
+
+			for (int i=0;i<numRows;i++)
+			{
+				const btMultiBodySolverConstraint& ci = m_multiBodyNonContactConstraints[m_directRows[firstRow+i]];
+				m_directBlockOfRow[m_directRows[firstRow+i]] = blockIndex;
+				for (int j=0;j<numRows;j++)
+				{
+					//velocity of row i caused by a unit impulse on row j, the responses come from the articulated body inertias of this step
+					const btMultiBodySolverConstraint& cj = m_multiBodyNonContactConstraints[m_directRows[firstRow+j]];
+					const btScalar* responseA = &m_data.m_deltaVelocitiesUnitImpulse[cj.m_jacAindex];
+					const btScalar* responseB = &m_data.m_deltaVelocitiesUnitImpulse[cj.m_jacBindex];
+					A.setElem(i,j,jacobianDot(ci.m_jacAindex,-1,0,responseA,ndof) + jacobianDot(ci.m_jacAindex,-1,0,responseB,ndof)
+						+ jacobianDot(ci.m_jacBindex,-1,0,responseA,ndof) + jacobianDot(ci.m_jacBindex,-1,0,responseB,ndof));
+				}
+				A.setElem(i,i,A(i,i) + ci.m_cfm/ci.m_jacDiagABInv);
+			}
+
+			//while no limit is active, each iteration is one solve with the factor of this step, O(rows^2) instead of O(rows^3)
+			block.m_firstFactorElem = m_directFactors.size();
+			m_directFactors.resize(m_directFactors.size()+numRows*numRows);
+			if (!btCholeskyFactor(A,&m_directFactors[block.m_firstFactorElem],numRows))
+			{
+				m_directFactors.resize(block.m_firstFactorElem);
+				block.m_firstFactorElem = -1;
+			}
+		}
+		firstRow += numRows;
+	}
+}
+
+void	btMultiBodyConstraintSolver::solveDirectBlock(int blockIndex, const btContactSolverInfo& infoGlobal)
+{
+	const btMultiBodyDirectBlock& block = m_directBlocks[blockIndex];
+	const btMatrixXu& A = m_directMatrices[blockIndex];
+	const int n = block.m_numRows;
+
+	m_directB.resize(n);
+	m_directX.resize(n);
+
+	for (int i=0;i<n;i++)
+	{
+		const btMultiBodySolverConstraint& c = m_multiBodyNonContactConstraints[m_directRows[block.m_firstRow+i]];
+		const int ndof = (c.m_multiBodyA->isMultiDof() ? c.m_multiBodyA->getNumDofs() : c.m_multiBodyA->getNumLinks()) + 6;
+		const btScalar* deltaV = &m_data.m_deltaVelocities[c.m_deltaVelAindex];
+
+		//the velocity error left by the contacts and the other rows, plus the velocity of the impulses applied so far,
+		//because the solver returns total impulses. The cfm on the diagonal of A is not a velocity
+		btScalar b = c.m_rhs/c.m_jacDiagABInv - jacobianDot(c.m_jacAindex,-1,0,deltaV,ndof) - jacobianDot(c.m_jacBindex,-1,0,deltaV,ndof)
+			- c.m_cfm/c.m_jacDiagABInv*c.m_appliedImpulse;
+		for (int j=0;j<n;j++)
+		{
+			const btMultiBodySolverConstraint& cj = m_multiBodyNonContactConstraints[m_directRows[block.m_firstRow+j]];
+			b += A(i,j)*cj.m_appliedImpulse;
+		}
+		m_directB[i] = b;
+	}
+
+	bool solved = false;
+	if (block.m_firstFactorElem >= 0)
+	{
+		//without an active limit the LCP solution is the solution of the linear system
+		btCholeskySolve(&m_directFactors[block.m_firstFactorElem],n,m_directB,m_directX);
+		solved = true;
+		for (int i=0;i<n && solved;i++)
+		{
+			const btMultiBodySolverConstraint& c = m_multiBodyNonContactConstraints[m_directRows[block.m_firstRow+i]];
+			solved = m_directX[i] >= c.m_lowerLimit && m_directX[i] <= c.m_upperLimit;
+		}
+	}
+
+	if (!solved)
+	{
+		m_directLo.resize(n);
+		m_directHi.resize(n);
+		m_directLimitDependency.resize(n);
+		for (int i=0;i<n;i++)
+		{
+			const btMultiBodySolverConstraint& c = m_multiBodyNonContactConstraints[m_directRows[block.m_firstRow+i]];
+			m_directX[i] = c.m_appliedImpulse;
+			m_directLo[i] = c.m_lowerLimit;
+			m_directHi[i] = c.m_upperLimit;
+			m_directLimitDependency[i] = -1;
+		}
+		if (!m_jointConstraintSolver->solveMLCP(A,m_directB,m_directX,m_directLo,m_directHi,m_directLimitDependency,infoGlobal.m_numIterations,false))
+		{
+			m_fallback++;
+			for (int i=0;i<n;i++)
+			{
+				resolveSingleConstraintRowGeneric(m_multiBodyNonContactConstraints[m_directRows[block.m_firstRow+i]]);
+			}
+			return;
+		}
+	}
+
+	for (int i=0;i<n;i++)
+	{
+		const btMultiBodySolverConstraint& c = m_multiBodyNonContactConstraints[m_directRows[block.m_firstRow+i]];
+		const btScalar deltaImpulse = m_directX[i] - c.m_appliedImpulse;
+		c.m_appliedImpulse = m_directX[i];
+		applyRowImpulse(c,deltaImpulse);
+	}
+}
+
+void	btMultiBodyConstraintSolver::applyRowImpulse(const btMultiBodySolverConstraint& c, btScalar deltaImpulse)
+{
+	if (c.m_multiBodyA)
+	{
+		const int ndofA  = (c.m_multiBodyA->isMultiDof() ? c.m_multiBodyA->getNumDofs() : c.m_multiBodyA->getNumLinks()) + 6;
+		applyDeltaVee(&m_data.m_deltaVelocitiesUnitImpulse[c.m_jacAindex],deltaImpulse,c.m_deltaVelAindex,ndofA);
+#ifdef DIRECTLY_UPDATE_VELOCITY_DURING_SOLVER_ITERATIONS
+		if(c.m_multiBodyA->isMultiDof())
+			c.m_multiBodyA->applyDeltaVeeMultiDof2(&m_data.m_deltaVelocitiesUnitImpulse[c.m_jacAindex],deltaImpulse);
+		else
+			c.m_multiBodyA->applyDeltaVee(&m_data.m_deltaVelocitiesUnitImpulse[c.m_jacAindex],deltaImpulse);
+#endif //DIRECTLY_UPDATE_VELOCITY_DURING_SOLVER_ITERATIONS
+	}
+	if (c.m_multiBodyB)
+	{
+		const int ndofB  = (c.m_multiBodyB->isMultiDof() ? c.m_multiBodyB->getNumDofs() : c.m_multiBodyB->getNumLinks()) + 6;
+		applyDeltaVee(&m_data.m_deltaVelocitiesUnitImpulse[c.m_jacBindex],deltaImpulse,c.m_deltaVelBindex,ndofB);
+#ifdef DIRECTLY_UPDATE_VELOCITY_DURING_SOLVER_ITERATIONS
+		if(c.m_multiBodyB->isMultiDof())
+			c.m_multiBodyB->applyDeltaVeeMultiDof2(&m_data.m_deltaVelocitiesUnitImpulse[c.m_jacBindex],deltaImpulse);
+		else
+			c.m_multiBodyB->applyDeltaVee(&m_data.m_deltaVelocitiesUnitImpulse[c.m_jacBindex],deltaImpulse);
+#endif //DIRECTLY_UPDATE_VELOCITY_DURING_SOLVER_ITERATIONS
+	}
+}
+
 void	btMultiBodyConstraintSolver::applyDeltaVee(btScalar* delta_vee, btScalar impulse, int velocityIndex, int ndof)
 {
     for (int i = 0; i < ndof; ++i) 
 		m_data.m_deltaVelocities[velocityIndex+i] += delta_vee[i] * impulse;
 }
 
+btScalar	btMultiBodyConstraintSolver::jacobianDot(int jacIndex, int sparseJacIndex, int sparseNumDofs, const btScalar* vec, int ndof) const
+{
+	btScalar dot = 0;
+	if (sparseJacIndex >= 0)
+	{
+		const btScalar* jac = &m_data.m_sparseJacobians[sparseJacIndex];
+		const int* dofs = &m_data.m_sparseDofs[sparseJacIndex];
+		for (int i = 0; i < sparseNumDofs; ++i)
+			dot += jac[i] * vec[dofs[i]];
+	} else
+	{
+		const btScalar* jac = &m_data.m_jacobians[jacIndex];
+		for (int i = 0; i < ndof; ++i)
+			dot += jac[i] * vec[i];
+	}
+	return dot;
+}
+
+void	btMultiBodyConstraintSolver::storeSparseJacobian(const btMultiBody* multiBody, int link, const btScalar* jac, int& sparseJacIndex, int& sparseNumDofs)
+{
+	//a point on link only moves with the base and the joints on the path from the root to link, the other entries of jac are zero
+	sparseNumDofs = 6;
+	for (int l = link; l >= 0; l = multiBody->getParent(l))
+		sparseNumDofs += multiBody->isMultiDof() ? multiBody->getLink(l).m_dofCount : 1;
+
+	sparseJacIndex = m_data.m_sparseJacobians.size();
+	m_data.m_sparseJacobians.resize(sparseJacIndex+sparseNumDofs);
+	m_data.m_sparseDofs.resize(sparseJacIndex+sparseNumDofs);
+	int* dofs = &m_data.m_sparseDofs[sparseJacIndex];
+	for (int i = 0; i < 6; ++i)
+		dofs[i] = i;
+	//walk from link to the root, filling from the back so the dofs end up in increasing order
+	int n = sparseNumDofs;
+	for (int l = link; l >= 0; l = multiBody->getParent(l))
+	{
+		const int dofOffset = 6 + (multiBody->isMultiDof() ? multiBody->getLink(l).m_dofOffset : l);
+		const int dofCount = multiBody->isMultiDof() ? multiBody->getLink(l).m_dofCount : 1;
+		for (int d = dofCount-1; d >= 0; --d)
+			dofs[--n] = dofOffset + d;
+	}
+	btAssert(n == 6);
+
+	btScalar* sparseJac = &m_data.m_sparseJacobians[sparseJacIndex];
+	for (int i = 0; i < sparseNumDofs; ++i)
+		sparseJac[i] = jac[dofs[i]];
+}
+
 void btMultiBodyConstraintSolver::resolveSingleConstraintRowGeneric(const btMultiBodySolverConstraint& c)
 {
 
@@ -124,8 +443,7 @@ void btMultiBodyConstraintSolver::resolveSingleConstraintRowGeneric(const btMult
 	if (c.m_multiBodyA)
 	{
 		ndofA  = (c.m_multiBodyA->isMultiDof() ? c.m_multiBodyA->getNumDofs() : c.m_multiBodyA->getNumLinks()) + 6;
-		for (int i = 0; i < ndofA; ++i) 
-			deltaVelADotn += m_data.m_jacobians[c.m_jacAindex+i] * m_data.m_deltaVelocities[c.m_deltaVelAindex+i];
+		deltaVelADotn += jacobianDot(c.m_jacAindex,c.m_sparseJacAindex,c.m_sparseJacAnumDofs,&m_data.m_deltaVelocities[c.m_deltaVelAindex],ndofA);
 	} else if(c.m_solverBodyIdA >= 0)
 	{
 		bodyA = &m_tmpSolverBodyPool[c.m_solverBodyIdA];
@@ -135,8 +453,7 @@ void btMultiBodyConstraintSolver::resolveSingleConstraintRowGeneric(const btMult
 	if (c.m_multiBodyB)
 	{
 		ndofB  = (c.m_multiBodyB->isMultiDof() ? c.m_multiBodyB->getNumDofs() : c.m_multiBodyB->getNumLinks()) + 6;
-		for (int i = 0; i < ndofB; ++i) 
-			deltaVelBDotn += m_data.m_jacobians[c.m_jacBindex+i] * m_data.m_deltaVelocities[c.m_deltaVelBindex+i];
+		deltaVelBDotn += jacobianDot(c.m_jacBindex,c.m_sparseJacBindex,c.m_sparseJacBnumDofs,&m_data.m_deltaVelocities[c.m_deltaVelBindex],ndofB);
 	} else if(c.m_solverBodyIdB >= 0)
 	{
 		bodyB = &m_tmpSolverBodyPool[c.m_solverBodyIdB];
@@ -210,15 +527,13 @@ void btMultiBodyConstraintSolver::resolveSingleConstraintRowGenericMultiBody(con
 	if (c.m_multiBodyA)
 	{
 		ndofA  = (c.m_multiBodyA->isMultiDof() ? c.m_multiBodyA->getNumDofs() : c.m_multiBodyA->getNumLinks()) + 6;
-		for (int i = 0; i < ndofA; ++i) 
-			deltaVelADotn += m_data.m_jacobians[c.m_jacAindex+i] * m_data.m_deltaVelocities[c.m_deltaVelAindex+i];
+		deltaVelADotn += jacobianDot(c.m_jacAindex,c.m_sparseJacAindex,c.m_sparseJacAnumDofs,&m_data.m_deltaVelocities[c.m_deltaVelAindex],ndofA);
 	}
 
 	if (c.m_multiBodyB)
 	{
 		ndofB  = (c.m_multiBodyB->isMultiDof() ? c.m_multiBodyB->getNumDofs() : c.m_multiBodyB->getNumLinks()) + 6;
-		for (int i = 0; i < ndofB; ++i) 
-			deltaVelBDotn += m_data.m_jacobians[c.m_jacBindex+i] * m_data.m_deltaVelocities[c.m_deltaVelBindex+i];
+		deltaVelBDotn += jacobianDot(c.m_jacBindex,c.m_sparseJacBindex,c.m_sparseJacBnumDofs,&m_data.m_deltaVelocities[c.m_deltaVelBindex],ndofB);
 	}
 
 	
@@ -284,6 +599,7 @@ void btMultiBodyConstraintSolver::setupMultiBodyContactConstraint(btMultiBodySol
 
 	relaxation = 1.f;
 
+	const bool sparseJacobians = (infoGlobal.m_solverMode & SOLVER_MULTIBODY_SPARSE_JACOBIANS) != 0;
 	
 
 
@@ -310,21 +626,35 @@ void btMultiBodyConstraintSolver::setupMultiBodyContactConstraint(btMultiBodySol
 			btAssert(m_data.m_deltaVelocities.size() >= solverConstraint.m_deltaVelAindex+ndofA);
 		}
 
-		solverConstraint.m_jacAindex = m_data.m_jacobians.size();
-		m_data.m_jacobians.resize(m_data.m_jacobians.size()+ndofA);
-		m_data.m_deltaVelocitiesUnitImpulse.resize(m_data.m_deltaVelocitiesUnitImpulse.size()+ndofA);
-		btAssert(m_data.m_jacobians.size() == m_data.m_deltaVelocitiesUnitImpulse.size());
+		btScalar* jac1;
+		solverConstraint.m_sparseJacAindex = -1;
+		if (sparseJacobians)
+		{
+			//the dense row only lives in m_denseJacobian until it is compressed, m_jacAindex just locates the unit impulse response
+			solverConstraint.m_jacAindex = m_data.m_deltaVelocitiesUnitImpulse.size();
+			m_data.m_deltaVelocitiesUnitImpulse.resize(m_data.m_deltaVelocitiesUnitImpulse.size()+ndofA);
+			m_denseJacobian.resize(ndofA);
+			jac1 = &m_denseJacobian[0];
+		} else
+		{
+			solverConstraint.m_jacAindex = m_data.m_jacobians.size();
+			m_data.m_jacobians.resize(m_data.m_jacobians.size()+ndofA);
+			m_data.m_deltaVelocitiesUnitImpulse.resize(m_data.m_deltaVelocitiesUnitImpulse.size()+ndofA);
+			btAssert(m_data.m_jacobians.size() == m_data.m_deltaVelocitiesUnitImpulse.size());
+			jac1 = &m_data.m_jacobians[solverConstraint.m_jacAindex];
+		}
 
-		btScalar* jac1=&m_data.m_jacobians[solverConstraint.m_jacAindex];
 		if(multiBodyA->isMultiDof())
 			multiBodyA->fillContactJacobianMultiDof(solverConstraint.m_linkA, cp.getPositionWorldOnA(), contactNormal, jac1, m_data.scratch_r, m_data.scratch_v, m_data.scratch_m);
 		else
 			multiBodyA->fillContactJacobian(solverConstraint.m_linkA, cp.getPositionWorldOnA(), contactNormal, jac1, m_data.scratch_r, m_data.scratch_v, m_data.scratch_m);
 		btScalar* delta = &m_data.m_deltaVelocitiesUnitImpulse[solverConstraint.m_jacAindex];
 		if(multiBodyA->isMultiDof())
-			multiBodyA->calcAccelerationDeltasMultiDof(&m_data.m_jacobians[solverConstraint.m_jacAindex],delta,m_data.scratch_r, m_data.scratch_v);
+			multiBodyA->calcAccelerationDeltasMultiDof(jac1,delta,m_data.scratch_r, m_data.scratch_v);
 		else
-			multiBodyA->calcAccelerationDeltas(&m_data.m_jacobians[solverConstraint.m_jacAindex],delta,m_data.scratch_r, m_data.scratch_v);
+			multiBodyA->calcAccelerationDeltas(jac1,delta,m_data.scratch_r, m_data.scratch_v);
+		if (sparseJacobians)
+			storeSparseJacobian(multiBodyA,solverConstraint.m_linkA,jac1,solverConstraint.m_sparseJacAindex,solverConstraint.m_sparseJacAnumDofs);
 
 		btVector3 torqueAxis0 = rel_pos1.cross(contactNormal);
 		solverConstraint.m_relpos1CrossNormal = torqueAxis0;
@@ -359,20 +689,34 @@ void btMultiBodyConstraintSolver::setupMultiBodyContactConstraint(btMultiBodySol
 			m_data.m_deltaVelocities.resize(m_data.m_deltaVelocities.size()+ndofB);
 		}
 
-		solverConstraint.m_jacBindex = m_data.m_jacobians.size();
+		btScalar* jac2;
+		solverConstraint.m_sparseJacBindex = -1;
+		if (sparseJacobians)
+		{
+			solverConstraint.m_jacBindex = m_data.m_deltaVelocitiesUnitImpulse.size();
+			m_data.m_deltaVelocitiesUnitImpulse.resize(m_data.m_deltaVelocitiesUnitImpulse.size()+ndofB);
+			m_denseJacobian.resize(ndofB);
+			jac2 = &m_denseJacobian[0];
+		} else
+		{
+			solverConstraint.m_jacBindex = m_data.m_jacobians.size();
 
-		m_data.m_jacobians.resize(m_data.m_jacobians.size()+ndofB);
-		m_data.m_deltaVelocitiesUnitImpulse.resize(m_data.m_deltaVelocitiesUnitImpulse.size()+ndofB);
-		btAssert(m_data.m_jacobians.size() == m_data.m_deltaVelocitiesUnitImpulse.size());
+			m_data.m_jacobians.resize(m_data.m_jacobians.size()+ndofB);
+			m_data.m_deltaVelocitiesUnitImpulse.resize(m_data.m_deltaVelocitiesUnitImpulse.size()+ndofB);
+			btAssert(m_data.m_jacobians.size() == m_data.m_deltaVelocitiesUnitImpulse.size());
+			jac2 = &m_data.m_jacobians[solverConstraint.m_jacBindex];
+		}
 
 		if(multiBodyB->isMultiDof())
-			multiBodyB->fillContactJacobianMultiDof(solverConstraint.m_linkB, cp.getPositionWorldOnB(), -contactNormal, &m_data.m_jacobians[solverConstraint.m_jacBindex], m_data.scratch_r, m_data.scratch_v, m_data.scratch_m);
+			multiBodyB->fillContactJacobianMultiDof(solverConstraint.m_linkB, cp.getPositionWorldOnB(), -contactNormal, jac2, m_data.scratch_r, m_data.scratch_v, m_data.scratch_m);
 		else
-			multiBodyB->fillContactJacobian(solverConstraint.m_linkB, cp.getPositionWorldOnB(), -contactNormal, &m_data.m_jacobians[solverConstraint.m_jacBindex], m_data.scratch_r, m_data.scratch_v, m_data.scratch_m);
+			multiBodyB->fillContactJacobian(solverConstraint.m_linkB, cp.getPositionWorldOnB(), -contactNormal, jac2, m_data.scratch_r, m_data.scratch_v, m_data.scratch_m);
 		if(multiBodyB->isMultiDof())
-			multiBodyB->calcAccelerationDeltasMultiDof(&m_data.m_jacobians[solverConstraint.m_jacBindex],&m_data.m_deltaVelocitiesUnitImpulse[solverConstraint.m_jacBindex],m_data.scratch_r, m_data.scratch_v);
+			multiBodyB->calcAccelerationDeltasMultiDof(jac2,&m_data.m_deltaVelocitiesUnitImpulse[solverConstraint.m_jacBindex],m_data.scratch_r, m_data.scratch_v);
 		else
-			multiBodyB->calcAccelerationDeltas(&m_data.m_jacobians[solverConstraint.m_jacBindex],&m_data.m_deltaVelocitiesUnitImpulse[solverConstraint.m_jacBindex],m_data.scratch_r, m_data.scratch_v);
+			multiBodyB->calcAccelerationDeltas(jac2,&m_data.m_deltaVelocitiesUnitImpulse[solverConstraint.m_jacBindex],m_data.scratch_r, m_data.scratch_v);
+		if (sparseJacobians)
+			storeSparseJacobian(multiBodyB,solverConstraint.m_linkB,jac2,solverConstraint.m_sparseJacBindex,solverConstraint.m_sparseJacBnumDofs);
 		
 		btVector3 torqueAxis1 = rel_pos2.cross(contactNormal);		
 		solverConstraint.m_relpos2CrossNormal = -torqueAxis1;
@@ -392,22 +736,14 @@ void btMultiBodyConstraintSolver::setupMultiBodyContactConstraint(btMultiBodySol
 		btVector3 vec;
 		btScalar denom0 = 0.f;
 		btScalar denom1 = 0.f;
-		btScalar* jacB = 0;
-		btScalar* jacA = 0;
 		btScalar* lambdaA =0;
 		btScalar* lambdaB =0;
 		int ndofA  = 0;
 		if (multiBodyA)
 		{
 			ndofA  = (multiBodyA->isMultiDof() ? multiBodyA->getNumDofs() : multiBodyA->getNumLinks()) + 6;
-			jacA = &m_data.m_jacobians[solverConstraint.m_jacAindex];
 			lambdaA = &m_data.m_deltaVelocitiesUnitImpulse[solverConstraint.m_jacAindex];
-			for (int i = 0; i < ndofA; ++i)
-			{
-				btScalar j = jacA[i] ;
-				btScalar l =lambdaA[i];
-				denom0 += j*l;
-			}
+			denom0 = jacobianDot(solverConstraint.m_jacAindex,solverConstraint.m_sparseJacAindex,solverConstraint.m_sparseJacAnumDofs,lambdaA,ndofA);
 		} else
 		{
 			if (rb0)
@@ -419,14 +755,8 @@ void btMultiBodyConstraintSolver::setupMultiBodyContactConstraint(btMultiBodySol
 		if (multiBodyB)
 		{
 			const int ndofB  = (multiBodyB->isMultiDof() ? multiBodyB->getNumDofs() : multiBodyB->getNumLinks()) + 6;
-			jacB = &m_data.m_jacobians[solverConstraint.m_jacBindex];
 			lambdaB = &m_data.m_deltaVelocitiesUnitImpulse[solverConstraint.m_jacBindex];
-			for (int i = 0; i < ndofB; ++i)
-			{
-				btScalar j = jacB[i] ;
-				btScalar l =lambdaB[i];
-				denom1 += j*l;
-			}
+			denom1 = jacobianDot(solverConstraint.m_jacBindex,solverConstraint.m_sparseJacBindex,solverConstraint.m_sparseJacBnumDofs,lambdaB,ndofB);
 
 		} else
 		{
@@ -468,9 +798,7 @@ void btMultiBodyConstraintSolver::setupMultiBodyContactConstraint(btMultiBodySol
 		if (multiBodyA)
 		{
 			ndofA  = (multiBodyA->isMultiDof() ? multiBodyA->getNumDofs() : multiBodyA->getNumLinks()) + 6;
-			btScalar* jacA = &m_data.m_jacobians[solverConstraint.m_jacAindex];
-			for (int i = 0; i < ndofA ; ++i) 
-				rel_vel += multiBodyA->getVelocityVector()[i] * jacA[i];
+			rel_vel += jacobianDot(solverConstraint.m_jacAindex,solverConstraint.m_sparseJacAindex,solverConstraint.m_sparseJacAnumDofs,multiBodyA->getVelocityVector(),ndofA);
 		} else
 		{
 			if (rb0)
@@ -481,9 +809,7 @@ void btMultiBodyConstraintSolver::setupMultiBodyContactConstraint(btMultiBodySol
 		if (multiBodyB)
 		{
 			ndofB  = (multiBodyB->isMultiDof() ? multiBodyB->getNumDofs() : multiBodyB->getNumLinks()) + 6;
-			btScalar* jacB = &m_data.m_jacobians[solverConstraint.m_jacBindex];
-			for (int i = 0; i < ndofB ; ++i) 
-				rel_vel += multiBodyB->getVelocityVector()[i] * jacB[i];
+			rel_vel += jacobianDot(solverConstraint.m_jacBindex,solverConstraint.m_sparseJacBindex,solverConstraint.m_sparseJacBnumDofs,multiBodyB->getVelocityVector(),ndofB);
 
 		} else
 		{
@@ -830,6 +1156,17 @@ void btMultiBodyConstraintSolver::convertContacts(btPersistentManifold** manifol
 {
 	//btPersistentManifold* manifold = 0;
 
+	//convert the multibody constraints first, if any: their rows always store dense Jacobians, sharing m_jacAindex
+	//between m_jacobians and m_deltaVelocitiesUnitImpulse, while sparse contact rows only add to m_deltaVelocitiesUnitImpulse
+	for (int i=0;i<m_tmpNumMultiBodyConstraints;i++)
+	{
+		btMultiBodyConstraint* c = m_tmpMultiBodyConstraints[i];
+		m_data.m_solverBodyPool = &m_tmpSolverBodyPool;
+		m_data.m_fixedBodyId = m_fixedBodyId;
+		
+		c->createConstraintRows(m_multiBodyNonContactConstraints,m_data,	infoGlobal);
+	}
+
 	for (int i=0;i<numManifolds;i++)
 	{
 		btPersistentManifold* manifold= manifoldPtr[i];
@@ -845,18 +1182,6 @@ void btMultiBodyConstraintSolver::convertContacts(btPersistentManifold** manifol
 		}
 	}
 
-	//also convert the multibody constraints, if any
-
-	
-	for (int i=0;i<m_tmpNumMultiBodyConstraints;i++)
-	{
-		btMultiBodyConstraint* c = m_tmpMultiBodyConstraints[i];
-		m_data.m_solverBodyPool = &m_tmpSolverBodyPool;
-		m_data.m_fixedBodyId = m_fixedBodyId;
-		
-		c->createConstraintRows(m_multiBodyNonContactConstraints,m_data,	infoGlobal);
-	}
-
 }
 
 
@@ -24,7 +24,9 @@ subject to the following restrictions:
 class btMultiBody;
 
 #include "btMultiBodyConstraint.h"
+#include "LinearMath/btMatrixX.h"
 
+class btMLCPSolverInterface;
 
 
 ATTRIBUTE_ALIGNED16(class) btMultiBodyConstraintSolver : public btSequentialImpulseConstraintSolver
@@ -39,10 +41,39 @@ protected:
 
 	btMultiBodyJacobianData				m_data;
 	
+	///the dense Jacobian row of a contact, before it is compressed with SOLVER_MULTIBODY_SPARSE_JACOBIANS
+	btAlignedObjectArray<btScalar>		m_denseJacobian;
+
 	//temp storage for multi body constraints for a specific island/group called by 'solveGroup'
 	btMultiBodyConstraint**					m_tmpMultiBodyConstraints;
 	int										m_tmpNumMultiBodyConstraints;
 
+	///the rows of m_multiBodyNonContactConstraints that act inside the same btMultiBody, solved together by m_jointConstraintSolver
+	struct btMultiBodyDirectBlock
+	{
+		int	m_firstRow;			//index in m_directRows
+		int	m_numRows;
+		int	m_firstFactorElem;	//index of the numRows*numRows Cholesky factor of the block matrix in m_directFactors, -1 if it is singular
+	};
+
+	btMLCPSolverInterface*					m_jointConstraintSolver;
+	btAlignedObjectArray<btMultiBodyDirectBlock>	m_directBlocks;
+	btAlignedObjectArray<int>				m_directRows;
+	btAlignedObjectArray<btMatrixXu>		m_directMatrices;		//J M^-1 J^T plus cfm of each block, built once per step
+	btAlignedObjectArray<btScalar>			m_directFactors;
+	btAlignedObjectArray<int>				m_directBlockOfRow;		//block of each non contact row, or -1 if the row is solved by PGS
+	int										m_fallback;
+	btVectorXu								m_directB;
+	btVectorXu								m_directX;
+	btVectorXu								m_directLo;
+	btVectorXu								m_directHi;
+	btAlignedObjectArray<int>				m_directLimitDependency;
+
+	///dot product of one side of a row with the joint space vector vec, only over the dofs of a sparse Jacobian (sparseJacIndex >= 0)
+	btScalar	jacobianDot(int jacIndex, int sparseJacIndex, int sparseNumDofs, const btScalar* vec, int ndof) const;
+	///copies the base and root to link entries of the dense contact Jacobian jac of link to m_data.m_sparseJacobians
+	void	storeSparseJacobian(const btMultiBody* multiBody, int link, const btScalar* jac, int& sparseJacIndex, int& sparseNumDofs);
+
 	void resolveSingleConstraintRowGeneric(const btMultiBodySolverConstraint& c);
 	void resolveSingleConstraintRowGenericMultiBody(const btMultiBodySolverConstraint& c);
 
@@ -68,10 +99,43 @@ protected:
 	virtual btScalar solveSingleIteration(int iteration, btCollisionObject** bodies ,int numBodies,btPersistentManifold** manifoldPtr, int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& infoGlobal,btIDebugDraw* debugDrawer);
 	void	applyDeltaVee(btScalar* deltaV, btScalar impulse, int velocityIndex, int ndof);
 	void writeBackSolverBodyToMultiBody(btMultiBodySolverConstraint& constraint, btScalar deltaTime);
+
+	void	setupDirectBlocks();
+	void	solveDirectBlock(int blockIndex, const btContactSolverInfo& infoGlobal);
+	void	applyRowImpulse(const btMultiBodySolverConstraint& c, btScalar deltaImpulse);
 public:
 
 	BT_DECLARE_ALIGNED_ALLOCATOR();
 
+	///The solver starts without a joint constraint solver, so all rows are solved by PGS like before, and with no fallbacks counted.
+	btMultiBodyConstraintSolver();
+
+	///The rows of btMultiBodyConstraints that act inside a single btMultiBody (btMultiBodyJointLimitConstraint, btMultiBodyJointMotor)
+	///are solved iteratively together with the contacts by default. With a joint constraint solver, for example btDantzigSolver,
+	///all such rows of a btMultiBody are solved at once during each iteration instead: a mixed LCP with the matrix J M^-1 J^T,
+	///built once per step from the unit impulse responses of the articulated body algorithm, and the velocity left by the
+	///contacts of the iteration. Stiff joints then converge in a few iterations. The matrix is also factored once per step, so
+	///an iteration in which no limit of the body is active costs O(rows^2); the O(rows^3) MLCP solve only runs when a limit is hit
+	///or the rows are dependent. If the solver fails, the rows of the body fall back to PGS for that iteration.
+	///The solver is not owned, pass 0 to go back to PGS.
+	void	setJointConstraintSolver(btMLCPSolverInterface* solver)
+	{
+		m_jointConstraintSolver = solver;
+	}
+	btMLCPSolverInterface*	getJointConstraintSolver() const
+	{
+		return m_jointConstraintSolver;
+	}
+	///number of direct block solves that fell back to PGS
+	int	getNumFallbacks() const
+	{
+		return m_fallback;
+	}
+	void	setNumFallbacks(int num)
+	{
+		m_fallback = num;
+	}
+
 	///this method should not be called, it was just used during porting/integration of Featherstone btMultiBody, providing backwards compatibility but no support for btMultiBodyConstraint (only contact constraints)
 	virtual btScalar solveGroup(btCollisionObject** bodies,int numBodies,btPersistentManifold** manifold,int numManifolds,btTypedConstraint** constraints,int numConstraints,const btContactSolverInfo& info, btIDebugDraw* debugDrawer,btDispatcher* dispatcher);
 	virtual btScalar solveGroupCacheFriendlyFinish(btCollisionObject** bodies,int numBodies,const btContactSolverInfo& infoGlobal);
@@ -379,6 +379,106 @@ struct MultiBodyInplaceSolverIslandCallback : public btSimulationIslandManager::
 
 
 
+static bool btIsMultiBodySleeping(const btMultiBody* bod)
+{
+	if (bod->getBaseCollider() && bod->getBaseCollider()->getActivationState() == ISLAND_SLEEPING)
+	{
+		return true;
+	}
+	for (int b=0;b<bod->getNumLinks();b++)
+	{
+		if (bod->getLink(b).m_collider && bod->getLink(b).m_collider->getActivationState()==ISLAND_SLEEPING)
+			return true;
+	}
+	return false;
+}
+
+struct btMultiBodyDynamicsWorld::UpdaterForwardKinematics : public btIParallelForBody
+{
+	btMultiBodyDynamicsWorld* world;
+	btMultiBody** multiBodies;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "forwardKinematics loop" );
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			multiBodies[ i ]->forwardKinematics();
+		}
+	}
+};
+
+struct btMultiBodyDynamicsWorld::UpdaterStepVelocities : public btIParallelForBody
+{
+	btMultiBodyDynamicsWorld* world;
+	btMultiBody** multiBodies;
+	btScalar timeStep;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "stepVelocities loop" );
+		MultiBodyScratch& scratch = world->getMultiBodyScratch();
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btMultiBody* bod = multiBodies[ i ];
+			if ( !btIsMultiBodySleeping( bod ) )
+			{
+				world->stepMultiBodyVelocities( bod, timeStep, scratch );
+			}
+		}
+	}
+};
+
+struct btMultiBodyDynamicsWorld::UpdaterConstraintVelocities : public btIParallelForBody
+{
+	btMultiBodyDynamicsWorld* world;
+	btMultiBody** multiBodies;
+	btScalar timeStep;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "stepVelocities constraint pass loop" );
+		MultiBodyScratch& scratch = world->getMultiBodyScratch();
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			btMultiBody* bod = multiBodies[ i ];
+			if ( !btIsMultiBodySleeping( bod ) )
+			{
+				//useless? they get resized in stepVelocities once again (AND DIFFERENTLY)
+				scratch.m_scratch_r.resize(bod->getNumLinks()+1);			//multidof? ("Y"s use it and it is used to store qdd)
+				scratch.m_scratch_v.resize(bod->getNumLinks()+1);
+				scratch.m_scratch_m.resize(bod->getNumLinks()+1);
+
+				if(bod->isMultiDof())
+				{
+					if(!bod->isUsingRK4Integration())
+					{
+						bool isConstraintPass = true;
+						bod->stepVelocitiesMultiDof(timeStep, scratch.m_scratch_r, scratch.m_scratch_v, scratch.m_scratch_m, isConstraintPass);
+					}
+				}
+			}
+			bod->processDeltaVeeMultiDof2();
+		}
+	}
+};
+
+struct btMultiBodyDynamicsWorld::UpdaterIntegrateTransforms : public btIParallelForBody
+{
+	btMultiBodyDynamicsWorld* world;
+	btMultiBody** multiBodies;
+	btScalar timeStep;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "integrateTransforms loop" );
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			world->integrateMultiBodyTransforms( multiBodies[ i ], timeStep );
+		}
+	}
+};
+
 btMultiBodyDynamicsWorld::btMultiBodyDynamicsWorld(btDispatcher* dispatcher,btBroadphaseInterface* pairCache,btMultiBodyConstraintSolver* constraintSolver,btCollisionConfiguration* collisionConfiguration)
 	:btDiscreteDynamicsWorld(dispatcher,pairCache,constraintSolver,collisionConfiguration),
 	m_multiBodyConstraintSolver(constraintSolver)
@@ -387,6 +487,8 @@ btMultiBodyDynamicsWorld::btMultiBodyDynamicsWorld(btDispatcher* dispatcher,btBr
 	getSolverInfo().m_splitImpulse = false;
 	getSolverInfo().m_solverMode |=SOLVER_USE_2_FRICTION_DIRECTIONS;
 	m_solverMultiBodyIslandCallback = new MultiBodyInplaceSolverIslandCallback(constraintSolver,dispatcher);
+	m_multiBodyScratch.resize(BT_MAX_THREAD_COUNT);
+	m_parallelMultiBodyIntegration = false;
 }
 
 btMultiBodyDynamicsWorld::~btMultiBodyDynamicsWorld ()
@@ -394,26 +496,40 @@ btMultiBodyDynamicsWorld::~btMultiBodyDynamicsWorld ()
 	delete m_solverMultiBodyIslandCallback;
 }
 
-void	btMultiBodyDynamicsWorld::forwardKinematics()
+btMultiBodyDynamicsWorld::MultiBodyScratch&	btMultiBodyDynamicsWorld::getMultiBodyScratch()
 {
-	btAlignedObjectArray<btQuaternion> world_to_local;
-	btAlignedObjectArray<btVector3> local_origin;
+	unsigned int threadIndex = btGetCurrentThreadIndex();
+	btAssert(threadIndex < unsigned(m_multiBodyScratch.size()));
+	return m_multiBodyScratch[threadIndex];
+}
 
-	for (int b=0;b<m_multiBodies.size();b++)
+void	btMultiBodyDynamicsWorld::forEachMultiBody(const btIParallelForBody& body)
+{
+	if (m_multiBodies.size() == 0)
+	{
+		return;
+	}
+	if (m_parallelMultiBodyIntegration)
+	{
+		int grainSize = 4;  // num of multi bodies per task for task scheduler
+		btParallelFor( 0, m_multiBodies.size(), grainSize, body );
+	} else
 	{
-		btMultiBody* bod = m_multiBodies[b];
-		bod->forwardKinematics(world_to_local,local_origin);
+		body.forLoop( 0, m_multiBodies.size() );
 	}
 }
+
+void	btMultiBodyDynamicsWorld::forwardKinematics()
+{
+	UpdaterForwardKinematics update;
+	update.world = this;
+	update.multiBodies = m_multiBodies.size() ? &m_multiBodies[0] : 0;
+	forEachMultiBody(update);
+}
 void	btMultiBodyDynamicsWorld::solveConstraints(btContactSolverInfo& solverInfo)
 {
 	forwardKinematics();
 
-	btAlignedObjectArray<btScalar> scratch_r;
-	btAlignedObjectArray<btVector3> scratch_v;
-	btAlignedObjectArray<btMatrix3x3> scratch_m;
-
-
 	BT_PROFILE("solveConstraints");
 	
 	m_sortedConstraints.resize( m_constraints.size());
@@ -462,11 +578,6 @@ void	btMultiBodyDynamicsWorld::solveConstraints(btContactSolverInfo& solverInfo)
 
 			if (!isSleeping)
 			{
-				//useless? they get resized in stepVelocities once again (AND DIFFERENTLY)
-				scratch_r.resize(bod->getNumLinks()+1);			//multidof? ("Y"s use it and it is used to store qdd)
-				scratch_v.resize(bod->getNumLinks()+1);
-				scratch_m.resize(bod->getNumLinks()+1);
-
 				bod->addBaseForce(m_gravity * bod->getBaseMass());
 
 				for (int j = 0; j < bod->getNumLinks(); ++j) 
@@ -481,98 +592,112 @@ void	btMultiBodyDynamicsWorld::solveConstraints(btContactSolverInfo& solverInfo)
 
 	{
 		BT_PROFILE("btMultiBody stepVelocities");
-		for (int i=0;i<this->m_multiBodies.size();i++)
-		{
-			btMultiBody* bod = m_multiBodies[i];
+		UpdaterStepVelocities update;
+		update.world = this;
+		update.multiBodies = m_multiBodies.size() ? &m_multiBodies[0] : 0;
+		update.timeStep = solverInfo.m_timeStep;
+		forEachMultiBody(update);
+	}
 
-			bool isSleeping = false;
-			
-			if (bod->getBaseCollider() && bod->getBaseCollider()->getActivationState() == ISLAND_SLEEPING)
-			{
-				isSleeping = true;
-			} 
-			for (int b=0;b<bod->getNumLinks();b++)
-			{
-				if (bod->getLink(b).m_collider && bod->getLink(b).m_collider->getActivationState()==ISLAND_SLEEPING)
-					isSleeping = true;
-			} 
+	clearMultiBodyConstraintForces();
 
-			if (!isSleeping)
-			{
-				//useless? they get resized in stepVelocities once again (AND DIFFERENTLY)
-				scratch_r.resize(bod->getNumLinks()+1);			//multidof? ("Y"s use it and it is used to store qdd)
-				scratch_v.resize(bod->getNumLinks()+1);
-				scratch_m.resize(bod->getNumLinks()+1);
-				bool doNotUpdatePos = false;
+	m_solverMultiBodyIslandCallback->processConstraints();
+	
+	m_constraintSolver->allSolved(solverInfo, m_debugDrawer);
 
-				if(bod->isMultiDof())
-				{
-					if(!bod->isUsingRK4Integration())
-					{
-						bod->stepVelocitiesMultiDof(solverInfo.m_timeStep, scratch_r, scratch_v, scratch_m);
-					}
-					else
-					{						
-						//
-						int numDofs = bod->getNumDofs() + 6;
-						int numPosVars = bod->getNumPosVars() + 7;
-						btAlignedObjectArray<btScalar> scratch_r2; scratch_r2.resize(2*numPosVars + 8*numDofs);
-						//convenience
-						btScalar *pMem = &scratch_r2[0];
-						btScalar *scratch_q0 = pMem; pMem += numPosVars;
-						btScalar *scratch_qx = pMem; pMem += numPosVars;
-						btScalar *scratch_qd0 = pMem; pMem += numDofs;
-						btScalar *scratch_qd1 = pMem; pMem += numDofs;
-						btScalar *scratch_qd2 = pMem; pMem += numDofs;
-						btScalar *scratch_qd3 = pMem; pMem += numDofs;
-						btScalar *scratch_qdd0 = pMem; pMem += numDofs;
-						btScalar *scratch_qdd1 = pMem; pMem += numDofs;
-						btScalar *scratch_qdd2 = pMem; pMem += numDofs;
-						btScalar *scratch_qdd3 = pMem; pMem += numDofs;
-						btAssert((pMem - (2*numPosVars + 8*numDofs)) == &scratch_r2[0]);
-
-						/////						
-						//copy q0 to scratch_q0 and qd0 to scratch_qd0
-						scratch_q0[0] = bod->getWorldToBaseRot().x();
-						scratch_q0[1] = bod->getWorldToBaseRot().y();
-						scratch_q0[2] = bod->getWorldToBaseRot().z();
-						scratch_q0[3] = bod->getWorldToBaseRot().w();
-						scratch_q0[4] = bod->getBasePos().x();
-						scratch_q0[5] = bod->getBasePos().y();
-						scratch_q0[6] = bod->getBasePos().z();
-						//
-						for(int link = 0; link < bod->getNumLinks(); ++link)
-						{
-							for(int dof = 0; dof < bod->getLink(link).m_posVarCount; ++dof)
-								scratch_q0[7 + bod->getLink(link).m_cfgOffset + dof] = bod->getLink(link).m_jointPos[dof];							
-						}
-						//
-						for(int dof = 0; dof < numDofs; ++dof)								
-							scratch_qd0[dof] = bod->getVelocityVector()[dof];
-						////
-						struct
-						{
-						    btMultiBody *bod;
+	{
+		BT_PROFILE("btMultiBody stepVelocities");
+		UpdaterConstraintVelocities update;
+		update.world = this;
+		update.multiBodies = m_multiBodies.size() ? &m_multiBodies[0] : 0;
+		update.timeStep = solverInfo.m_timeStep;
+		forEachMultiBody(update);
+	}
+}
+
+void	btMultiBodyDynamicsWorld::stepMultiBodyVelocities(btMultiBody* bod, btScalar timeStep, MultiBodyScratch& scratch)
+{
+	btAlignedObjectArray<btScalar>& scratch_r = scratch.m_scratch_r;
+	btAlignedObjectArray<btVector3>& scratch_v = scratch.m_scratch_v;
+	btAlignedObjectArray<btMatrix3x3>& scratch_m = scratch.m_scratch_m;
+
+	//useless? they get resized in stepVelocities once again (AND DIFFERENTLY)
+	scratch_r.resize(bod->getNumLinks()+1);			//multidof? ("Y"s use it and it is used to store qdd)
+	scratch_v.resize(bod->getNumLinks()+1);
+	scratch_m.resize(bod->getNumLinks()+1);
+	bool doNotUpdatePos = false;
+
+	if(bod->isMultiDof())
+	{
+		if(!bod->isUsingRK4Integration())
+		{
+			bod->stepVelocitiesMultiDof(timeStep, scratch_r, scratch_v, scratch_m);
+		}
+		else
+		{						
+			//
+			int numDofs = bod->getNumDofs() + 6;
+			int numPosVars = bod->getNumPosVars() + 7;
+			btScratchArenaScope scope(bod->getScratchArena());
+			btScalar *scratch_r2 = bod->getScratchArena().allocate<btScalar>(2*numPosVars + 10*numDofs);
+			//convenience
+			btScalar *pMem = scratch_r2;
+			btScalar *scratch_q0 = pMem; pMem += numPosVars;
+			btScalar *scratch_qx = pMem; pMem += numPosVars;
+			btScalar *scratch_qd0 = pMem; pMem += numDofs;
+			btScalar *scratch_qd1 = pMem; pMem += numDofs;
+			btScalar *scratch_qd2 = pMem; pMem += numDofs;
+			btScalar *scratch_qd3 = pMem; pMem += numDofs;
+			btScalar *scratch_qdd0 = pMem; pMem += numDofs;
+			btScalar *scratch_qdd1 = pMem; pMem += numDofs;
+			btScalar *scratch_qdd2 = pMem; pMem += numDofs;
+			btScalar *scratch_qdd3 = pMem; pMem += numDofs;
+			btScalar *delta_q = pMem; pMem += numDofs;
+			btScalar *delta_qd = pMem; pMem += numDofs;
+			btAssert((pMem - (2*numPosVars + 10*numDofs)) == scratch_r2);
+
+			/////						
+			//copy q0 to scratch_q0 and qd0 to scratch_qd0
+			scratch_q0[0] = bod->getWorldToBaseRot().x();
+			scratch_q0[1] = bod->getWorldToBaseRot().y();
+			scratch_q0[2] = bod->getWorldToBaseRot().z();
+			scratch_q0[3] = bod->getWorldToBaseRot().w();
+			scratch_q0[4] = bod->getBasePos().x();
+			scratch_q0[5] = bod->getBasePos().y();
+			scratch_q0[6] = bod->getBasePos().z();
+			//
+			for(int link = 0; link < bod->getNumLinks(); ++link)
+			{
+				for(int dof = 0; dof < bod->getLink(link).m_posVarCount; ++dof)
+					scratch_q0[7 + bod->getLink(link).m_cfgOffset + dof] = bod->getLink(link).m_jointPos[dof];							
+			}
+			//
+			for(int dof = 0; dof < numDofs; ++dof)								
+				scratch_qd0[dof] = bod->getVelocityVector()[dof];
+			////
+			struct
+			{
+			    btMultiBody *bod;
                             btScalar *scratch_qx, *scratch_q0;
 
-						    void operator()()
-						    {
-						        for(int dof = 0; dof < bod->getNumPosVars() + 7; ++dof)
+			    void operator()()
+			    {
+			        for(int dof = 0; dof < bod->getNumPosVars() + 7; ++dof)
                                     scratch_qx[dof] = scratch_q0[dof];
-						    }
-						} pResetQx = {bod, scratch_qx, scratch_q0};
-						//
-						struct
-						{
-						    void operator()(btScalar dt, const btScalar *pDer, const btScalar *pCurVal, btScalar *pVal, int size)
-						    {
-						        for(int i = 0; i < size; ++i)
+			    }
+			} pResetQx = {bod, scratch_qx, scratch_q0};
+			//
+			struct
+			{
+			    void operator()(btScalar dt, const btScalar *pDer, const btScalar *pCurVal, btScalar *pVal, int size)
+			    {
+			        for(int i = 0; i < size; ++i)
                                     pVal[i] = pCurVal[i] + dt * pDer[i];
-						    }
+			    }
 
-						} pEulerIntegrate;
-						//
-						struct
+			} pEulerIntegrate;
+			//
+			struct
                         {
                             void operator()(btMultiBody *pBody, const btScalar *pData)
                             {
@@ -583,150 +708,95 @@ void	btMultiBodyDynamicsWorld::solveConstraints(btContactSolverInfo& solverInfo)
 
                             }
                         } pCopyToVelocityVector;
-						//
+			//
                         struct
-						{
-						    void operator()(const btScalar *pSrc, btScalar *pDst, int start, int size)
-						    {
-						        for(int i = 0; i < size; ++i)
+			{
+			    void operator()(const btScalar *pSrc, btScalar *pDst, int start, int size)
+			    {
+			        for(int i = 0; i < size; ++i)
                                     pDst[i] = pSrc[start + i];
-						    }
-						} pCopy;
-						//
-
-						btScalar h = solverInfo.m_timeStep;
-						#define output &scratch_r[bod->getNumDofs()]
-						//calc qdd0 from: q0 & qd0	
-						bod->stepVelocitiesMultiDof(0., scratch_r, scratch_v, scratch_m);
-						pCopy(output, scratch_qdd0, 0, numDofs);
-						//calc q1 = q0 + h/2 * qd0
-						pResetQx();
-						bod->stepPositionsMultiDof(btScalar(.5)*h, scratch_qx, scratch_qd0);
-						//calc qd1 = qd0 + h/2 * qdd0
-						pEulerIntegrate(btScalar(.5)*h, scratch_qdd0, scratch_qd0, scratch_qd1, numDofs);
-						//
-						//calc qdd1 from: q1 & qd1
-						pCopyToVelocityVector(bod, scratch_qd1);
-						bod->stepVelocitiesMultiDof(0., scratch_r, scratch_v, scratch_m);
-						pCopy(output, scratch_qdd1, 0, numDofs);
-						//calc q2 = q0 + h/2 * qd1
-						pResetQx();
-						bod->stepPositionsMultiDof(btScalar(.5)*h, scratch_qx, scratch_qd1);
-						//calc qd2 = qd0 + h/2 * qdd1
-						pEulerIntegrate(btScalar(.5)*h, scratch_qdd1, scratch_qd0, scratch_qd2, numDofs);
-						//
-						//calc qdd2 from: q2 & qd2
-						pCopyToVelocityVector(bod, scratch_qd2);
-						bod->stepVelocitiesMultiDof(0., scratch_r, scratch_v, scratch_m);
-						pCopy(output, scratch_qdd2, 0, numDofs);
-						//calc q3 = q0 + h * qd2
-						pResetQx();
-						bod->stepPositionsMultiDof(h, scratch_qx, scratch_qd2);
-						//calc qd3 = qd0 + h * qdd2
-						pEulerIntegrate(h, scratch_qdd2, scratch_qd0, scratch_qd3, numDofs);
-						//
-						//calc qdd3 from: q3 & qd3
-						pCopyToVelocityVector(bod, scratch_qd3);
-						bod->stepVelocitiesMultiDof(0., scratch_r, scratch_v, scratch_m);
-						pCopy(output, scratch_qdd3, 0, numDofs);
-
-						//
-						//calc q = q0 + h/6(qd0 + 2*(qd1 + qd2) + qd3)
-						//calc qd = qd0 + h/6(qdd0 + 2*(qdd1 + qdd2) + qdd3)						
-						btAlignedObjectArray<btScalar> delta_q; delta_q.resize(numDofs);
-						btAlignedObjectArray<btScalar> delta_qd; delta_qd.resize(numDofs);
-						for(int i = 0; i < numDofs; ++i)
-						{
-							delta_q[i] = h/btScalar(6.)*(scratch_qd0[i] + 2*scratch_qd1[i] + 2*scratch_qd2[i] + scratch_qd3[i]);
-							delta_qd[i] = h/btScalar(6.)*(scratch_qdd0[i] + 2*scratch_qdd1[i] + 2*scratch_qdd2[i] + scratch_qdd3[i]);							
-							//delta_q[i] = h*scratch_qd0[i];
-							//delta_qd[i] = h*scratch_qdd0[i];
-						}
-						//
-						pCopyToVelocityVector(bod, scratch_qd0);
-						bod->applyDeltaVeeMultiDof(&delta_qd[0], 1);						
-						//
-						if(!doNotUpdatePos)
-						{
-							btScalar *pRealBuf = const_cast<btScalar *>(bod->getVelocityVector());
-							pRealBuf += 6 + bod->getNumDofs() + bod->getNumDofs()*bod->getNumDofs();
-
-							for(int i = 0; i < numDofs; ++i)
-								pRealBuf[i] = delta_q[i];
-
-							//bod->stepPositionsMultiDof(1, 0, &delta_q[0]);
-							bod->setPosUpdated(true);							
-						}
-
-						//ugly hack which resets the cached data to t0 (needed for constraint solver)
-						{
-							for(int link = 0; link < bod->getNumLinks(); ++link)
-								bod->getLink(link).updateCacheMultiDof();
-							bod->stepVelocitiesMultiDof(0, scratch_r, scratch_v, scratch_m);
-						}
-						
-					}
-				}
-				else//if(bod->isMultiDof())
-				{
-					bod->stepVelocities(solverInfo.m_timeStep, scratch_r, scratch_v, scratch_m);
-				}
-#ifndef BT_USE_VIRTUAL_CLEARFORCES_AND_GRAVITY
-				bod->clearForcesAndTorques();
-#endif //BT_USE_VIRTUAL_CLEARFORCES_AND_GRAVITY
-			}//if (!isSleeping)
-		}
-	}
-
-	clearMultiBodyConstraintForces();
-
-	m_solverMultiBodyIslandCallback->processConstraints();
-	
-	m_constraintSolver->allSolved(solverInfo, m_debugDrawer);
-
-	{
-                BT_PROFILE("btMultiBody stepVelocities");
-                for (int i=0;i<this->m_multiBodies.size();i++)
-                {
-                        btMultiBody* bod = m_multiBodies[i];
+			    }
+			} pCopy;
+			//
+
+			btScalar h = timeStep;
+			#define output &scratch_r[bod->getNumDofs()]
+			//calc qdd0 from: q0 & qd0	
+			bod->stepVelocitiesMultiDof(0., scratch_r, scratch_v, scratch_m);
+			pCopy(output, scratch_qdd0, 0, numDofs);
+			//calc q1 = q0 + h/2 * qd0
+			pResetQx();
+			bod->stepPositionsMultiDof(btScalar(.5)*h, scratch_qx, scratch_qd0);
+			//calc qd1 = qd0 + h/2 * qdd0
+			pEulerIntegrate(btScalar(.5)*h, scratch_qdd0, scratch_qd0, scratch_qd1, numDofs);
+			//
+			//calc qdd1 from: q1 & qd1
+			pCopyToVelocityVector(bod, scratch_qd1);
+			bod->stepVelocitiesMultiDof(0., scratch_r, scratch_v, scratch_m);
+			pCopy(output, scratch_qdd1, 0, numDofs);
+			//calc q2 = q0 + h/2 * qd1
+			pResetQx();
+			bod->stepPositionsMultiDof(btScalar(.5)*h, scratch_qx, scratch_qd1);
+			//calc qd2 = qd0 + h/2 * qdd1
+			pEulerIntegrate(btScalar(.5)*h, scratch_qdd1, scratch_qd0, scratch_qd2, numDofs);
+			//
+			//calc qdd2 from: q2 & qd2
+			pCopyToVelocityVector(bod, scratch_qd2);
+			bod->stepVelocitiesMultiDof(0., scratch_r, scratch_v, scratch_m);
+			pCopy(output, scratch_qdd2, 0, numDofs);
+			//calc q3 = q0 + h * qd2
+			pResetQx();
+			bod->stepPositionsMultiDof(h, scratch_qx, scratch_qd2);
+			//calc qd3 = qd0 + h * qdd2
+			pEulerIntegrate(h, scratch_qdd2, scratch_qd0, scratch_qd3, numDofs);
+			//
+			//calc qdd3 from: q3 & qd3
+			pCopyToVelocityVector(bod, scratch_qd3);
+			bod->stepVelocitiesMultiDof(0., scratch_r, scratch_v, scratch_m);
+			pCopy(output, scratch_qdd3, 0, numDofs);
+
+			//
+			//calc q = q0 + h/6(qd0 + 2*(qd1 + qd2) + qd3)
+			//calc qd = qd0 + h/6(qdd0 + 2*(qdd1 + qdd2) + qdd3)						
+			for(int i = 0; i < numDofs; ++i)
+			{
+				delta_q[i] = h/btScalar(6.)*(scratch_qd0[i] + 2*scratch_qd1[i] + 2*scratch_qd2[i] + scratch_qd3[i]);
+				delta_qd[i] = h/btScalar(6.)*(scratch_qdd0[i] + 2*scratch_qdd1[i] + 2*scratch_qdd2[i] + scratch_qdd3[i]);							
+				//delta_q[i] = h*scratch_qd0[i];
+				//delta_qd[i] = h*scratch_qdd0[i];
+			}
+			//
+			pCopyToVelocityVector(bod, scratch_qd0);
+			bod->applyDeltaVeeMultiDof(&delta_qd[0], 1);						
+			//
+			if(!doNotUpdatePos)
+			{
+				btScalar *pRealBuf = const_cast<btScalar *>(bod->getVelocityVector());
+				pRealBuf += 6 + bod->getNumDofs() + bod->getNumDofs()*bod->getNumDofs();
 
-                        bool isSleeping = false;
+				for(int i = 0; i < numDofs; ++i)
+					pRealBuf[i] = delta_q[i];
 
-                        if (bod->getBaseCollider() && bod->getBaseCollider()->getActivationState() == ISLAND_SLEEPING)
-                        {
-                                isSleeping = true;
-                        }
-                        for (int b=0;b<bod->getNumLinks();b++)
-                        {
-                                if (bod->getLink(b).m_collider && bod->getLink(b).m_collider->getActivationState()==ISLAND_SLEEPING)
-                                        isSleeping = true;
-                        }
+				//bod->stepPositionsMultiDof(1, 0, &delta_q[0]);
+				bod->setPosUpdated(true);							
+			}
 
-                        if (!isSleeping)
-                        {
-                                //useless? they get resized in stepVelocities once again (AND DIFFERENTLY)
-                                scratch_r.resize(bod->getNumLinks()+1);                 //multidof? ("Y"s use it and it is used to store qdd)
-                                scratch_v.resize(bod->getNumLinks()+1);
-                                scratch_m.resize(bod->getNumLinks()+1);
-
-                                if(bod->isMultiDof())
-                                {
-                                        if(!bod->isUsingRK4Integration())
-                                        {
-						bool isConstraintPass = true;
-                                                bod->stepVelocitiesMultiDof(solverInfo.m_timeStep, scratch_r, scratch_v, scratch_m, isConstraintPass);
-                                        }
-				}
+			//ugly hack which resets the cached data to t0 (needed for constraint solver)
+			{
+				for(int link = 0; link < bod->getNumLinks(); ++link)
+					bod->getLink(link).updateCacheMultiDof();
+				bod->stepVelocitiesMultiDof(0, scratch_r, scratch_v, scratch_m);
 			}
+			
 		}
 	}
-
-	for (int i=0;i<this->m_multiBodies.size();i++)
-       {
-                btMultiBody* bod = m_multiBodies[i];
-		bod->processDeltaVeeMultiDof2();
+	else//if(bod->isMultiDof())
+	{
+		bod->stepVelocities(timeStep, scratch_r, scratch_v, scratch_m);
 	}
-
+#ifndef BT_USE_VIRTUAL_CLEARFORCES_AND_GRAVITY
+	bod->clearForcesAndTorques();
+#endif //BT_USE_VIRTUAL_CLEARFORCES_AND_GRAVITY
 }
 
 void	btMultiBodyDynamicsWorld::integrateTransforms(btScalar timeStep)
@@ -736,57 +806,40 @@ void	btMultiBodyDynamicsWorld::integrateTransforms(btScalar timeStep)
 	{
 		BT_PROFILE("btMultiBody stepPositions");
 		//integrate and update the Featherstone hierarchies
-		btAlignedObjectArray<btQuaternion> world_to_local;
-		btAlignedObjectArray<btVector3> local_origin;
+		UpdaterIntegrateTransforms update;
+		update.world = this;
+		update.multiBodies = m_multiBodies.size() ? &m_multiBodies[0] : 0;
+		update.timeStep = timeStep;
+		forEachMultiBody(update);
+	}
+}
 
-		for (int b=0;b<m_multiBodies.size();b++)
+void	btMultiBodyDynamicsWorld::integrateMultiBodyTransforms(btMultiBody* bod, btScalar timeStep)
+{
+	if (!btIsMultiBodySleeping(bod))
+	{
+		if(bod->isMultiDof())
 		{
-			btMultiBody* bod = m_multiBodies[b];
-			bool isSleeping = false;
-			if (bod->getBaseCollider() && bod->getBaseCollider()->getActivationState() == ISLAND_SLEEPING)
-			{
-				isSleeping = true;
-			} 
-			for (int b=0;b<bod->getNumLinks();b++)
+			if(!bod->isPosUpdated())
+				bod->stepPositionsMultiDof(timeStep);
+			else
 			{
-				if (bod->getLink(b).m_collider && bod->getLink(b).m_collider->getActivationState()==ISLAND_SLEEPING)
-					isSleeping = true;
-			}
-
-
-			if (!isSleeping)
-			{
-				int nLinks = bod->getNumLinks();
+				btScalar *pRealBuf = const_cast<btScalar *>(bod->getVelocityVector());
+				pRealBuf += 6 + bod->getNumDofs() + bod->getNumDofs()*bod->getNumDofs();
 
-				///base + num m_links
-			
-				if(bod->isMultiDof())
-				{
-					if(!bod->isPosUpdated())
-						bod->stepPositionsMultiDof(timeStep);
-					else
-					{
-						btScalar *pRealBuf = const_cast<btScalar *>(bod->getVelocityVector());
-						pRealBuf += 6 + bod->getNumDofs() + bod->getNumDofs()*bod->getNumDofs();
-
-						bod->stepPositionsMultiDof(1, 0, pRealBuf);
-						bod->setPosUpdated(false);
-					}
-				}
-				else
-				{
-					bod->stepPositions(timeStep);			
-				}
-				world_to_local.resize(nLinks+1);
-				local_origin.resize(nLinks+1);
-
-				bod->updateCollisionObjectWorldTransforms(world_to_local,local_origin);
-				
-			} else
-			{
-				bod->clearVelocities();
+				bod->stepPositionsMultiDof(1, 0, pRealBuf);
+				bod->setPosUpdated(false);
 			}
 		}
+		else
+		{
+			bod->stepPositions(timeStep);			
+		}
+		bod->updateCollisionObjectWorldTransforms();
+		
+	} else
+	{
+		bod->clearVelocities();
 	}
 }
 
@@ -825,9 +878,6 @@ void	btMultiBodyDynamicsWorld::debugDrawWorld()
 		{
 			BT_PROFILE("btMultiBody debugDrawWorld");
 			
-			btAlignedObjectArray<btQuaternion> world_to_local1;
-			btAlignedObjectArray<btVector3> local_origin1;
-
 			for (int c=0;c<m_multiBodyConstraints.size();c++)
 			{
 				btMultiBodyConstraint* constraint = m_multiBodyConstraints[c];
@@ -837,7 +887,7 @@ void	btMultiBodyDynamicsWorld::debugDrawWorld()
 			for (int b = 0; b<m_multiBodies.size(); b++)
 			{
 				btMultiBody* bod = m_multiBodies[b];
-				bod->forwardKinematics(world_to_local1,local_origin1);
+				bod->forwardKinematics();
 				
 				getDebugDrawer()->drawTransform(bod->getBaseWorldTransform(), 0.1);
 
@@ -17,6 +17,7 @@ subject to the following restrictions:
 #define BT_MULTIBODY_DYNAMICS_WORLD_H
 
 #include "BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h"
+#include "LinearMath/btThreads.h"
 
 #define BT_USE_VIRTUAL_CLEARFORCES_AND_GRAVITY
 
@@ -27,18 +28,44 @@ struct MultiBodyInplaceSolverIslandCallback;
 
 ///The btMultiBodyDynamicsWorld adds Featherstone multi body dynamics to Bullet
 ///This implementation is still preliminary/experimental.
+///With setParallelMultiBodyIntegration(true) the passes over the multi bodies that only touch one multi body at a time
+///(forward kinematics, the articulated body algorithm before and after the constraint solver, the position integration
+///and the update of the collider transforms) run with btParallelFor, each thread with its own scratch buffers.
+///Forward kinematics and the collider transforms use the scratch arena of each multi body, so after the first steps
+///stepping doesn't allocate memory.
+///The constraints are still solved serially, and the results are the same as with the serial passes.
 class btMultiBodyDynamicsWorld : public btDiscreteDynamicsWorld
 {
 protected:
+	///scratch buffers of the per multi body passes, one set per thread
+	struct MultiBodyScratch
+	{
+		btAlignedObjectArray<btScalar>		m_scratch_r;
+		btAlignedObjectArray<btVector3>		m_scratch_v;
+		btAlignedObjectArray<btMatrix3x3>	m_scratch_m;
+	};
+	struct UpdaterForwardKinematics;
+	struct UpdaterStepVelocities;
+	struct UpdaterConstraintVelocities;
+	struct UpdaterIntegrateTransforms;
+
 	btAlignedObjectArray<btMultiBody*> m_multiBodies;
 	btAlignedObjectArray<btMultiBodyConstraint*> m_multiBodyConstraints;
 	btAlignedObjectArray<btMultiBodyConstraint*> m_sortedMultiBodyConstraints;
 	btMultiBodyConstraintSolver*	m_multiBodyConstraintSolver;
 	MultiBodyInplaceSolverIslandCallback*	m_solverMultiBodyIslandCallback;
+	btAlignedObjectArray<MultiBodyScratch>	m_multiBodyScratch;
+	bool	m_parallelMultiBodyIntegration;
 
 	virtual void	calculateSimulationIslands();
 	virtual void	updateActivationState(btScalar timeStep);
 	virtual void	solveConstraints(btContactSolverInfo& solverInfo);
+
+	MultiBodyScratch&	getMultiBodyScratch();
+	///calls body.forLoop for all multi bodies, in parallel if setParallelMultiBodyIntegration is on
+	void	forEachMultiBody(const btIParallelForBody& body);
+	void	stepMultiBodyVelocities(btMultiBody* bod, btScalar timeStep, MultiBodyScratch& scratch);
+	void	integrateMultiBodyTransforms(btMultiBody* bod, btScalar timeStep);
 	
 	virtual void	serializeMultiBodies(btSerializer* serializer);
 
@@ -52,6 +79,16 @@ public:
 
 	virtual void	removeMultiBody(btMultiBody* body);
 
+	void	setParallelMultiBodyIntegration(bool parallel)
+	{
+		m_parallelMultiBodyIntegration = parallel;
+	}
+
+	bool	getParallelMultiBodyIntegration() const
+	{
+		return m_parallelMultiBodyIntegration;
+	}
+
 	virtual int		getNumMultibodies() const
 	{
 		return m_multiBodies.size();
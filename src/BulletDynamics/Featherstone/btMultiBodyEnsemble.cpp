@@ -0,0 +1,1212 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btMultiBodyEnsemble.h"
+#include "btMultiBody.h"
+#include "LinearMath/btTransformUtil.h"
+#include "LinearMath/btQuickprof.h"
+
+///the lanes only need SSE2 (or AVX), so they are also used where btVector3 itself doesn't use SSE.
+///The loads are unaligned since the force and output arrays of calcAccelerationDeltas come from the user
+#if !defined (BT_USE_DOUBLE_PRECISION) && defined (__AVX__)
+#define BT_ENSEMBLE_USE_AVX 1
+#include <immintrin.h>
+#define BT_ENSEMBLE_LANE_COUNT 8
+#elif !defined (BT_USE_DOUBLE_PRECISION) && (defined (USE_SIMD) || defined (__SSE2__) || defined (_M_X64) || defined (_M_AMD64))
+#define BT_ENSEMBLE_USE_SSE 1
+#include <emmintrin.h>
+#define BT_ENSEMBLE_LANE_COUNT 4
+#else
+#define BT_ENSEMBLE_LANE_COUNT 4
+#endif
+
+enum { LANES = BT_ENSEMBLE_LANE_COUNT };
+
+///one scalar for each lane of a block
+struct btEnsembleReal
+{
+#if defined (BT_ENSEMBLE_USE_AVX)
+	__m256 v;
+
+	static SIMD_FORCE_INLINE btEnsembleReal make(__m256 x) { btEnsembleReal r; r.v = x; return r; }
+	static SIMD_FORCE_INLINE btEnsembleReal load(const btScalar* p) { return make(_mm256_loadu_ps(p)); }
+	static SIMD_FORCE_INLINE btEnsembleReal splat(btScalar s) { return make(_mm256_set1_ps(s)); }
+	SIMD_FORCE_INLINE void store(btScalar* p) const { _mm256_storeu_ps(p, v); }
+	SIMD_FORCE_INLINE btEnsembleReal operator+(const btEnsembleReal& b) const { return make(_mm256_add_ps(v, b.v)); }
+	SIMD_FORCE_INLINE btEnsembleReal operator-(const btEnsembleReal& b) const { return make(_mm256_sub_ps(v, b.v)); }
+	SIMD_FORCE_INLINE btEnsembleReal operator*(const btEnsembleReal& b) const { return make(_mm256_mul_ps(v, b.v)); }
+	SIMD_FORCE_INLINE btEnsembleReal operator/(const btEnsembleReal& b) const { return make(_mm256_div_ps(v, b.v)); }
+	SIMD_FORCE_INLINE btEnsembleReal operator-() const { return make(_mm256_sub_ps(_mm256_setzero_ps(), v)); }
+	static SIMD_FORCE_INLINE btEnsembleReal sqrt(const btEnsembleReal& a) { return make(_mm256_sqrt_ps(a.v)); }
+	static SIMD_FORCE_INLINE btEnsembleReal clamp(const btEnsembleReal& a, const btEnsembleReal& lo, const btEnsembleReal& hi) { return make(_mm256_min_ps(_mm256_max_ps(a.v, lo.v), hi.v)); }
+#elif defined (BT_ENSEMBLE_USE_SSE)
+	__m128 v;
+
+	static SIMD_FORCE_INLINE btEnsembleReal make(__m128 x) { btEnsembleReal r; r.v = x; return r; }
+	static SIMD_FORCE_INLINE btEnsembleReal load(const btScalar* p) { return make(_mm_loadu_ps(p)); }
+	static SIMD_FORCE_INLINE btEnsembleReal splat(btScalar s) { return make(_mm_set1_ps(s)); }
+	SIMD_FORCE_INLINE void store(btScalar* p) const { _mm_storeu_ps(p, v); }
+	SIMD_FORCE_INLINE btEnsembleReal operator+(const btEnsembleReal& b) const { return make(_mm_add_ps(v, b.v)); }
+	SIMD_FORCE_INLINE btEnsembleReal operator-(const btEnsembleReal& b) const { return make(_mm_sub_ps(v, b.v)); }
+	SIMD_FORCE_INLINE btEnsembleReal operator*(const btEnsembleReal& b) const { return make(_mm_mul_ps(v, b.v)); }
+	SIMD_FORCE_INLINE btEnsembleReal operator/(const btEnsembleReal& b) const { return make(_mm_div_ps(v, b.v)); }
+	SIMD_FORCE_INLINE btEnsembleReal operator-() const { return make(_mm_sub_ps(_mm_setzero_ps(), v)); }
+	static SIMD_FORCE_INLINE btEnsembleReal sqrt(const btEnsembleReal& a) { return make(_mm_sqrt_ps(a.v)); }
+	static SIMD_FORCE_INLINE btEnsembleReal clamp(const btEnsembleReal& a, const btEnsembleReal& lo, const btEnsembleReal& hi) { return make(_mm_min_ps(_mm_max_ps(a.v, lo.v), hi.v)); }
+#else
+	btScalar v[LANES];
+
+	static SIMD_FORCE_INLINE btEnsembleReal load(const btScalar* p) { btEnsembleReal r; for (int i=0;i<LANES;i++) r.v[i] = p[i]; return r; }
+	static SIMD_FORCE_INLINE btEnsembleReal splat(btScalar s) { btEnsembleReal r; for (int i=0;i<LANES;i++) r.v[i] = s; return r; }
+	SIMD_FORCE_INLINE void store(btScalar* p) const { for (int i=0;i<LANES;i++) p[i] = v[i]; }
+	SIMD_FORCE_INLINE btEnsembleReal operator+(const btEnsembleReal& b) const { btEnsembleReal r; for (int i=0;i<LANES;i++) r.v[i] = v[i] + b.v[i]; return r; }
+	SIMD_FORCE_INLINE btEnsembleReal operator-(const btEnsembleReal& b) const { btEnsembleReal r; for (int i=0;i<LANES;i++) r.v[i] = v[i] - b.v[i]; return r; }
+	SIMD_FORCE_INLINE btEnsembleReal operator*(const btEnsembleReal& b) const { btEnsembleReal r; for (int i=0;i<LANES;i++) r.v[i] = v[i] * b.v[i]; return r; }
+	SIMD_FORCE_INLINE btEnsembleReal operator/(const btEnsembleReal& b) const { btEnsembleReal r; for (int i=0;i<LANES;i++) r.v[i] = v[i] / b.v[i]; return r; }
+	SIMD_FORCE_INLINE btEnsembleReal operator-() const { btEnsembleReal r; for (int i=0;i<LANES;i++) r.v[i] = -v[i]; return r; }
+	static SIMD_FORCE_INLINE btEnsembleReal sqrt(const btEnsembleReal& a) { btEnsembleReal r; for (int i=0;i<LANES;i++) r.v[i] = btSqrt(a.v[i]); return r; }
+	static SIMD_FORCE_INLINE btEnsembleReal clamp(const btEnsembleReal& a, const btEnsembleReal& lo, const btEnsembleReal& hi) { btEnsembleReal r; for (int i=0;i<LANES;i++) { r.v[i] = a.v[i]; btClamp(r.v[i], lo.v[i], hi.v[i]); } return r; }
+#endif
+	SIMD_FORCE_INLINE btEnsembleReal& operator+=(const btEnsembleReal& b) { *this = *this + b; return *this; }
+	SIMD_FORCE_INLINE btEnsembleReal& operator-=(const btEnsembleReal& b) { *this = *this - b; return *this; }
+};
+
+typedef btEnsembleReal Real;
+
+struct btEnsembleVector3
+{
+	Real x, y, z;
+
+	static SIMD_FORCE_INLINE btEnsembleVector3 make(const Real& x, const Real& y, const Real& z) { btEnsembleVector3 r; r.x = x; r.y = y; r.z = z; return r; }
+	///p points to 3 consecutive fields of a block
+	static SIMD_FORCE_INLINE btEnsembleVector3 load(const btScalar* p) { return make(Real::load(p), Real::load(p + LANES), Real::load(p + 2*LANES)); }
+	static SIMD_FORCE_INLINE btEnsembleVector3 splat(const btVector3& v) { return make(Real::splat(v.x()), Real::splat(v.y()), Real::splat(v.z())); }
+	static SIMD_FORCE_INLINE btEnsembleVector3 zero() { return splat(btVector3(0, 0, 0)); }
+	SIMD_FORCE_INLINE void store(btScalar* p) const { x.store(p); y.store(p + LANES); z.store(p + 2*LANES); }
+	SIMD_FORCE_INLINE btEnsembleVector3 operator+(const btEnsembleVector3& b) const { return make(x + b.x, y + b.y, z + b.z); }
+	SIMD_FORCE_INLINE btEnsembleVector3 operator-(const btEnsembleVector3& b) const { return make(x - b.x, y - b.y, z - b.z); }
+	SIMD_FORCE_INLINE btEnsembleVector3 operator-() const { return make(-x, -y, -z); }
+	SIMD_FORCE_INLINE btEnsembleVector3 operator*(const Real& s) const { return make(x * s, y * s, z * s); }
+	///component-wise, like btVector3 * btVector3
+	SIMD_FORCE_INLINE btEnsembleVector3 operator*(const btEnsembleVector3& b) const { return make(x * b.x, y * b.y, z * b.z); }
+	SIMD_FORCE_INLINE btEnsembleVector3& operator+=(const btEnsembleVector3& b) { *this = *this + b; return *this; }
+	SIMD_FORCE_INLINE btEnsembleVector3& operator-=(const btEnsembleVector3& b) { *this = *this - b; return *this; }
+	SIMD_FORCE_INLINE Real dot(const btEnsembleVector3& b) const { return x * b.x + y * b.y + z * b.z; }
+	SIMD_FORCE_INLINE btEnsembleVector3 cross(const btEnsembleVector3& b) const { return make(y * b.z - z * b.y, z * b.x - x * b.z, x * b.y - y * b.x); }
+	SIMD_FORCE_INLINE Real norm() const { return Real::sqrt(dot(*this)); }
+};
+
+typedef btEnsembleVector3 Vec3;
+
+///row major 3x3 matrix for each lane
+struct btEnsembleMatrix3x3
+{
+	Real m[3][3];
+
+	static SIMD_FORCE_INLINE btEnsembleMatrix3x3 load(const btScalar* p)
+	{
+		btEnsembleMatrix3x3 r;
+		for (int i=0;i<3;i++)
+			for (int j=0;j<3;j++)
+				r.m[i][j] = Real::load(p + (i*3 + j)*LANES);
+		return r;
+	}
+	static SIMD_FORCE_INLINE btEnsembleMatrix3x3 splat(const btMatrix3x3& a)
+	{
+		btEnsembleMatrix3x3 r;
+		for (int i=0;i<3;i++)
+			for (int j=0;j<3;j++)
+				r.m[i][j] = Real::splat(a[i][j]);
+		return r;
+	}
+	static SIMD_FORCE_INLINE btEnsembleMatrix3x3 diagonal(const btVector3& d)
+	{
+		btEnsembleMatrix3x3 r = splat(btMatrix3x3(d.x(), 0, 0, 0, d.y(), 0, 0, 0, d.z()));
+		return r;
+	}
+	///same as btMatrix3x3::setRotation
+	static SIMD_FORCE_INLINE btEnsembleMatrix3x3 fromQuat(const Real& qx, const Real& qy, const Real& qz, const Real& qw)
+	{
+		Real d = qx * qx + qy * qy + qz * qz + qw * qw;
+		Real s = Real::splat(btScalar(2.0)) / d;
+		Real xs = qx * s, ys = qy * s, zs = qz * s;
+		Real wx = qw * xs, wy = qw * ys, wz = qw * zs;
+		Real xx = qx * xs, xy = qx * ys, xz = qx * zs;
+		Real yy = qy * ys, yz = qy * zs, zz = qz * zs;
+		Real one = Real::splat(btScalar(1.0));
+		btEnsembleMatrix3x3 r;
+		r.m[0][0] = one - (yy + zz); r.m[0][1] = xy - wz; r.m[0][2] = xz + wy;
+		r.m[1][0] = xy + wz; r.m[1][1] = one - (xx + zz); r.m[1][2] = yz - wx;
+		r.m[2][0] = xz - wy; r.m[2][1] = yz + wx; r.m[2][2] = one - (xx + yy);
+		return r;
+	}
+	SIMD_FORCE_INLINE void store(btScalar* p) const
+	{
+		for (int i=0;i<3;i++)
+			for (int j=0;j<3;j++)
+				m[i][j].store(p + (i*3 + j)*LANES);
+	}
+	SIMD_FORCE_INLINE Vec3 operator*(const Vec3& v) const
+	{
+		return Vec3::make(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+						m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+						m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+	}
+	///transpose() * v
+	SIMD_FORCE_INLINE Vec3 transposeTimes(const Vec3& v) const
+	{
+		return Vec3::make(m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z,
+						m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+						m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z);
+	}
+	SIMD_FORCE_INLINE btEnsembleMatrix3x3 operator*(const btEnsembleMatrix3x3& b) const
+	{
+		btEnsembleMatrix3x3 r;
+		for (int i=0;i<3;i++)
+			for (int j=0;j<3;j++)
+				r.m[i][j] = m[i][0] * b.m[0][j] + m[i][1] * b.m[1][j] + m[i][2] * b.m[2][j];
+		return r;
+	}
+	SIMD_FORCE_INLINE btEnsembleMatrix3x3 operator+(const btEnsembleMatrix3x3& b) const
+	{
+		btEnsembleMatrix3x3 r;
+		for (int i=0;i<3;i++)
+			for (int j=0;j<3;j++)
+				r.m[i][j] = m[i][j] + b.m[i][j];
+		return r;
+	}
+	SIMD_FORCE_INLINE btEnsembleMatrix3x3 operator-(const btEnsembleMatrix3x3& b) const
+	{
+		btEnsembleMatrix3x3 r;
+		for (int i=0;i<3;i++)
+			for (int j=0;j<3;j++)
+				r.m[i][j] = m[i][j] - b.m[i][j];
+		return r;
+	}
+	SIMD_FORCE_INLINE btEnsembleMatrix3x3 transpose() const
+	{
+		btEnsembleMatrix3x3 r;
+		for (int i=0;i<3;i++)
+			for (int j=0;j<3;j++)
+				r.m[i][j] = m[j][i];
+		return r;
+	}
+	SIMD_FORCE_INLINE Real cofac(int r1, int c1, int r2, int c2) const
+	{
+		return m[r1][c1] * m[r2][c2] - m[r1][c2] * m[r2][c1];
+	}
+	///same as btMatrix3x3::inverse
+	SIMD_FORCE_INLINE btEnsembleMatrix3x3 inverse() const
+	{
+		Vec3 co = Vec3::make(cofac(1, 1, 2, 2), cofac(1, 2, 2, 0), cofac(1, 0, 2, 1));
+		Real det = m[0][0] * co.x + m[0][1] * co.y + m[0][2] * co.z;
+		Real s = Real::splat(btScalar(1.0)) / det;
+		btEnsembleMatrix3x3 r;
+		r.m[0][0] = co.x * s; r.m[0][1] = cofac(0, 2, 2, 1) * s; r.m[0][2] = cofac(0, 1, 1, 2) * s;
+		r.m[1][0] = co.y * s; r.m[1][1] = cofac(0, 0, 2, 2) * s; r.m[1][2] = cofac(0, 2, 1, 0) * s;
+		r.m[2][0] = co.z * s; r.m[2][1] = cofac(0, 1, 2, 0) * s; r.m[2][2] = cofac(0, 0, 1, 1) * s;
+		return r;
+	}
+};
+
+typedef btEnsembleMatrix3x3 Mat3;
+
+static SIMD_FORCE_INLINE Mat3 outerProduct(const Vec3& a, const Vec3& b)
+{
+	Mat3 r;
+	r.m[0][0] = a.x * b.x; r.m[0][1] = a.x * b.y; r.m[0][2] = a.x * b.z;
+	r.m[1][0] = a.y * b.x; r.m[1][1] = a.y * b.y; r.m[1][2] = a.y * b.z;
+	r.m[2][0] = a.z * b.x; r.m[2][1] = a.z * b.y; r.m[2][2] = a.z * b.z;
+	return r;
+}
+
+///the lane versions of btSpatialMotionVector (top = angular), btSpatialForceVector (top = linear) and btSymmetricSpatialDyad,
+///stored in the blocks in that order
+struct btEnsembleMotion
+{
+	Vec3 m_topVec, m_bottomVec;
+
+	static SIMD_FORCE_INLINE btEnsembleMotion make(const Vec3& top, const Vec3& bottom) { btEnsembleMotion r; r.m_topVec = top; r.m_bottomVec = bottom; return r; }
+	static SIMD_FORCE_INLINE btEnsembleMotion load(const btScalar* p) { return make(Vec3::load(p), Vec3::load(p + 3*LANES)); }
+	static SIMD_FORCE_INLINE btEnsembleMotion splat(const btVector3& top, const btVector3& bottom) { return make(Vec3::splat(top), Vec3::splat(bottom)); }
+	SIMD_FORCE_INLINE void store(btScalar* p) const { m_topVec.store(p); m_bottomVec.store(p + 3*LANES); }
+	SIMD_FORCE_INLINE btEnsembleMotion operator+(const btEnsembleMotion& b) const { return make(m_topVec + b.m_topVec, m_bottomVec + b.m_bottomVec); }
+	SIMD_FORCE_INLINE btEnsembleMotion operator*(const Real& s) const { return make(m_topVec * s, m_bottomVec * s); }
+};
+
+struct btEnsembleForce
+{
+	Vec3 m_topVec, m_bottomVec;
+
+	static SIMD_FORCE_INLINE btEnsembleForce make(const Vec3& top, const Vec3& bottom) { btEnsembleForce r; r.m_topVec = top; r.m_bottomVec = bottom; return r; }
+	static SIMD_FORCE_INLINE btEnsembleForce load(const btScalar* p) { return make(Vec3::load(p), Vec3::load(p + 3*LANES)); }
+	SIMD_FORCE_INLINE void store(btScalar* p) const { m_topVec.store(p); m_bottomVec.store(p + 3*LANES); }
+	SIMD_FORCE_INLINE btEnsembleForce operator+(const btEnsembleForce& b) const { return make(m_topVec + b.m_topVec, m_bottomVec + b.m_bottomVec); }
+	SIMD_FORCE_INLINE btEnsembleForce operator*(const Real& s) const { return make(m_topVec * s, m_bottomVec * s); }
+};
+
+typedef btEnsembleMotion Motion;
+typedef btEnsembleForce Force;
+
+static SIMD_FORCE_INLINE Real dot(const Motion& a, const Force& b)
+{
+	return a.m_bottomVec.dot(b.m_topVec) + a.m_topVec.dot(b.m_bottomVec);
+}
+
+///see btSpatialMotionVector::cross
+static SIMD_FORCE_INLINE Motion cross(const Motion& a, const Motion& b)
+{
+	return Motion::make(a.m_topVec.cross(b.m_topVec), a.m_bottomVec.cross(b.m_topVec) + a.m_topVec.cross(b.m_bottomVec));
+}
+
+///see btSpatialTransformationMatrix::transform
+static SIMD_FORCE_INLINE Motion transform(const Mat3& rot, const Vec3& trn, const Motion& in)
+{
+	Vec3 top = rot * in.m_topVec;
+	return Motion::make(top, -trn.cross(top) + rot * in.m_bottomVec);
+}
+
+///see btSpatialTransformationMatrix::transformInverse
+static SIMD_FORCE_INLINE Force transformInverse(const Mat3& rot, const Vec3& trn, const Force& in)
+{
+	return Force::make(rot.transposeTimes(in.m_topVec), rot.transposeTimes(in.m_bottomVec + trn.cross(in.m_topVec)));
+}
+
+struct btEnsembleDyad
+{
+	Mat3 m_topLeftMat, m_topRightMat, m_bottomLeftMat;
+
+	static SIMD_FORCE_INLINE btEnsembleDyad load(const btScalar* p)
+	{
+		btEnsembleDyad r;
+		r.m_topLeftMat = Mat3::load(p);
+		r.m_topRightMat = Mat3::load(p + 9*LANES);
+		r.m_bottomLeftMat = Mat3::load(p + 18*LANES);
+		return r;
+	}
+	SIMD_FORCE_INLINE void store(btScalar* p) const
+	{
+		m_topLeftMat.store(p);
+		m_topRightMat.store(p + 9*LANES);
+		m_bottomLeftMat.store(p + 18*LANES);
+	}
+	///the spatial inertia of a body in its center of mass frame
+	static SIMD_FORCE_INLINE btEnsembleDyad rigidBody(btScalar mass, const btVector3& inertia)
+	{
+		btEnsembleDyad r;
+		r.m_topLeftMat = Mat3::splat(btMatrix3x3(0, 0, 0, 0, 0, 0, 0, 0, 0));
+		r.m_topRightMat = Mat3::diagonal(btVector3(mass, mass, mass));
+		r.m_bottomLeftMat = Mat3::diagonal(inertia);
+		return r;
+	}
+	SIMD_FORCE_INLINE Force operator*(const Motion& vec) const
+	{
+		return Force::make(m_topLeftMat * vec.m_topVec + m_topRightMat * vec.m_bottomVec, m_bottomLeftMat * vec.m_topVec + m_topLeftMat.transposeTimes(vec.m_bottomVec));
+	}
+};
+
+typedef btEnsembleDyad Dyad;
+
+///see btSpatialTransformationMatrix::transformInverse, accumulates into out
+static SIMD_FORCE_INLINE void transformInverseAdd(const Mat3& rot, const Vec3& trn, const Dyad& in, Dyad& out)
+{
+	Real zero = Real::splat(btScalar(0));
+	Mat3 rCross;
+	rCross.m[0][0] = zero; rCross.m[0][1] = -trn.z; rCross.m[0][2] = trn.y;
+	rCross.m[1][0] = trn.z; rCross.m[1][1] = zero; rCross.m[1][2] = -trn.x;
+	rCross.m[2][0] = -trn.y; rCross.m[2][1] = trn.x; rCross.m[2][2] = zero;
+	Mat3 rotT = rot.transpose();
+	Mat3 topLeft = in.m_topLeftMat - in.m_topRightMat * rCross;
+	out.m_topLeftMat = out.m_topLeftMat + rotT * topLeft * rot;
+	out.m_topRightMat = out.m_topRightMat + rotT * in.m_topRightMat * rot;
+	out.m_bottomLeftMat = out.m_bottomLeftMat + rotT * (rCross * topLeft + in.m_bottomLeftMat - in.m_topLeftMat.transpose() * rCross) * rot;
+}
+
+///result = invI * rhs, with the blocks computed by btMultiBody::solveImatrix
+static SIMD_FORCE_INLINE Motion solveImatrix(const Mat3& invIupperLeft, const Mat3& invIupperRight, const Mat3& invIlowerLeft, const Force& rhs)
+{
+	Vec3 vtop = invIupperLeft * rhs.m_topVec + invIupperRight * rhs.m_bottomVec;
+	Vec3 vbot = invIlowerLeft * rhs.m_topVec + invIupperLeft.transposeTimes(rhs.m_bottomVec);
+	return Motion::make(vtop, vbot);
+}
+
+///the exponential map of btMultiBody::stepPositionsMultiDof for the base, omega is in world coordinates
+static void integrateBaseQuat(const btVector3& omega, btQuaternion& quat, btScalar dt)
+{
+	btVector3 axis;
+	btScalar fAngle = omega.length();
+	//limit the angular motion
+	if (fAngle * dt > ANGULAR_MOTION_THRESHOLD)
+	{
+		fAngle = btScalar(0.5)*SIMD_HALF_PI / dt;
+	}
+	if ( fAngle < btScalar(0.001) )
+	{
+		// use Taylor's expansions of sync function
+		axis = omega*( btScalar(0.5)*dt-(dt*dt*dt)*(btScalar(0.020833333333))*fAngle*fAngle );
+	}
+	else
+	{
+		// sync(fAngle) = sin(c*fAngle)/t
+		axis = omega*( btSin(btScalar(0.5)*fAngle*dt)/fAngle );
+	}
+	quat = quat * btQuaternion(-axis.x(),-axis.y(),-axis.z(),btCos( fAngle*dt*btScalar(0.5) ));
+	quat.normalize();
+}
+
+
+struct btMultiBodyEnsemble::StepVelocitiesLoop : public btIParallelForBody
+{
+	btMultiBodyEnsemble* m_ensemble;
+	btScalar m_dt;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "btMultiBodyEnsemble stepVelocities loop" );
+		btAlignedObjectArray<btScalar>& scratch = m_ensemble->m_scratch[btGetCurrentThreadIndex()];
+		int numLinks = m_ensemble->getNumLinks();
+		scratch.resizeNoInitialize(LANES * ((numLinks + 1) * (6 + 6 + 27 + 6 + 9) + numLinks * 6 + m_ensemble->getNumDofs() + 1));
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			m_ensemble->stepVelocitiesBlock( i, m_dt, &scratch[0] );
+		}
+	}
+};
+
+struct btMultiBodyEnsemble::AccelerationDeltasLoop : public btIParallelForBody
+{
+	const btMultiBodyEnsemble* m_ensemble;
+	const btScalar* m_force;
+	btScalar* m_output;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "btMultiBodyEnsemble calcAccelerationDeltas loop" );
+		btAlignedObjectArray<btScalar>& scratch = m_ensemble->m_scratch[btGetCurrentThreadIndex()];
+		scratch.resizeNoInitialize(LANES * ((m_ensemble->getNumLinks() + 1) * (6 + 6) + m_ensemble->getNumDofs() + 1));
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			m_ensemble->calcAccelerationDeltasBlock( i, m_force, m_output, &scratch[0] );
+		}
+	}
+};
+
+struct btMultiBodyEnsemble::StepPositionsLoop : public btIParallelForBody
+{
+	btMultiBodyEnsemble* m_ensemble;
+	btScalar m_dt;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "btMultiBodyEnsemble stepPositions loop" );
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			m_ensemble->stepPositionsBlock( i, m_dt );
+		}
+	}
+};
+
+struct btMultiBodyEnsemble::ForwardKinematicsLoop : public btIParallelForBody
+{
+	btMultiBodyEnsemble* m_ensemble;
+	bool m_updateLinkCache;
+	bool m_forwardKinematics;
+
+	void forLoop( int iBegin, int iEnd ) const
+	{
+		BT_PROFILE_THREAD( "btMultiBodyEnsemble forwardKinematics loop" );
+		for ( int i = iBegin; i < iEnd; ++i )
+		{
+			if (m_updateLinkCache)
+				m_ensemble->updateLinkCacheBlock( i );
+			if (m_forwardKinematics)
+				m_ensemble->forwardKinematicsBlock( i );
+		}
+	}
+};
+
+
+btMultiBodyEnsemble::btMultiBodyEnsemble(const btMultiBody* templateBody, int numInstances)
+	:m_numInstances(0),
+	m_numBlocks(0),
+	m_numDofs(0),
+	m_baseMass(0),
+	m_baseInertia(0,0,0),
+	m_fixedBase(false),
+	m_useGyroTerm(false),
+	m_linearDamping(0),
+	m_angularDamping(0),
+	m_maxCoordinateVelocity(0),
+	m_grainSize(1),
+	m_cacheDirty(true),
+	m_blockSize(0)
+{
+	m_fields = LinkFields();
+	//an unsupported template gives an empty ensemble instead of stepping it with the wrong math
+	if (!isSupported(templateBody) || numInstances <= 0)
+	{
+		return;
+	}
+
+	m_numInstances = numInstances;
+	m_numBlocks = (numInstances + LANES - 1) / LANES;
+	m_numDofs = templateBody->getNumDofs();
+	m_baseMass = templateBody->getBaseMass();
+	m_baseInertia = templateBody->getBaseInertia();
+	m_fixedBase = templateBody->hasFixedBase();
+	m_useGyroTerm = templateBody->getUseGyroTerm();
+	m_linearDamping = templateBody->getLinearDamping();
+	m_angularDamping = templateBody->getAngularDamping();
+	m_maxCoordinateVelocity = templateBody->getMaxCoordinateVelocity();
+
+	int numLinks = templateBody->getNumLinks();
+	m_links.resize(numLinks);
+	for (int i=0;i<numLinks;i++)
+	{
+		const btMultibodyLink& src = templateBody->getLink(i);
+		LinkTemplate& link = m_links[i];
+		link.m_parent = src.m_parent;
+		link.m_jointType = src.m_jointType;
+		link.m_dofOffset = src.m_dofCount ? src.m_dofOffset : -1;
+		link.m_mass = src.m_mass;
+		link.m_inertiaLocal = src.m_inertiaLocal;
+		link.m_axisTop = src.getAxisTop(0);
+		link.m_axisBottom = src.getAxisBottom(0);
+		link.m_zeroRotParentToThis = src.m_zeroRotParentToThis;
+		link.m_dVector = src.m_dVector;
+		link.m_eVector = src.m_eVector;
+		link.m_zeroRotMatrix = btMatrix3x3(src.m_zeroRotParentToThis);
+		link.m_zeroRVector = src.m_dVector + quatRotate(src.m_zeroRotParentToThis, src.m_eVector);
+	}
+
+	int field = FIELD_ACCEL + 6 + m_numDofs;
+	m_fields.m_force = field; field += 3 * numLinks;
+	m_fields.m_torque = field; field += 3 * numLinks;
+	m_fields.m_rotParentToThis = field; field += 9 * numLinks;
+	m_fields.m_rVector = field; field += 3 * numLinks;
+	m_fields.m_worldToLocal = field; field += 9 * numLinks;
+	m_fields.m_worldOrigin = field; field += 3 * numLinks;
+	m_fields.m_jointPos = field; field += m_numDofs;
+	m_fields.m_jointVel = field; field += m_numDofs;
+	m_fields.m_jointTorque = field; field += m_numDofs;
+	m_fields.m_h = field; field += 6 * m_numDofs;
+	m_fields.m_invD = field; field += m_numDofs;
+	m_blockSize = field * LANES;
+
+	m_blocks.resize(m_numBlocks * m_blockSize, btScalar(0));
+
+	//every instance starts in the state of the template, the padding lanes too so they stay finite
+	for (int i=0;i<m_numBlocks*LANES;i++)
+	{
+		setInstanceFromMultiBody(i, templateBody);
+	}
+}
+
+btMultiBodyEnsemble::~btMultiBodyEnsemble()
+{
+}
+
+bool	btMultiBodyEnsemble::isSupported(const btMultiBody* body)
+{
+	if (!body->isMultiDof() || body->isUsingRK4Integration() || body->isUsingGlobalVelocities())
+	{
+		return false;
+	}
+	for (int i=0;i<body->getNumLinks();i++)
+	{
+		const btMultibodyLink& link = body->getLink(i);
+		if (link.m_jointFeedback)
+		{
+			return false;
+		}
+		if (link.m_jointType != btMultibodyLink::eRevolute &&
+			link.m_jointType != btMultibodyLink::ePrismatic &&
+			link.m_jointType != btMultibodyLink::eFixed)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int	btMultiBodyEnsemble::getLaneCount()
+{
+	return LANES;
+}
+
+btVector3	btMultiBodyEnsemble::getVectorField(int instance, int field) const
+{
+	const btScalar* p = getField(instance, field);
+	return btVector3(p[0], p[LANES], p[2*LANES]);
+}
+
+void	btMultiBodyEnsemble::setVectorField(int instance, int field, const btVector3& v)
+{
+	btScalar* p = getField(instance, field);
+	p[0] = v.x();
+	p[LANES] = v.y();
+	p[2*LANES] = v.z();
+}
+
+void	btMultiBodyEnsemble::addVectorField(int instance, int field, const btVector3& v)
+{
+	btScalar* p = getField(instance, field);
+	p[0] += v.x();
+	p[LANES] += v.y();
+	p[2*LANES] += v.z();
+}
+
+void	btMultiBodyEnsemble::setInstanceFromMultiBody(int instance, const btMultiBody* body)
+{
+	btAssert(body->getNumLinks() == getNumLinks() && body->getNumDofs() == getNumDofs());
+	setBasePos(instance, body->getBasePos());
+	setWorldToBaseRot(instance, body->getWorldToBaseRot());
+	setBaseVel(instance, body->getBaseVel());
+	setBaseOmega(instance, body->getBaseOmega());
+	setVectorField(instance, FIELD_BASE_FORCE, body->getBaseForce());
+	setVectorField(instance, FIELD_BASE_TORQUE, body->getBaseTorque());
+	for (int i=0;i<getNumLinks();i++)
+	{
+		setVectorField(instance, m_fields.m_force + 3*i, body->getLinkForce(i));
+		setVectorField(instance, m_fields.m_torque + 3*i, body->getLinkTorque(i));
+		int dof = m_links[i].m_dofOffset;
+		if (dof >= 0)
+		{
+			*getField(instance, m_fields.m_jointPos + dof) = body->getJointPosMultiDof(i)[0];
+			*getField(instance, m_fields.m_jointVel + dof) = body->getJointVelMultiDof(i)[0];
+			*getField(instance, m_fields.m_jointTorque + dof) = body->getLink(i).m_jointTorque[0];
+		}
+	}
+	m_cacheDirty = true;
+}
+
+void	btMultiBodyEnsemble::copyInstanceToMultiBody(int instance, btMultiBody* body) const
+{
+	btAssert(body->getNumLinks() == getNumLinks() && body->getNumDofs() == getNumDofs());
+	body->setBasePos(getBasePos(instance));
+	body->setWorldToBaseRot(getWorldToBaseRot(instance));
+	body->setBaseVel(getBaseVel(instance));
+	body->setBaseOmega(getBaseOmega(instance));
+	for (int i=0;i<getNumLinks();i++)
+	{
+		int dof = m_links[i].m_dofOffset;
+		if (dof >= 0)
+		{
+			btScalar q = *getField(instance, m_fields.m_jointPos + dof);
+			btScalar qdot = *getField(instance, m_fields.m_jointVel + dof);
+			body->setJointPosMultiDof(i, &q);
+			body->setJointVelMultiDof(i, &qdot);
+		}
+	}
+}
+
+btVector3	btMultiBodyEnsemble::getBasePos(int instance) const
+{
+	return getVectorField(instance, FIELD_BASE_POS);
+}
+
+void	btMultiBodyEnsemble::setBasePos(int instance, const btVector3& pos)
+{
+	setVectorField(instance, FIELD_BASE_POS, pos);
+}
+
+btQuaternion	btMultiBodyEnsemble::getWorldToBaseRot(int instance) const
+{
+	const btScalar* p = getField(instance, FIELD_BASE_QUAT);
+	return btQuaternion(p[0], p[LANES], p[2*LANES], p[3*LANES]);
+}
+
+void	btMultiBodyEnsemble::setWorldToBaseRot(int instance, const btQuaternion& rot)
+{
+	btScalar* p = getField(instance, FIELD_BASE_QUAT);
+	p[0] = rot.x();
+	p[LANES] = rot.y();
+	p[2*LANES] = rot.z();
+	p[3*LANES] = rot.w();
+}
+
+btVector3	btMultiBodyEnsemble::getBaseVel(int instance) const
+{
+	return getVectorField(instance, FIELD_BASE_VEL);
+}
+
+void	btMultiBodyEnsemble::setBaseVel(int instance, const btVector3& vel)
+{
+	setVectorField(instance, FIELD_BASE_VEL, vel);
+}
+
+btVector3	btMultiBodyEnsemble::getBaseOmega(int instance) const
+{
+	return getVectorField(instance, FIELD_BASE_OMEGA);
+}
+
+void	btMultiBodyEnsemble::setBaseOmega(int instance, const btVector3& omega)
+{
+	setVectorField(instance, FIELD_BASE_OMEGA, omega);
+}
+
+btScalar	btMultiBodyEnsemble::getJointPos(int instance, int link) const
+{
+	btAssert(m_links[link].m_dofOffset >= 0);
+	return *getField(instance, m_fields.m_jointPos + m_links[link].m_dofOffset);
+}
+
+void	btMultiBodyEnsemble::setJointPos(int instance, int link, btScalar q)
+{
+	btAssert(m_links[link].m_dofOffset >= 0);
+	*getField(instance, m_fields.m_jointPos + m_links[link].m_dofOffset) = q;
+	m_cacheDirty = true;
+}
+
+btScalar	btMultiBodyEnsemble::getJointVel(int instance, int link) const
+{
+	btAssert(m_links[link].m_dofOffset >= 0);
+	return *getField(instance, m_fields.m_jointVel + m_links[link].m_dofOffset);
+}
+
+void	btMultiBodyEnsemble::setJointVel(int instance, int link, btScalar qdot)
+{
+	btAssert(m_links[link].m_dofOffset >= 0);
+	*getField(instance, m_fields.m_jointVel + m_links[link].m_dofOffset) = qdot;
+}
+
+void	btMultiBodyEnsemble::addBaseForce(int instance, const btVector3& f)
+{
+	addVectorField(instance, FIELD_BASE_FORCE, f);
+}
+
+void	btMultiBodyEnsemble::addBaseTorque(int instance, const btVector3& t)
+{
+	addVectorField(instance, FIELD_BASE_TORQUE, t);
+}
+
+void	btMultiBodyEnsemble::addLinkForce(int instance, int link, const btVector3& f)
+{
+	addVectorField(instance, m_fields.m_force + 3*link, f);
+}
+
+void	btMultiBodyEnsemble::addLinkTorque(int instance, int link, const btVector3& t)
+{
+	addVectorField(instance, m_fields.m_torque + 3*link, t);
+}
+
+void	btMultiBodyEnsemble::addJointTorque(int instance, int link, btScalar Q)
+{
+	btAssert(m_links[link].m_dofOffset >= 0);
+	*getField(instance, m_fields.m_jointTorque + m_links[link].m_dofOffset) += Q;
+}
+
+void	btMultiBodyEnsemble::addGravity(const btVector3& gravity)
+{
+	for (int block=0;block<m_numBlocks;block++)
+	{
+		btScalar* b = &m_blocks[block * m_blockSize];
+		Vec3 baseForce = Vec3::load(b + FIELD_BASE_FORCE*LANES) + Vec3::splat(gravity * m_baseMass);
+		baseForce.store(b + FIELD_BASE_FORCE*LANES);
+		for (int i=0;i<getNumLinks();i++)
+		{
+			btScalar* p = b + (m_fields.m_force + 3*i)*LANES;
+			Vec3 force = Vec3::load(p) + Vec3::splat(gravity * m_links[i].m_mass);
+			force.store(p);
+		}
+	}
+}
+
+void	btMultiBodyEnsemble::clearForcesAndTorques()
+{
+	for (int block=0;block<m_numBlocks;block++)
+	{
+		btScalar* b = &m_blocks[block * m_blockSize];
+		for (int j=0;j<6*LANES;j++)
+		{
+			b[FIELD_BASE_FORCE*LANES + j] = btScalar(0);
+		}
+		for (int j=0;j<6*getNumLinks()*LANES;j++)
+		{
+			b[m_fields.m_force*LANES + j] = btScalar(0);
+		}
+		for (int j=0;j<m_numDofs*LANES;j++)
+		{
+			b[m_fields.m_jointTorque*LANES + j] = btScalar(0);
+		}
+	}
+}
+
+btTransform	btMultiBodyEnsemble::getLinkWorldTransform(int instance, int link) const
+{
+	const btScalar* p = getField(instance, m_fields.m_worldToLocal + 9*link);
+	//the field holds rot_from_world, the transposed basis
+	btMatrix3x3 basis(p[0], p[3*LANES], p[6*LANES],
+					p[LANES], p[4*LANES], p[7*LANES],
+					p[2*LANES], p[5*LANES], p[8*LANES]);
+	return btTransform(basis, getVectorField(instance, m_fields.m_worldOrigin + 3*link));
+}
+
+btScalar	btMultiBodyEnsemble::getAcceleration(int instance, int dof) const
+{
+	return *getField(instance, FIELD_ACCEL + dof);
+}
+
+void	btMultiBodyEnsemble::runBlocks(const btIParallelForBody& body) const
+{
+	if (m_numBlocks)
+	{
+		btParallelFor(0, m_numBlocks, m_grainSize, body);
+	}
+}
+
+void	btMultiBodyEnsemble::updateLinkCache()
+{
+	if (m_cacheDirty)
+	{
+		ForwardKinematicsLoop loop;
+		loop.m_ensemble = this;
+		loop.m_updateLinkCache = true;
+		loop.m_forwardKinematics = false;
+		runBlocks(loop);
+		m_cacheDirty = false;
+	}
+}
+
+void	btMultiBodyEnsemble::stepVelocities(btScalar dt)
+{
+	BT_PROFILE("btMultiBodyEnsemble stepVelocities");
+	updateLinkCache();
+	StepVelocitiesLoop loop;
+	loop.m_ensemble = this;
+	loop.m_dt = dt;
+	runBlocks(loop);
+}
+
+void	btMultiBodyEnsemble::calcAccelerationDeltas(const btScalar* force, btScalar* output) const
+{
+	BT_PROFILE("btMultiBodyEnsemble calcAccelerationDeltas");
+	AccelerationDeltasLoop loop;
+	loop.m_ensemble = this;
+	loop.m_force = force;
+	loop.m_output = output;
+	runBlocks(loop);
+}
+
+void	btMultiBodyEnsemble::stepPositions(btScalar dt)
+{
+	BT_PROFILE("btMultiBodyEnsemble stepPositions");
+	StepPositionsLoop loop;
+	loop.m_ensemble = this;
+	loop.m_dt = dt;
+	runBlocks(loop);
+	m_cacheDirty = false;
+}
+
+void	btMultiBodyEnsemble::forwardKinematics()
+{
+	BT_PROFILE("btMultiBodyEnsemble forwardKinematics");
+	ForwardKinematicsLoop loop;
+	loop.m_ensemble = this;
+	loop.m_updateLinkCache = m_cacheDirty;
+	loop.m_forwardKinematics = true;
+	runBlocks(loop);
+	m_cacheDirty = false;
+}
+
+
+void	btMultiBodyEnsemble::stepVelocitiesBlock(int block, btScalar dt, btScalar* scratch)
+{
+	// this is btMultiBody::stepVelocitiesMultiDof for 1 dof (revolute, prismatic) and fixed joints, see there for the comments
+	const int num_links = getNumLinks();
+	btScalar* b = &m_blocks[block * m_blockSize];
+
+	btScalar* spatVelPtr = scratch; scratch += (num_links + 1) * 6 * LANES;
+	btScalar* zeroAccSpatFrcPtr = scratch; scratch += (num_links + 1) * 6 * LANES;
+	btScalar* spatInertiaPtr = scratch; scratch += (num_links + 1) * 27 * LANES;
+	btScalar* spatAccPtr = scratch; scratch += (num_links + 1) * 6 * LANES;
+	btScalar* rotFromWorldPtr = scratch; scratch += (num_links + 1) * 9 * LANES;
+	btScalar* spatCoriolisAccPtr = scratch; scratch += num_links * 6 * LANES;
+	btScalar* YPtr = scratch;
+
+	const Real DAMPING_K1_LINEAR = Real::splat(m_linearDamping);
+	const Real DAMPING_K2_LINEAR = Real::splat(m_linearDamping);
+	const Real DAMPING_K1_ANGULAR = Real::splat(m_angularDamping);
+	const Real DAMPING_K2_ANGULAR = Real::splat(m_angularDamping);
+
+	// First 'upward' loop.
+	const Mat3 rot0 = Mat3::fromQuat(Real::load(b + FIELD_BASE_QUAT*LANES), Real::load(b + (FIELD_BASE_QUAT + 1)*LANES),
+									Real::load(b + (FIELD_BASE_QUAT + 2)*LANES), Real::load(b + (FIELD_BASE_QUAT + 3)*LANES));
+	rot0.store(b + FIELD_BASE_ROT*LANES);
+
+	const Motion spatVel0 = Motion::make(rot0 * Vec3::load(b + FIELD_BASE_OMEGA*LANES), rot0 * Vec3::load(b + FIELD_BASE_VEL*LANES));
+	spatVel0.store(spatVelPtr);
+
+	Force zeroAccSpatFrc0;
+	if (m_fixedBase)
+	{
+		zeroAccSpatFrc0 = Force::make(Vec3::zero(), Vec3::zero());
+	}
+	else
+	{
+		const Vec3 omega = spatVel0.m_topVec;
+		const Vec3 vel = spatVel0.m_bottomVec;
+		const Vec3 inertia = Vec3::splat(m_baseInertia);
+		const Real mass = Real::splat(m_baseMass);
+		//external forces
+		zeroAccSpatFrc0 = Force::make(-(rot0 * Vec3::load(b + FIELD_BASE_FORCE*LANES)), -(rot0 * Vec3::load(b + FIELD_BASE_TORQUE*LANES)));
+		//adding damping terms (only)
+		zeroAccSpatFrc0.m_bottomVec += inertia * omega * (DAMPING_K1_ANGULAR + DAMPING_K2_ANGULAR * omega.norm());
+		zeroAccSpatFrc0.m_topVec += vel * mass * (DAMPING_K1_LINEAR + DAMPING_K2_LINEAR * vel.norm());
+		if (m_useGyroTerm)
+			zeroAccSpatFrc0.m_bottomVec += omega.cross(inertia * omega);
+		zeroAccSpatFrc0.m_topVec += omega.cross(vel) * mass;
+	}
+	zeroAccSpatFrc0.store(zeroAccSpatFrcPtr);
+	Dyad::rigidBody(m_baseMass, m_baseInertia).store(spatInertiaPtr);
+	rot0.store(rotFromWorldPtr);
+
+	for (int i = 0; i < num_links; ++i)
+	{
+		const LinkTemplate& link = m_links[i];
+		const int parent = link.m_parent;
+		const Mat3 rotFromParent = Mat3::load(b + (m_fields.m_rotParentToThis + 9*i)*LANES);
+		const Vec3 rVector = Vec3::load(b + (m_fields.m_rVector + 3*i)*LANES);
+		const Mat3 rotFromWorld = rotFromParent * Mat3::load(rotFromWorldPtr + (parent + 1)*9*LANES);
+		rotFromWorld.store(rotFromWorldPtr + (i + 1)*9*LANES);
+
+		Motion spatVel = transform(rotFromParent, rVector, Motion::load(spatVelPtr + (parent + 1)*6*LANES));
+		Motion spatJointVel = Motion::make(Vec3::zero(), Vec3::zero());
+		if (link.m_dofOffset >= 0)
+		{
+			spatJointVel = Motion::splat(link.m_axisTop, link.m_axisBottom) * Real::load(b + (m_fields.m_jointVel + link.m_dofOffset)*LANES);
+			spatVel = spatVel + spatJointVel;
+		}
+		spatVel.store(spatVelPtr + (i + 1)*6*LANES);
+		cross(spatVel, spatJointVel).store(spatCoriolisAccPtr + i*6*LANES);
+
+		const Vec3 omega = spatVel.m_topVec;
+		const Vec3 vel = spatVel.m_bottomVec;
+		const Vec3 inertia = Vec3::splat(link.m_inertiaLocal);
+		const Real mass = Real::splat(link.m_mass);
+		Force zeroAccSpatFrc = Force::make(-(rotFromWorld * Vec3::load(b + (m_fields.m_force + 3*i)*LANES)), -(rotFromWorld * Vec3::load(b + (m_fields.m_torque + 3*i)*LANES)));
+		zeroAccSpatFrc.m_bottomVec += inertia * omega * (DAMPING_K1_ANGULAR + DAMPING_K2_ANGULAR * omega.norm());
+		zeroAccSpatFrc.m_topVec += vel * mass * (DAMPING_K1_LINEAR + DAMPING_K2_LINEAR * vel.norm());
+		if (m_useGyroTerm)
+			zeroAccSpatFrc.m_bottomVec += omega.cross(inertia * omega);
+		zeroAccSpatFrc.m_topVec += omega.cross(vel) * mass;
+		zeroAccSpatFrc.store(zeroAccSpatFrcPtr + (i + 1)*6*LANES);
+
+		Dyad::rigidBody(link.m_mass, link.m_inertiaLocal).store(spatInertiaPtr + (i + 1)*27*LANES);
+	}
+
+	// 'Downward' loop.
+	for (int i = num_links - 1; i >= 0; --i)
+	{
+		const LinkTemplate& link = m_links[i];
+		const int parent = link.m_parent;
+		const Mat3 rotFromParent = Mat3::load(b + (m_fields.m_rotParentToThis + 9*i)*LANES);
+		const Vec3 rVector = Vec3::load(b + (m_fields.m_rVector + 3*i)*LANES);
+		const Dyad spatInertia = Dyad::load(spatInertiaPtr + (i + 1)*27*LANES);
+		const Force zeroAccSpatFrc = Force::load(zeroAccSpatFrcPtr + (i + 1)*6*LANES);
+		const Motion spatCoriolisAcc = Motion::load(spatCoriolisAccPtr + i*6*LANES);
+
+		Dyad dyadTemp = spatInertia;
+		Force spatForceVecTemp = zeroAccSpatFrc + spatInertia * spatCoriolisAcc;
+		const int dof = link.m_dofOffset;
+		if (dof >= 0)
+		{
+			const Motion axis = Motion::splat(link.m_axisTop, link.m_axisBottom);
+			const Force hDof = spatInertia * axis;
+			hDof.store(b + (m_fields.m_h + 6*dof)*LANES);
+			const Real Y = Real::load(b + (m_fields.m_jointTorque + dof)*LANES) - dot(axis, zeroAccSpatFrc) - dot(spatCoriolisAcc, hDof);
+			Y.store(YPtr + dof*LANES);
+			const Real invD = Real::splat(btScalar(1.0)) / dot(axis, hDof);
+			invD.store(b + (m_fields.m_invD + dof)*LANES);
+
+			//determine (h*D^{-1}) * h^{T}
+			const Force hInvD = hDof * invD;
+			dyadTemp.m_topLeftMat = dyadTemp.m_topLeftMat - outerProduct(hDof.m_topVec, hInvD.m_bottomVec);
+			dyadTemp.m_topRightMat = dyadTemp.m_topRightMat - outerProduct(hDof.m_topVec, hInvD.m_topVec);
+			dyadTemp.m_bottomLeftMat = dyadTemp.m_bottomLeftMat - outerProduct(hDof.m_bottomVec, hInvD.m_bottomVec);
+
+			spatForceVecTemp = spatForceVecTemp + hDof * (invD * Y);
+		}
+
+		Dyad parentInertia = Dyad::load(spatInertiaPtr + (parent + 1)*27*LANES);
+		transformInverseAdd(rotFromParent, rVector, dyadTemp, parentInertia);
+		parentInertia.store(spatInertiaPtr + (parent + 1)*27*LANES);
+
+		Force parentZeroAccSpatFrc = Force::load(zeroAccSpatFrcPtr + (parent + 1)*6*LANES) + transformInverse(rotFromParent, rVector, spatForceVecTemp);
+		parentZeroAccSpatFrc.store(zeroAccSpatFrcPtr + (parent + 1)*6*LANES);
+	}
+
+	// Second 'upward' loop
+	Mat3 invIupperLeft, invIupperRight, invIlowerLeft;
+	if (num_links > 0)
+	{
+		// see btMultiBody::solveImatrix
+		const Dyad spatInertia0 = Dyad::load(spatInertiaPtr);
+		const Mat3& topLeft = spatInertia0.m_topLeftMat;
+		const Mat3& topRight = spatInertia0.m_topRightMat;
+		const Mat3& lowerLeft = spatInertia0.m_bottomLeftMat;
+		const Mat3 lowerRight = topLeft.transpose();
+		const Mat3 Binv = topRight.inverse() * Mat3::splat(btMatrix3x3(-1, 0, 0, 0, -1, 0, 0, 0, -1));
+		Mat3 tmp = lowerRight * Binv;
+		invIupperRight = (tmp * topLeft + lowerLeft).inverse();
+		tmp = invIupperRight * lowerRight;
+		invIupperLeft = tmp * Binv;
+		tmp = topLeft * invIupperLeft - Mat3::splat(btMatrix3x3::getIdentity());
+		invIlowerLeft = Binv * tmp;
+	}
+	else
+	{
+		invIupperLeft = Mat3::splat(btMatrix3x3(0, 0, 0, 0, 0, 0, 0, 0, 0));
+		invIupperRight = Mat3::diagonal(btVector3(1 / m_baseInertia[0], 1 / m_baseInertia[1], 1 / m_baseInertia[2]));
+		invIlowerLeft = Mat3::diagonal(btVector3(1 / m_baseMass, 1 / m_baseMass, 1 / m_baseMass));
+	}
+	invIupperLeft.store(b + FIELD_INV_BASE_INERTIA*LANES);
+	invIupperRight.store(b + (FIELD_INV_BASE_INERTIA + 9)*LANES);
+	invIlowerLeft.store(b + (FIELD_INV_BASE_INERTIA + 18)*LANES);
+
+	Motion spatAcc0 = Motion::make(Vec3::zero(), Vec3::zero());
+	if (!m_fixedBase)
+	{
+		const Motion result = solveImatrix(invIupperLeft, invIupperRight, invIlowerLeft, Force::load(zeroAccSpatFrcPtr));
+		spatAcc0 = Motion::make(-result.m_topVec, -result.m_bottomVec);
+	}
+	spatAcc0.store(spatAccPtr);
+
+	btScalar* joint_accel = b + (FIELD_ACCEL + 6)*LANES;
+	for (int i = 0; i < num_links; ++i)
+	{
+		const LinkTemplate& link = m_links[i];
+		const int parent = link.m_parent;
+		const Mat3 rotFromParent = Mat3::load(b + (m_fields.m_rotParentToThis + 9*i)*LANES);
+		const Vec3 rVector = Vec3::load(b + (m_fields.m_rVector + 3*i)*LANES);
+
+		Motion spatAcc = transform(rotFromParent, rVector, Motion::load(spatAccPtr + (parent + 1)*6*LANES));
+		const int dof = link.m_dofOffset;
+		if (dof >= 0)
+		{
+			const Force hDof = Force::load(b + (m_fields.m_h + 6*dof)*LANES);
+			const Real qdd = Real::load(b + (m_fields.m_invD + dof)*LANES) * (Real::load(YPtr + dof*LANES) - dot(spatAcc, hDof));
+			qdd.store(joint_accel + dof*LANES);
+			spatAcc = spatAcc + Motion::load(spatCoriolisAccPtr + i*6*LANES);
+			spatAcc = spatAcc + Motion::splat(link.m_axisTop, link.m_axisBottom) * qdd;
+		}
+		else
+		{
+			spatAcc = spatAcc + Motion::load(spatCoriolisAccPtr + i*6*LANES);
+		}
+		spatAcc.store(spatAccPtr + (i + 1)*6*LANES);
+	}
+
+	// transform base accelerations back to the world frame.
+	const Vec3 omegadot_out = rot0.transposeTimes(spatAcc0.m_topVec);
+	const Vec3 vdot_out = rot0.transposeTimes(spatAcc0.m_bottomVec + spatVel0.m_topVec.cross(spatVel0.m_bottomVec));
+	omegadot_out.store(b + FIELD_ACCEL*LANES);
+	vdot_out.store(b + (FIELD_ACCEL + 3)*LANES);
+
+	// Final step: add the accelerations (times dt) to the velocities.
+	if (dt > 0.)
+	{
+		const Real dtReal = Real::splat(dt);
+		const Real maxVel = Real::splat(m_maxCoordinateVelocity);
+		const Real minVel = Real::splat(-m_maxCoordinateVelocity);
+		for (int j = 0; j < 6 + m_numDofs; ++j)
+		{
+			// the velocities are stored as omega, vel, joint velocities like m_realBuf, but not contiguous
+			btScalar* vel = j < 3 ? b + (FIELD_BASE_OMEGA + j)*LANES : j < 6 ? b + (FIELD_BASE_VEL + j - 3)*LANES : b + (m_fields.m_jointVel + j - 6)*LANES;
+			Real v = Real::load(vel) + Real::load(b + (FIELD_ACCEL + j)*LANES) * dtReal;
+			Real::clamp(v, minVel, maxVel).store(vel);
+		}
+	}
+}
+
+void	btMultiBodyEnsemble::calcAccelerationDeltasBlock(int block, const btScalar* force, btScalar* output, btScalar* scratch) const
+{
+	// this is btMultiBody::calcAccelerationDeltasMultiDof, see there for the comments
+	const int num_links = getNumLinks();
+	const btScalar* b = &m_blocks[block * m_blockSize];
+	force += block * (6 + m_numDofs) * LANES;
+	output += block * (6 + m_numDofs) * LANES;
+
+	btScalar* zeroAccSpatFrcPtr = scratch; scratch += (num_links + 1) * 6 * LANES;
+	btScalar* spatAccPtr = scratch; scratch += (num_links + 1) * 6 * LANES;
+	btScalar* YPtr = scratch;
+
+	const Mat3 rot0 = Mat3::load(b + FIELD_BASE_ROT*LANES);
+	Force zeroAccSpatFrc0 = Force::make(Vec3::zero(), Vec3::zero());
+	if (!m_fixedBase)
+	{
+		zeroAccSpatFrc0 = Force::make(-(rot0 * Vec3::load(force + 3*LANES)), -(rot0 * Vec3::load(force)));
+	}
+	zeroAccSpatFrc0.store(zeroAccSpatFrcPtr);
+	for (int i = 0; i < num_links; ++i)
+	{
+		Force::make(Vec3::zero(), Vec3::zero()).store(zeroAccSpatFrcPtr + (i + 1)*6*LANES);
+	}
+
+	// 'Downward' loop.
+	for (int i = num_links - 1; i >= 0; --i)
+	{
+		const LinkTemplate& link = m_links[i];
+		const int parent = link.m_parent;
+		const Mat3 rotFromParent = Mat3::load(b + (m_fields.m_rotParentToThis + 9*i)*LANES);
+		const Vec3 rVector = Vec3::load(b + (m_fields.m_rVector + 3*i)*LANES);
+		Force spatForceVecTemp = Force::load(zeroAccSpatFrcPtr + (i + 1)*6*LANES);
+		const int dof = link.m_dofOffset;
+		if (dof >= 0)
+		{
+			const Motion axis = Motion::splat(link.m_axisTop, link.m_axisBottom);
+			const Real Y = Real::load(force + (6 + dof)*LANES) - dot(axis, spatForceVecTemp);
+			Y.store(YPtr + dof*LANES);
+			// Zp += pXi * (Zi + hi*Yi/Di)
+			spatForceVecTemp = spatForceVecTemp + Force::load(b + (m_fields.m_h + 6*dof)*LANES) * (Real::load(b + (m_fields.m_invD + dof)*LANES) * Y);
+		}
+		Force parentZeroAccSpatFrc = Force::load(zeroAccSpatFrcPtr + (parent + 1)*6*LANES) + transformInverse(rotFromParent, rVector, spatForceVecTemp);
+		parentZeroAccSpatFrc.store(zeroAccSpatFrcPtr + (parent + 1)*6*LANES);
+	}
+
+	// Second 'upward' loop
+	Motion spatAcc0 = Motion::make(Vec3::zero(), Vec3::zero());
+	if (!m_fixedBase)
+	{
+		const Motion result = solveImatrix(Mat3::load(b + FIELD_INV_BASE_INERTIA*LANES), Mat3::load(b + (FIELD_INV_BASE_INERTIA + 9)*LANES),
+											Mat3::load(b + (FIELD_INV_BASE_INERTIA + 18)*LANES), Force::load(zeroAccSpatFrcPtr));
+		spatAcc0 = Motion::make(-result.m_topVec, -result.m_bottomVec);
+	}
+	spatAcc0.store(spatAccPtr);
+
+	btScalar* joint_accel = output + 6*LANES;
+	for (int i = 0; i < num_links; ++i)
+	{
+		const LinkTemplate& link = m_links[i];
+		const int parent = link.m_parent;
+		const Mat3 rotFromParent = Mat3::load(b + (m_fields.m_rotParentToThis + 9*i)*LANES);
+		const Vec3 rVector = Vec3::load(b + (m_fields.m_rVector + 3*i)*LANES);
+		Motion spatAcc = transform(rotFromParent, rVector, Motion::load(spatAccPtr + (parent + 1)*6*LANES));
+		const int dof = link.m_dofOffset;
+		if (dof >= 0)
+		{
+			const Force hDof = Force::load(b + (m_fields.m_h + 6*dof)*LANES);
+			const Real qdd = Real::load(b + (m_fields.m_invD + dof)*LANES) * (Real::load(YPtr + dof*LANES) - dot(spatAcc, hDof));
+			qdd.store(joint_accel + dof*LANES);
+			spatAcc = spatAcc + Motion::splat(link.m_axisTop, link.m_axisBottom) * qdd;
+		}
+		spatAcc.store(spatAccPtr + (i + 1)*6*LANES);
+	}
+
+	// transform base accelerations back to the world frame.
+	rot0.transposeTimes(spatAcc0.m_topVec).store(output);
+	rot0.transposeTimes(spatAcc0.m_bottomVec).store(output + 3*LANES);
+}
+
+void	btMultiBodyEnsemble::stepPositionsBlock(int block, btScalar dt)
+{
+	btScalar* b = &m_blocks[block * m_blockSize];
+	const Real dtReal = Real::splat(dt);
+
+	Vec3 basePos = Vec3::load(b + FIELD_BASE_POS*LANES) + Vec3::load(b + FIELD_BASE_VEL*LANES) * dtReal;
+	basePos.store(b + FIELD_BASE_POS*LANES);
+
+	// the exponential map needs sin and cos, so the base orientation is integrated lane by lane
+	for (int lane = 0; lane < LANES; ++lane)
+	{
+		btScalar* q = b + FIELD_BASE_QUAT*LANES + lane;
+		btScalar* w = b + FIELD_BASE_OMEGA*LANES + lane;
+		btQuaternion baseQuat(q[0], q[LANES], q[2*LANES], q[3*LANES]);
+		integrateBaseQuat(btVector3(w[0], w[LANES], w[2*LANES]), baseQuat, dt);
+		q[0] = baseQuat.x();
+		q[LANES] = baseQuat.y();
+		q[2*LANES] = baseQuat.z();
+		q[3*LANES] = baseQuat.w();
+	}
+
+	for (int dof = 0; dof < m_numDofs; ++dof)
+	{
+		btScalar* q = b + (m_fields.m_jointPos + dof)*LANES;
+		Real jointPos = Real::load(q) + Real::load(b + (m_fields.m_jointVel + dof)*LANES) * dtReal;
+		jointPos.store(q);
+	}
+
+	updateLinkCacheBlock(block);
+}
+
+void	btMultiBodyEnsemble::updateLinkCacheBlock(int block)
+{
+	// see btMultibodyLink::updateCacheMultiDof
+	btScalar* b = &m_blocks[block * m_blockSize];
+	for (int i = 0; i < getNumLinks(); ++i)
+	{
+		const LinkTemplate& link = m_links[i];
+		btScalar* rotPtr = b + (m_fields.m_rotParentToThis + 9*i)*LANES;
+		btScalar* rVectorPtr = b + (m_fields.m_rVector + 3*i)*LANES;
+		switch (link.m_jointType)
+		{
+			case btMultibodyLink::eRevolute:
+			{
+				// btQuaternion(axis, -q), the sin and cos are taken lane by lane
+				ATTRIBUTE_ALIGNED16(btScalar) halfSin[LANES];
+				ATTRIBUTE_ALIGNED16(btScalar) halfCos[LANES];
+				const btScalar* q = b + (m_fields.m_jointPos + link.m_dofOffset)*LANES;
+				btScalar invAxisLength = btScalar(1.0) / link.m_axisTop.length();
+				for (int lane = 0; lane < LANES; ++lane)
+				{
+					halfSin[lane] = btSin(-q[lane] * btScalar(0.5)) * invAxisLength;
+					halfCos[lane] = btCos(-q[lane] * btScalar(0.5));
+				}
+				const Real s = Real::load(halfSin);
+				const Vec3 v1 = Vec3::splat(link.m_axisTop) * s;
+				const Real w1 = Real::load(halfCos);
+				const Vec3 v2 = Vec3::splat(btVector3(link.m_zeroRotParentToThis.x(), link.m_zeroRotParentToThis.y(), link.m_zeroRotParentToThis.z()));
+				const Real w2 = Real::splat(link.m_zeroRotParentToThis.w());
+				// quaternion product (v1, w1) * (v2, w2)
+				const Vec3 v = v2 * w1 + v1 * w2 + v1.cross(v2);
+				const Real w = w1 * w2 - v1.dot(v2);
+				const Mat3 rot = Mat3::fromQuat(v.x, v.y, v.z, w);
+				rot.store(rotPtr);
+				(Vec3::splat(link.m_dVector) + rot * Vec3::splat(link.m_eVector)).store(rVectorPtr);
+				break;
+			}
+			case btMultibodyLink::ePrismatic:
+			{
+				Mat3::splat(link.m_zeroRotMatrix).store(rotPtr);
+				const Real q = Real::load(b + (m_fields.m_jointPos + link.m_dofOffset)*LANES);
+				(Vec3::splat(link.m_zeroRVector) + Vec3::splat(link.m_axisBottom) * q).store(rVectorPtr);
+				break;
+			}
+			default:
+			{
+				Mat3::splat(link.m_zeroRotMatrix).store(rotPtr);
+				Vec3::splat(link.m_zeroRVector).store(rVectorPtr);
+			}
+		}
+	}
+}
+
+void	btMultiBodyEnsemble::forwardKinematicsBlock(int block)
+{
+	// see btMultiBody::forwardKinematics, with rotation matrices instead of quaternions
+	btScalar* b = &m_blocks[block * m_blockSize];
+	const Mat3 rot0 = Mat3::fromQuat(Real::load(b + FIELD_BASE_QUAT*LANES), Real::load(b + (FIELD_BASE_QUAT + 1)*LANES),
+									Real::load(b + (FIELD_BASE_QUAT + 2)*LANES), Real::load(b + (FIELD_BASE_QUAT + 3)*LANES));
+	const Vec3 basePos = Vec3::load(b + FIELD_BASE_POS*LANES);
+	for (int i = 0; i < getNumLinks(); ++i)
+	{
+		const int parent = m_links[i].m_parent;
+		const Mat3 parentRot = parent < 0 ? rot0 : Mat3::load(b + (m_fields.m_worldToLocal + 9*parent)*LANES);
+		const Vec3 parentOrigin = parent < 0 ? basePos : Vec3::load(b + (m_fields.m_worldOrigin + 3*parent)*LANES);
+		const Mat3 rot = Mat3::load(b + (m_fields.m_rotParentToThis + 9*i)*LANES) * parentRot;
+		rot.store(b + (m_fields.m_worldToLocal + 9*i)*LANES);
+		(parentOrigin + rot.transposeTimes(Vec3::load(b + (m_fields.m_rVector + 3*i)*LANES))).store(b + (m_fields.m_worldOrigin + 3*i)*LANES);
+	}
+}
@@ -0,0 +1,251 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_MULTIBODY_ENSEMBLE_H
+#define BT_MULTIBODY_ENSEMBLE_H
+
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btTransform.h"
+#include "LinearMath/btThreads.h"
+
+class btMultiBody;
+
+///btMultiBodyEnsemble steps many instances of the same articulation, several instances per instruction.
+///The instances share everything the template btMultiBody was set up with (links, joint types and axes, masses, inertias,
+///offsets, damping, fixed base and gyro term), only the state differs per instance: base pose and velocity,
+///joint positions and velocities, joint torques and the external forces and torques.
+///The state is stored in blocks of getLaneCount() instances, and inside a block every scalar is an array over the instances
+///(structure-of-arrays), so the articulated body algorithm, calcAccelerationDeltas, the position integration and
+///the forward kinematics run on all lanes of a block at once: 8 lanes with AVX, 4 with SSE, else the same math lane by lane.
+///The blocks are processed with btParallelFor.
+///The math is the one of btMultiBody::stepVelocitiesMultiDof and friends, so an instance stepped here follows
+///the same btMultiBody stepped on its own, up to rounding.
+///Only multi dof bodies with revolute, prismatic and fixed joints are supported (see isSupported), without RK4,
+///global velocities or joint feedback. An ensemble created from an unsupported template is empty (getNumInstances() is 0)
+///and its step functions do nothing. The instances are not part of a btMultiBodyDynamicsWorld, use
+///setInstanceFromMultiBody/copyInstanceToMultiBody to move the state of an instance to and from a btMultiBody.
+class btMultiBodyEnsemble
+{
+public:
+
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	///check getNumInstances() afterwards, it is 0 when isSupported(templateBody) is false
+	btMultiBodyEnsemble(const btMultiBody* templateBody, int numInstances);
+
+	virtual ~btMultiBodyEnsemble();
+
+	///returns true if the joint types and flags of body can be stepped by btMultiBodyEnsemble
+	static bool	isSupported(const btMultiBody* body);
+
+	///number of instances in a block, that is the SIMD width
+	static int	getLaneCount();
+
+	int	getNumInstances() const
+	{
+		return m_numInstances;
+	}
+
+	int	getNumLinks() const
+	{
+		return m_links.size();
+	}
+
+	int	getNumDofs() const
+	{
+		return m_numDofs;
+	}
+
+	///copies the base pose and velocity, the joint positions and velocities, and the applied forces and torques
+	void	setInstanceFromMultiBody(int instance, const btMultiBody* body);
+	void	copyInstanceToMultiBody(int instance, btMultiBody* body) const;
+
+	btVector3	getBasePos(int instance) const;
+	void	setBasePos(int instance, const btVector3& pos);
+	btQuaternion	getWorldToBaseRot(int instance) const;
+	void	setWorldToBaseRot(int instance, const btQuaternion& rot);
+	btVector3	getBaseVel(int instance) const;
+	void	setBaseVel(int instance, const btVector3& vel);
+	btVector3	getBaseOmega(int instance) const;
+	void	setBaseOmega(int instance, const btVector3& omega);
+
+	btScalar	getJointPos(int instance, int link) const;
+	void	setJointPos(int instance, int link, btScalar q);
+	btScalar	getJointVel(int instance, int link) const;
+	void	setJointVel(int instance, int link, btScalar qdot);
+
+	void	addBaseForce(int instance, const btVector3& f);
+	void	addBaseTorque(int instance, const btVector3& t);
+	void	addLinkForce(int instance, int link, const btVector3& f);
+	void	addLinkTorque(int instance, int link, const btVector3& t);
+	void	addJointTorque(int instance, int link, btScalar Q);
+
+	///adds the weight of the base and the links of every instance, like btMultiBodyDynamicsWorld does before stepping
+	void	addGravity(const btVector3& gravity);
+	void	clearForcesAndTorques();
+
+	///the world transform of a link computed by the last forwardKinematics call
+	btTransform	getLinkWorldTransform(int instance, int link) const;
+
+	///the accelerations of the last stepVelocities call, in the layout of btMultiBody::stepVelocitiesMultiDof:
+	///base angular and linear acceleration (world frame) followed by one entry per dof
+	btScalar	getAcceleration(int instance, int dof) const;
+
+	///articulated body algorithm for all instances, like btMultiBody::stepVelocitiesMultiDof
+	///applies the accelerations times dt to the velocities when dt > 0
+	void	stepVelocities(btScalar dt);
+
+	///like btMultiBody::calcAccelerationDeltasMultiDof for all instances, using the articulated inertias of the last stepVelocities call.
+	///force and output hold 6 + getNumDofs() values per instance, at the indices given by getDofVectorIndex
+	void	calcAccelerationDeltas(const btScalar* force, btScalar* output) const;
+
+	///integrates the base pose and the joint positions, like btMultiBody::stepPositionsMultiDof
+	void	stepPositions(btScalar dt);
+
+	///computes the world transforms of all links, see getLinkWorldTransform
+	void	forwardKinematics();
+
+	///index of entry dof of an instance in the arrays passed to calcAccelerationDeltas, the arrays need getDofVectorSize() entries
+	int	getDofVectorIndex(int instance, int dof) const
+	{
+		int lanes = getLaneCount();
+		return ((instance / lanes) * (6 + m_numDofs) + dof) * lanes + instance % lanes;
+	}
+
+	int	getDofVectorSize() const
+	{
+		return m_numBlocks * (6 + m_numDofs) * getLaneCount();
+	}
+
+	///number of blocks per task of btParallelFor
+	void	setGrainSize(int grainSize)
+	{
+		m_grainSize = grainSize;
+	}
+
+protected:
+
+	///the constant data of a link of the template, the joint position lives in the blocks
+	struct LinkTemplate
+	{
+		int	m_parent;
+		int	m_jointType;
+		int	m_dofOffset;		///< -1 for fixed joints
+		btScalar	m_mass;
+		btVector3	m_inertiaLocal;
+		btVector3	m_axisTop;
+		btVector3	m_axisBottom;
+		btQuaternion	m_zeroRotParentToThis;
+		btVector3	m_dVector;
+		btVector3	m_eVector;
+		btMatrix3x3	m_zeroRotMatrix;	///< m_zeroRotParentToThis as a matrix
+		btVector3	m_zeroRVector;		///< m_dVector + m_eVector rotated into the link frame, at q = 0
+
+		LinkTemplate()
+			:m_parent(-1),
+			m_jointType(0),
+			m_dofOffset(-1),
+			m_mass(0),
+			m_inertiaLocal(0,0,0),
+			m_axisTop(0,0,0),
+			m_axisBottom(0,0,0),
+			m_zeroRotParentToThis(0,0,0,1),
+			m_dVector(0,0,0),
+			m_eVector(0,0,0),
+			m_zeroRotMatrix(btMatrix3x3::getIdentity()),
+			m_zeroRVector(0,0,0)
+		{
+		}
+	};
+
+	///offsets of the fields of a block, in units of lanes
+	enum BlockField
+	{
+		FIELD_BASE_POS = 0,
+		FIELD_BASE_QUAT = FIELD_BASE_POS + 3,
+		FIELD_BASE_OMEGA = FIELD_BASE_QUAT + 4,
+		FIELD_BASE_VEL = FIELD_BASE_OMEGA + 3,
+		FIELD_BASE_FORCE = FIELD_BASE_VEL + 3,
+		FIELD_BASE_TORQUE = FIELD_BASE_FORCE + 3,
+		FIELD_BASE_ROT = FIELD_BASE_TORQUE + 3,		///< rot_from_parent[0], from the last stepVelocities
+		FIELD_INV_BASE_INERTIA = FIELD_BASE_ROT + 9,	///< upper left, upper right and lower left blocks of the inverse articulated base inertia
+		FIELD_ACCEL = FIELD_INV_BASE_INERTIA + 27	///< 6 + numDofs
+	};
+
+	struct LinkFields
+	{
+		int	m_force;			///< 3 per link
+		int	m_torque;			///< 3 per link
+		int	m_rotParentToThis;	///< 9 per link
+		int	m_rVector;			///< 3 per link
+		int	m_worldToLocal;		///< 9 per link, rot_from_world
+		int	m_worldOrigin;		///< 3 per link
+		int	m_jointPos;			///< 1 per dof
+		int	m_jointVel;			///< 1 per dof
+		int	m_jointTorque;		///< 1 per dof
+		int	m_h;				///< 6 per dof
+		int	m_invD;				///< 1 per dof
+	};
+
+	struct	StepVelocitiesLoop;
+	struct	AccelerationDeltasLoop;
+	struct	StepPositionsLoop;
+	struct	ForwardKinematicsLoop;
+
+	btAlignedObjectArray<LinkTemplate>	m_links;
+	int	m_numInstances;
+	int	m_numBlocks;
+	int	m_numDofs;
+	btScalar	m_baseMass;
+	btVector3	m_baseInertia;
+	bool	m_fixedBase;
+	bool	m_useGyroTerm;
+	btScalar	m_linearDamping;
+	btScalar	m_angularDamping;
+	btScalar	m_maxCoordinateVelocity;
+	int	m_grainSize;
+	bool	m_cacheDirty;
+
+	LinkFields	m_fields;
+	int	m_blockSize;		///< in scalars
+	btAlignedObjectArray<btScalar>	m_blocks;
+	///per thread scratch of the block kernels
+	mutable btAlignedObjectArray<btScalar>	m_scratch[BT_MAX_THREAD_COUNT];
+
+	btScalar*	getField(int instance, int field)
+	{
+		int lanes = getLaneCount();
+		return &m_blocks[(instance / lanes) * m_blockSize + field * lanes + instance % lanes];
+	}
+	const btScalar*	getField(int instance, int field) const
+	{
+		int lanes = getLaneCount();
+		return &m_blocks[(instance / lanes) * m_blockSize + field * lanes + instance % lanes];
+	}
+	btVector3	getVectorField(int instance, int field) const;
+	void	setVectorField(int instance, int field, const btVector3& v);
+	void	addVectorField(int instance, int field, const btVector3& v);
+
+	void	updateLinkCache();
+	void	runBlocks(const btIParallelForBody& body) const;
+
+	void	stepVelocitiesBlock(int block, btScalar dt, btScalar* scratch);
+	void	calcAccelerationDeltasBlock(int block, const btScalar* force, btScalar* output, btScalar* scratch) const;
+	void	stepPositionsBlock(int block, btScalar dt);
+	void	updateLinkCacheBlock(int block);
+	void	forwardKinematicsBlock(int block);
+};
+
+#endif //BT_MULTIBODY_ENSEMBLE_H
@@ -29,13 +29,17 @@ ATTRIBUTE_ALIGNED16 (struct)	btMultiBodySolverConstraint
 {
 	BT_DECLARE_ALIGNED_ALLOCATOR();
 
-	btMultiBodySolverConstraint() : m_solverBodyIdA(-1), m_multiBodyA(0), m_linkA(-1), m_solverBodyIdB(-1), m_multiBodyB(0), m_linkB(-1),m_orgConstraint(0), m_orgDofIndex(-1)
+	btMultiBodySolverConstraint() : m_sparseJacAindex(-1), m_sparseJacAnumDofs(0), m_sparseJacBindex(-1), m_sparseJacBnumDofs(0), m_solverBodyIdA(-1), m_multiBodyA(0), m_linkA(-1), m_solverBodyIdB(-1), m_multiBodyB(0), m_linkB(-1),m_orgConstraint(0), m_orgDofIndex(-1)
 	{}
 
 	int				m_deltaVelAindex;//more generic version of m_relpos1CrossNormal/m_contactNormal1
 	int				m_jacAindex;
 	int				m_deltaVelBindex;
 	int				m_jacBindex;
+	int				m_sparseJacAindex;//-1 if the Jacobian of A is stored in m_jacobians, else the index in btMultiBodyJacobianData::m_sparseJacobians/m_sparseDofs
+	int				m_sparseJacAnumDofs;
+	int				m_sparseJacBindex;
+	int				m_sparseJacBnumDofs;
 
 	btVector3		m_relpos1CrossNormal;
 	btVector3		m_contactNormal1;	
@@ -14,6 +14,7 @@
 // Ogre (www.ogre3d.org).
 
 #include "btQuickprof.h"
+#include "btThreads.h"
 
 #ifndef BT_NO_PROFILE
 
@@ -455,6 +456,10 @@ unsigned long int			CProfileManager::ResetTime = 0;
  *=============================================================================================*/
 void	CProfileManager::Start_Profile( const char * name )
 {
+	//the profile tree is not thread-safe, samples taken on worker threads are ignored
+	if (!btIsMainThread())
+		return;
+
 	if (name != CurrentNode->Get_Name()) {
 		CurrentNode = CurrentNode->Get_Sub_Node( name );
 	}
@@ -468,6 +473,9 @@ void	CProfileManager::Start_Profile( const char * name )
  *=============================================================================================*/
 void	CProfileManager::Stop_Profile( void )
 {
+	if (!btIsMainThread())
+		return;
+
 	// Return will indicate whether we should back up to our parent (we may
 	// be profiling a recursive function)
 	if (CurrentNode->Return()) {
@@ -21,6 +21,7 @@
 #include <stdio.h>//@todo remove this, backwards compatibility
 #include "btScalar.h"
 #include "btAlignedAllocator.h"
+#include "btThreadProfiler.h"
 #include <new>
 
 
@@ -179,15 +180,22 @@ private:
 
 ///ProfileSampleClass is a simple way to profile a function's scope
 ///Use the BT_PROFILE macro at the start of scope to time
+///With BT_ENABLE_THREAD_PROFILER the scope is also recorded by btThreadProfiler, on every thread
 class	CProfileSample {
 public:
 	CProfileSample( const char * name )
 	{ 
 		CProfileManager::Start_Profile( name ); 
+#if BT_ENABLE_THREAD_PROFILER
+		btThreadProfiler::beginZone( name );
+#endif
 	}
 
 	~CProfileSample( void )					
 	{ 
+#if BT_ENABLE_THREAD_PROFILER
+		btThreadProfiler::endZone();
+#endif
 		CProfileManager::Stop_Profile(); 
 	}
 };
@@ -198,6 +206,7 @@ public:
 #else
 
 #define	BT_PROFILE( name )
+#define	BT_PROFILE_THREAD( name )
 
 #endif //#ifndef BT_NO_PROFILE
 
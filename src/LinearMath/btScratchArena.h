@@ -0,0 +1,164 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SCRATCH_ARENA_H
+#define BT_SCRATCH_ARENA_H
+
+#include "btScalar.h"
+#include "btAlignedAllocator.h"
+
+///btScratchArena is a LIFO bump allocator for temporary arrays, like btStackAlloc, but it grows on demand.
+///Allocations that don't fit the current chunk are served by the heap, and once the arena is empty again
+///the chunk is replaced by one that holds the high water mark. A repeated sequence of allocations therefore
+///only touches the heap during its first round (the warm-up).
+///The memory is 16 byte aligned and not initialized, and no constructors or destructors are called.
+class btScratchArena
+{
+	///header of a block allocated from the heap when the chunk was too small, the data starts 16 bytes after it
+	struct OverflowBlock
+	{
+		OverflowBlock*	m_previous;
+	};
+
+	unsigned char*	m_chunk;
+	int	m_capacity;
+	int	m_used;
+	int	m_highWater;
+	OverflowBlock*	m_overflow;
+
+	btScratchArena(const btScratchArena&);
+	btScratchArena& operator=(const btScratchArena&);
+
+	static int	alignSize(int size)
+	{
+		return (size + 15) & ~15;
+	}
+
+	void	freeOverflow()
+	{
+		while (m_overflow)
+		{
+			OverflowBlock* previous = m_overflow->m_previous;
+			btAlignedFree(m_overflow);
+			m_overflow = previous;
+		}
+	}
+
+public:
+
+	btScratchArena()
+		:m_chunk(0),
+		m_capacity(0),
+		m_used(0),
+		m_highWater(0),
+		m_overflow(0)
+	{
+	}
+
+	~btScratchArena()
+	{
+		btAssert(m_used == 0);
+		freeOverflow();
+		if (m_chunk)
+		{
+			btAlignedFree(m_chunk);
+		}
+	}
+
+	///makes sure the chunk holds at least size bytes, only valid while the arena is empty
+	void	reserve(int size)
+	{
+		btAssert(m_used == 0);
+		size = alignSize(size);
+		if (size > m_capacity)
+		{
+			if (m_chunk)
+			{
+				btAlignedFree(m_chunk);
+			}
+			m_chunk = (unsigned char*) btAlignedAlloc(size, 16);
+			m_capacity = size;
+		}
+		if (size > m_highWater)
+		{
+			m_highWater = size;
+		}
+	}
+
+	template <typename T>
+	T*	allocate(int count)
+	{
+		int size = alignSize(count * int(sizeof(T)));
+		int offset = m_used;
+		m_used += size;
+		if (m_used > m_highWater)
+		{
+			m_highWater = m_used;
+		}
+		if (m_used <= m_capacity)
+		{
+			return (T*) (m_chunk + offset);
+		}
+		OverflowBlock* block = (OverflowBlock*) btAlignedAlloc(16 + size, 16);
+		block->m_previous = m_overflow;
+		m_overflow = block;
+		return (T*) ((unsigned char*) block + 16);
+	}
+
+	int	getMarker() const
+	{
+		return m_used;
+	}
+
+	///releases everything allocated after getMarker returned marker
+	void	release(int marker)
+	{
+		btAssert(marker <= m_used);
+		m_used = marker;
+		if (m_used == 0 && (m_overflow || m_highWater > m_capacity))
+		{
+			//heap blocks are only returned once the arena is empty, the next round fits the chunk
+			freeOverflow();
+			reserve(m_highWater);
+		}
+	}
+
+	int	getCapacity() const
+	{
+		return m_capacity;
+	}
+};
+
+///releases the allocations of a scope, see btScratchArena
+class btScratchArenaScope
+{
+	btScratchArena&	m_arena;
+	int	m_marker;
+
+public:
+
+	btScratchArenaScope(btScratchArena& arena)
+		:m_arena(arena),
+		m_marker(arena.getMarker())
+	{
+	}
+
+	~btScratchArenaScope()
+	{
+		m_arena.release(m_marker);
+	}
+};
+
+#endif //BT_SCRATCH_ARENA_H
@@ -0,0 +1,275 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btThreadProfiler.h"
+#include "btThreads.h"
+#include "btHashMap.h"
+#include "btMinMax.h"
+#include "btAlignedAllocator.h"
+#include <stdio.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+
+///each buffer is only written by its own thread, the padding keeps the write counters of different threads on separate cache lines
+struct btThreadProfileBuffer
+{
+	btThreadProfileEvent*	m_events;
+	unsigned long long	m_numEvents;	///< events written since the last reset, the ring buffer keeps the last BT_THREAD_PROFILER_EVENT_COUNT
+	char	m_padding[64];
+};
+
+static btThreadProfileBuffer gThreadProfileBuffers[BT_MAX_THREAD_COUNT];
+static bool gThreadProfilerEnabled = true;
+
+
+static SIMD_FORCE_INLINE void	btRecordProfileEvent(const char* name)
+{
+	if (!gThreadProfilerEnabled)
+	{
+		return;
+	}
+	unsigned long long ticks = btThreadProfiler::getTicks();
+	btThreadProfileBuffer& buffer = gThreadProfileBuffers[btGetCurrentThreadIndex()];
+	if (!buffer.m_events)
+	{
+		buffer.m_events = (btThreadProfileEvent*) btAlignedAlloc(sizeof(btThreadProfileEvent)*BT_THREAD_PROFILER_EVENT_COUNT,16);
+	}
+	btThreadProfileEvent& event = buffer.m_events[buffer.m_numEvents & (BT_THREAD_PROFILER_EVENT_COUNT-1)];
+	event.m_name = name;
+	event.m_ticks = ticks;
+	buffer.m_numEvents++;
+}
+
+
+void	btThreadProfiler::setEnabled(bool enabled)
+{
+	gThreadProfilerEnabled = enabled;
+}
+
+bool	btThreadProfiler::isEnabled()
+{
+	return gThreadProfilerEnabled;
+}
+
+void	btThreadProfiler::reset()
+{
+	for (unsigned int i=0;i<BT_MAX_THREAD_COUNT;i++)
+	{
+		gThreadProfileBuffers[i].m_numEvents = 0;
+	}
+}
+
+void	btThreadProfiler::cleanupMemory()
+{
+	for (unsigned int i=0;i<BT_MAX_THREAD_COUNT;i++)
+	{
+		btAlignedFree(gThreadProfileBuffers[i].m_events);
+		gThreadProfileBuffers[i].m_events = 0;
+		gThreadProfileBuffers[i].m_numEvents = 0;
+	}
+}
+
+void	btThreadProfiler::beginZone(const char* name)
+{
+	btAssert(name);
+	btRecordProfileEvent(name);
+}
+
+void	btThreadProfiler::endZone()
+{
+	btRecordProfileEvent(0);
+}
+
+
+unsigned long long	btThreadProfiler::getTicks()
+{
+#if defined(_WIN32)
+	LARGE_INTEGER ticks;
+	QueryPerformanceCounter(&ticks);
+	return (unsigned long long) ticks.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (unsigned long long) ts.tv_sec*1000000000ULL + (unsigned long long) ts.tv_nsec;
+#else
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return (unsigned long long) tv.tv_sec*1000000000ULL + (unsigned long long) tv.tv_usec*1000ULL;
+#endif
+}
+
+unsigned long long	btThreadProfiler::getTicksPerSecond()
+{
+#if defined(_WIN32)
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return (unsigned long long) frequency.QuadPart;
+#else
+	return 1000000000ULL;
+#endif
+}
+
+
+void	btThreadProfiler::getZones(int threadIndex, btAlignedObjectArray<btThreadProfileZone>& zones)
+{
+	zones.resize(0);
+	const btThreadProfileBuffer& buffer = gThreadProfileBuffers[threadIndex];
+	if (!buffer.m_events)
+	{
+		return;
+	}
+	unsigned long long first = 0;
+	if (buffer.m_numEvents > BT_THREAD_PROFILER_EVENT_COUNT)
+	{
+		first = buffer.m_numEvents - BT_THREAD_PROFILER_EVENT_COUNT;
+	}
+
+	btAlignedObjectArray<const btThreadProfileEvent*> openZones;
+	for (unsigned long long i=first;i<buffer.m_numEvents;i++)
+	{
+		const btThreadProfileEvent& event = buffer.m_events[i & (BT_THREAD_PROFILER_EVENT_COUNT-1)];
+		if (event.m_name)
+		{
+			openZones.push_back(&event);
+		}
+		else if (openZones.size())
+		{
+			const btThreadProfileEvent* begin = openZones[openZones.size()-1];
+			openZones.pop_back();
+			btThreadProfileZone& zone = zones.expand();
+			zone.m_name = begin->m_name;
+			zone.m_beginTicks = begin->m_ticks;
+			zone.m_endTicks = event.m_ticks;
+			zone.m_depth = openZones.size();
+		}
+	}
+}
+
+void	btThreadProfiler::aggregate(btAlignedObjectArray<btThreadProfileStats>& stats)
+{
+	stats.resize(0);
+	double secondsPerTick = 1.0/double(getTicksPerSecond());
+	btAlignedObjectArray<btThreadProfileZone> zones;
+	btHashMap<btHashString,int> statsIndices;
+	for (unsigned int threadIndex=0;threadIndex<BT_MAX_THREAD_COUNT;threadIndex++)
+	{
+		getZones(threadIndex,zones);
+		statsIndices.clear();
+		for (int i=0;i<zones.size();i++)
+		{
+			const btThreadProfileZone& zone = zones[i];
+			double seconds = double(zone.m_endTicks - zone.m_beginTicks)*secondsPerTick;
+			const int* index = statsIndices.find(zone.m_name);
+			if (!index)
+			{
+				statsIndices.insert(zone.m_name,stats.size());
+				btThreadProfileStats& entry = stats.expand();
+				entry.m_name = zone.m_name;
+				entry.m_threadIndex = threadIndex;
+				entry.m_numCalls = 1;
+				entry.m_totalSeconds = seconds;
+				entry.m_maxSeconds = seconds;
+			}
+			else
+			{
+				btThreadProfileStats& entry = stats[*index];
+				entry.m_numCalls++;
+				entry.m_totalSeconds += seconds;
+				entry.m_maxSeconds = btMax(entry.m_maxSeconds,seconds);
+			}
+		}
+	}
+}
+
+static void	btWriteJsonString(FILE* file, const char* text)
+{
+	fputc('"',file);
+	for (const char* c=text;*c;c++)
+	{
+		if (*c=='"' || *c=='\\')
+		{
+			fputc('\\',file);
+		}
+		if ((unsigned char)*c >= 0x20)
+		{
+			fputc(*c,file);
+		}
+	}
+	fputc('"',file);
+}
+
+bool	btThreadProfiler::writeChromeTrace(const char* fileName)
+{
+	FILE* file = fopen(fileName,"w");
+	if (!file)
+	{
+		return false;
+	}
+
+	// timestamps are microseconds since the earliest recorded event
+	unsigned long long startTicks = 0;
+	bool haveStart = false;
+	for (unsigned int threadIndex=0;threadIndex<BT_MAX_THREAD_COUNT;threadIndex++)
+	{
+		const btThreadProfileBuffer& buffer = gThreadProfileBuffers[threadIndex];
+		if (buffer.m_events && buffer.m_numEvents)
+		{
+			unsigned long long first = buffer.m_numEvents > BT_THREAD_PROFILER_EVENT_COUNT ? buffer.m_numEvents - BT_THREAD_PROFILER_EVENT_COUNT : 0;
+			unsigned long long ticks = buffer.m_events[first & (BT_THREAD_PROFILER_EVENT_COUNT-1)].m_ticks;
+			if (!haveStart || ticks < startTicks)
+			{
+				startTicks = ticks;
+				haveStart = true;
+			}
+		}
+	}
+	double microsecondsPerTick = 1000000.0/double(getTicksPerSecond());
+
+	fprintf(file,"{\"traceEvents\":[");
+	bool first = true;
+	btAlignedObjectArray<btThreadProfileZone> zones;
+	for (unsigned int threadIndex=0;threadIndex<BT_MAX_THREAD_COUNT;threadIndex++)
+	{
+		getZones(threadIndex,zones);
+		if (zones.size()==0)
+		{
+			continue;
+		}
+		fprintf(file,"%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",first ? "" : ",",threadIndex,threadIndex);
+		first = false;
+		for (int i=0;i<zones.size();i++)
+		{
+			const btThreadProfileZone& zone = zones[i];
+			fprintf(file,",\n{\"name\":");
+			btWriteJsonString(file,zone.m_name);
+			fprintf(file,",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				threadIndex,
+				double(zone.m_beginTicks - startTicks)*microsecondsPerTick,
+				double(zone.m_endTicks - zone.m_beginTicks)*microsecondsPerTick);
+		}
+	}
+	fprintf(file,"\n]}\n");
+	bool ok = ferror(file)==0;
+	fclose(file);
+	return ok;
+}
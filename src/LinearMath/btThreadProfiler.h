@@ -0,0 +1,113 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_THREAD_PROFILER_H
+#define BT_THREAD_PROFILER_H
+
+#include "btScalar.h"
+#include "btAlignedObjectArray.h"
+
+///BT_ENABLE_THREAD_PROFILER is set by the build (cmake option BULLET2_THREAD_PROFILER).
+///When it is 0, BT_PROFILE only feeds the CProfileManager tree of the main thread and btThreadProfileSample compiles to nothing.
+#ifndef BT_ENABLE_THREAD_PROFILER
+#define BT_ENABLE_THREAD_PROFILER 0
+#endif
+
+///number of events kept per thread, the oldest events are overwritten. Must be a power of two.
+#define BT_THREAD_PROFILER_EVENT_COUNT (1<<16)
+
+
+///a zone begins with a named event and ends with an event without a name
+struct btThreadProfileEvent
+{
+	const char*	m_name;
+	unsigned long long	m_ticks;
+};
+
+///btThreadProfileZone is a matched begin/end pair, m_depth is the nesting level within its thread
+struct btThreadProfileZone
+{
+	const char*	m_name;
+	unsigned long long	m_beginTicks;
+	unsigned long long	m_endTicks;
+	int	m_depth;
+};
+
+///totals of all zones with the same name on one thread, times are inclusive of nested zones
+struct btThreadProfileStats
+{
+	const char*	m_name;
+	int	m_threadIndex;
+	int	m_numCalls;
+	double	m_totalSeconds;
+	double	m_maxSeconds;
+};
+
+
+///btThreadProfiler records begin/end events into a ring buffer per thread (indexed by btGetCurrentThreadIndex).
+///Recording doesn't lock, each thread only writes its own buffer. Reading the events (getZones, aggregate, writeChromeTrace)
+///and reset must only be done while no tasks are running, for example between simulation steps.
+class btThreadProfiler
+{
+public:
+	static void	setEnabled(bool enabled);
+	static bool	isEnabled();
+
+	///forget all recorded events
+	static void	reset();
+	///releases the event buffers
+	static void	cleanupMemory();
+
+	static void	beginZone(const char* name);
+	static void	endZone();
+
+	///monotonic clock used for the events
+	static unsigned long long	getTicks();
+	static unsigned long long	getTicksPerSecond();
+
+	///matched zones of one thread in order of their end, zones that lost their begin event to the ring buffer are skipped
+	static void	getZones(int threadIndex, btAlignedObjectArray<btThreadProfileZone>& zones);
+	///totals per thread and zone name
+	static void	aggregate(btAlignedObjectArray<btThreadProfileStats>& stats);
+	///writes the zones of all threads in the Chrome trace event format (chrome://tracing), returns false if the file can't be written
+	static bool	writeChromeTrace(const char* fileName);
+};
+
+
+///BT_PROFILE_THREAD only records the scope with btThreadProfiler, it is used in parallel loop bodies
+///that run many times per step, where BT_PROFILE would grow the CProfileManager tree of the main thread
+#if BT_ENABLE_THREAD_PROFILER
+
+struct btThreadProfileSample
+{
+	btThreadProfileSample(const char* name)
+	{
+		btThreadProfiler::beginZone(name);
+	}
+	~btThreadProfileSample()
+	{
+		btThreadProfiler::endZone();
+	}
+};
+
+#define	BT_PROFILE_THREAD( name )	btThreadProfileSample __threadProfile( name )
+
+#else
+
+#define	BT_PROFILE_THREAD( name )
+
+#endif //BT_ENABLE_THREAD_PROFILER
+
+#endif //BT_THREAD_PROFILER_H
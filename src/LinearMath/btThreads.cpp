@@ -0,0 +1,523 @@
+/*
+Copyright (c) 2003-2014 Erwin Coumans  http://bullet.googlecode.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "btThreads.h"
+#include "btMinMax.h"
+#include "btAlignedObjectArray.h"
+#include "btQuickprof.h"
+
+#if BT_THREADSAFE
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#if BT_USE_OPENMP
+#include <omp.h>
+#endif //BT_USE_OPENMP
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#pragma intrinsic(_InterlockedCompareExchange)
+#pragma intrinsic(_InterlockedExchange)
+#pragma intrinsic(_InterlockedExchangeAdd)
+#endif //_MSC_VER
+
+
+static inline int btAtomicCompareExchange( volatile int* dest, int exchange, int comparand )
+{
+#if defined( _MSC_VER )
+	return _InterlockedCompareExchange( (volatile long*) dest, exchange, comparand );
+#else
+	__atomic_compare_exchange_n( dest, &comparand, exchange, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE );
+	return comparand;
+#endif
+}
+
+static inline void btAtomicRelease( volatile int* dest )
+{
+#if defined( _MSC_VER )
+	_InterlockedExchange( (volatile long*) dest, 0 );
+#else
+	__atomic_store_n( dest, 0, __ATOMIC_RELEASE );
+#endif
+}
+
+static inline int btAtomicFetchAdd( volatile int* dest, int value )
+{
+#if defined( _MSC_VER )
+	return _InterlockedExchangeAdd( (volatile long*) dest, value );
+#else
+	return __atomic_fetch_add( dest, value, __ATOMIC_ACQ_REL );
+#endif
+}
+
+
+bool btSpinMutex::tryLock()
+{
+	return btAtomicCompareExchange( &mLock, 1, 0 ) == 0;
+}
+
+void btSpinMutex::lock()
+{
+	// note: this lock does not sleep the thread
+	while ( !tryLock() )
+	{
+	}
+}
+
+void btSpinMutex::unlock()
+{
+	btAtomicRelease( &mLock );
+}
+
+
+static volatile int gThreadCounter = 0;
+static volatile int gThreadCounterGeneration = 0;
+static volatile int gThreadsRunningCounter = 0;
+static thread_local int sThreadIndex = -1;
+static thread_local int sThreadIndexGeneration = -1;
+
+unsigned int btGetCurrentThreadIndex()
+{
+	// a thread that survived btResetThreadIndexCounter (OpenMP may keep its threads when the thread count changes)
+	// takes a new index, else it could share its old index with a thread that got it after the reset
+	if ( sThreadIndex < 0 || sThreadIndexGeneration != gThreadCounterGeneration )
+	{
+		sThreadIndexGeneration = gThreadCounterGeneration;
+		sThreadIndex = btAtomicFetchAdd( &gThreadCounter, 1 );
+		btAssert( sThreadIndex < int( BT_MAX_THREAD_COUNT ) );
+	}
+	return unsigned( sThreadIndex );
+}
+
+void btResetThreadIndexCounter()
+{
+	// main thread should always be thread 0
+	gThreadCounterGeneration = gThreadCounterGeneration + 1;
+	gThreadCounter = 0;
+	sThreadIndex = -1;
+	btGetCurrentThreadIndex();
+}
+
+bool btIsMainThread()
+{
+	return btGetCurrentThreadIndex() == 0;
+}
+
+bool btThreadsAreRunning()
+{
+	return gThreadsRunningCounter != 0;
+}
+
+static void btPushThreadsAreRunning()
+{
+	btAtomicFetchAdd( &gThreadsRunningCounter, 1 );
+}
+
+static void btPopThreadsAreRunning()
+{
+	btAtomicFetchAdd( &gThreadsRunningCounter, -1 );
+}
+
+#else // #if BT_THREADSAFE
+
+// These should not be called ever
+void btSpinMutex::lock()
+{
+	btAssert( !"unimplemented btSpinMutex::lock() called" );
+}
+
+void btSpinMutex::unlock()
+{
+	btAssert( !"unimplemented btSpinMutex::unlock() called" );
+}
+
+bool btSpinMutex::tryLock()
+{
+	btAssert( !"unimplemented btSpinMutex::tryLock() called" );
+	return true;
+}
+
+unsigned int btGetCurrentThreadIndex()
+{
+	return 0;
+}
+
+void btResetThreadIndexCounter()
+{
+}
+
+bool btIsMainThread()
+{
+	return true;
+}
+
+bool btThreadsAreRunning()
+{
+	return false;
+}
+
+#endif // #else // #if BT_THREADSAFE
+
+
+btITaskScheduler::btITaskScheduler( const char* name )
+{
+	m_name = name;
+	m_isActive = false;
+}
+
+void btITaskScheduler::activate()
+{
+	// gThreadCounter is used to assign a thread index to each worker thread in a task scheduler.
+	// The main thread is always thread 0, and worker threads are numbered from 1 up, so claim
+	// index 0 for the thread that activates the scheduler.
+	btGetCurrentThreadIndex();
+	m_isActive = true;
+}
+
+void btITaskScheduler::deactivate()
+{
+	m_isActive = false;
+}
+
+
+///
+/// btTaskSchedulerSequential -- non-threaded implementation of task scheduler
+///                              (really just useful for testing performance of single threaded vs multi)
+///
+class btTaskSchedulerSequential : public btITaskScheduler
+{
+public:
+	btTaskSchedulerSequential() : btITaskScheduler( "Sequential" ) {}
+	virtual int getMaxNumThreads() const { return 1; }
+	virtual int getNumThreads() const { return 1; }
+	virtual void setNumThreads( int numThreads ) { (void) numThreads; }
+	virtual void parallelFor( int iBegin, int iEnd, int grainSize, const btIParallelForBody& body )
+	{
+		(void) grainSize;
+		BT_PROFILE( "parallelFor_sequential" );
+		body.forLoop( iBegin, iEnd );
+	}
+};
+
+
+#if BT_THREADSAFE && BT_USE_OPENMP
+///
+/// btTaskSchedulerOpenMP -- wrapper around OpenMP task scheduler
+///
+class btTaskSchedulerOpenMP : public btITaskScheduler
+{
+	int m_numThreads;
+public:
+	btTaskSchedulerOpenMP() : btITaskScheduler( "OpenMP" )
+	{
+		m_numThreads = 0;
+	}
+	virtual int getMaxNumThreads() const
+	{
+		return omp_get_max_threads();
+	}
+	virtual int getNumThreads() const
+	{
+		return m_numThreads;
+	}
+	virtual void setNumThreads( int numThreads )
+	{
+		// With OpenMP, because it is a standard with various implementations, we can't
+		// know for sure if every implementation has the same behavior of destroying all
+		// previous threads when resizing the threadpool
+		m_numThreads = ( btMax )( 1, ( btMin )( int( BT_MAX_THREAD_COUNT ), numThreads ) );
+		omp_set_num_threads( 1 );  // hopefully, all previous threads get destroyed here
+		omp_set_num_threads( m_numThreads );
+		if ( m_isActive )
+		{
+			btResetThreadIndexCounter();
+		}
+	}
+	virtual void parallelFor( int iBegin, int iEnd, int grainSize, const btIParallelForBody& body )
+	{
+		BT_PROFILE( "parallelFor_OpenMP" );
+		grainSize = ( btMax )( 1, grainSize );
+		btPushThreadsAreRunning();
+#pragma omp parallel for schedule( static, 1 )
+		for ( int i = iBegin; i < iEnd; i += grainSize )
+		{
+			body.forLoop( i, ( btMin )( i + grainSize, iEnd ) );
+		}
+		btPopThreadsAreRunning();
+	}
+};
+#endif // #if BT_THREADSAFE && BT_USE_OPENMP
+
+
+#if BT_THREADSAFE
+///
+/// btTaskSchedulerThreadPool -- simple pool of std::thread workers. The calling thread takes part
+///                              in every parallelFor, so numThreads-1 workers are created.
+///
+class btTaskSchedulerThreadPool : public btITaskScheduler
+{
+	btAlignedObjectArray<std::thread*> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+	int m_numThreads;
+	bool m_quit;
+	unsigned int m_jobGeneration;
+	int m_numJobWorkers;
+	int m_numWorkersBusy;
+
+	// the current job
+	const btIParallelForBody* m_body;
+	int m_begin;
+	int m_end;
+	int m_grainSize;
+	int m_numChunks;
+	std::atomic<int> m_nextChunk;
+
+	void runChunks()
+	{
+		for ( ;; )
+		{
+			int chunk = m_nextChunk.fetch_add( 1 );
+			if ( chunk >= m_numChunks )
+			{
+				break;
+			}
+			int iBegin = m_begin + chunk * m_grainSize;
+			int iEnd = ( btMin )( iBegin + m_grainSize, m_end );
+			m_body->forLoop( iBegin, iEnd );
+		}
+	}
+
+	void workerLoop( int workerIndex )
+	{
+		btGetCurrentThreadIndex();
+		unsigned int seenGeneration = 0;
+		for ( ;; )
+		{
+			{
+				std::unique_lock<std::mutex> lock( m_mutex );
+				while ( !m_quit && m_jobGeneration == seenGeneration )
+				{
+					m_wakeCondition.wait( lock );
+				}
+				if ( m_quit )
+				{
+					return;
+				}
+				seenGeneration = m_jobGeneration;
+				if ( workerIndex >= m_numJobWorkers )
+				{
+					// this worker is not needed with the current thread count
+					continue;
+				}
+			}
+			runChunks();
+			{
+				std::unique_lock<std::mutex> lock( m_mutex );
+				if ( --m_numWorkersBusy == 0 )
+				{
+					m_doneCondition.notify_one();
+				}
+			}
+		}
+	}
+
+	static void workerEntry( btTaskSchedulerThreadPool* pool, int workerIndex )
+	{
+		pool->workerLoop( workerIndex );
+	}
+
+	void startWorkers( int numWorkers )
+	{
+		while ( m_workers.size() < numWorkers )
+		{
+			m_workers.push_back( new std::thread( workerEntry, this, m_workers.size() ) );
+		}
+	}
+
+	void stopWorkers()
+	{
+		{
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_quit = true;
+		}
+		m_wakeCondition.notify_all();
+		for ( int i = 0; i < m_workers.size(); ++i )
+		{
+			m_workers[ i ]->join();
+			delete m_workers[ i ];
+		}
+		m_workers.clear();
+		m_quit = false;
+	}
+
+public:
+	btTaskSchedulerThreadPool() : btITaskScheduler( "ThreadPool" )
+	{
+		m_numThreads = getMaxNumThreads();
+		m_quit = false;
+		m_jobGeneration = 0;
+		m_numJobWorkers = 0;
+		m_numWorkersBusy = 0;
+		m_body = NULL;
+		m_begin = 0;
+		m_end = 0;
+		m_grainSize = 1;
+		m_numChunks = 0;
+		m_nextChunk = 0;
+	}
+	virtual ~btTaskSchedulerThreadPool()
+	{
+		stopWorkers();
+	}
+	virtual int getMaxNumThreads() const
+	{
+		int numCores = int( std::thread::hardware_concurrency() );
+		return ( btMax )( 1, ( btMin )( int( BT_MAX_THREAD_COUNT ), numCores ) );
+	}
+	virtual int getNumThreads() const
+	{
+		return m_numThreads;
+	}
+	virtual void setNumThreads( int numThreads )
+	{
+		m_numThreads = ( btMax )( 1, ( btMin )( int( BT_MAX_THREAD_COUNT ), numThreads ) );
+		if ( m_isActive )
+		{
+			startWorkers( m_numThreads - 1 );
+		}
+	}
+	virtual void activate()
+	{
+		btITaskScheduler::activate();
+		startWorkers( m_numThreads - 1 );
+	}
+	virtual void parallelFor( int iBegin, int iEnd, int grainSize, const btIParallelForBody& body )
+	{
+		BT_PROFILE( "parallelFor_ThreadPool" );
+		grainSize = ( btMax )( 1, grainSize );
+		int numChunks = ( iEnd - iBegin + grainSize - 1 ) / grainSize;
+		int numJobWorkers = ( btMin )( m_numThreads - 1, m_workers.size() );
+		if ( numChunks <= 1 || numJobWorkers <= 0 )
+		{
+			body.forLoop( iBegin, iEnd );
+			return;
+		}
+		btPushThreadsAreRunning();
+		{
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_body = &body;
+			m_begin = iBegin;
+			m_end = iEnd;
+			m_grainSize = grainSize;
+			m_numChunks = numChunks;
+			m_nextChunk = 0;
+			m_numJobWorkers = numJobWorkers;
+			m_numWorkersBusy = numJobWorkers;
+			++m_jobGeneration;
+		}
+		m_wakeCondition.notify_all();
+		// the calling thread works too
+		runChunks();
+		{
+			std::unique_lock<std::mutex> lock( m_mutex );
+			while ( m_numWorkersBusy > 0 )
+			{
+				m_doneCondition.wait( lock );
+			}
+			m_body = NULL;
+		}
+		btPopThreadsAreRunning();
+	}
+};
+#endif // #if BT_THREADSAFE
+
+
+// create a non-threaded task scheduler (always available)
+static btTaskSchedulerSequential gSequentialTaskScheduler;
+static btITaskScheduler* gBtTaskScheduler = &gSequentialTaskScheduler;
+
+
+void btSetTaskScheduler( btITaskScheduler* ts )
+{
+	btAssert( btIsMainThread() );
+	if ( ts == NULL )
+	{
+		ts = &gSequentialTaskScheduler;
+	}
+	if ( gBtTaskScheduler )
+	{
+		gBtTaskScheduler->deactivate();
+	}
+	gBtTaskScheduler = ts;
+	ts->activate();
+}
+
+
+btITaskScheduler* btGetTaskScheduler()
+{
+	return gBtTaskScheduler;
+}
+
+
+void btParallelFor( int iBegin, int iEnd, int grainSize, const btIParallelForBody& body )
+{
+#if BT_THREADSAFE
+	if ( btThreadsAreRunning() )
+	{
+		// nested parallelFor is not supported, just run the loop on this thread
+		body.forLoop( iBegin, iEnd );
+		return;
+	}
+	btAssert( gBtTaskScheduler != NULL );  // call btSetTaskScheduler() with a valid task scheduler first!
+	gBtTaskScheduler->parallelFor( iBegin, iEnd, grainSize, body );
+#else // #if BT_THREADSAFE
+	// non-parallel version of btParallelFor
+	(void) grainSize;
+	body.forLoop( iBegin, iEnd );
+#endif // #if BT_THREADSAFE
+}
+
+
+btITaskScheduler* btGetSequentialTaskScheduler()
+{
+	return &gSequentialTaskScheduler;
+}
+
+
+btITaskScheduler* btGetOpenMPTaskScheduler()
+{
+#if BT_THREADSAFE && BT_USE_OPENMP
+	static btTaskSchedulerOpenMP sTaskScheduler;
+	return &sTaskScheduler;
+#else
+	return NULL;
+#endif
+}
+
+
+btITaskScheduler* btGetThreadPoolTaskScheduler()
+{
+#if BT_THREADSAFE
+	static btTaskSchedulerThreadPool sTaskScheduler;
+	return &sTaskScheduler;
+#else
+	return NULL;
+#endif
+}
@@ -0,0 +1,148 @@
+/*
+Copyright (c) 2003-2014 Erwin Coumans  http://bullet.googlecode.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+
+#ifndef BT_THREADS_H
+#define BT_THREADS_H
+
+#include "btScalar.h" // has definitions like SIMD_FORCE_INLINE
+
+///BT_THREADSAFE is set by the build system (BULLET2_MULTITHREADING option) and requires a C++11 compiler.
+///When it is 0 or undefined, btSpinMutex becomes a no-op and every task scheduler runs its loops on the calling thread.
+#ifndef BT_THREADSAFE
+#define BT_THREADSAFE 0
+#endif
+
+const unsigned int BT_MAX_THREAD_COUNT = 64;
+
+///returns true if the calling thread is the thread that first called btGetCurrentThreadIndex (normally the main thread)
+bool btIsMainThread();
+///returns true while a parallelFor is being executed by the current task scheduler
+bool btThreadsAreRunning();
+///returns a unique index in [0, BT_MAX_THREAD_COUNT) for the calling thread, the main thread is index 0
+unsigned int btGetCurrentThreadIndex();
+///hands out the indices from 0 again, only call while no parallelFor is running.
+///Threads that are still alive take a new index on their next btGetCurrentThreadIndex call.
+void btResetThreadIndexCounter();
+
+///
+/// btSpinMutex -- lightweight spin-mutex implemented with atomic ops, never puts
+///               a thread to sleep because it is designed to be used with a task scheduler
+///               which has one thread per core and the threads don't sleep until they
+///               run out of tasks. Not good for general purpose use.
+///
+class btSpinMutex
+{
+	int mLock;
+
+public:
+	btSpinMutex()
+	{
+		mLock = 0;
+	}
+	void lock();
+	void unlock();
+	bool tryLock();
+};
+
+///these functions compile down to nothing when BT_THREADSAFE is not defined,
+///so they can be sprinkled through the code without cost for single threaded builds
+SIMD_FORCE_INLINE void btMutexLock( btSpinMutex* mutex )
+{
+#if BT_THREADSAFE
+	mutex->lock();
+#else
+	(void) mutex;
+#endif
+}
+
+SIMD_FORCE_INLINE void btMutexUnlock( btSpinMutex* mutex )
+{
+#if BT_THREADSAFE
+	mutex->unlock();
+#else
+	(void) mutex;
+#endif
+}
+
+SIMD_FORCE_INLINE bool btMutexTryLock( btSpinMutex* mutex )
+{
+#if BT_THREADSAFE
+	return mutex->tryLock();
+#else
+	(void) mutex;
+	return true;
+#endif
+}
+
+
+///
+/// btIParallelForBody -- subclass this to express work that can be done in parallel
+///
+class btIParallelForBody
+{
+public:
+	virtual ~btIParallelForBody() {}
+	virtual void forLoop( int iBegin, int iEnd ) const = 0;
+};
+
+///
+/// btITaskScheduler -- subclass this to implement a task scheduler that can dispatch work to
+///                     worker threads
+///
+class btITaskScheduler
+{
+public:
+	btITaskScheduler( const char* name );
+	virtual ~btITaskScheduler() {}
+	const char* getName() const { return m_name; }
+
+	virtual int getMaxNumThreads() const = 0;
+	virtual int getNumThreads() const = 0;
+	virtual void setNumThreads( int numThreads ) = 0;
+	///calls body.forLoop on sub-ranges of [iBegin, iEnd), grainSize is the preferred number of iterations per sub-range
+	virtual void parallelFor( int iBegin, int iEnd, int grainSize, const btIParallelForBody& body ) = 0;
+
+	// internal use only
+	virtual void activate();
+	virtual void deactivate();
+
+protected:
+	const char* m_name;
+	bool m_isActive;
+};
+
+///set the task scheduler to use for all calls to btParallelFor()
+///NOTE: you must set this prior to using any of the multi-threaded "Mt" classes
+void btSetTaskScheduler( btITaskScheduler* ts );
+
+///get the current task scheduler
+btITaskScheduler* btGetTaskScheduler();
+
+///get non-threaded task scheduler (always available)
+btITaskScheduler* btGetSequentialTaskScheduler();
+
+///get OpenMP task scheduler (if available, otherwise returns null)
+btITaskScheduler* btGetOpenMPTaskScheduler();
+
+///get the std::thread pool task scheduler (if available, otherwise returns null)
+btITaskScheduler* btGetThreadPoolTaskScheduler();
+
+///btParallelFor -- call this to dispatch work like a for-loop
+///                 (iterations may be done out of order, so no dependencies are allowed)
+void btParallelFor( int iBegin, int iEnd, int grainSize, const btIParallelForBody& body );
+
+
+#endif //BT_THREADS_H
@@ -0,0 +1,377 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///Runs the same convex pairs through the shortcuts of the convex-convex narrowphase (GJK warm start, support kernels,
+///SAT feature cache and Gauss map pruning) and through the plain queries, and checks that the results agree.
+
+
+#include <gtest/gtest.h>
+
+#include "TestRandom.h"
+#include "BulletCollision/CollisionShapes/btBoxShape.h"
+#include "BulletCollision/CollisionShapes/btSphereShape.h"
+#include "BulletCollision/CollisionShapes/btCapsuleShape.h"
+#include "BulletCollision/CollisionShapes/btCylinderShape.h"
+#include "BulletCollision/CollisionShapes/btConvexHullShape.h"
+#include "BulletCollision/NarrowPhaseCollision/btGjkPairDetector.h"
+#include "BulletCollision/NarrowPhaseCollision/btGjkEpaPenetrationDepthSolver.h"
+#include "BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h"
+#include "BulletCollision/NarrowPhaseCollision/btPointCollector.h"
+#include "BulletCollision/NarrowPhaseCollision/btPolyhedralContactClipping.h"
+#include "BulletCollision/CollisionShapes/btConvexPolyhedron.h"
+#include "BulletCollision/CollisionDispatch/btConvexConvexKernelAlgorithm.h"
+
+
+namespace
+{
+
+struct ConvexShapes
+{
+	btAlignedObjectArray<btConvexShape*>	m_shapes;
+
+	ConvexShapes(TestRandom& rnd)
+	{
+		m_shapes.push_back(new btBoxShape(btVector3(0.5f,0.3f,0.8f)));
+		m_shapes.push_back(new btSphereShape(0.6f));
+		m_shapes.push_back(new btCapsuleShape(0.3f,1.0f));
+		m_shapes.push_back(new btCylinderShape(btVector3(0.4f,0.6f,0.4f)));
+		btConvexHullShape* hull = new btConvexHullShape();
+		for (int i=0;i<30;i++)
+		{
+			hull->addPoint(rnd.vector(-0.7f,0.7f),false);
+		}
+		hull->recalcLocalAabb();
+		m_shapes.push_back(hull);
+	}
+
+	~ConvexShapes()
+	{
+		for (int i=0;i<m_shapes.size();i++)
+		{
+			delete m_shapes[i];
+		}
+	}
+};
+
+static btPointCollector	closestPoints(const btConvexShape* a, const btConvexShape* b, const btTransform& transA, const btTransform& transB, const btVector3* warmStartAxis)
+{
+	btVoronoiSimplexSolver simplexSolver;
+	btGjkEpaPenetrationDepthSolver epaSolver;
+	btGjkPairDetector gjk(a,b,&simplexSolver,&epaSolver);
+	if (warmStartAxis)
+	{
+		gjk.setCachedSeperatingAxis(*warmStartAxis);
+		gjk.setWarmStart(true);
+	}
+	btGjkPairDetector::ClosestPointInput input;
+	input.m_transformA = transA;
+	input.m_transformB = transB;
+	btPointCollector result;
+	gjk.getClosestPoints(input,result,0);
+	return result;
+}
+
+///the query of btConvexConvexKernelAlgorithm::computeClosestPoints
+template <typename btSupportKernelA, typename btSupportKernelB>
+static btPointCollector	kernelClosestPoints(const btConvexShape* a, const btConvexShape* b, const btTransform& transA, const btTransform& transB)
+{
+	btVector3 positionOffset = (transA.getOrigin() + transB.getOrigin()) * btScalar(0.5);
+	btTransform localTransA = transA;
+	btTransform localTransB = transB;
+	localTransA.getOrigin() -= positionOffset;
+	localTransB.getOrigin() -= positionOffset;
+	int supportVertexCache[2] = { -1, -1 };
+	btSupportKernelA kernelA(a,localTransA);
+	btSupportKernelB kernelB(b,localTransB);
+	kernelA.setSupportVertexCache(&supportVertexCache[0]);
+	kernelB.setSupportVertexCache(&supportVertexCache[1]);
+
+	btGjkCollisionDescription colDesc;
+	btVoronoiSimplexSolver simplexSolver;
+	btConvexKernelDistanceInfo distInfo;
+	btPointCollector result;
+	if (btComputeGjkEpaPenetration(kernelA,kernelB,colDesc,simplexSolver,&distInfo) == 0)
+	{
+		result.addContactPoint(distInfo.m_normalBtoA,distInfo.m_pointOnB+positionOffset,distInfo.m_distance);
+	}
+	return result;
+}
+
+struct KernelComparison
+{
+	int	m_numSeparated;
+	int	m_numPenetrating;
+
+	KernelComparison()
+		:m_numSeparated(0),
+		m_numPenetrating(0)
+	{
+	}
+
+	template <typename btSupportKernelA, typename btSupportKernelB>
+	void	compare(const btConvexShape* a, const btConvexShape* b, TestRandom& rnd)
+	{
+		bool polyhedral = a->isPolyhedral() && b->isPolyhedral();
+		for (int k=0;k<200;k++)
+		{
+			btTransform transA = rnd.transform(1.5f);
+			btTransform transB = rnd.transform(1.5f);
+			btPointCollector generic = closestPoints(a,b,transA,transB,0);
+			btPointCollector kernel = kernelClosestPoints<btSupportKernelA,btSupportKernelB>(a,b,transA,transB);
+			ASSERT_EQ(generic.m_hasResult,kernel.m_hasResult) << a->getName() << " " << b->getName() << " pair: " << k;
+			if (!generic.m_hasResult)
+			{
+				continue;
+			}
+			if (generic.m_distance > 0)
+			{
+				m_numSeparated++;
+				//the same GJK, up to the frame it runs in, so it stops at the same point within its tolerance
+				btScalar distanceTolerance = polyhedral ? btScalar(1e-5) : btScalar(1e-2);
+				btScalar normalTolerance = polyhedral ? btScalar(1e-4) : btScalar(1e-2);
+				ASSERT_NEAR(generic.m_distance,kernel.m_distance,distanceTolerance) << a->getName() << " " << b->getName() << " pair: " << k;
+				ASSERT_GT(generic.m_normalOnBInWorld.dot(kernel.m_normalOnBInWorld),1-normalTolerance) << a->getName() << " " << b->getName() << " pair: " << k;
+			}
+			else
+			{
+				m_numPenetrating++;
+				//the kernels use the EPA of btGjkEpa3.h, the generic path btGjkEpa2, both converge to the same depth
+				ASSERT_NEAR(generic.m_distance,kernel.m_distance,1e-2) << a->getName() << " " << b->getName() << " pair: " << k;
+			}
+		}
+	}
+
+	template <typename btSupportKernelA>
+	void	compare(const btConvexShape* a, const btConvexShape* b, int kernelIndexB, TestRandom& rnd)
+	{
+		switch (kernelIndexB)
+		{
+		case 0:
+			compare<btSupportKernelA,btBoxSupportKernel>(a,b,rnd);
+			break;
+		case 1:
+			compare<btSupportKernelA,btSphereSupportKernel>(a,b,rnd);
+			break;
+		case 2:
+			compare<btSupportKernelA,btCapsuleSupportKernel>(a,b,rnd);
+			break;
+		default:
+			compare<btSupportKernelA,btConvexHullSupportKernel>(a,b,rnd);
+			break;
+		}
+	}
+};
+
+///depth of the overlap of the two hulls along axis, negative when the axis separates them
+static btScalar	overlapAlongAxis(const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA, const btTransform& transB, const btVector3& axis)
+{
+	btScalar minA = BT_LARGE_FLOAT, maxA = -BT_LARGE_FLOAT;
+	btScalar minB = BT_LARGE_FLOAT, maxB = -BT_LARGE_FLOAT;
+	for (int i=0;i<hullA.m_vertices.size();i++)
+	{
+		btScalar d = axis.dot(transA(hullA.m_vertices[i]));
+		minA = btMin(minA,d);
+		maxA = btMax(maxA,d);
+	}
+	for (int i=0;i<hullB.m_vertices.size();i++)
+	{
+		btScalar d = axis.dot(transB(hullB.m_vertices[i]));
+		minB = btMin(minB,d);
+		maxB = btMax(maxB,d);
+	}
+	return btMin(maxA-minB,maxB-minA);
+}
+
+struct SatResult
+{
+	bool	m_overlapping;
+	btScalar	m_depth;
+};
+
+static SatResult	findSeparatingAxis(const btConvexPolyhedron& hullA, const btConvexPolyhedron& hullB, const btTransform& transA, const btTransform& transB, btSatFeatureCache* featureCache, bool gaussMapPruning)
+{
+	bool useGaussMapPruning = gUseGaussMapPruning;
+	gUseGaussMapPruning = gaussMapPruning;
+	btVector3 sep(0,1,0);
+	btPointCollector dummy;
+	SatResult result;
+	result.m_overlapping = btPolyhedralContactClipping::findSeparatingAxis(hullA,hullB,transA,transB,sep,dummy,featureCache);
+	result.m_depth = result.m_overlapping ? overlapAlongAxis(hullA,hullB,transA,transB,sep.normalized()) : btScalar(0.);
+	gUseGaussMapPruning = useGaussMapPruning;
+	return result;
+}
+
+}
+
+
+TEST(BulletCollisionTest, GjkWarmStartMatchesColdStart)
+{
+	TestRandom rnd(12345);
+	ConvexShapes shapes(rnd);
+	int numSeparated = 0;
+	int numPenetrating = 0;
+	for (int i=0;i<shapes.m_shapes.size();i++)
+	{
+		for (int j=0;j<shapes.m_shapes.size();j++)
+		{
+			const btConvexShape* a = shapes.m_shapes[i];
+			const btConvexShape* b = shapes.m_shapes[j];
+			for (int k=0;k<200;k++)
+			{
+				btTransform transA = rnd.transform(1.5f);
+				btTransform transB = rnd.transform(1.5f);
+
+				//the warm start axis is the one of the previous frame, after a small motion of both objects
+				btTransform prevA(transA.getRotation()*btQuaternion(rnd.vector(-1,1).normalized(),rnd.uniform(0,0.1f)),transA.getOrigin()+rnd.vector(-0.05f,0.05f));
+				btPointCollector prev = closestPoints(a,b,prevA,transB,0);
+				if (!prev.m_hasResult)
+				{
+					continue;
+				}
+				btVector3 axis = prev.m_normalOnBInWorld;
+
+				btPointCollector cold = closestPoints(a,b,transA,transB,0);
+				btPointCollector warm = closestPoints(a,b,transA,transB,&axis);
+				ASSERT_EQ(cold.m_hasResult,warm.m_hasResult) << "shapes: " << i << " " << j << " pair: " << k;
+				if (!cold.m_hasResult)
+				{
+					continue;
+				}
+				//on polyhedra GJK ends on the same feature from any start, on curved shapes it stops within its relative
+				//tolerance, which is a different point for a different start
+				bool polyhedral = a->isPolyhedral() && b->isPolyhedral();
+				btScalar distanceTolerance = polyhedral ? btScalar(1e-5) : btScalar(1e-2);
+				btScalar normalTolerance = polyhedral ? btScalar(1e-4) : btScalar(1e-2);
+				ASSERT_NEAR(cold.m_distance,warm.m_distance,distanceTolerance) << "shapes: " << i << " " << j << " pair: " << k;
+				if (cold.m_distance > 0)
+				{
+					numSeparated++;
+					ASSERT_GT(cold.m_normalOnBInWorld.dot(warm.m_normalOnBInWorld),1-normalTolerance) << "shapes: " << i << " " << j << " pair: " << k;
+				}
+				else
+				{
+					numPenetrating++;
+				}
+			}
+		}
+	}
+	ASSERT_GT(numSeparated,500);
+	ASSERT_GT(numPenetrating,500);
+}
+
+TEST(BulletCollisionTest, SupportKernelsMatchGenericGjk)
+{
+	TestRandom rnd(54321);
+	ConvexShapes shapes(rnd);
+	//box, sphere, capsule and hull, the shapes with support kernels
+	const btConvexShape* kernelShapes[] = { shapes.m_shapes[0], shapes.m_shapes[1], shapes.m_shapes[2], shapes.m_shapes[4] };
+	KernelComparison comparison;
+	for (int i=0;i<4;i++)
+	{
+		for (int j=0;j<4;j++)
+		{
+			const btConvexShape* a = kernelShapes[i];
+			const btConvexShape* b = kernelShapes[j];
+			switch (i)
+			{
+			case 0:
+				comparison.compare<btBoxSupportKernel>(a,b,j,rnd);
+				break;
+			case 1:
+				comparison.compare<btSphereSupportKernel>(a,b,j,rnd);
+				break;
+			case 2:
+				comparison.compare<btCapsuleSupportKernel>(a,b,j,rnd);
+				break;
+			default:
+				comparison.compare<btConvexHullSupportKernel>(a,b,j,rnd);
+				break;
+			}
+			ASSERT_FALSE(::testing::Test::HasFatalFailure());
+		}
+	}
+	ASSERT_GT(comparison.m_numSeparated,500);
+	ASSERT_GT(comparison.m_numPenetrating,500);
+}
+
+TEST(BulletCollisionTest, SatFeatureCacheAndGaussMapMatchFullSat)
+{
+	TestRandom rnd(777);
+	btAlignedObjectArray<btConvexHullShape*> hulls;
+	for (int i=0;i<8;i++)
+	{
+		btConvexHullShape* hull = new btConvexHullShape();
+		for (int j=0;j<20;j++)
+		{
+			btVector3 v = rnd.vector(-0.5f,0.5f);
+			if (i&1)
+			{
+				//points on a coarse grid give coplanar points, so initializePolyhedralFeatures merges faces
+				v = btVector3(btScalar(int(v[0]*4))/4,btScalar(int(v[1]*4))/4,btScalar(int(v[2]*4))/4);
+			}
+			hull->addPoint(v,false);
+		}
+		hull->recalcLocalAabb();
+		hull->initializePolyhedralFeatures();
+		hulls.push_back(hull);
+	}
+
+	int numOverlapping = 0;
+	int numSeparated = 0;
+	for (int i=0;i<hulls.size();i++)
+	{
+		for (int j=0;j<hulls.size();j++)
+		{
+			const btConvexPolyhedron& hullA = *hulls[i]->getConvexPolyhedron();
+			const btConvexPolyhedron& hullB = *hulls[j]->getConvexPolyhedron();
+			btSatFeatureCache cache;
+			btTransform transA = rnd.transform(0.6f);
+			btTransform transB = rnd.transform(0.6f);
+			for (int k=0;k<50;k++)
+			{
+				//coherent motion, so the cached feature is often still the right one
+				transA.setOrigin(transA.getOrigin()+rnd.vector(-0.05f,0.05f));
+				transA.setRotation(transA.getRotation()*btQuaternion(rnd.vector(-1,1).normalized(),rnd.uniform(0,0.1f)));
+				if (k%10==0)
+				{
+					transB = rnd.transform(0.6f);
+				}
+
+				SatResult reference = findSeparatingAxis(hullA,hullB,transA,transB,0,false);
+				SatResult pruned = findSeparatingAxis(hullA,hullB,transA,transB,0,true);
+				SatResult cached = findSeparatingAxis(hullA,hullB,transA,transB,&cache,true);
+				ASSERT_EQ(reference.m_overlapping,pruned.m_overlapping) << "hulls: " << i << " " << j << " step: " << k;
+				ASSERT_EQ(reference.m_overlapping,cached.m_overlapping) << "hulls: " << i << " " << j << " step: " << k;
+				if (reference.m_overlapping)
+				{
+					numOverlapping++;
+					//with merged faces the pruning can pick another axis of nearly the same depth, see btPolyhedralContactClipping
+					ASSERT_NEAR(reference.m_depth,pruned.m_depth,1e-3) << "hulls: " << i << " " << j << " step: " << k;
+					ASSERT_NEAR(reference.m_depth,cached.m_depth,1e-3) << "hulls: " << i << " " << j << " step: " << k;
+				}
+				else
+				{
+					numSeparated++;
+				}
+			}
+		}
+	}
+	for (int i=0;i<hulls.size();i++)
+	{
+		delete hulls[i];
+	}
+	ASSERT_GT(numOverlapping,500);
+	ASSERT_GT(numSeparated,500);
+}
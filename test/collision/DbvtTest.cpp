@@ -0,0 +1,514 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///Checks the queries of btCompactDbvt against the ones of the btDbvt it was laid out from: the same leaves in the same order.
+///Also checks that the parallel top down build of btDbvt gives the same tree as the serial one, that tree rotations keep the tree valid,
+///and that rotations of a settled fixed set keep its compact layout valid.
+
+
+#include <gtest/gtest.h>
+
+#include "TestRandom.h"
+#include "BulletCollision/BroadphaseCollision/btDbvt.h"
+#include "BulletCollision/BroadphaseCollision/btCompactDbvt.h"
+#include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.h"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "LinearMath/btThreads.h"
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+
+namespace
+{
+
+struct LeafCollector : btDbvt::ICollide
+{
+	std::vector<const btDbvtNode*>	m_leaves;
+	std::vector<std::pair<const btDbvtNode*,const btDbvtNode*> >	m_pairs;
+
+	void	Process(const btDbvtNode* leaf)
+	{
+		m_leaves.push_back(leaf);
+	}
+	void	Process(const btDbvtNode* a, const btDbvtNode* b)
+	{
+		m_pairs.push_back(std::make_pair(a,b));
+	}
+};
+
+static btDbvtVolume	randomVolume(TestRandom& rnd, btScalar range, btScalar maxSize)
+{
+	btVector3 center = rnd.vector(-range,range);
+	btVector3 extents = rnd.vector(btScalar(0.01),maxSize);
+	return btDbvtVolume::FromCE(center,extents);
+}
+
+static void	insertLeaves(btDbvt& tree, TestRandom& rnd, int numLeaves, btAlignedObjectArray<btDbvtNode*>& leaves)
+{
+	for (int i=0;i<numLeaves;i++)
+	{
+		leaves.push_back(tree.insert(randomVolume(rnd,50,2),(void*)(size_t)(leaves.size()+1)));
+	}
+}
+
+struct RayQuery
+{
+	btVector3	m_from;
+	btVector3	m_to;
+	btVector3	m_rayDirectionInverse;
+	unsigned int	m_signs[3];
+	btScalar	m_lambdaMax;
+
+	RayQuery(const btVector3& from, const btVector3& to)
+		:m_from(from),
+		m_to(to)
+	{
+		btVector3 rayDir = (to-from).normalized();
+		for (int i=0;i<3;i++)
+		{
+			m_rayDirectionInverse[i] = rayDir[i] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[i];
+			m_signs[i] = m_rayDirectionInverse[i] < 0.0;
+		}
+		m_lambdaMax = rayDir.dot(to-from);
+	}
+};
+
+///runs every query on the tree and on the compact copy and compares the leaves they report
+static void	compareQueries(const btDbvt& tree, const btDbvt& otherTree, const btCompactDbvt& compact, TestRandom& rnd)
+{
+	ASSERT_TRUE(compact.isValid(tree));
+	ASSERT_EQ(tree.m_leaves,compact.getNumLeaves());
+
+	for (int i=0;i<200;i++)
+	{
+		btDbvtVolume volume = randomVolume(rnd,50,10);
+		LeafCollector expected;
+		LeafCollector actual;
+		tree.collideTV(tree.m_root,volume,expected);
+		compact.collideTV(volume,actual);
+		ASSERT_EQ(expected.m_leaves,actual.m_leaves) << "collideTV query: " << i;
+	}
+
+	btAlignedObjectArray<const btDbvtNode*> rayStack;
+	int numRayHits = 0;
+	for (int i=0;i<200;i++)
+	{
+		RayQuery ray(rnd.vector(-60,60),rnd.vector(-60,60));
+		btVector3 aabbMin(0,0,0);
+		btVector3 aabbMax(0,0,0);
+		LeafCollector expected;
+		LeafCollector actual;
+		tree.rayTestInternal(tree.m_root,ray.m_from,ray.m_to,ray.m_rayDirectionInverse,ray.m_signs,ray.m_lambdaMax,aabbMin,aabbMax,rayStack,expected);
+		compact.rayTestInternal(ray.m_from,ray.m_rayDirectionInverse,ray.m_signs,ray.m_lambdaMax,aabbMin,aabbMax,actual);
+		ASSERT_EQ(expected.m_leaves,actual.m_leaves) << "rayTestInternal query: " << i;
+		numRayHits += int(expected.m_leaves.size());
+	}
+	ASSERT_GT(numRayHits,0);
+
+	btAlignedObjectArray<btCompactDbvt::sStkNC> stack;
+	{
+		LeafCollector expected;
+		LeafCollector actual;
+		btDbvt& mutableTree = const_cast<btDbvt&>(tree);
+		mutableTree.collideTTpersistentStack(tree.m_root,otherTree.m_root,expected);
+		compact.collideTT(otherTree.m_root,true,stack,actual);
+		ASSERT_GT(expected.m_pairs.size(),0u);
+		ASSERT_TRUE(expected.m_pairs==actual.m_pairs) << "collideTT compact first";
+	}
+	{
+		LeafCollector expected;
+		LeafCollector actual;
+		btDbvt& mutableOther = const_cast<btDbvt&>(otherTree);
+		mutableOther.collideTTpersistentStack(otherTree.m_root,tree.m_root,expected);
+		compact.collideTT(otherTree.m_root,false,stack,actual);
+		ASSERT_TRUE(expected.m_pairs==actual.m_pairs) << "collideTT compact second";
+	}
+}
+
+static void	testCompactDbvt(bool quantized)
+{
+	TestRandom rnd(quantized ? 31 : 13);
+	btDbvt tree;
+	btDbvt otherTree;
+	btAlignedObjectArray<btDbvtNode*> leaves;
+	btAlignedObjectArray<btDbvtNode*> otherLeaves;
+	insertLeaves(tree,rnd,2000,leaves);
+	insertLeaves(otherTree,rnd,300,otherLeaves);
+
+	btCompactDbvt compact;
+	compact.build(tree,quantized);
+	ASSERT_EQ(quantized,compact.isQuantized());
+	compareQueries(tree,otherTree,compact,rnd);
+
+	//every change of the tree bumps m_revision, which invalidates the copy until it is built again
+	for (int round=0;round<3;round++)
+	{
+		unsigned revision = tree.m_revision;
+		for (int i=0;i<100;i++)
+		{
+			int index = int(rnd.uniform(0,btScalar(leaves.size()-1)));
+			tree.remove(leaves[index]);
+			leaves.swap(index,leaves.size()-1);
+			leaves.pop_back();
+		}
+		ASSERT_NE(revision,tree.m_revision);
+		ASSERT_FALSE(compact.isValid(tree));
+		compact.build(tree,quantized);
+		compareQueries(tree,otherTree,compact,rnd);
+
+		revision = tree.m_revision;
+		insertLeaves(tree,rnd,150,leaves);
+		ASSERT_NE(revision,tree.m_revision);
+		ASSERT_FALSE(compact.isValid(tree));
+		compact.build(tree,quantized);
+		compareQueries(tree,otherTree,compact,rnd);
+
+		revision = tree.m_revision;
+		for (int i=0;i<100;i++)
+		{
+			btDbvtVolume volume = randomVolume(rnd,50,2);
+			tree.update(leaves[int(rnd.uniform(0,btScalar(leaves.size()-1)))],volume);
+		}
+		tree.optimizeIncremental(1);
+		ASSERT_NE(revision,tree.m_revision);
+		ASSERT_FALSE(compact.isValid(tree));
+		compact.build(tree,quantized);
+		compareQueries(tree,otherTree,compact,rnd);
+	}
+	tree.clear();
+	otherTree.clear();
+}
+
+struct PairCollector : btOverlapCallback
+{
+	std::vector<std::pair<int,int> >	m_pairs;
+
+	virtual bool	processOverlap(btBroadphasePair& pair)
+	{
+		int a = pair.m_pProxy0->getUid();
+		int b = pair.m_pProxy1->getUid();
+		m_pairs.push_back(a<b ? std::make_pair(a,b) : std::make_pair(b,a));
+		return false;
+	}
+};
+
+static std::vector<std::pair<int,int> >	getPairs(btDbvtBroadphase& broadphase)
+{
+	PairCollector collector;
+	broadphase.getOverlappingPairCache()->processAllOverlappingPairs(&collector,0);
+	std::sort(collector.m_pairs.begin(),collector.m_pairs.end());
+	return collector.m_pairs;
+}
+
+static bool	sameVolume(const btDbvtVolume& a, const btDbvtVolume& b)
+{
+	return a.Mins()==b.Mins() && a.Maxs()==b.Maxs();
+}
+
+static void	compareTrees(const btDbvtNode* a, const btDbvtNode* b)
+{
+	ASSERT_EQ(a->isleaf(),b->isleaf());
+	ASSERT_TRUE(sameVolume(a->volume,b->volume));
+	if (a->isleaf())
+	{
+		ASSERT_EQ(a->data,b->data);
+		return;
+	}
+	for (int i=0;i<2;i++)
+	{
+		compareTrees(a->childs[i],b->childs[i]);
+		if (::testing::Test::HasFatalFailure())
+		{
+			return;
+		}
+	}
+}
+
+///checks the parent links and that the volume of every internal node contains the volumes of its children, returns the number of leaves
+static int	checkTree(const btDbvtNode* node, const btDbvtNode* parent)
+{
+	EXPECT_EQ(parent,node->parent);
+	if (node->isleaf())
+	{
+		return 1;
+	}
+	int numLeaves = 0;
+	for (int i=0;i<2;i++)
+	{
+		EXPECT_TRUE(node->volume.Contain(node->childs[i]->volume));
+		numLeaves += checkTree(node->childs[i],node);
+	}
+	return numLeaves;
+}
+
+///the surface area heuristic cost of the tree, the sum of the surface areas of the internal nodes
+static btScalar	surfaceAreaCost(const btDbvtNode* node)
+{
+	if (node->isleaf())
+	{
+		return 0;
+	}
+	btVector3 e = node->volume.Lengths();
+	return e[0]*e[1]+e[1]*e[2]+e[2]*e[0]+surfaceAreaCost(node->childs[0])+surfaceAreaCost(node->childs[1]);
+}
+
+///switches to a task scheduler with the given number of threads, and back to the previous scheduler and thread count
+///when it goes out of scope, also when an ASSERT returns early
+struct TaskSchedulerGuard
+{
+	btITaskScheduler*	m_previousScheduler;
+	btITaskScheduler*	m_scheduler;
+	int	m_previousNumThreads;
+
+	TaskSchedulerGuard(btITaskScheduler* scheduler, int numThreads)
+		:m_previousScheduler(btGetTaskScheduler()),
+		m_scheduler(scheduler),
+		m_previousNumThreads(scheduler ? scheduler->getNumThreads() : 0)
+	{
+		if (m_scheduler)
+		{
+			m_scheduler->setNumThreads(numThreads);
+			btSetTaskScheduler(m_scheduler);
+		}
+	}
+
+	~TaskSchedulerGuard()
+	{
+		if (m_scheduler)
+		{
+			btSetTaskScheduler(m_previousScheduler);
+			m_scheduler->setNumThreads(m_previousNumThreads);
+		}
+	}
+};
+
+}
+
+
+TEST(BulletCollisionTest, CompactDbvtMatchesDbvt)
+{
+	testCompactDbvt(false);
+}
+
+TEST(BulletCollisionTest, QuantizedCompactDbvtMatchesDbvt)
+{
+	testCompactDbvt(true);
+}
+
+TEST(BulletCollisionTest, DbvtBroadphaseWithCompactFixedSetFindsTheSamePairs)
+{
+	TestRandom rnd(99);
+	btDbvtBroadphase plain;
+	btDbvtBroadphase compact;
+	btDbvtBroadphase quantized;
+	compact.m_compactLayoutPeriod = 1;
+	quantized.m_compactLayoutPeriod = 1;
+	quantized.m_compactLayoutQuantized = true;
+	btDbvtBroadphase* broadphases[] = { &plain, &compact, &quantized };
+
+	//static proxies go to the fixed set, the moving ones stay in the dynamic set
+	btAlignedObjectArray<btBroadphaseProxy*> proxies[3];
+	for (int i=0;i<600;i++)
+	{
+		btDbvtVolume volume = randomVolume(rnd,30,1.5f);
+		bool isStatic = i%3 != 0;
+		for (int b=0;b<3;b++)
+		{
+			btBroadphaseProxy* proxy = broadphases[b]->createProxy(volume.Mins(),volume.Maxs(),0,0,
+				isStatic ? short(btBroadphaseProxy::StaticFilter) : short(btBroadphaseProxy::DefaultFilter),
+				isStatic ? short(btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter) : short(btBroadphaseProxy::AllFilter),0,0);
+			proxies[b].push_back(proxy);
+		}
+	}
+	for (int step=0;step<40;step++)
+	{
+		//move some dynamic proxies, and now and then remove and add static ones, which rebuilds the compact fixed set
+		for (int i=0;i<50;i++)
+		{
+			int index = 3*int(rnd.uniform(0,btScalar(proxies[0].size()/3-1)));
+			btDbvtVolume volume = randomVolume(rnd,30,1.5f);
+			for (int b=0;b<3;b++)
+			{
+				broadphases[b]->setAabb(proxies[b][index],volume.Mins(),volume.Maxs(),0);
+			}
+		}
+		if (step%5==4)
+		{
+			int index = 3*int(rnd.uniform(0,btScalar(proxies[0].size()/3-1)))+1;
+			btDbvtVolume volume = randomVolume(rnd,30,1.5f);
+			for (int b=0;b<3;b++)
+			{
+				broadphases[b]->destroyProxy(proxies[b][index],0);
+				proxies[b][index] = broadphases[b]->createProxy(volume.Mins(),volume.Maxs(),0,0,
+					short(btBroadphaseProxy::StaticFilter),short(btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter),0,0);
+			}
+		}
+		for (int b=0;b<3;b++)
+		{
+			broadphases[b]->calculateOverlappingPairs(0);
+		}
+		std::vector<std::pair<int,int> > expected = getPairs(plain);
+		ASSERT_GT(expected.size(),0u);
+		ASSERT_TRUE(expected==getPairs(compact)) << "step: " << step;
+		ASSERT_TRUE(expected==getPairs(quantized)) << "step: " << step;
+	}
+	ASSERT_GT(compact.m_sets[btDbvtBroadphase::FIXED_SET].m_leaves,0);
+	ASSERT_TRUE(compact.useCompactFixedSet());
+	ASSERT_TRUE(quantized.useCompactFixedSet());
+	for (int b=0;b<3;b++)
+	{
+		for (int i=0;i<proxies[b].size();i++)
+		{
+			broadphases[b]->destroyProxy(proxies[b][i],0);
+		}
+	}
+}
+
+TEST(BulletCollisionTest, DbvtParallelTopDownBuildMatchesSerialBuild)
+{
+	TaskSchedulerGuard guard(btGetThreadPoolTaskScheduler(),4);
+	for (int round=0;round<3;round++)
+	{
+		TestRandom rnd(1000+round);
+		btDbvt serial;
+		btDbvt parallel;
+		for (int i=0;i<5000;i++)
+		{
+			btDbvtVolume volume = randomVolume(rnd,50,2);
+			serial.insert(volume,(void*)(size_t)(i+1));
+			parallel.insert(volume,(void*)(size_t)(i+1));
+		}
+		//a small grain size, so the build is split into many tasks
+		int grainSize = 100 << round;
+		serial.optimizeTopDown();
+		parallel.optimizeTopDownParallel(128,grainSize);
+		compareTrees(serial.m_root,parallel.m_root);
+		ASSERT_FALSE(::testing::Test::HasFatalFailure()) << "grain size: " << grainSize;
+		ASSERT_EQ(5000,checkTree(parallel.m_root,0));
+	}
+}
+
+TEST(BulletCollisionTest, DbvtRotationsKeepTheTreeValid)
+{
+	TestRandom rnd(4321);
+	btDbvt tree;
+	btAlignedObjectArray<btDbvtNode*> leaves;
+	insertLeaves(tree,rnd,3000,leaves);
+	//move the leaves far, the incremental updates leave a loose tree behind
+	for (int i=0;i<3000;i++)
+	{
+		btDbvtVolume volume = randomVolume(rnd,50,2);
+		tree.update(leaves[i],volume);
+	}
+	ASSERT_EQ(3000,checkTree(tree.m_root,0));
+
+	btScalar initialCost = surfaceAreaCost(tree.m_root);
+	btScalar cost = initialCost;
+	for (int round=0;round<10;round++)
+	{
+		tree.optimizeRotations(1000);
+		ASSERT_EQ(3000,checkTree(tree.m_root,0)) << "round: " << round;
+		ASSERT_FALSE(::testing::Test::HasFailure()) << "round: " << round;
+		//a rotation is only done when it lowers the cost
+		btScalar newCost = surfaceAreaCost(tree.m_root);
+		ASSERT_LE(newCost,cost*(1+1e-5)) << "round: " << round;
+		cost = newCost;
+	}
+	ASSERT_LT(cost,initialCost*btScalar(0.95));
+
+	//the revision only changes while rotations still swap nodes, a round without swaps keeps it and the tree
+	int numStableRounds = 0;
+	for (int round=0;(round<200)&&(numStableRounds<5);round++)
+	{
+		unsigned revision = tree.m_revision;
+		tree.optimizeRotations(1000);
+		btScalar newCost = surfaceAreaCost(tree.m_root);
+		if (revision == tree.m_revision)
+		{
+			ASSERT_EQ(cost,newCost) << "round: " << round;
+			numStableRounds++;
+		}
+		else
+		{
+			numStableRounds = 0;
+		}
+		cost = newCost;
+	}
+	ASSERT_EQ(5,numStableRounds) << "the rotations don't settle";
+
+	//every leaf is still in the tree, and the queries still find it
+	for (int i=0;i<leaves.size();i++)
+	{
+		LeafCollector collector;
+		tree.collideTV(tree.m_root,leaves[i]->volume,collector);
+		ASSERT_TRUE(std::find(collector.m_leaves.begin(),collector.m_leaves.end(),leaves[i])!=collector.m_leaves.end()) << "leaf: " << i;
+	}
+	tree.clear();
+}
+
+///moves every fourth proxy, the dynamic ones, so they stay in the dynamic set
+static void	moveDynamicProxies(btDbvtBroadphase& broadphase, btAlignedObjectArray<btBroadphaseProxy*>& proxies, TestRandom& rnd)
+{
+	for (int i=0;i<proxies.size();i+=4)
+	{
+		btDbvtVolume volume = randomVolume(rnd,30,1.5f);
+		broadphase.setAabb(proxies[i],volume.Mins(),volume.Maxs(),0);
+	}
+}
+
+TEST(BulletCollisionTest, DbvtBroadphaseRotationsKeepASettledCompactFixedSetValid)
+{
+	TestRandom rnd(777);
+	btDbvtBroadphase broadphase;
+	broadphase.m_rupdates = 10;
+	broadphase.m_compactLayoutPeriod = 1;
+	btAlignedObjectArray<btBroadphaseProxy*> proxies;
+	for (int i=0;i<800;i++)
+	{
+		btDbvtVolume volume = randomVolume(rnd,30,1.5f);
+		bool isStatic = i%4 != 0;
+		proxies.push_back(broadphase.createProxy(volume.Mins(),volume.Maxs(),0,0,
+			isStatic ? short(btBroadphaseProxy::StaticFilter) : short(btBroadphaseProxy::DefaultFilter),
+			isStatic ? short(btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter) : short(btBroadphaseProxy::AllFilter),0,0));
+	}
+	const btDbvt& fixedSet = broadphase.m_sets[btDbvtBroadphase::FIXED_SET];
+	//run until the static proxies are staged into the fixed set and its rotations run out of swaps
+	int numStableFrames = 0;
+	unsigned revision = fixedSet.m_revision;
+	for (int frame=0;(frame<1000)&&(numStableFrames<10);frame++)
+	{
+		moveDynamicProxies(broadphase,proxies,rnd);
+		broadphase.calculateOverlappingPairs(0);
+		numStableFrames = ((fixedSet.m_leaves > 0) && (revision == fixedSet.m_revision)) ? numStableFrames+1 : 0;
+		revision = fixedSet.m_revision;
+	}
+	ASSERT_EQ(10,numStableFrames) << "the fixed set doesn't settle";
+	ASSERT_GT(fixedSet.m_leaves,500);
+
+	//the fixed set is still rotated every frame, but its revision and the compact layout stay valid
+	for (int frame=0;frame<20;frame++)
+	{
+		moveDynamicProxies(broadphase,proxies,rnd);
+		broadphase.calculateOverlappingPairs(0);
+		ASSERT_EQ(revision,fixedSet.m_revision) << "frame: " << frame;
+		ASSERT_TRUE(broadphase.useCompactFixedSet()) << "frame: " << frame;
+	}
+	for (int i=0;i<proxies.size();i++)
+	{
+		broadphase.destroyProxy(proxies[i],0);
+	}
+}
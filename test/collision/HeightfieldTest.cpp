@@ -0,0 +1,194 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///Compares the queries of btHeightfieldTerrainShape with min/max mips against the brute-force path without them:
+///the closest hit of performRaycast against a raycast of every triangle, and the triangles that processAllTriangles reports,
+///for every up axis, a non-uniform scaling and the flipped, diamond and zigzag triangulations.
+
+
+#include <gtest/gtest.h>
+
+#include "TestRandom.h"
+#include "BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h"
+#include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
+#include "LinearMath/btAabbUtil2.h"
+
+#include <vector>
+#include <algorithm>
+
+
+namespace
+{
+
+struct ClosestHitCallback : public btTriangleRaycastCallback
+{
+	int	m_numTriangles;
+	bool	m_hasHit;
+
+	ClosestHitCallback(const btVector3& from, const btVector3& to)
+		:btTriangleRaycastCallback(from,to),
+		m_numTriangles(0),
+		m_hasHit(false)
+	{
+	}
+
+	virtual void	processTriangle(btVector3* triangle, int partId, int triangleIndex)
+	{
+		m_numTriangles++;
+		btTriangleRaycastCallback::processTriangle(triangle,partId,triangleIndex);
+	}
+
+	virtual btScalar	reportHit(const btVector3& /*hitNormalLocal*/, btScalar hitFraction, int /*partId*/, int /*triangleIndex*/)
+	{
+		m_hasHit = true;
+		return hitFraction;
+	}
+};
+
+///the triangles that really overlap the box, as sorted vertex coordinates, since the two paths visit them in different orders
+struct OverlapCollector : public btTriangleCallback
+{
+	btVector3	m_aabbMin;
+	btVector3	m_aabbMax;
+	std::vector<std::vector<btScalar> >	m_triangles;
+
+	OverlapCollector(const btVector3& aabbMin, const btVector3& aabbMax)
+		:m_aabbMin(aabbMin),
+		m_aabbMax(aabbMax)
+	{
+	}
+
+	virtual void	processTriangle(btVector3* triangle, int /*partId*/, int /*triangleIndex*/)
+	{
+		btVector3 triMin = triangle[0];
+		btVector3 triMax = triangle[0];
+		triMin.setMin(triangle[1]);
+		triMax.setMax(triangle[1]);
+		triMin.setMin(triangle[2]);
+		triMax.setMax(triangle[2]);
+		if (TestAabbAgainstAabb2(triMin,triMax,m_aabbMin,m_aabbMax))
+		{
+			std::vector<btScalar> coords;
+			for (int k=0;k<3;k++)
+			{
+				coords.push_back(triangle[k][0]);
+				coords.push_back(triangle[k][1]);
+				coords.push_back(triangle[k][2]);
+			}
+			m_triangles.push_back(coords);
+		}
+	}
+
+	void	sort()
+	{
+		std::sort(m_triangles.begin(),m_triangles.end());
+	}
+};
+
+}
+
+
+TEST(BulletCollisionTest, HeightfieldMipsMatchBruteForce)
+{
+	TestRandom rnd(13579);
+	const int width = 65;
+	const int length = 49;
+	std::vector<float> heights(width*length);
+	int numRays = 0;
+	int numHits = 0;
+	long numMipTriangles = 0;
+	long numBruteForceTriangles = 0;
+	for (int config=0;config<9;config++)
+	{
+		//smooth hills with some noise and a few spikes, so there are steep and flat blocks
+		for (int j=0;j<length;j++)
+		{
+			for (int i=0;i<width;i++)
+			{
+				btScalar h = btSin(btScalar(i)*btScalar(0.2))*btCos(btScalar(j)*btScalar(0.15))*btScalar(8.)+rnd.uniform(0,1);
+				if (rnd.uniform(0,1) < btScalar(0.01))
+				{
+					h += btScalar(15.);
+				}
+				heights[j*width+i] = float(h);
+			}
+		}
+		int upAxis = config%3;
+		btHeightfieldTerrainShape bruteForce(width,length,&heights[0],1,-10,25,upAxis,PHY_FLOAT,(config%2)==0);
+		btHeightfieldTerrainShape mips(width,length,&heights[0],1,-10,25,upAxis,PHY_FLOAT,(config%2)==0);
+		if (config >= 3)
+		{
+			btVector3 scaling(btScalar(1.5),btScalar(0.75),btScalar(2.));
+			bruteForce.setLocalScaling(scaling);
+			mips.setLocalScaling(scaling);
+		}
+		if (config >= 6)
+		{
+			bool diamond = (config == 6);
+			bruteForce.setUseDiamondSubdivision(diamond);
+			bruteForce.setUseZigzagSubdivision(!diamond);
+			mips.setUseDiamondSubdivision(diamond);
+			mips.setUseZigzagSubdivision(!diamond);
+		}
+		mips.buildMinMaxMips(config < 5 ? 8 : 4);
+		ASSERT_TRUE(mips.hasMinMaxMips());
+		ASSERT_FALSE(bruteForce.hasMinMaxMips());
+
+		btTransform identity;
+		identity.setIdentity();
+		btVector3 aabbMin,aabbMax;
+		bruteForce.getAabb(identity,aabbMin,aabbMax);
+		btVector3 center = (aabbMin+aabbMax)*btScalar(0.5);
+		btVector3 extents = (aabbMax-aabbMin)*btScalar(0.5);
+
+		for (int i=0;i<1000;i++)
+		{
+			//steep rays from above, grazing rays along the terrain and rays starting below it
+			btVector3 from = center+rnd.vector(-1,1)*extents*btScalar(1.2);
+			btVector3 to = center+rnd.vector(-1,1)*extents*btScalar(1.2);
+			if (i%3 == 0)
+			{
+				from[upAxis] = aabbMax[upAxis]+btScalar(5.);
+				to[upAxis] = aabbMin[upAxis]-btScalar(5.);
+			}
+			ClosestHitCallback expected(from,to);
+			bruteForce.processAllTriangles(&expected,aabbMin-btVector3(1,1,1),aabbMax+btVector3(1,1,1));
+			ClosestHitCallback culled(from,to);
+			mips.performRaycast(&culled,from,to);
+			ASSERT_EQ(expected.m_hasHit,culled.m_hasHit) << "config: " << config << " ray: " << i;
+			ASSERT_NEAR(expected.m_hitFraction,culled.m_hitFraction,1e-5) << "config: " << config << " ray: " << i;
+			numRays++;
+			numHits += culled.m_hasHit ? 1 : 0;
+			numMipTriangles += culled.m_numTriangles;
+			numBruteForceTriangles += expected.m_numTriangles;
+		}
+
+		for (int i=0;i<200;i++)
+		{
+			btVector3 queryCenter = center+rnd.vector(-1,1)*extents;
+			btVector3 queryExtents = rnd.vector(btScalar(0.2),btScalar(4.));
+			OverlapCollector expected(queryCenter-queryExtents,queryCenter+queryExtents);
+			bruteForce.processAllTriangles(&expected,queryCenter-queryExtents,queryCenter+queryExtents);
+			OverlapCollector culled(queryCenter-queryExtents,queryCenter+queryExtents);
+			mips.processAllTriangles(&culled,queryCenter-queryExtents,queryCenter+queryExtents);
+			expected.sort();
+			culled.sort();
+			ASSERT_TRUE(expected.m_triangles == culled.m_triangles) << "config: " << config << " aabb query: " << i;
+		}
+	}
+	//the rays are not trivial, and the mips skip most of the triangles
+	ASSERT_GT(numHits,numRays/4);
+	ASSERT_LT(numMipTriangles*10,numBruteForceTriangles);
+}
@@ -0,0 +1,181 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///Compares the closest hits of btCollisionWorld::rayTestBatch with a rayTest and a ClosestRayResultCallback per ray,
+///for coherent and random rays against a triangle mesh (with the binary and the wide tree) and convex and compound shapes.
+
+
+#include <gtest/gtest.h>
+
+#include "TestRandom.h"
+#include "btBulletCollisionCommon.h"
+
+#include <vector>
+
+
+namespace
+{
+
+struct RayBatchScene
+{
+	btDefaultCollisionConfiguration	m_collisionConfiguration;
+	btCollisionDispatcher	m_dispatcher;
+	btDbvtBroadphase	m_broadphase;
+	btCollisionWorld	m_world;
+	btTriangleMesh	m_mesh;
+	btAlignedObjectArray<btCollisionShape*>	m_shapes;
+	btBvhTriangleMeshShape*	m_meshShape;
+
+	RayBatchScene(TestRandom& rnd)
+		:m_dispatcher(&m_collisionConfiguration),
+		m_world(&m_dispatcher,&m_broadphase,&m_collisionConfiguration)
+	{
+		//a bumpy ground
+		const int gridSize = 30;
+		for (int i=0;i<gridSize;i++)
+		{
+			for (int j=0;j<gridSize;j++)
+			{
+				btVector3 v[4];
+				for (int k=0;k<4;k++)
+				{
+					btScalar x = btScalar(i+(k&1))-btScalar(gridSize/2);
+					btScalar z = btScalar(j+(k>>1))-btScalar(gridSize/2);
+					v[k] = btVector3(x,btSin(x*btScalar(0.4))*btCos(z*btScalar(0.3)),z);
+				}
+				m_mesh.addTriangle(v[0],v[1],v[2]);
+				m_mesh.addTriangle(v[1],v[3],v[2]);
+			}
+		}
+		m_meshShape = new btBvhTriangleMeshShape(&m_mesh,true);
+		addObject(m_meshShape,btTransform::getIdentity());
+
+		//convex and compound shapes above it, some of them overlapping
+		m_shapes.push_back(new btBoxShape(btVector3(1,btScalar(0.5),btScalar(0.75))));
+		m_shapes.push_back(new btSphereShape(btScalar(0.8)));
+		m_shapes.push_back(new btCapsuleShape(btScalar(0.4),btScalar(1.5)));
+		m_shapes.push_back(new btCylinderShape(btVector3(btScalar(0.6),btScalar(0.8),btScalar(0.6))));
+		btCompoundShape* compound = new btCompoundShape();
+		compound->addChildShape(btTransform(btQuaternion::getIdentity(),btVector3(1,0,0)),m_shapes[0]);
+		compound->addChildShape(btTransform(btQuaternion::getIdentity(),btVector3(-1,0,0)),m_shapes[1]);
+		m_shapes.push_back(compound);
+		int numConvexShapes = m_shapes.size();
+		for (int i=0;i<60;i++)
+		{
+			btTransform tr = rnd.transform(12);
+			tr.getOrigin().setY(rnd.uniform(1,6));
+			addObject(m_shapes[i%numConvexShapes],tr);
+		}
+		m_shapes.push_back(m_meshShape);
+		m_world.updateAabbs();
+	}
+
+	~RayBatchScene()
+	{
+		for (int i=m_world.getNumCollisionObjects()-1;i>=0;i--)
+		{
+			btCollisionObject* colObj = m_world.getCollisionObjectArray()[i];
+			m_world.removeCollisionObject(colObj);
+			delete colObj;
+		}
+		for (int i=0;i<m_shapes.size();i++)
+		{
+			delete m_shapes[i];
+		}
+	}
+
+	void	addObject(btCollisionShape* shape, const btTransform& tr)
+	{
+		btCollisionObject* colObj = new btCollisionObject();
+		colObj->setCollisionShape(shape);
+		colObj->setWorldTransform(tr);
+		m_world.addCollisionObject(colObj);
+	}
+};
+
+static void	compareBatchWithSingleRays(const RayBatchScene& scene, const std::vector<btVector3>& from, const std::vector<btVector3>& to, int& numHits)
+{
+	int numRays = int(from.size());
+	std::vector<btCollisionWorld::BatchedRayResult> results(numRays);
+	scene.m_world.rayTestBatch(&from[0],&to[0],numRays,&results[0]);
+	for (int i=0;i<numRays;i++)
+	{
+		btCollisionWorld::ClosestRayResultCallback expected(from[i],to[i]);
+		scene.m_world.rayTest(from[i],to[i],expected);
+		const btCollisionWorld::BatchedRayResult& result = results[i];
+		if (!expected.hasHit())
+		{
+			ASSERT_TRUE(result.m_collisionObject == 0) << "ray: " << i;
+			continue;
+		}
+		numHits++;
+		ASSERT_NEAR(expected.m_closestHitFraction,result.m_hitFraction,1e-5) << "ray: " << i;
+		//two objects can be hit at the same distance, where they touch
+		if (expected.m_collisionObject != result.m_collisionObject)
+		{
+			ASSERT_NEAR(expected.m_closestHitFraction,result.m_hitFraction,1e-6) << "ray: " << i;
+			continue;
+		}
+		ASSERT_NEAR(0,(expected.m_hitPointWorld-result.m_hitPointWorld).length(),1e-4) << "ray: " << i;
+		ASSERT_NEAR(0,(expected.m_hitNormalWorld-result.m_hitNormalWorld).length(),1e-4) << "ray: " << i;
+	}
+}
+
+}
+
+
+TEST(BulletCollisionTest, RayTestBatchMatchesRayTest)
+{
+	TestRandom rnd(24680);
+	RayBatchScene scene(rnd);
+	int numHits = 0;
+	int numRays = 0;
+	for (int wide=0;wide<2;wide++)
+	{
+		if (wide)
+		{
+			scene.m_meshShape->buildWideBvh();
+		}
+		std::vector<btVector3> from,to;
+		//fans of coherent rays from a common origin, like camera or sensor rays, and a last packet that is not full
+		for (int fan=0;fan<20;fan++)
+		{
+			btVector3 origin = rnd.vector(-10,10);
+			origin.setY(rnd.uniform(4,12));
+			btVector3 dir = btVector3(rnd.uniform(-1,1),-1,rnd.uniform(-1,1)).normalized();
+			int numFanRays = (fan == 19) ? 13 : 64;
+			for (int i=0;i<numFanRays;i++)
+			{
+				from.push_back(origin);
+				to.push_back(origin+(dir+rnd.vector(-1,1)*btScalar(0.3))*btScalar(25.));
+			}
+		}
+		compareBatchWithSingleRays(scene,from,to,numHits);
+		numRays += int(from.size());
+
+		//incoherent rays, including ones that start inside an object and ones that miss everything
+		from.clear();
+		to.clear();
+		for (int i=0;i<500;i++)
+		{
+			from.push_back(rnd.vector(-20,20));
+			to.push_back(rnd.vector(-20,20));
+		}
+		compareBatchWithSingleRays(scene,from,to,numHits);
+		numRays += int(from.size());
+	}
+	ASSERT_GT(numHits,numRays/3);
+	ASSERT_LT(numHits,numRays);
+}
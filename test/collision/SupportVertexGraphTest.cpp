@@ -0,0 +1,117 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///Compares the hill climbing support queries of btSupportVertexGraph with a scan of all points, for random directions
+///on point clouds with interior points, coplanar points and duplicates.
+
+
+#include <gtest/gtest.h>
+
+#include "TestRandom.h"
+#include "BulletCollision/CollisionShapes/btConvexHullShape.h"
+#include "BulletCollision/CollisionShapes/btSupportVertexGraph.h"
+
+
+static btScalar	bruteForceSupport(const btAlignedObjectArray<btVector3>& points, const btVector3& dir)
+{
+	btScalar maxDot = -BT_LARGE_FLOAT;
+	for (int i=0;i<points.size();i++)
+	{
+		maxDot = btMax(maxDot,dir.dot(points[i]));
+	}
+	return maxDot;
+}
+
+static void	createPointCloud(TestRandom& rnd, int cloud, btAlignedObjectArray<btVector3>& points)
+{
+	points.resize(0);
+	for (int i=0;i<200;i++)
+	{
+		switch (cloud)
+		{
+		case 0:
+			//on a sphere, every point is a hull vertex
+			points.push_back(rnd.direction());
+			break;
+		case 1:
+			//in a box, most points are inside
+			points.push_back(rnd.vector(-1,1)*btVector3(2,1,0.5f));
+			break;
+		case 2:
+		{
+			//on a coarse grid, with many coplanar and duplicate points
+			btVector3 v = rnd.vector(-1,1);
+			points.push_back(btVector3(btScalar(int(v[0]*3)),btScalar(int(v[1]*3)),btScalar(int(v[2]*3))));
+			break;
+		}
+		default:
+			//a flat disc, the hull is degenerate
+			btVector3 v = rnd.direction();
+			points.push_back(btVector3(v[0],v[1],0));
+			break;
+		}
+	}
+}
+
+TEST(BulletCollisionTest, SupportVertexGraphMatchesBruteForce)
+{
+	TestRandom rnd(2468);
+	btAlignedObjectArray<btVector3> points;
+	int numQueries = 0;
+	for (int cloud=0;cloud<4;cloud++)
+	{
+		createPointCloud(rnd,cloud,points);
+		btConvexHullShape hull(&points[0][0],points.size(),sizeof(btVector3));
+		hull.buildSupportVertexGraph();
+		const btSupportVertexGraph& graph = hull.getSupportVertexGraph();
+		ASSERT_FALSE(graph.isEmpty()) << "cloud: " << cloud;
+		ASSERT_TRUE(hull.useSupportVertexGraph()) << "cloud: " << cloud;
+
+		int prevVertex = -1;
+		for (int i=0;i<2000;i++)
+		{
+			btVector3 dir = rnd.direction();
+			btScalar expected = bruteForceSupport(points,dir);
+
+			//from the seeds, from the previous result and from a random vertex
+			int fromSeeds = graph.findSupportVertex(hull.getUnscaledPoints(),dir,-1);
+			int fromPrev = graph.findSupportVertex(hull.getUnscaledPoints(),dir,prevVertex);
+			int fromRandom = graph.findSupportVertex(hull.getUnscaledPoints(),dir,int(rnd.uniform(0,btScalar(points.size()-1))));
+			ASSERT_NEAR(expected,dir.dot(points[fromSeeds]),1e-5) << "cloud: " << cloud << " query: " << i;
+			ASSERT_NEAR(expected,dir.dot(points[fromPrev]),1e-5) << "cloud: " << cloud << " query: " << i;
+			ASSERT_NEAR(expected,dir.dot(points[fromRandom]),1e-5) << "cloud: " << cloud << " query: " << i;
+			prevVertex = fromPrev;
+
+			//through the shape, with a non-uniform scaling
+			btVector3 support = hull.localGetSupportingVertexWithoutMargin(dir);
+			ASSERT_NEAR(expected,dir.dot(support),1e-5) << "cloud: " << cloud << " query: " << i;
+			numQueries++;
+		}
+
+		hull.setLocalScaling(btVector3(1.5f,0.5f,2));
+		btAlignedObjectArray<btVector3> scaledPoints;
+		for (int i=0;i<points.size();i++)
+		{
+			scaledPoints.push_back(points[i]*hull.getLocalScaling());
+		}
+		for (int i=0;i<500;i++)
+		{
+			btVector3 dir = rnd.direction();
+			btVector3 support = hull.localGetSupportingVertexWithoutMargin(dir);
+			ASSERT_NEAR(bruteForceSupport(scaledPoints,dir),dir.dot(support),1e-5) << "cloud: " << cloud << " scaled query: " << i;
+		}
+	}
+	ASSERT_EQ(8000,numQueries);
+}
@@ -0,0 +1,69 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_TEST_RANDOM_H
+#define BT_TEST_RANDOM_H
+
+#include "LinearMath/btTransform.h"
+
+///small deterministic generator for the randomized tests, so failures can be reproduced on every platform
+struct TestRandom
+{
+	unsigned int m_state;
+
+	TestRandom(unsigned int seed)
+		:m_state(seed)
+	{
+	}
+
+	btScalar	uniform(btScalar lo, btScalar hi)
+	{
+		m_state = m_state*1664525u+1013904223u;
+		return lo+(hi-lo)*btScalar(m_state>>8)/btScalar(1<<24);
+	}
+
+	btVector3	vector(btScalar lo, btScalar hi)
+	{
+		btScalar x = uniform(lo,hi);
+		btScalar y = uniform(lo,hi);
+		btScalar z = uniform(lo,hi);
+		return btVector3(x,y,z);
+	}
+
+	btVector3	direction()
+	{
+		for (;;)
+		{
+			btVector3 v = vector(-1,1);
+			btScalar l2 = v.length2();
+			if (l2 > btScalar(1e-4) && l2 <= btScalar(1.))
+			{
+				return v/btSqrt(l2);
+			}
+		}
+	}
+
+	btQuaternion	rotation()
+	{
+		return btQuaternion(direction(),uniform(0,SIMD_2_PI));
+	}
+
+	btTransform	transform(btScalar range)
+	{
+		return btTransform(rotation(),vector(-range,range));
+	}
+};
+
+#endif //BT_TEST_RANDOM_H
@@ -0,0 +1,384 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///Checks the triangles that the midphase trees of btBvhTriangleMeshShape report for aabb and ray queries:
+///btWideBvh against the btQuantizedBvh it was built from, which differ only by quantization, and both against a scan of all triangles.
+///The wide tree is also checked after partial refits, which must not need a rebuild.
+///A tree built with the binned SAH split must report exactly the triangles of the median split tree.
+
+
+#include <gtest/gtest.h>
+
+#include "TestRandom.h"
+#include "BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h"
+#include "BulletCollision/CollisionShapes/btTriangleIndexVertexArray.h"
+#include "BulletCollision/BroadphaseCollision/btWideBvh.h"
+#include "LinearMath/btAabbUtil2.h"
+
+#include <vector>
+#include <algorithm>
+#include <iterator>
+
+
+namespace
+{
+
+///a bumpy grid with triangles scattered above it
+struct TestMesh
+{
+	btAlignedObjectArray<btScalar>	m_vertices;
+	btAlignedObjectArray<int>	m_indices;
+	btTriangleIndexVertexArray*	m_meshInterface;
+
+	TestMesh(TestRandom& rnd, int gridSize, int numScattered)
+	{
+		for (int i=0;i<=gridSize;i++)
+		{
+			for (int j=0;j<=gridSize;j++)
+			{
+				btScalar x = btScalar(i)-btScalar(gridSize)*btScalar(0.5);
+				btScalar z = btScalar(j)-btScalar(gridSize)*btScalar(0.5);
+				addVertex(btVector3(x,btSin(x*btScalar(0.3))*btCos(z*btScalar(0.2))*btScalar(3.)+rnd.uniform(0,btScalar(0.5)),z));
+			}
+		}
+		for (int i=0;i<gridSize;i++)
+		{
+			for (int j=0;j<gridSize;j++)
+			{
+				int v = i*(gridSize+1)+j;
+				addTriangle(v,v+1,v+gridSize+1);
+				addTriangle(v+1,v+gridSize+2,v+gridSize+1);
+			}
+		}
+		btScalar range = btScalar(gridSize)*btScalar(0.5);
+		for (int i=0;i<numScattered;i++)
+		{
+			btVector3 center = rnd.vector(-range,range);
+			center.setY(rnd.uniform(0,10));
+			int v = m_vertices.size()/3;
+			for (int k=0;k<3;k++)
+			{
+				addVertex(center+rnd.vector(-1,1));
+			}
+			addTriangle(v,v+1,v+2);
+		}
+		m_meshInterface = new btTriangleIndexVertexArray(m_indices.size()/3,&m_indices[0],3*sizeof(int),m_vertices.size()/3,&m_vertices[0],3*sizeof(btScalar));
+	}
+
+	~TestMesh()
+	{
+		delete m_meshInterface;
+	}
+
+	void	addVertex(const btVector3& v)
+	{
+		m_vertices.push_back(v[0]);
+		m_vertices.push_back(v[1]);
+		m_vertices.push_back(v[2]);
+	}
+
+	void	addTriangle(int a, int b, int c)
+	{
+		m_indices.push_back(a);
+		m_indices.push_back(b);
+		m_indices.push_back(c);
+	}
+
+	int	getNumTriangles() const
+	{
+		return m_indices.size()/3;
+	}
+
+	btVector3	getVertex(int triangleIndex, int k) const
+	{
+		int v = m_indices[triangleIndex*3+k];
+		return btVector3(m_vertices[v*3],m_vertices[v*3+1],m_vertices[v*3+2]);
+	}
+
+	void	getTriangleAabb(int triangleIndex, btVector3& aabbMin, btVector3& aabbMax) const
+	{
+		aabbMin = aabbMax = getVertex(triangleIndex,0);
+		for (int k=1;k<3;k++)
+		{
+			aabbMin.setMin(getVertex(triangleIndex,k));
+			aabbMax.setMax(getVertex(triangleIndex,k));
+		}
+	}
+
+	///true if the segment clearly crosses the inside of the triangle, away from its edges and the segment ends
+	bool	rayHitsTriangle(int triangleIndex, const btVector3& from, const btVector3& to) const
+	{
+		const btScalar eps = btScalar(1e-3);
+		btVector3 v0 = getVertex(triangleIndex,0);
+		btVector3 e1 = getVertex(triangleIndex,1)-v0;
+		btVector3 e2 = getVertex(triangleIndex,2)-v0;
+		btVector3 dir = to-from;
+		btVector3 p = dir.cross(e2);
+		btScalar det = e1.dot(p);
+		if (btFabs(det) < btScalar(1e-9))
+		{
+			return false;
+		}
+		btScalar invDet = btScalar(1.)/det;
+		btVector3 s = from-v0;
+		btScalar u = s.dot(p)*invDet;
+		btVector3 q = s.cross(e1);
+		btScalar v = dir.dot(q)*invDet;
+		btScalar t = e2.dot(q)*invDet;
+		return u > eps && v > eps && u+v < 1-eps && t > eps && t < 1-eps;
+	}
+
+	void	bruteForceAabb(const btVector3& aabbMin, const btVector3& aabbMax, std::vector<int>& triangles) const
+	{
+		triangles.clear();
+		for (int i=0;i<getNumTriangles();i++)
+		{
+			btVector3 triMin,triMax;
+			getTriangleAabb(i,triMin,triMax);
+			if (TestAabbAgainstAabb2(triMin,triMax,aabbMin,aabbMax))
+			{
+				triangles.push_back(i);
+			}
+		}
+	}
+
+	void	bruteForceRay(const btVector3& from, const btVector3& to, std::vector<int>& triangles) const
+	{
+		triangles.clear();
+		for (int i=0;i<getNumTriangles();i++)
+		{
+			if (rayHitsTriangle(i,from,to))
+			{
+				triangles.push_back(i);
+			}
+		}
+	}
+};
+
+struct TriangleCollector : btNodeOverlapCallback
+{
+	std::vector<int>	m_triangles;
+
+	virtual void	processNode(int subPart, int triangleIndex)
+	{
+		EXPECT_EQ(0,subPart);
+		m_triangles.push_back(triangleIndex);
+	}
+
+	///sorted, the trees report the triangles in different orders
+	const std::vector<int>&	getTriangles()
+	{
+		std::sort(m_triangles.begin(),m_triangles.end());
+		return m_triangles;
+	}
+};
+
+///every triangle of expected (sorted) is in found (sorted)
+static bool	containsAll(const std::vector<int>& found, const std::vector<int>& expected)
+{
+	return std::includes(found.begin(),found.end(),expected.begin(),expected.end());
+}
+
+static void	randomAabb(TestRandom& rnd, btScalar range, btVector3& aabbMin, btVector3& aabbMax)
+{
+	btVector3 center = rnd.vector(-range,range);
+	center.setY(rnd.uniform(-2,10));
+	btVector3 extents = rnd.vector(btScalar(0.1),btScalar(4.));
+	aabbMin = center-extents;
+	aabbMax = center+extents;
+}
+
+static void	randomRay(TestRandom& rnd, btScalar range, btVector3& from, btVector3& to)
+{
+	from = rnd.vector(-range,range);
+	from.setY(rnd.uniform(5,20));
+	to = rnd.vector(-range,range);
+	to.setY(rnd.uniform(-10,5));
+}
+
+///the wide tree reports the same triangles as the binary tree, up to quantization, and neither misses one of the brute-force scan
+static void	compareQueries(const TestMesh& mesh, const btQuantizedBvh& bvh, const btWideBvh& wideBvh, TestRandom& rnd, btScalar range, bool compareWithBinaryTree)
+{
+	std::vector<int> expected;
+	for (int i=0;i<300;i++)
+	{
+		btVector3 aabbMin,aabbMax;
+		randomAabb(rnd,range,aabbMin,aabbMax);
+		TriangleCollector binary,wide;
+		bvh.reportAabbOverlappingNodex(&binary,aabbMin,aabbMax);
+		wideBvh.reportAabbOverlappingNodex(&wide,aabbMin,aabbMax);
+		mesh.bruteForceAabb(aabbMin,aabbMax,expected);
+		ASSERT_TRUE(containsAll(wide.getTriangles(),expected)) << "aabb query: " << i;
+		if (compareWithBinaryTree)
+		{
+			ASSERT_TRUE(containsAll(binary.getTriangles(),expected)) << "aabb query: " << i;
+			//the trees quantize differently, so they only differ on triangles that nearly touch the box
+			std::vector<int> difference;
+			std::set_symmetric_difference(binary.m_triangles.begin(),binary.m_triangles.end(),wide.m_triangles.begin(),wide.m_triangles.end(),std::back_inserter(difference));
+			btVector3 tolerance(btScalar(0.01),btScalar(0.01),btScalar(0.01));
+			mesh.bruteForceAabb(aabbMin-tolerance,aabbMax+tolerance,expected);
+			ASSERT_TRUE(containsAll(expected,difference)) << "aabb query: " << i;
+		}
+	}
+	for (int i=0;i<300;i++)
+	{
+		btVector3 from,to;
+		randomRay(rnd,range,from,to);
+		TriangleCollector binary,wide;
+		bvh.reportRayOverlappingNodex(&binary,from,to);
+		wideBvh.reportRayOverlappingNodex(&wide,from,to);
+		mesh.bruteForceRay(from,to,expected);
+		ASSERT_TRUE(containsAll(wide.getTriangles(),expected)) << "ray query: " << i;
+		if (compareWithBinaryTree)
+		{
+			ASSERT_TRUE(containsAll(binary.getTriangles(),expected)) << "ray query: " << i;
+		}
+	}
+}
+
+}
+
+
+TEST(BulletCollisionTest, WideBvhMatchesQuantizedBvh)
+{
+	TestRandom rnd(97531);
+	TestMesh mesh(rnd,40,600);
+	btBvhTriangleMeshShape shape(mesh.m_meshInterface,true);
+	shape.buildWideBvh();
+	ASSERT_TRUE(shape.getWideBvh() != 0);
+	ASSERT_GT(shape.getWideBvh()->getNumNodes(),0);
+	compareQueries(mesh,*shape.getOptimizedBvh(),*shape.getWideBvh(),rnd,20,true);
+
+	//move the grid vertices of a patch, up and down, and refit only that part of the trees
+	btVector3 patchMin(-6,-10,-4);
+	btVector3 patchMax(3,15,5);
+	for (int round=0;round<4;round++)
+	{
+		btVector3 refitMin(BT_LARGE_FLOAT,BT_LARGE_FLOAT,BT_LARGE_FLOAT);
+		btVector3 refitMax(-BT_LARGE_FLOAT,-BT_LARGE_FLOAT,-BT_LARGE_FLOAT);
+		for (int i=0;i<mesh.getNumTriangles();i++)
+		{
+			btVector3 triMin,triMax;
+			mesh.getTriangleAabb(i,triMin,triMax);
+			if (TestAabbAgainstAabb2(triMin,triMax,patchMin,patchMax))
+			{
+				refitMin.setMin(triMin);
+				refitMax.setMax(triMax);
+			}
+		}
+		btScalar lift = (round & 1) ? btScalar(-0.8) : btScalar(1.5);
+		for (int v=0;v<mesh.m_vertices.size()/3;v++)
+		{
+			btVector3 p(mesh.m_vertices[v*3],mesh.m_vertices[v*3+1],mesh.m_vertices[v*3+2]);
+			if (p[0] > patchMin[0] && p[0] < patchMax[0] && p[2] > patchMin[2] && p[2] < patchMax[2] && p[1] < btScalar(5.))
+			{
+				mesh.m_vertices[v*3+1] += lift*rnd.uniform(btScalar(0.5),btScalar(1.));
+				refitMin.setMin(btVector3(p[0],mesh.m_vertices[v*3+1],p[2]));
+				refitMax.setMax(btVector3(p[0],mesh.m_vertices[v*3+1],p[2]));
+			}
+		}
+		shape.partialRefitTree(refitMin,refitMax);
+		//nothing left the quantization range, so the wide tree was refit in place (refitting again changes nothing)
+		ASSERT_TRUE(shape.getWideBvh()->refitPartial(*shape.getOptimizedBvh(),refitMin,refitMax)) << "round: " << round;
+		compareQueries(mesh,*shape.getOptimizedBvh(),*shape.getWideBvh(),rnd,20,false);
+	}
+}
+
+static void	reportQuery(const btQuantizedBvh& bvh, int queryType, const btVector3& a, const btVector3& b, const btVector3& castExtents, TriangleCollector& collector)
+{
+	switch (queryType)
+	{
+	case 0:
+		bvh.reportAabbOverlappingNodex(&collector,a,b);
+		break;
+	case 1:
+		bvh.reportRayOverlappingNodex(&collector,a,b);
+		break;
+	default:
+		bvh.reportBoxCastOverlappingNodex(&collector,a,b,-castExtents,castExtents);
+		break;
+	}
+}
+
+TEST(BulletCollisionTest, SahBvhReportsTheSameTrianglesAsMedianSplitBvh)
+{
+	TestRandom rnd(86420);
+	TestMesh mesh(rnd,40,600);
+	const int savedBinCount = gQuantizedBvhSahBinCount;
+	for (int quantized=0;quantized<2;quantized++)
+	{
+		gQuantizedBvhSahBinCount = 0;
+		btBvhTriangleMeshShape medianShape(mesh.m_meshInterface,quantized!=0);
+		gQuantizedBvhSahBinCount = 16;
+		btBvhTriangleMeshShape sahShape(mesh.m_meshInterface,quantized!=0);
+		gQuantizedBvhSahBinCount = savedBinCount;
+		const btQuantizedBvh& median = *medianShape.getOptimizedBvh();
+		const btQuantizedBvh& sah = *sahShape.getOptimizedBvh();
+
+		//the same leaves, in a different tree
+		ASSERT_EQ(median.getNumNodes(),sah.getNumNodes());
+		std::vector<int> medianLeaves,sahLeaves;
+		for (int i=0;i<median.getNumNodes();i++)
+		{
+			int partId,triangleIndex;
+			if (median.isLeafNode(i))
+			{
+				median.getLeafNodeTriangle(i,partId,triangleIndex);
+				medianLeaves.push_back(triangleIndex);
+			}
+			if (sah.isLeafNode(i))
+			{
+				sah.getLeafNodeTriangle(i,partId,triangleIndex);
+				sahLeaves.push_back(triangleIndex);
+			}
+		}
+		ASSERT_EQ(mesh.getNumTriangles(),int(sahLeaves.size()));
+		ASSERT_TRUE(medianLeaves != sahLeaves) << "quantized: " << quantized;
+		std::sort(medianLeaves.begin(),medianLeaves.end());
+		std::sort(sahLeaves.begin(),sahLeaves.end());
+		ASSERT_EQ(medianLeaves,sahLeaves) << "quantized: " << quantized;
+
+		//the leaf boxes are the same, so every query reports exactly the same triangles
+		std::vector<int> expected;
+		for (int i=0;i<900;i++)
+		{
+			int queryType = i%3;
+			btVector3 a,b;
+			if (queryType == 0)
+			{
+				randomAabb(rnd,20,a,b);
+			}
+			else
+			{
+				randomRay(rnd,20,a,b);
+			}
+			btVector3 castExtents = rnd.vector(btScalar(0.1),btScalar(1.));
+			TriangleCollector medianTriangles,sahTriangles;
+			reportQuery(median,queryType,a,b,castExtents,medianTriangles);
+			reportQuery(sah,queryType,a,b,castExtents,sahTriangles);
+			ASSERT_EQ(medianTriangles.getTriangles(),sahTriangles.getTriangles()) << "quantized: " << quantized << " query: " << i;
+			if (queryType == 0)
+			{
+				mesh.bruteForceAabb(a,b,expected);
+				ASSERT_TRUE(containsAll(sahTriangles.getTriangles(),expected)) << "quantized: " << quantized << " query: " << i;
+			}
+			else if (queryType == 1)
+			{
+				mesh.bruteForceRay(a,b,expected);
+				ASSERT_TRUE(containsAll(sahTriangles.getTriangles(),expected)) << "quantized: " << quantized << " query: " << i;
+			}
+		}
+	}
+}
@@ -21,23 +21,11 @@
 		defines {"_VARIADIC_MAX=10"}
 	end
 	
-	links {"LinearMath", "gtest"}
+	links {"BulletCollision", "LinearMath", "gtest"}
 	
 	files {
 		"**.cpp",
 		"**.h",
-		"../../src/BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.cpp",
-		"../../src/BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h",
-
--- the *Shape.* files are not strictly necessary if you provide your own 'support' function
-		"../../src/BulletCollision/CollisionShapes/btSphereShape.cpp",
-		"../../src/BulletCollision/CollisionShapes/btMultiSphereShape.cpp",
-		"../../src/BulletCollision/CollisionShapes/btPolyhedralConvexShape.cpp",
-		"../../src/BulletCollision/CollisionShapes/btConvexShape.cpp",
-		"../../src/BulletCollision/CollisionShapes/btConvexInternalShape.cpp",
-		"../../src/BulletCollision/CollisionShapes/btCollisionShape.cpp",
-		"../../src/BulletCollision/CollisionShapes/btConvexPolyhedron.cpp",
-
 	}
 
 	if os.is("Linux") then
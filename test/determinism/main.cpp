@@ -0,0 +1,429 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///Runs the same scene with the multi-threaded world, dispatcher and solver pool for several thread counts,
+///with btDispatcherInfo::m_deterministicOrder set, and checks that a hash of the world state is identical after every step.
+///Also checks that bodies clamped by CCD end up where btDiscreteDynamicsWorld puts them.
+///Needs the libraries and this test built with BT_THREADSAFE=1 and a parallel task scheduler (thread pool or OpenMP),
+///with the sequential scheduler it would compare a single threaded run with itself.
+
+
+#include <gtest/gtest.h>
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletDynamics/Dynamics/btSimulationIslandManagerMt.h"
+#include "LinearMath/btThreads.h"
+
+#include <vector>
+
+#if !BT_THREADSAFE
+#error "the determinism test needs BT_THREADSAFE=1, see BULLET2_MULTITHREADING"
+#endif
+
+
+extern int gNumClampedCcdMotions;
+
+typedef unsigned long long HashValue;
+
+static void	hashBytes(HashValue& hash, const void* data, int numBytes)
+{
+	//FNV-1a
+	const unsigned char* bytes = (const unsigned char*) data;
+	for (int i=0;i<numBytes;i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+}
+
+static void	hashVector(HashValue& hash, const btVector3& v)
+{
+	//the 4th component is padding
+	hashBytes(hash,&v[0],3*sizeof(btScalar));
+}
+
+static HashValue	hashWorld(const btDynamicsWorld* world)
+{
+	HashValue hash = 14695981039346656037ULL;
+	const btCollisionObjectArray& objects = world->getCollisionObjectArray();
+	for (int i=0;i<objects.size();i++)
+	{
+		const btCollisionObject* colObj = objects[i];
+		const btTransform& tr = colObj->getWorldTransform();
+		hashVector(hash,tr.getOrigin());
+		for (int j=0;j<3;j++)
+		{
+			hashVector(hash,tr.getBasis()[j]);
+		}
+		if (const btRigidBody* body = btRigidBody::upcast(colObj))
+		{
+			hashVector(hash,body->getLinearVelocity());
+			hashVector(hash,body->getAngularVelocity());
+		}
+	}
+	return hash;
+}
+
+
+struct DeterminismScene
+{
+	btDefaultCollisionConfiguration	m_collisionConfiguration;
+	btCollisionDispatcherMt*	m_dispatcher;
+	btDbvtBroadphase*	m_broadphase;
+	btConstraintSolverPoolMt*	m_solverPool;
+	btDiscreteDynamicsWorldMt*	m_world;
+	btAlignedObjectArray<btCollisionShape*>	m_shapes;
+
+	DeterminismScene(int numThreads, int solverMode)
+	{
+		m_dispatcher = new btCollisionDispatcherMt(&m_collisionConfiguration);
+		m_broadphase = new btDbvtBroadphase();
+		m_solverPool = new btConstraintSolverPoolMt(numThreads);
+		m_world = new btDiscreteDynamicsWorldMt(m_dispatcher,m_broadphase,m_solverPool,&m_collisionConfiguration);
+		m_world->getDispatchInfo().m_deterministicOrder = true;
+		m_world->getSolverInfo().m_solverMode |= solverMode;
+		//don't merge the islands, so they are solved on different threads
+		static_cast<btSimulationIslandManagerMt*>(m_world->getSimulationIslandManager())->setMinimumSolverBatchSize(1);
+		m_world->setGravity(btVector3(0,-10,0));
+		createObjects();
+	}
+
+	~DeterminismScene()
+	{
+		for (int i=m_world->getNumConstraints()-1;i>=0;i--)
+		{
+			btTypedConstraint* constraint = m_world->getConstraint(i);
+			m_world->removeConstraint(constraint);
+			delete constraint;
+		}
+		for (int i=m_world->getNumCollisionObjects()-1;i>=0;i--)
+		{
+			btCollisionObject* colObj = m_world->getCollisionObjectArray()[i];
+			btRigidBody* body = btRigidBody::upcast(colObj);
+			if (body && body->getMotionState())
+			{
+				delete body->getMotionState();
+			}
+			m_world->removeCollisionObject(colObj);
+			delete colObj;
+		}
+		for (int i=0;i<m_shapes.size();i++)
+		{
+			delete m_shapes[i];
+		}
+		delete m_world;
+		delete m_solverPool;
+		delete m_broadphase;
+		delete m_dispatcher;
+	}
+
+	btRigidBody*	createBody(btScalar mass, const btVector3& origin, btCollisionShape* shape)
+	{
+		btVector3 localInertia(0,0,0);
+		if (mass != btScalar(0))
+		{
+			shape->calculateLocalInertia(mass,localInertia);
+		}
+		btTransform tr;
+		tr.setIdentity();
+		tr.setOrigin(origin);
+		btRigidBody::btRigidBodyConstructionInfo info(mass,new btDefaultMotionState(tr),shape,localInertia);
+		btRigidBody* body = new btRigidBody(info);
+		m_world->addRigidBody(body);
+		return body;
+	}
+
+	void	createObjects()
+	{
+		btCollisionShape* groundShape = new btBoxShape(btVector3(60,1,60));
+		m_shapes.push_back(groundShape);
+		createBody(0,btVector3(0,-1,0),groundShape);
+
+		btCollisionShape* boxShape = new btBoxShape(btVector3(0.5f,0.5f,0.5f));
+		btCollisionShape* sphereShape = new btSphereShape(0.5f);
+		btCollisionShape* capsuleShape = new btCapsuleShape(0.3f,0.6f);
+		btConvexHullShape* hullShape = new btConvexHullShape();
+		for (int i=0;i<8;i++)
+		{
+			hullShape->addPoint(btVector3((i&1)?0.5f:-0.5f,(i&2)?0.4f:-0.4f,(i&4)?0.3f:-0.6f));
+		}
+		btCompoundShape* compoundShape = new btCompoundShape();
+		btTransform childTr;
+		childTr.setIdentity();
+		childTr.setOrigin(btVector3(-0.3f,0,0));
+		compoundShape->addChildShape(childTr,boxShape);
+		childTr.setOrigin(btVector3(0.3f,0.2f,0));
+		compoundShape->addChildShape(childTr,sphereShape);
+		m_shapes.push_back(boxShape);
+		m_shapes.push_back(sphereShape);
+		m_shapes.push_back(capsuleShape);
+		m_shapes.push_back(hullShape);
+		m_shapes.push_back(compoundShape);
+		btCollisionShape* shapes[] = { boxShape, sphereShape, capsuleShape, hullShape, compoundShape };
+
+		//separate stacks (many islands) next to one wide pile (one large island)
+		int shapeIndex = 0;
+		for (int x=0;x<6;x++)
+		{
+			for (int z=0;z<6;z++)
+			{
+				for (int y=0;y<5;y++)
+				{
+					btVector3 origin(x*3.0f-8.0f,0.55f+y*1.05f,z*3.0f-8.0f);
+					createBody(1,origin,shapes[shapeIndex++ % 5]);
+				}
+			}
+		}
+		for (int x=0;x<10;x++)
+		{
+			for (int z=0;z<10;z++)
+			{
+				for (int y=0;y<3;y++)
+				{
+					btVector3 origin(x*1.0f+12.0f,0.55f+y*1.05f,z*1.0f+12.0f+0.1f*y);
+					createBody(1,origin,shapes[shapeIndex++ % 5]);
+				}
+			}
+		}
+
+		//a swinging chain
+		btRigidBody* prevBody = 0;
+		for (int i=0;i<8;i++)
+		{
+			btRigidBody* body = createBody(i==0 ? 0 : 1,btVector3(-20.0f+i*1.1f,12,0),boxShape);
+			if (prevBody)
+			{
+				btTypedConstraint* p2p = new btPoint2PointConstraint(*prevBody,*body,btVector3(0.55f,0,0),btVector3(-0.55f,0,0));
+				m_world->addConstraint(p2p,true);
+			}
+			prevBody = body;
+		}
+	}
+};
+
+
+static btITaskScheduler*	getTaskScheduler()
+{
+	//only a parallel scheduler, never fall back to the sequential one
+	btITaskScheduler* scheduler = btGetThreadPoolTaskScheduler();
+	if (!scheduler)
+	{
+		scheduler = btGetOpenMPTaskScheduler();
+	}
+	return scheduler;
+}
+
+static std::vector<HashValue>	runScene(int numThreads, int solverMode, int numSteps)
+{
+	btITaskScheduler* scheduler = getTaskScheduler();
+	scheduler->setNumThreads(numThreads);
+	btSetTaskScheduler(scheduler);
+	EXPECT_EQ(numThreads,btGetTaskScheduler()->getNumThreads());
+
+	std::vector<HashValue> hashes;
+	DeterminismScene scene(numThreads,solverMode);
+	for (int i=0;i<numSteps;i++)
+	{
+		scene.m_world->stepSimulation(btScalar(1.)/btScalar(60.),0);
+		hashes.push_back(hashWorld(scene.m_world));
+	}
+	return hashes;
+}
+
+static void	checkThreadCounts(int solverMode)
+{
+	const int numSteps = 200;
+	ASSERT_TRUE(getTaskScheduler() != NULL) << "no parallel task scheduler available";
+	//the thread pool runs more threads than cores, so the thread counts below are used even on a single core
+	int maxThreads = getTaskScheduler()->getMaxNumThreads();
+	int threadCounts[] = { 1, 2, 4, maxThreads > 4 ? maxThreads : 8 };
+
+	std::vector<HashValue> reference = runScene(threadCounts[0],solverMode,numSteps);
+	for (int i=1;i<4;i++)
+	{
+		std::vector<HashValue> hashes = runScene(threadCounts[i],solverMode,numSteps);
+		for (int step=0;step<numSteps;step++)
+		{
+			ASSERT_EQ(reference[step],hashes[step]) << "threads: " << threadCounts[i] << " step: " << step;
+		}
+	}
+}
+
+
+TEST(BulletDynamicsTest, HasParallelTaskScheduler)
+{
+	btITaskScheduler* scheduler = getTaskScheduler();
+	ASSERT_TRUE(scheduler != NULL) << "neither the thread pool nor the OpenMP task scheduler is available";
+	ASSERT_NE(btGetSequentialTaskScheduler(),scheduler);
+	scheduler->setNumThreads(4);
+	ASSERT_EQ(4,scheduler->getNumThreads());
+}
+
+TEST(BulletDynamicsTest, DeterministicForAnyThreadCount)
+{
+	checkThreadCounts(0);
+}
+
+TEST(BulletDynamicsTest, DeterministicWithRandomizedOrder)
+{
+	checkThreadCounts(SOLVER_RANDMIZE_ORDER);
+}
+
+TEST(BulletDynamicsTest, DeterministicWithParallelBatches)
+{
+	checkThreadCounts(SOLVER_PARALLEL_BATCHES);
+}
+
+TEST(BulletDynamicsTest, DeterministicWithContactRowBlocks)
+{
+	checkThreadCounts(SOLVER_PARALLEL_BATCHES | SOLVER_CONTACT_ROW_BLOCKS);
+}
+
+
+///fast spheres with CCD shot through rows of slow boxes and into a wall, every sphere is preceded and followed by boxes
+///in the body order, so its sweep depends on which of the boxes already moved
+struct CcdScene
+{
+	btDefaultCollisionConfiguration	m_collisionConfiguration;
+	btCollisionDispatcher*	m_dispatcher;
+	btDbvtBroadphase*	m_broadphase;
+	btConstraintSolver*	m_solver;
+	btConstraintSolverPoolMt*	m_solverPool;
+	btDiscreteDynamicsWorld*	m_world;
+	btBoxShape	m_wallShape;
+	btBoxShape	m_boxShape;
+	btSphereShape	m_sphereShape;
+
+	CcdScene(bool multiThreaded)
+		:m_solver(0),
+		m_solverPool(0),
+		m_wallShape(btVector3(1,10,40)),
+		m_boxShape(btVector3(0.5f,0.5f,0.5f)),
+		m_sphereShape(0.1f)
+	{
+		if (multiThreaded)
+		{
+			m_dispatcher = new btCollisionDispatcherMt(&m_collisionConfiguration);
+			m_broadphase = new btDbvtBroadphase();
+			m_solverPool = new btConstraintSolverPoolMt(BT_MAX_THREAD_COUNT);
+			m_world = new btDiscreteDynamicsWorldMt(m_dispatcher,m_broadphase,m_solverPool,&m_collisionConfiguration);
+		}
+		else
+		{
+			m_dispatcher = new btCollisionDispatcher(&m_collisionConfiguration);
+			m_broadphase = new btDbvtBroadphase();
+			m_solver = new btSequentialImpulseConstraintSolver();
+			m_world = new btDiscreteDynamicsWorld(m_dispatcher,m_broadphase,m_solver,&m_collisionConfiguration);
+		}
+		m_world->setGravity(btVector3(0,0,0));
+
+		createBody(0,btVector3(20,0,0),&m_wallShape);
+		for (int z=0;z<60;z++)
+		{
+			for (int x=0;x<3;x++)
+			{
+				btRigidBody* box = createBody(1,btVector3(x*4.0f,0,z*1.2f-36.0f),&m_boxShape);
+				box->setLinearVelocity(btVector3(0,0,(z&1) ? 1.0f : -1.0f));
+			}
+			btRigidBody* sphere = createBody(1,btVector3(-10,0,z*1.2f-36.0f),&m_sphereShape);
+			sphere->setLinearVelocity(btVector3(200.0f+z,0,0));
+			sphere->setCcdMotionThreshold(0.1f);
+			sphere->setCcdSweptSphereRadius(0.1f);
+			for (int x=0;x<3;x++)
+			{
+				btRigidBody* box = createBody(1,btVector3(x*4.0f+2.0f,0,z*1.2f-36.0f),&m_boxShape);
+				box->setLinearVelocity(btVector3(0,(z&1) ? 1.0f : -1.0f,0));
+			}
+		}
+	}
+
+	~CcdScene()
+	{
+		for (int i=m_world->getNumCollisionObjects()-1;i>=0;i--)
+		{
+			btCollisionObject* colObj = m_world->getCollisionObjectArray()[i];
+			m_world->removeCollisionObject(colObj);
+			delete colObj;
+		}
+		delete m_world;
+		delete m_solver;
+		delete m_solverPool;
+		delete m_broadphase;
+		delete m_dispatcher;
+	}
+
+	btRigidBody*	createBody(btScalar mass, const btVector3& origin, btCollisionShape* shape)
+	{
+		btVector3 localInertia(0,0,0);
+		if (mass != btScalar(0))
+		{
+			shape->calculateLocalInertia(mass,localInertia);
+		}
+		btTransform tr;
+		tr.setIdentity();
+		tr.setOrigin(origin);
+		btRigidBody::btRigidBodyConstructionInfo info(mass,0,shape,localInertia);
+		info.m_startWorldTransform = tr;
+		btRigidBody* body = new btRigidBody(info);
+		body->setActivationState(DISABLE_DEACTIVATION);
+		m_world->addRigidBody(body);
+		return body;
+	}
+};
+
+TEST(BulletDynamicsTest, CcdClampingMatchesSerialWorld)
+{
+	btITaskScheduler* scheduler = getTaskScheduler();
+	ASSERT_TRUE(scheduler != NULL) << "no parallel task scheduler available";
+	scheduler->setNumThreads(4);
+	btSetTaskScheduler(scheduler);
+
+	CcdScene serial(false);
+	CcdScene parallel(true);
+	const int numSteps = 30;
+	int numClamped = 0;
+	for (int step=0;step<numSteps;step++)
+	{
+		gNumClampedCcdMotions = 0;
+		serial.m_world->stepSimulation(btScalar(1.)/btScalar(60.),0);
+		int numSerialClamped = gNumClampedCcdMotions;
+		gNumClampedCcdMotions = 0;
+		parallel.m_world->stepSimulation(btScalar(1.)/btScalar(60.),0);
+		ASSERT_EQ(numSerialClamped,gNumClampedCcdMotions) << "step: " << step;
+		numClamped += numSerialClamped;
+
+		const btCollisionObjectArray& a = serial.m_world->getCollisionObjectArray();
+		const btCollisionObjectArray& b = parallel.m_world->getCollisionObjectArray();
+		ASSERT_EQ(a.size(),b.size());
+		for (int i=0;i<a.size();i++)
+		{
+			btVector3 delta = a[i]->getWorldTransform().getOrigin()-b[i]->getWorldTransform().getOrigin();
+			ASSERT_NEAR(0,delta.length(),1e-4) << "step: " << step << " body: " << i;
+		}
+	}
+	//the scene is only useful if the spheres actually get clamped
+	ASSERT_GT(numClamped,60);
+}
+
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	int result = RUN_ALL_TESTS();
+	btSetTaskScheduler(0);
+	return result;
+}
@@ -0,0 +1,200 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///Solves random contact rows with btSolverContactBlock::solveLowerLimit and, lane by lane,
+///with btSequentialImpulseConstraintSolver::resolveSingleConstraintRowLowerLimit, and compares the results.
+
+
+#include <gtest/gtest.h>
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletDynamics/ConstraintSolver/btSolverContactBlock.h"
+#include "../collision/TestRandom.h"
+
+
+namespace
+{
+
+///gives the test access to the scalar reference row solver
+struct ReferenceRowSolver : public btSequentialImpulseConstraintSolver
+{
+	btSimdScalar	solveLowerLimit(btSolverBody& bodyA, btSolverBody& bodyB, const btSolverConstraint& c)
+	{
+		return resolveSingleConstraintRowLowerLimit(bodyA,bodyB,c);
+	}
+};
+
+enum
+{
+	STATIC_BODY = 0,		///< no m_originalBody, like the solver's fixed body
+	KINEMATIC_BODY = 1,		///< m_originalBody with zero inverse mass
+	FIRST_DYNAMIC_BODY = 2,
+	BODY_COUNT = FIRST_DYNAMIC_BODY + 2*btSolverContactBlock::LANE_COUNT
+};
+
+static void	initSolverBody(btSolverBody& body, btRigidBody* rb, TestRandom& rnd)
+{
+	body.m_worldTransform.setIdentity();
+	body.m_originalBody = rb;
+	body.m_linearFactor = rb ? btVector3(rnd.uniform(btScalar(0.5),1),rnd.uniform(btScalar(0.5),1),rnd.uniform(btScalar(0.5),1)) : btVector3(1,1,1);
+	body.m_angularFactor = rb ? btVector3(rnd.uniform(btScalar(0.5),1),rnd.uniform(btScalar(0.5),1),rnd.uniform(btScalar(0.5),1)) : btVector3(1,1,1);
+	//like btSequentialImpulseConstraintSolver::initSolverBody
+	body.m_invMass = rb ? rb->getInvMass()*body.m_linearFactor : btVector3(0,0,0);
+	//bodies with zero inverse mass never get a velocity change
+	bool dynamic = rb && rb->getInvMass() != btScalar(0);
+	body.m_deltaLinearVelocity = dynamic ? rnd.vector(-2,2) : btVector3(0,0,0);
+	body.m_deltaAngularVelocity = dynamic ? rnd.vector(-2,2) : btVector3(0,0,0);
+	body.m_pushVelocity.setValue(0,0,0);
+	body.m_turnVelocity.setValue(0,0,0);
+	body.m_linearVelocity.setValue(0,0,0);
+	body.m_angularVelocity.setValue(0,0,0);
+	body.m_externalForceImpulse.setValue(0,0,0);
+	body.m_externalTorqueImpulse.setValue(0,0,0);
+}
+
+static void	initContactRow(btSolverConstraint& c, int bodyIdA, int bodyIdB, const btSolverBody* bodies, TestRandom& rnd)
+{
+	memset(&c,0,sizeof(c));
+	btVector3 normal = rnd.direction();
+	c.m_contactNormal1 = normal;
+	c.m_contactNormal2 = -normal;
+	c.m_relpos1CrossNormal = rnd.vector(-1,1);
+	c.m_relpos2CrossNormal = rnd.vector(-1,1);
+	//the inverse inertia times the relative position cross normal, zero for bodies with zero inverse mass
+	c.m_angularComponentA = bodies[bodyIdA].m_invMass.isZero() ? btVector3(0,0,0) : rnd.vector(-1,1);
+	c.m_angularComponentB = bodies[bodyIdB].m_invMass.isZero() ? btVector3(0,0,0) : rnd.vector(-1,1);
+	c.m_solverBodyIdA = bodyIdA;
+	c.m_solverBodyIdB = bodyIdB;
+	c.m_rhs = rnd.uniform(-2,2);
+	c.m_cfm = rnd.uniform(0,btScalar(0.1));
+	c.m_jacDiagABInv = rnd.uniform(btScalar(0.1),2);
+	c.m_lowerLimit = 0;
+	c.m_upperLimit = btScalar(1e10);
+	c.m_appliedImpulse = rnd.uniform(0,1);
+}
+
+static void	expectNearVector(const btVector3& expected, const btVector3& actual, btScalar tolerance, const char* what, int trial, int lane)
+{
+	for (int k=0;k<3;k++)
+	{
+		EXPECT_NEAR(expected[k],actual[k],tolerance*btMax(btScalar(1.),btFabs(expected[k]))) << what << " trial: " << trial << " lane: " << lane;
+	}
+}
+
+}
+
+
+TEST(BulletDynamicsTest, ContactBlockMatchesSingleRowSolver)
+{
+	btSphereShape shape(btScalar(0.5));
+	btRigidBody::btRigidBodyConstructionInfo kinematicInfo(0,0,&shape);
+	btRigidBody kinematic(kinematicInfo);
+	kinematic.setCollisionFlags(kinematic.getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);
+	btAlignedObjectArray<btRigidBody*> dynamicBodies;
+	TestRandom rnd(12345);
+	for (int i=FIRST_DYNAMIC_BODY;i<BODY_COUNT;i++)
+	{
+		btScalar mass = rnd.uniform(btScalar(0.5),5);
+		btRigidBody::btRigidBodyConstructionInfo info(mass,0,&shape,btVector3(1,1,1));
+		dynamicBodies.push_back(new btRigidBody(info));
+	}
+
+	ReferenceRowSolver reference;
+	const int laneCount = btSolverContactBlock::LANE_COUNT;
+	//the block multiplies the factors in another order than btSolverBody::internalApplyImpulse
+#ifdef BT_USE_DOUBLE_PRECISION
+	const btScalar tolerance = btScalar(1e-12);
+#else
+	const btScalar tolerance = btScalar(1e-5);
+#endif
+	int numClamped = 0;
+	for (int trial=0;trial<200;trial++)
+	{
+		btSolverBody bodies[BODY_COUNT];
+		initSolverBody(bodies[STATIC_BODY],0,rnd);
+		initSolverBody(bodies[KINEMATIC_BODY],&kinematic,rnd);
+		for (int i=FIRST_DYNAMIC_BODY;i<BODY_COUNT;i++)
+		{
+			initSolverBody(bodies[i],dynamicBodies[i-FIRST_DYNAMIC_BODY],rnd);
+		}
+
+		//every lane has its own dynamic bodies, the static and kinematic body are shared, some lanes are unused
+		btSolverConstraint rows[btSolverContactBlock::LANE_COUNT];
+		int rowIndices[btSolverContactBlock::LANE_COUNT];
+		for (int lane=0;lane<laneCount;lane++)
+		{
+			int bodyIdA = FIRST_DYNAMIC_BODY + 2*lane;
+			int bodyIdB = bodyIdA + 1;
+			int pick = int(rnd.uniform(0,4));
+			if (pick == 1)
+				bodyIdB = STATIC_BODY;
+			else if (pick == 2)
+				bodyIdA = KINEMATIC_BODY;
+			initContactRow(rows[lane],bodyIdA,bodyIdB,bodies,rnd);
+			rowIndices[lane] = (rnd.uniform(0,1) < btScalar(0.1)) ? -1 : lane;
+		}
+
+		btSolverBody blockBodies[BODY_COUNT];
+		btSolverConstraint blockRows[btSolverContactBlock::LANE_COUNT];
+		for (int i=0;i<BODY_COUNT;i++)
+			blockBodies[i] = bodies[i];
+		for (int lane=0;lane<laneCount;lane++)
+			blockRows[lane] = rows[lane];
+		btSolverContactBlock block;
+		block.init(rowIndices,blockRows,blockBodies);
+		block.solveLowerLimit(blockBodies,blockRows);
+
+		for (int lane=0;lane<laneCount;lane++)
+		{
+			if (rowIndices[lane] < 0)
+				continue;
+			btSolverConstraint& c = rows[lane];
+			reference.solveLowerLimit(bodies[c.m_solverBodyIdA],bodies[c.m_solverBodyIdB],c);
+			if (c.m_appliedImpulse == c.m_lowerLimit)
+				numClamped++;
+			EXPECT_NEAR(c.m_appliedImpulse,blockRows[lane].m_appliedImpulse,tolerance*btMax(btScalar(1.),btFabs(c.m_appliedImpulse))) << "applied impulse trial: " << trial << " lane: " << lane;
+		}
+		for (int lane=0;lane<laneCount;lane++)
+		{
+			for (int i=FIRST_DYNAMIC_BODY+2*lane;i<FIRST_DYNAMIC_BODY+2*lane+2;i++)
+			{
+				expectNearVector(bodies[i].m_deltaLinearVelocity,blockBodies[i].m_deltaLinearVelocity,tolerance,"linear velocity",trial,lane);
+				expectNearVector(bodies[i].m_deltaAngularVelocity,blockBodies[i].m_deltaAngularVelocity,tolerance,"angular velocity",trial,lane);
+			}
+		}
+		//the shared bodies are never written
+		for (int i=STATIC_BODY;i<FIRST_DYNAMIC_BODY;i++)
+		{
+			EXPECT_TRUE(blockBodies[i].m_deltaLinearVelocity.isZero()) << "trial: " << trial;
+			EXPECT_TRUE(blockBodies[i].m_deltaAngularVelocity.isZero()) << "trial: " << trial;
+		}
+		if (HasFailure())
+			break;
+	}
+	//the random rows take both branches of the lower limit
+	EXPECT_GT(numClamped,0);
+
+	for (int i=0;i<dynamicBodies.size();i++)
+	{
+		delete dynamicBodies[i];
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,300 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///Steps identical articulations with different states through btMultiBodyEnsemble and, one by one, through
+///btMultiBody::stepVelocitiesMultiDof, stepPositionsMultiDof and forwardKinematics, and compares the results.
+///Also compares calcAccelerationDeltas with btMultiBody::calcAccelerationDeltasMultiDof.
+
+
+#include <gtest/gtest.h>
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletDynamics/Featherstone/btMultiBody.h"
+#include "BulletDynamics/Featherstone/btMultiBodyEnsemble.h"
+
+
+namespace
+{
+
+///a chain with revolute joints about different axes, a prismatic and a fixed joint, and a branch off the base
+static btMultiBody*	createArticulation(bool fixedBase)
+{
+	btVector3 inertia(btScalar(0.05),btScalar(0.02),btScalar(0.05));
+	btMultiBody* mb = new btMultiBody(6,2,inertia*2,fixedBase,false,true);
+	btVector3 parentComToPivot(0,btScalar(-0.3),0);
+	btVector3 pivotToCom(0,btScalar(-0.3),0);
+	btQuaternion tilt(btVector3(0,1,0),btScalar(0.3));
+	mb->setupRevolute(0,1,inertia,-1,btQuaternion::getIdentity(),btVector3(1,0,0),parentComToPivot,pivotToCom);
+	mb->setupRevolute(1,btScalar(0.8),inertia,0,tilt,btVector3(0,0,1),parentComToPivot,pivotToCom);
+	mb->setupPrismatic(2,btScalar(0.5),inertia,1,btQuaternion::getIdentity(),btVector3(0,1,0),parentComToPivot,pivotToCom,true);
+	mb->setupFixed(3,btScalar(0.3),inertia,2,tilt,parentComToPivot,pivotToCom,true);
+	mb->setupRevolute(4,btScalar(0.6),inertia,3,btQuaternion::getIdentity(),btVector3(1,0,1).normalized(),parentComToPivot,pivotToCom);
+	mb->setupRevolute(5,btScalar(0.7),inertia,-1,btQuaternion::getIdentity(),btVector3(0,0,1),btVector3(btScalar(0.2),0,0),btVector3(btScalar(0.3),0,0));
+	mb->finalizeMultiDof();
+	return mb;
+}
+
+///a different state per instance, from smooth functions of the instance index
+static void	setInstanceState(btMultiBody* mb, int instance)
+{
+	btScalar s = btScalar(instance);
+	mb->setBasePos(btVector3(s,1,0));
+	if (!mb->hasFixedBase())
+	{
+		mb->setWorldToBaseRot(btQuaternion(btVector3(1,1,0).normalized(),btScalar(0.2)*s));
+		mb->setBaseVel(btVector3(btSin(s),btScalar(0.5),btCos(s)));
+		mb->setBaseOmega(btVector3(btScalar(0.3)*btCos(s),btScalar(0.2),btScalar(0.1)*btSin(s)));
+	}
+	for (int i=0;i<mb->getNumLinks();i++)
+	{
+		if (mb->getLink(i).m_dofCount)
+		{
+			btScalar q = btScalar(0.4)*btSin(s*btScalar(1.7)+btScalar(i));
+			btScalar qdot = btScalar(0.5)*btCos(s*btScalar(0.9)+btScalar(2*i));
+			if (mb->getLink(i).m_jointType == btMultibodyLink::ePrismatic)
+			{
+				q *= btScalar(0.2);
+				qdot *= btScalar(0.2);
+			}
+			mb->setJointPosMultiDof(i,&q);
+			mb->setJointVelMultiDof(i,&qdot);
+		}
+	}
+}
+
+static void	expectNearVector(const btVector3& expected, const btVector3& actual, btScalar tolerance, const char* what, int instance)
+{
+	for (int k=0;k<3;k++)
+	{
+		EXPECT_NEAR(expected[k],actual[k],tolerance*btMax(btScalar(1.),btFabs(expected[k]))) << what << " of instance: " << instance;
+	}
+}
+
+static void	compareEnsembleWithSingleBodies(bool fixedBase)
+{
+	const int numInstances = 11;
+	const btScalar dt = btScalar(1.)/btScalar(240.);
+	const btVector3 gravity(0,-10,0);
+
+	btMultiBody* templateBody = createArticulation(fixedBase);
+	ASSERT_TRUE(btMultiBodyEnsemble::isSupported(templateBody));
+	btMultiBodyEnsemble ensemble(templateBody,numInstances);
+	ASSERT_EQ(numInstances,ensemble.getNumInstances());
+
+	btAlignedObjectArray<btMultiBody*> bodies;
+	for (int i=0;i<numInstances;i++)
+	{
+		btMultiBody* mb = createArticulation(fixedBase);
+		setInstanceState(mb,i);
+		//joint torques that differ per instance too
+		mb->addJointTorque(4,btScalar(0.01)*btScalar(i));
+		ensemble.setInstanceFromMultiBody(i,mb);
+		bodies.push_back(mb);
+	}
+
+	btAlignedObjectArray<btScalar> scratch_r;
+	btAlignedObjectArray<btVector3> scratch_v;
+	btAlignedObjectArray<btMatrix3x3> scratch_m;
+	btAlignedObjectArray<btQuaternion> scratch_q;
+	btAlignedObjectArray<btVector3> scratch_o;
+	for (int step=0;step<240;step++)
+	{
+		for (int i=0;i<numInstances;i++)
+		{
+			//the weight, like btMultiBodyDynamicsWorld adds it
+			btMultiBody* mb = bodies[i];
+			mb->addBaseForce(gravity*mb->getBaseMass());
+			for (int j=0;j<mb->getNumLinks();j++)
+			{
+				mb->addLinkForce(j,gravity*mb->getLinkMass(j));
+			}
+			mb->stepVelocitiesMultiDof(dt,scratch_r,scratch_v,scratch_m);
+			mb->stepPositionsMultiDof(dt);
+			mb->forwardKinematics(scratch_q,scratch_o);
+			mb->clearForcesAndTorques();
+		}
+		ensemble.addGravity(gravity);
+		ensemble.stepVelocities(dt);
+		ensemble.stepPositions(dt);
+		ensemble.forwardKinematics();
+		ensemble.clearForcesAndTorques();
+	}
+
+	//the two paths only differ in the order of the operations, so the differences stay at the rounding level after 240 steps
+#ifdef BT_USE_DOUBLE_PRECISION
+	const btScalar tolerance = btScalar(1e-6);
+#else
+	const btScalar tolerance = btScalar(5e-6);
+#endif
+	for (int i=0;i<numInstances;i++)
+	{
+		const btMultiBody* mb = bodies[i];
+		expectNearVector(mb->getBasePos(),ensemble.getBasePos(i),tolerance,"base position",i);
+		expectNearVector(mb->getBaseVel(),ensemble.getBaseVel(i),tolerance,"base velocity",i);
+		expectNearVector(mb->getBaseOmega(),ensemble.getBaseOmega(i),tolerance,"base angular velocity",i);
+		btQuaternion expectedRot = mb->getWorldToBaseRot();
+		btQuaternion rot = ensemble.getWorldToBaseRot(i);
+		EXPECT_NEAR(btScalar(1.),btFabs(expectedRot.dot(rot)),tolerance) << "base orientation of instance: " << i;
+		for (int j=0;j<mb->getNumLinks();j++)
+		{
+			if (mb->getLink(j).m_dofCount)
+			{
+				EXPECT_NEAR(mb->getJointPosMultiDof(j)[0],ensemble.getJointPos(i,j),tolerance) << "instance: " << i << " joint position: " << j;
+				EXPECT_NEAR(mb->getJointVelMultiDof(j)[0],ensemble.getJointVel(i,j),tolerance) << "instance: " << i << " joint velocity: " << j;
+			}
+			const btTransform& expected = mb->getLink(j).m_cachedWorldTransform;
+			btTransform tr = ensemble.getLinkWorldTransform(i,j);
+			expectNearVector(expected.getOrigin(),tr.getOrigin(),tolerance,"link origin",i);
+			for (int k=0;k<3;k++)
+			{
+				expectNearVector(expected.getBasis()[k],tr.getBasis()[k],tolerance,"link basis",i);
+			}
+		}
+	}
+
+	//the instances really moved, and not all the same way
+	EXPECT_GT(btFabs(bodies[0]->getJointPosMultiDof(0)[0]-bodies[1]->getJointPosMultiDof(0)[0]),btScalar(0.01));
+	EXPECT_GT((bodies[0]->getLink(4).m_cachedWorldTransform.getOrigin()-templateBody->getBasePos()).length(),btScalar(0.1));
+
+	for (int i=0;i<numInstances;i++)
+	{
+		delete bodies[i];
+	}
+	delete templateBody;
+}
+
+///applies different unit forces per instance with calcAccelerationDeltas and btMultiBody::calcAccelerationDeltasMultiDof
+static void	compareAccelerationDeltasWithSingleBodies(bool fixedBase)
+{
+	//more instances than one block holds, and a partly filled last block
+	const int numInstances = 2*btMultiBodyEnsemble::getLaneCount()+3;
+	const btScalar dt = btScalar(1.)/btScalar(240.);
+	const btVector3 gravity(0,-10,0);
+
+	btMultiBody* templateBody = createArticulation(fixedBase);
+	btMultiBodyEnsemble ensemble(templateBody,numInstances);
+	ASSERT_EQ(numInstances,ensemble.getNumInstances());
+	const int numEntries = 6+ensemble.getNumDofs();
+
+	btAlignedObjectArray<btMultiBody*> bodies;
+	for (int i=0;i<numInstances;i++)
+	{
+		btMultiBody* mb = createArticulation(fixedBase);
+		setInstanceState(mb,i);
+		ensemble.setInstanceFromMultiBody(i,mb);
+		bodies.push_back(mb);
+	}
+
+	//one step, so the articulated inertias of both paths are those of the same state
+	btAlignedObjectArray<btScalar> scratch_r;
+	btAlignedObjectArray<btVector3> scratch_v;
+	btAlignedObjectArray<btMatrix3x3> scratch_m;
+	for (int i=0;i<numInstances;i++)
+	{
+		btMultiBody* mb = bodies[i];
+		mb->addBaseForce(gravity*mb->getBaseMass());
+		for (int j=0;j<mb->getNumLinks();j++)
+		{
+			mb->addLinkForce(j,gravity*mb->getLinkMass(j));
+		}
+		mb->stepVelocitiesMultiDof(dt,scratch_r,scratch_v,scratch_m);
+	}
+	ensemble.addGravity(gravity);
+	ensemble.stepVelocities(dt);
+
+	btAlignedObjectArray<btScalar> force;
+	btAlignedObjectArray<btScalar> output;
+	force.resize(ensemble.getDofVectorSize(),btScalar(0));
+	output.resize(ensemble.getDofVectorSize(),btScalar(0));
+	for (int i=0;i<numInstances;i++)
+	{
+		for (int k=0;k<numEntries;k++)
+		{
+			force[ensemble.getDofVectorIndex(i,k)] = btSin(btScalar(i*numEntries+k));
+		}
+	}
+	ensemble.calcAccelerationDeltas(&force[0],&output[0]);
+
+#ifdef BT_USE_DOUBLE_PRECISION
+	const btScalar tolerance = btScalar(1e-9);
+#else
+	const btScalar tolerance = btScalar(1e-5);
+#endif
+	btAlignedObjectArray<btScalar> singleForce;
+	btAlignedObjectArray<btScalar> singleOutput;
+	singleForce.resize(numEntries);
+	singleOutput.resize(numEntries);
+	for (int i=0;i<numInstances;i++)
+	{
+		for (int k=0;k<numEntries;k++)
+		{
+			singleForce[k] = force[ensemble.getDofVectorIndex(i,k)];
+		}
+		bodies[i]->calcAccelerationDeltasMultiDof(&singleForce[0],&singleOutput[0],scratch_r,scratch_v);
+		for (int k=0;k<numEntries;k++)
+		{
+			btScalar actual = output[ensemble.getDofVectorIndex(i,k)];
+			EXPECT_NEAR(singleOutput[k],actual,tolerance*btMax(btScalar(1.),btFabs(singleOutput[k]))) << "instance: " << i << " entry: " << k;
+		}
+	}
+
+	for (int i=0;i<numInstances;i++)
+	{
+		delete bodies[i];
+	}
+	delete templateBody;
+}
+
+}
+
+
+TEST(BulletMultiBodyTest, EnsembleMatchesSingleBodiesWithFixedBase)
+{
+	compareEnsembleWithSingleBodies(true);
+}
+
+TEST(BulletMultiBodyTest, EnsembleMatchesSingleBodiesWithFloatingBase)
+{
+	compareEnsembleWithSingleBodies(false);
+}
+
+TEST(BulletMultiBodyTest, EnsembleAccelerationDeltasMatchSingleBodiesWithFixedBase)
+{
+	compareAccelerationDeltasWithSingleBodies(true);
+}
+
+TEST(BulletMultiBodyTest, EnsembleAccelerationDeltasMatchSingleBodiesWithFloatingBase)
+{
+	compareAccelerationDeltasWithSingleBodies(false);
+}
+
+TEST(BulletMultiBodyTest, EnsembleRefusesUnsupportedBodies)
+{
+	btVector3 inertia(1,1,1);
+	btMultiBody* mb = new btMultiBody(1,1,inertia,false,false,true);
+	mb->setupSpherical(0,1,inertia,-1,btQuaternion::getIdentity(),btVector3(0,-1,0),btVector3(0,-1,0));
+	mb->finalizeMultiDof();
+	ASSERT_FALSE(btMultiBodyEnsemble::isSupported(mb));
+
+	btMultiBodyEnsemble ensemble(mb,5);
+	ASSERT_EQ(0,ensemble.getNumInstances());
+	ASSERT_EQ(0,ensemble.getDofVectorSize());
+	ensemble.addGravity(btVector3(0,-10,0));
+	ensemble.stepVelocities(btScalar(0.01));
+	ensemble.stepPositions(btScalar(0.01));
+	ensemble.forwardKinematics();
+	ensemble.clearForcesAndTorques();
+	delete mb;
+}
@@ -0,0 +1,427 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  http://continuousphysics.com/Bullet/
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+///Routes all Bullet allocations through a counting allocator and checks that btScratchArena, the btMultiBody queries
+///and the stepping of a btMultiBodyDynamicsWorld don't allocate anymore after a warm-up.
+///Also compares the contact solution with SOLVER_MULTIBODY_SPARSE_JACOBIANS to the one with dense Jacobians,
+///and checks the direct solve of joint motors, against PGS with many iterations.
+
+
+#include <gtest/gtest.h>
+
+#include "btBulletDynamicsCommon.h"
+#include "BulletDynamics/Featherstone/btMultiBody.h"
+#include "BulletDynamics/Featherstone/btMultiBodyLinkCollider.h"
+#include "BulletDynamics/Featherstone/btMultiBodyConstraintSolver.h"
+#include "BulletDynamics/Featherstone/btMultiBodyDynamicsWorld.h"
+#include "BulletDynamics/Featherstone/btMultiBodyJointMotor.h"
+#include "BulletDynamics/MLCPSolvers/btDantzigSolver.h"
+#include "LinearMath/btScratchArena.h"
+
+#include <stdlib.h>
+
+
+static int	gNumAllocations = 0;
+
+static void*	countingAlloc(size_t size)
+{
+	gNumAllocations++;
+	return malloc(size);
+}
+
+static void	countingFree(void* ptr)
+{
+	free(ptr);
+}
+
+
+struct MultiBodyScene
+{
+	btDefaultCollisionConfiguration	m_collisionConfiguration;
+	btCollisionDispatcher*	m_dispatcher;
+	btDbvtBroadphase*	m_broadphase;
+	btMultiBodyConstraintSolver*	m_solver;
+	btMultiBodyDynamicsWorld*	m_world;
+	btAlignedObjectArray<btCollisionShape*>	m_shapes;
+	btAlignedObjectArray<btMultiBody*>	m_multiBodies;
+
+	MultiBodyScene()
+	{
+		m_dispatcher = new btCollisionDispatcher(&m_collisionConfiguration);
+		m_broadphase = new btDbvtBroadphase();
+		m_solver = new btMultiBodyConstraintSolver();
+		m_world = new btMultiBodyDynamicsWorld(m_dispatcher,m_broadphase,m_solver,&m_collisionConfiguration);
+		m_world->setGravity(btVector3(0,-10,0));
+
+		btBoxShape* groundShape = new btBoxShape(btVector3(50,1,50));
+		m_shapes.push_back(groundShape);
+		btTransform tr;
+		tr.setIdentity();
+		tr.setOrigin(btVector3(0,-1,0));
+		btRigidBody* ground = new btRigidBody(0,new btDefaultMotionState(tr),groundShape);
+		m_world->addRigidBody(ground,1,1+2);
+
+		//a pendulum hanging from a fixed base and a floating chain that falls onto the ground
+		createChain(btVector3(-3,8,0),5,false);
+		createChain(btVector3(3,2,0),4,true);
+	}
+
+	~MultiBodyScene()
+	{
+		for (int i=m_world->getNumMultiBodyConstraints()-1;i>=0;i--)
+		{
+			btMultiBodyConstraint* c = m_world->getMultiBodyConstraint(i);
+			m_world->removeMultiBodyConstraint(c);
+			delete c;
+		}
+		for (int i=0;i<m_multiBodies.size();i++)
+		{
+			btMultiBody* mb = m_multiBodies[i];
+			m_world->removeMultiBody(mb);
+			delete mb;
+		}
+		for (int i=m_world->getNumCollisionObjects()-1;i>=0;i--)
+		{
+			btCollisionObject* colObj = m_world->getCollisionObjectArray()[i];
+			btRigidBody* body = btRigidBody::upcast(colObj);
+			if (body && body->getMotionState())
+			{
+				delete body->getMotionState();
+			}
+			m_world->removeCollisionObject(colObj);
+			delete colObj;
+		}
+		for (int i=0;i<m_shapes.size();i++)
+		{
+			delete m_shapes[i];
+		}
+		delete m_world;
+		delete m_solver;
+		delete m_broadphase;
+		delete m_dispatcher;
+	}
+
+	btMultiBody*	createChain(const btVector3& basePosition, int numLinks, bool floating)
+	{
+		btVector3 halfExtents(0.1f,0.3f,0.1f);
+		btBoxShape* box = new btBoxShape(halfExtents);
+		m_shapes.push_back(box);
+		btVector3 inertia;
+		box->calculateLocalInertia(1,inertia);
+
+		btMultiBody* mb = new btMultiBody(numLinks,1,inertia,!floating,false,true);
+		mb->setBasePos(basePosition);
+		btVector3 parentComToPivot(0,-halfExtents[1],0);
+		btVector3 pivotToCom(0,-halfExtents[1],0);
+		for (int i=0;i<numLinks;i++)
+		{
+			btVector3 axis = (i & 1) ? btVector3(0,0,1) : btVector3(1,0,0);
+			mb->setupRevolute(i,1,inertia,i-1,btQuaternion::getIdentity(),axis,parentComToPivot,pivotToCom,true);
+		}
+		mb->finalizeMultiDof();
+		btScalar q = btScalar(0.5);
+		mb->setJointPosMultiDof(0,&q);
+		m_world->addMultiBody(mb);
+
+		btMultiBodyLinkCollider* baseCollider = new btMultiBodyLinkCollider(mb,-1);
+		baseCollider->setCollisionShape(box);
+		m_world->addCollisionObject(baseCollider,2,1+2);
+		mb->setBaseCollider(baseCollider);
+		for (int i=0;i<numLinks;i++)
+		{
+			btMultiBodyLinkCollider* col = new btMultiBodyLinkCollider(mb,i);
+			col->setCollisionShape(box);
+			m_world->addCollisionObject(col,2,1+2);
+			mb->getLink(i).m_collider = col;
+		}
+		mb->updateCollisionObjectWorldTransforms();
+		m_multiBodies.push_back(mb);
+		return mb;
+	}
+
+	void	step()
+	{
+		m_world->stepSimulation(btScalar(1.)/btScalar(60.),0);
+	}
+};
+
+
+TEST(BulletMultiBodyTest, ScratchArenaAllocatesOnlyDuringWarmUp)
+{
+	btScratchArena arena;
+	for (int round=0;round<3;round++)
+	{
+		int numAllocations = gNumAllocations;
+		{
+			btScratchArenaScope outer(arena);
+			btVector3* a = arena.allocate<btVector3>(10);
+			a[9] = btVector3(1,2,3);
+			{
+				btScratchArenaScope inner(arena);
+				btScalar* b = arena.allocate<btScalar>(1000);
+				b[999] = 1;
+				ASSERT_EQ(0,((size_t) b) & 15);
+			}
+			btQuaternion* c = arena.allocate<btQuaternion>(20);
+			ASSERT_EQ(0,((size_t) c) & 15);
+			c[19] = btQuaternion::getIdentity();
+		}
+		if (round == 0)
+		{
+			//the counting allocator sees the warm-up
+			ASSERT_LT(numAllocations,gNumAllocations);
+		}
+		else
+		{
+			ASSERT_EQ(numAllocations,gNumAllocations) << "round: " << round;
+		}
+	}
+	ASSERT_GE(arena.getCapacity(),int(1000*sizeof(btScalar)));
+}
+
+TEST(BulletMultiBodyTest, QueriesDontAllocateAfterWarmUp)
+{
+	MultiBodyScene scene;
+	scene.step();
+	for (int round=0;round<3;round++)
+	{
+		int numAllocations = gNumAllocations;
+		for (int i=0;i<scene.m_multiBodies.size();i++)
+		{
+			btMultiBody* mb = scene.m_multiBodies[i];
+			mb->getKineticEnergy();
+			mb->getAngularMomentum();
+			mb->forwardKinematics();
+			mb->updateCollisionObjectWorldTransforms();
+		}
+		if (round > 0)
+		{
+			ASSERT_EQ(numAllocations,gNumAllocations) << "round: " << round;
+		}
+	}
+}
+
+TEST(BulletMultiBodyTest, SteppingDoesntAllocateAfterWarmUp)
+{
+	MultiBodyScene scene;
+	//let the floating chain land and settle, so the set of contacts stops growing
+	for (int i=0;i<240;i++)
+	{
+		scene.step();
+	}
+	int numAllocations = gNumAllocations;
+	for (int i=0;i<120;i++)
+	{
+		scene.step();
+		for (int j=0;j<scene.m_multiBodies.size();j++)
+		{
+			scene.m_multiBodies[j]->getKineticEnergy();
+		}
+	}
+	ASSERT_EQ(numAllocations,gNumAllocations);
+}
+
+TEST(BulletMultiBodyTest, SparseJacobiansMatchDenseJacobians)
+{
+	MultiBodyScene dense;
+	MultiBodyScene sparse;
+	sparse.m_world->getSolverInfo().m_solverMode |= SOLVER_MULTIBODY_SPARSE_JACOBIANS;
+	for (int i=0;i<240;i++)
+	{
+		dense.step();
+		sparse.step();
+	}
+	for (int i=0;i<dense.m_multiBodies.size();i++)
+	{
+		const btMultiBody* a = dense.m_multiBodies[i];
+		const btMultiBody* b = sparse.m_multiBodies[i];
+		ASSERT_NEAR(0,(a->getBasePos()-b->getBasePos()).length(),1e-3);
+		for (int j=0;j<a->getNumLinks();j++)
+		{
+			ASSERT_NEAR(a->getJointPos(j),b->getJointPos(j),1e-3) << "body: " << i << " link: " << j;
+		}
+	}
+}
+
+static btScalar	motorVelocityError(bool direct)
+{
+	MultiBodyScene scene;
+	btDantzigSolver mlcp;
+	if (direct)
+	{
+		scene.m_solver->setJointConstraintSolver(&mlcp);
+	}
+	scene.m_world->getSolverInfo().m_numIterations = 2;
+	//drive every joint of the pendulum, the motors are coupled through the chain
+	btMultiBody* pendulum = scene.m_multiBodies[0];
+	for (int i=0;i<pendulum->getNumLinks();i++)
+	{
+		scene.m_world->addMultiBodyConstraint(new btMultiBodyJointMotor(pendulum,i,btScalar(1.),btScalar(100.)));
+	}
+	btScalar maxError = 0;
+	for (int step=0;step<10;step++)
+	{
+		scene.step();
+		for (int i=0;i<pendulum->getNumLinks();i++)
+		{
+			maxError = btMax(maxError,btFabs(pendulum->getJointVel(i)-btScalar(1.)));
+		}
+	}
+	if (direct)
+	{
+		EXPECT_EQ(0,scene.m_solver->getNumFallbacks());
+		scene.m_solver->setJointConstraintSolver(0);
+	}
+	return maxError;
+}
+
+TEST(BulletMultiBodyTest, DirectJointSolveConvergesInFewIterations)
+{
+	btScalar pgsError = motorVelocityError(false);
+	btScalar directError = motorVelocityError(true);
+	ASSERT_LT(directError,btScalar(1e-3));
+	ASSERT_LT(directError,pgsError);
+}
+
+///joint velocities of the pendulum after driving all of its joints with motors of the given strength
+static void	motorJointVelocities(bool direct, int numIterations, btScalar maxMotorImpulse, btAlignedObjectArray<btScalar>& velocities)
+{
+	MultiBodyScene scene;
+	btDantzigSolver mlcp;
+	if (direct)
+	{
+		scene.m_solver->setJointConstraintSolver(&mlcp);
+	}
+	scene.m_world->getSolverInfo().m_numIterations = numIterations;
+	btMultiBody* pendulum = scene.m_multiBodies[0];
+	for (int i=0;i<pendulum->getNumLinks();i++)
+	{
+		scene.m_world->addMultiBodyConstraint(new btMultiBodyJointMotor(pendulum,i,btScalar(1.),maxMotorImpulse));
+	}
+	for (int step=0;step<10;step++)
+	{
+		scene.step();
+	}
+	velocities.resize(0);
+	for (int i=0;i<pendulum->getNumLinks();i++)
+	{
+		velocities.push_back(pendulum->getJointVel(i));
+	}
+	if (direct)
+	{
+		EXPECT_EQ(0,scene.m_solver->getNumFallbacks());
+		scene.m_solver->setJointConstraintSolver(0);
+	}
+}
+
+TEST(BulletMultiBodyTest, DirectJointSolveMatchesConvergedPgs)
+{
+	//strong motors reach their target, so the linear system is solved directly. Weak motors are clamped at their maximum impulse,
+	//which needs the MLCP solver
+	const btScalar maxMotorImpulses[2] = { btScalar(100.), btScalar(0.02) };
+	for (int i=0;i<2;i++)
+	{
+		btAlignedObjectArray<btScalar> pgs,direct;
+		motorJointVelocities(false,1000,maxMotorImpulses[i],pgs);
+		motorJointVelocities(true,2,maxMotorImpulses[i],direct);
+		int numClamped = 0;
+		for (int j=0;j<pgs.size();j++)
+		{
+			ASSERT_NEAR(pgs[j],direct[j],1e-3) << "max motor impulse: " << maxMotorImpulses[i] << " joint: " << j;
+			numClamped += (direct[j] < btScalar(0.9)) ? 1 : 0;
+		}
+		ASSERT_EQ(i == 1,numClamped > 0);
+	}
+}
+
+///steps a scene with more chains than fit in one task, with the per multi body passes serial or in parallel
+static void	runParallelIntegrationScene(bool parallel, btAlignedObjectArray<btScalar>& state)
+{
+	MultiBodyScene scene;
+	for (int i=0;i<10;i++)
+	{
+		scene.createChain(btVector3(btScalar(i-5)*btScalar(1.5),btScalar(3+i%3),btScalar(4)),3+i%3,(i&1)!=0);
+	}
+	scene.m_world->setParallelMultiBodyIntegration(parallel);
+	for (int i=0;i<120;i++)
+	{
+		scene.step();
+	}
+	state.resize(0);
+	for (int i=0;i<scene.m_multiBodies.size();i++)
+	{
+		const btMultiBody* mb = scene.m_multiBodies[i];
+		for (int k=0;k<3;k++)
+		{
+			state.push_back(mb->getBasePos()[k]);
+			state.push_back(mb->getBaseVel()[k]);
+			state.push_back(mb->getBaseOmega()[k]);
+		}
+		for (int k=0;k<4;k++)
+		{
+			state.push_back(mb->getWorldToBaseRot()[k]);
+		}
+		for (int j=0;j<mb->getNumLinks();j++)
+		{
+			state.push_back(mb->getJointPosMultiDof(j)[0]);
+			state.push_back(mb->getJointVelMultiDof(j)[0]);
+		}
+	}
+}
+
+TEST(BulletMultiBodyTest, ParallelIntegrationMatchesSerialIntegration)
+{
+	btAlignedObjectArray<btScalar> serial;
+	runParallelIntegrationScene(false,serial);
+
+	//every available scheduler, and a change of the thread count in between, which hands out the thread indices anew
+	btITaskScheduler* previousScheduler = btGetTaskScheduler();
+	btITaskScheduler* schedulers[3] = {btGetSequentialTaskScheduler(),btGetOpenMPTaskScheduler(),btGetThreadPoolTaskScheduler()};
+	int numThreads[3] = {2,4,3};
+	for (int i=0;(i<3)&&!::testing::Test::HasFailure();i++)
+	{
+		if (!schedulers[i])
+		{
+			continue;
+		}
+		int previousNumThreads = schedulers[i]->getNumThreads();
+		btSetTaskScheduler(schedulers[i]);
+		for (int j=0;(j<3)&&!::testing::Test::HasFailure();j++)
+		{
+			schedulers[i]->setNumThreads(numThreads[j]);
+			btAlignedObjectArray<btScalar> parallel;
+			runParallelIntegrationScene(true,parallel);
+			EXPECT_EQ(serial.size(),parallel.size());
+			for (int k=0;(k<serial.size())&&(k<parallel.size());k++)
+			{
+				if (serial[k] != parallel[k])
+				{
+					ADD_FAILURE() << "scheduler: " << schedulers[i]->getName() << " threads: " << numThreads[j] << " value: " << k;
+					break;
+				}
+			}
+		}
+		//no ASSERT above, so the scheduler and its thread count are always restored
+		btSetTaskScheduler(previousScheduler);
+		schedulers[i]->setNumThreads(previousNumThreads);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	btAlignedAllocSetCustom(countingAlloc,countingFree);
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}